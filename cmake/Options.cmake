@@ -37,6 +37,7 @@ option(TP_BUILD_BENCHMARK "Build benchmarks" OFF)
 option(TP_BUILD_MISC "Build misc tools" OFF)
 option(TP_BUILD_PYTHON "Build python bindings" OFF)
 option(TP_BUILD_TESTING "Build tests" OFF)
+option(TP_ENABLE_LOCK_STATS "Account the contention of internal mutexes" OFF)
 
 # Whether to build a static or shared library
 if(BUILD_SHARED_LIBS)
@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+
+#include <tensorpipe/benchmark/transport_registry.h>
+#include <tensorpipe/common/defs.h>
+#include <tensorpipe/transport/connection.h>
+#include <tensorpipe/transport/context.h>
+#include <tensorpipe/transport/listener.h>
+
+// Measure the bandwidth of a single connection of a transport for very large
+// transfers (by default from 64MiB to 1GiB), which is where one core's worth
+// of copying becomes the bottleneck. The two endpoints are in the same process
+// but in different contexts, so that each of them has its own event loop (and
+// its own helper threads, if any), as they would across processes. Along with
+// the bandwidth it reports the CPU time (of both endpoints) spent per GB, as
+// some transports (e.g., uv with zero-copy receive) aim at reducing that. The
+// destination buffer is page-aligned, as that's required by some of them.
+
+using namespace tensorpipe;
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+using Data = std::unique_ptr<uint8_t[]>;
+
+struct Result {
+  double bandwidth; // In bytes per second
+  double cpuSecondsPerGB;
+};
+
+struct Options {
+  std::string transport{"shm"};
+  size_t minSize{64 * 1024 * 1024};
+  size_t maxSize{1024 * 1024 * 1024};
+  size_t numIterations{4};
+};
+
+std::string getListenAddress(const std::string& transport) {
+  // The shm transport picks a unique name when given an empty one.
+  if (transport == "shm") {
+    return "";
+  }
+  return "127.0.0.1";
+}
+
+std::shared_ptr<transport::Context> createContext(const std::string& name) {
+  std::shared_ptr<transport::Context> context =
+      TensorpipeTransportRegistry().create(name);
+  validateTransportContext(context);
+  return context;
+}
+
+double getCpuSeconds() {
+  struct rusage usage;
+  TP_THROW_SYSTEM_IF(::getrusage(RUSAGE_SELF, &usage) < 0, errno);
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+      usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+// Send the buffer the given number of times, with a single read in flight at a
+// time, and return the bandwidth and the CPU usage. The first transfer isn't
+// timed, as it pays for faulting in the pages and for starting any thread.
+Result measure(
+    transport::Connection& writer,
+    transport::Connection& reader,
+    size_t size,
+    size_t numIterations) {
+  Data src = std::make_unique<uint8_t[]>(size);
+  for (size_t i = 0; i < size; i++) {
+    src[i] = (i >> 8) ^ (i & 0xff);
+  }
+  uint8_t* dst = reinterpret_cast<uint8_t*>(::mmap(
+      nullptr,
+      size,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS,
+      /*fd=*/-1,
+      /*off=*/0));
+  TP_THROW_SYSTEM_IF(dst == MAP_FAILED, errno);
+
+  clock::time_point start;
+  double startCpuSeconds;
+  std::promise<void> doneProm;
+  size_t numReadsDone = 0;
+
+  std::function<void()> readNext = [&]() {
+    reader.read(dst, size, [&](const Error& error, const void*, size_t len) {
+      TP_THROW_ASSERT_IF(error) << error.what();
+      TP_DCHECK_EQ(len, size);
+      if (numReadsDone++ == 0) {
+        start = clock::now();
+        startCpuSeconds = getCpuSeconds();
+      }
+      if (numReadsDone == numIterations + 1) {
+        doneProm.set_value();
+        return;
+      }
+      readNext();
+    });
+  };
+
+  for (size_t iterIdx = 0; iterIdx < numIterations + 1; iterIdx++) {
+    writer.write(src.get(), size, [](const Error& error) {
+      TP_THROW_ASSERT_IF(error) << error.what();
+    });
+  }
+  readNext();
+  doneProm.get_future().get();
+  double seconds =
+      std::chrono::duration<double>(clock::now() - start).count();
+  double cpuSeconds = getCpuSeconds() - startCpuSeconds;
+
+  TP_THROW_ASSERT_IF(std::memcmp(dst, src.get(), size) != 0)
+      << "Data was corrupted";
+  ::munmap(dst, size);
+  const double numGB = size * numIterations / 1000.0 / 1000.0 / 1000.0;
+  return Result{
+      .bandwidth = size * numIterations / seconds,
+      .cpuSecondsPerGB = cpuSeconds / numGB,
+  };
+}
+
+void usage(int status, const char* argv0) {
+  fprintf(stderr, "Usage: %s [OPTIONS]\n", argv0);
+#define X(x) fputs(x "\n", stderr);
+  X("--transport=TRANSPORT       Transport to measure (default shm)");
+  X("--min-size=SIZE             Smallest size (default 64MiB)");
+  X("--max-size=SIZE             Largest size (default 1GiB)");
+  X("--num-iterations=N          Transfers per size (default 4)");
+#undef X
+  exit(status);
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options options;
+  enum Flags : int {
+    TRANSPORT,
+    MIN_SIZE,
+    MAX_SIZE,
+    NUM_ITERATIONS,
+    HELP,
+  };
+
+  static struct option longOptions[] = {
+      {"transport", required_argument, nullptr, TRANSPORT},
+      {"min-size", required_argument, nullptr, MIN_SIZE},
+      {"max-size", required_argument, nullptr, MAX_SIZE},
+      {"num-iterations", required_argument, nullptr, NUM_ITERATIONS},
+      {"help", no_argument, nullptr, HELP},
+      {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (opt) {
+      case TRANSPORT:
+        options.transport = optarg;
+        break;
+      case MIN_SIZE:
+        options.minSize = std::strtoull(optarg, nullptr, 10);
+        break;
+      case MAX_SIZE:
+        options.maxSize = std::strtoull(optarg, nullptr, 10);
+        break;
+      case NUM_ITERATIONS:
+        options.numIterations = std::strtoull(optarg, nullptr, 10);
+        break;
+      case HELP:
+        usage(EXIT_SUCCESS, argv[0]);
+        break;
+      default:
+        usage(EXIT_FAILURE, argv[0]);
+        break;
+    }
+  }
+
+  if (options.minSize == 0 || options.minSize > options.maxSize) {
+    fprintf(stderr, "Invalid range of sizes\n");
+    usage(EXIT_FAILURE, argv[0]);
+  }
+  if (options.numIterations == 0) {
+    fprintf(stderr, "Need at least one iteration\n");
+    usage(EXIT_FAILURE, argv[0]);
+  }
+
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options options = parseOptions(argc, argv);
+
+  std::shared_ptr<transport::Context> writerContext =
+      createContext(options.transport);
+  std::shared_ptr<transport::Context> readerContext =
+      createContext(options.transport);
+
+  std::shared_ptr<transport::Listener> listener =
+      readerContext->listen(getListenAddress(options.transport));
+  std::promise<std::shared_ptr<transport::Connection>> connProm;
+  listener->accept(
+      [&](const Error& error, std::shared_ptr<transport::Connection> conn) {
+        TP_THROW_ASSERT_IF(error) << error.what();
+        connProm.set_value(std::move(conn));
+      });
+  std::shared_ptr<transport::Connection> writer =
+      writerContext->connect(listener->addr());
+  std::shared_ptr<transport::Connection> reader = connProm.get_future().get();
+
+  fprintf(
+      stderr,
+      "%-12s %-15s %-12s %-12s\n",
+      "transport",
+      "size",
+      "GB/sec",
+      "CPU sec/GB");
+  for (size_t size = options.minSize; size <= options.maxSize; size *= 2) {
+    Result result = measure(*writer, *reader, size, options.numIterations);
+    fprintf(
+        stderr,
+        "%-12s %-15lu %-12.3f %-12.3f\n",
+        options.transport.c_str(),
+        size,
+        result.bandwidth / 1000 / 1000 / 1000,
+        result.cpuSecondsPerGB);
+  }
+
+  writerContext->join();
+  readerContext->join();
+
+  return 0;
+}
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <tensorpipe/benchmark/channel_registry.h>
+#include <tensorpipe/benchmark/transport_registry.h>
+#include <tensorpipe/channel/channel.h>
+#include <tensorpipe/channel/context.h>
+#include <tensorpipe/channel/helpers.h>
+#include <tensorpipe/common/cpu_buffer.h>
+#include <tensorpipe/common/defs.h>
+#include <tensorpipe/transport/connection.h>
+#include <tensorpipe/transport/context.h>
+#include <tensorpipe/transport/listener.h>
+
+// Measure the latency of a single channel transfer of a CPU buffer, for sizes
+// that double from the smallest to the largest (by default from 4KiB to 1MiB),
+// one transfer at a time. This is meant to sweep the copy sizes around the
+// point (kMaxInlineCopyLength) below which the xth and cma channels copy inline
+// on their loop rather than on their worker, hence it prints where that point
+// is, so that a step in the latency can be told apart from the effect of size.
+// The two endpoints are in the same process but in different contexts, each
+// with its own event loop and worker, as they would be across processes.
+
+using namespace tensorpipe;
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+struct Result {
+  double p50Us;
+  double p99Us;
+  double bandwidth; // In bytes per second, from the median
+};
+
+struct Options {
+  std::string channel{"cma"};
+  std::string transport{"uv"};
+  size_t minSize{4 * 1024};
+  size_t maxSize{1024 * 1024};
+  size_t numIterations{1000};
+};
+
+std::string getListenAddress(const std::string& transport) {
+  // The shm transport picks a unique name when given an empty one.
+  if (transport == "shm") {
+    return "";
+  }
+  return "127.0.0.1";
+}
+
+// Send the buffer the given number of times, with a single transfer in flight
+// at a time, and return the percentiles of the time from the send to the later
+// of the two callbacks. The first transfers aren't timed, as they pay for
+// faulting in the pages and for starting any thread.
+Result measure(
+    channel::Channel& sender,
+    channel::Channel& receiver,
+    size_t size,
+    size_t numIterations) {
+  std::vector<uint8_t> src(size);
+  for (size_t i = 0; i < size; i++) {
+    src[i] = (i >> 8) ^ (i & 0xff);
+  }
+  std::vector<uint8_t> dst(size);
+
+  const size_t numWarmUps = std::max<size_t>(numIterations / 10, 1);
+  std::vector<double> latenciesUs;
+  latenciesUs.reserve(numIterations);
+  for (size_t iterIdx = 0; iterIdx < numWarmUps + numIterations; iterIdx++) {
+    std::promise<void> sendProm;
+    std::promise<void> recvProm;
+    const clock::time_point start = clock::now();
+    receiver.recv(CpuBuffer{.ptr = dst.data()}, size, [&](const Error& error) {
+      TP_THROW_ASSERT_IF(error) << error.what();
+      recvProm.set_value();
+    });
+    sender.send(CpuBuffer{.ptr = src.data()}, size, [&](const Error& error) {
+      TP_THROW_ASSERT_IF(error) << error.what();
+      sendProm.set_value();
+    });
+    sendProm.get_future().get();
+    recvProm.get_future().get();
+    if (iterIdx >= numWarmUps) {
+      latenciesUs.push_back(
+          std::chrono::duration<double, std::micro>(clock::now() - start)
+              .count());
+    }
+  }
+
+  TP_THROW_ASSERT_IF(std::memcmp(dst.data(), src.data(), size) != 0)
+      << "Data was corrupted";
+  std::sort(latenciesUs.begin(), latenciesUs.end());
+  const double p50Us = latenciesUs[latenciesUs.size() / 2];
+  return Result{
+      .p50Us = p50Us,
+      .p99Us = latenciesUs[latenciesUs.size() * 99 / 100],
+      .bandwidth = size / (p50Us / 1000 / 1000),
+  };
+}
+
+void usage(int status, const char* argv0) {
+  fprintf(stderr, "Usage: %s [OPTIONS]\n", argv0);
+#define X(x) fputs(x "\n", stderr);
+  X("--channel=CHANNEL           Channel to measure (default cma)");
+  X("--transport=TRANSPORT       Transport for its connections (default uv)");
+  X("--min-size=SIZE             Smallest size (default 4KiB)");
+  X("--max-size=SIZE             Largest size (default 1MiB)");
+  X("--num-iterations=N          Transfers per size (default 1000)");
+#undef X
+  exit(status);
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options options;
+  enum Flags : int {
+    CHANNEL,
+    TRANSPORT,
+    MIN_SIZE,
+    MAX_SIZE,
+    NUM_ITERATIONS,
+    HELP,
+  };
+
+  static struct option longOptions[] = {
+      {"channel", required_argument, nullptr, CHANNEL},
+      {"transport", required_argument, nullptr, TRANSPORT},
+      {"min-size", required_argument, nullptr, MIN_SIZE},
+      {"max-size", required_argument, nullptr, MAX_SIZE},
+      {"num-iterations", required_argument, nullptr, NUM_ITERATIONS},
+      {"help", no_argument, nullptr, HELP},
+      {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (opt) {
+      case CHANNEL:
+        options.channel = optarg;
+        break;
+      case TRANSPORT:
+        options.transport = optarg;
+        break;
+      case MIN_SIZE:
+        options.minSize = std::strtoull(optarg, nullptr, 10);
+        break;
+      case MAX_SIZE:
+        options.maxSize = std::strtoull(optarg, nullptr, 10);
+        break;
+      case NUM_ITERATIONS:
+        options.numIterations = std::strtoull(optarg, nullptr, 10);
+        break;
+      case HELP:
+        usage(EXIT_SUCCESS, argv[0]);
+        break;
+      default:
+        usage(EXIT_FAILURE, argv[0]);
+        break;
+    }
+  }
+
+  if (options.minSize == 0 || options.minSize > options.maxSize) {
+    fprintf(stderr, "Invalid range of sizes\n");
+    usage(EXIT_FAILURE, argv[0]);
+  }
+  if (options.numIterations == 0) {
+    fprintf(stderr, "Need at least one iteration\n");
+    usage(EXIT_FAILURE, argv[0]);
+  }
+
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options options = parseOptions(argc, argv);
+
+  std::shared_ptr<transport::Context> senderTransportContext =
+      TensorpipeTransportRegistry().create(options.transport);
+  validateTransportContext(senderTransportContext);
+  std::shared_ptr<transport::Context> receiverTransportContext =
+      TensorpipeTransportRegistry().create(options.transport);
+  validateTransportContext(receiverTransportContext);
+  std::shared_ptr<channel::Context> senderChannelContext =
+      TensorpipeChannelRegistry().create(options.channel);
+  validateChannelContext(senderChannelContext);
+  std::shared_ptr<channel::Context> receiverChannelContext =
+      TensorpipeChannelRegistry().create(options.channel);
+  validateChannelContext(receiverChannelContext);
+
+  const size_t numConnections = senderChannelContext->numConnectionsNeeded();
+  std::shared_ptr<transport::Listener> listener =
+      receiverTransportContext->listen(getListenAddress(options.transport));
+  std::vector<std::shared_ptr<transport::Connection>> senderConnections;
+  std::vector<std::shared_ptr<transport::Connection>> receiverConnections;
+  for (size_t connIdx = 0; connIdx < numConnections; connIdx++) {
+    std::promise<std::shared_ptr<transport::Connection>> connProm;
+    listener->accept(
+        [&](const Error& error, std::shared_ptr<transport::Connection> conn) {
+          TP_THROW_ASSERT_IF(error) << error.what();
+          connProm.set_value(std::move(conn));
+        });
+    senderConnections.push_back(
+        senderTransportContext->connect(listener->addr()));
+    receiverConnections.push_back(connProm.get_future().get());
+  }
+  std::shared_ptr<channel::Channel> sender =
+      senderChannelContext->createChannel(
+          std::move(senderConnections), channel::Endpoint::kConnect);
+  std::shared_ptr<channel::Channel> receiver =
+      receiverChannelContext->createChannel(
+          std::move(receiverConnections), channel::Endpoint::kListen);
+
+  fprintf(
+      stderr,
+      "Copies of up to %lu bytes are inline for xth and cma\n",
+      channel::kMaxInlineCopyLength);
+  fprintf(
+      stderr,
+      "%-12s %-15s %-12s %-12s %-12s\n",
+      "channel",
+      "size",
+      "p50 (us)",
+      "p99 (us)",
+      "GB/sec");
+  for (size_t size = options.minSize; size <= options.maxSize; size *= 2) {
+    Result result = measure(*sender, *receiver, size, options.numIterations);
+    fprintf(
+        stderr,
+        "%-12s %-15lu %-12.3f %-12.3f %-12.3f\n",
+        options.channel.c_str(),
+        size,
+        result.p50Us,
+        result.p99Us,
+        result.bandwidth / 1000 / 1000 / 1000);
+  }
+
+  sender->close();
+  receiver->close();
+  senderChannelContext->join();
+  receiverChannelContext->join();
+  senderTransportContext->join();
+  receiverTransportContext->join();
+
+  return 0;
+}
@@ -0,0 +1,598 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <tensorpipe/benchmark/channel_registry.h>
+#include <tensorpipe/benchmark/transport_registry.h>
+#include <tensorpipe/common/defs.h>
+#include <tensorpipe/common/fd.h>
+#include <tensorpipe/core/context.h>
+#include <tensorpipe/core/error.h>
+#include <tensorpipe/core/listener.h>
+#include <tensorpipe/core/pipe.h>
+#include <tensorpipe/transport/connection.h>
+#include <tensorpipe/transport/listener.h>
+
+// Measure how close each backend gets to the speed of light of the machine.
+// For each transport and channel, the raw primitive on which it's built is
+// measured first (memcpy for xth, process_vm_readv for cma, a TCP loopback
+// socket for uv and for basic, and a copy through a ring buffer for shm), and
+// then the same amount of data is sent through tensorpipe. The ratio between
+// the two bandwidths is the efficiency of the backend, and it's reported for a
+// range of sizes. Everything happens within one process, with both endpoints
+// in the same context, which suffices for all the backends listed above.
+
+using namespace tensorpipe;
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+using Data = std::unique_ptr<uint8_t[]>;
+
+// The same as the ring buffers of the shm transport.
+constexpr size_t kRingSize = 2 * 1024 * 1024;
+
+// Even for large sizes, repeat enough to amortize the warm-up.
+constexpr size_t kMinIterations = 8;
+
+struct Options {
+  std::vector<std::string> transports;
+  std::vector<std::string> channels;
+  std::string pipeTransport{"uv"};
+  size_t minSize{4 * 1024};
+  size_t maxSize{64 * 1024 * 1024};
+  size_t bytesPerSize{512 * 1024 * 1024};
+};
+
+// The bandwidth of the primitive for a given size, in bytes per second, or zero
+// if it couldn't be measured (e.g., because of missing permissions).
+using measure_fn = std::function<double(size_t, size_t)>;
+
+Data createData(size_t size) {
+  Data data = std::make_unique<uint8_t[]>(size);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = (i >> 8) ^ (i & 0xff);
+  }
+  return data;
+}
+
+double toBandwidth(size_t numBytes, clock::duration elapsed) {
+  return numBytes / std::chrono::duration<double>(elapsed).count();
+}
+
+// Raw primitives
+
+double measureMemcpy(size_t size, size_t numIterations) {
+  Data src = createData(size);
+  Data dst = std::make_unique<uint8_t[]>(size);
+
+  clock::time_point start = clock::now();
+  for (size_t iterIdx = 0; iterIdx < numIterations; iterIdx++) {
+    std::memcpy(dst.get(), src.get(), size);
+  }
+  clock::duration elapsed = clock::now() - start;
+  // Prevent the copies from being optimized away.
+  TP_THROW_ASSERT_IF(std::memcmp(dst.get(), src.get(), size) != 0);
+  return toBandwidth(size * numIterations, elapsed);
+}
+
+// The cma channel reads from the address space of the peer process, which has
+// the same cost as reading from our own.
+double measureProcessVmReadv(size_t size, size_t numIterations) {
+  Data src = createData(size);
+  Data dst = std::make_unique<uint8_t[]>(size);
+  struct iovec local {
+    .iov_base = dst.get(), .iov_len = size
+  };
+  struct iovec remote {
+    .iov_base = src.get(), .iov_len = size
+  };
+
+  clock::time_point start = clock::now();
+  for (size_t iterIdx = 0; iterIdx < numIterations; iterIdx++) {
+    ssize_t rv = ::process_vm_readv(::getpid(), &local, 1, &remote, 1, 0);
+    if (rv < 0) {
+      return 0;
+    }
+    TP_THROW_ASSERT_IF(static_cast<size_t>(rv) != size)
+        << "Partial read: " << rv << " of " << size;
+  }
+  return toBandwidth(size * numIterations, clock::now() - start);
+}
+
+// Connect two TCP sockets over the loopback interface, set up as libuv does for
+// the uv transport.
+std::pair<Fd, Fd> createTcpLoopbackPair() {
+  Fd listener(::socket(AF_INET, SOCK_STREAM, 0));
+  TP_THROW_SYSTEM_IF(listener.fd() < 0, errno);
+  struct sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = 0;
+  socklen_t addrLen = sizeof(addr);
+  TP_THROW_SYSTEM_IF(
+      ::bind(listener.fd(), reinterpret_cast<sockaddr*>(&addr), addrLen) < 0,
+      errno);
+  TP_THROW_SYSTEM_IF(::listen(listener.fd(), 1) < 0, errno);
+  TP_THROW_SYSTEM_IF(
+      ::getsockname(
+          listener.fd(), reinterpret_cast<sockaddr*>(&addr), &addrLen) < 0,
+      errno);
+
+  Fd client(::socket(AF_INET, SOCK_STREAM, 0));
+  TP_THROW_SYSTEM_IF(client.fd() < 0, errno);
+  TP_THROW_SYSTEM_IF(
+      ::connect(client.fd(), reinterpret_cast<sockaddr*>(&addr), addrLen) < 0,
+      errno);
+  Fd server(::accept(listener.fd(), nullptr, nullptr));
+  TP_THROW_SYSTEM_IF(server.fd() < 0, errno);
+
+  for (const Fd* fd : {&client, &server}) {
+    int one = 1;
+    TP_THROW_SYSTEM_IF(
+        ::setsockopt(fd->fd(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) <
+            0,
+        errno);
+  }
+  return std::make_pair(std::move(client), std::move(server));
+}
+
+double measureTcpLoopback(size_t size, size_t numIterations) {
+  Fd writerFd;
+  Fd readerFd;
+  std::tie(writerFd, readerFd) = createTcpLoopbackPair();
+  Data src = createData(size);
+  Data dst = std::make_unique<uint8_t[]>(size);
+
+  clock::time_point start = clock::now();
+  std::thread writer([&]() {
+    for (size_t iterIdx = 0; iterIdx < numIterations; iterIdx++) {
+      Error error = writerFd.writeFull(src.get(), size);
+      TP_THROW_ASSERT_IF(error) << error.what();
+    }
+  });
+  for (size_t iterIdx = 0; iterIdx < numIterations; iterIdx++) {
+    Error error = readerFd.readFull(dst.get(), size);
+    TP_THROW_ASSERT_IF(error) << error.what();
+  }
+  clock::duration elapsed = clock::now() - start;
+  writer.join();
+  return toBandwidth(size * numIterations, elapsed);
+}
+
+// A single-producer single-consumer ring buffer, as the ones the shm transport
+// places in shared memory: the writer copies the data in and the reader copies
+// it out, both busy-waiting for space or data. Being in the same process has no
+// effect on the cost of the copies.
+class Ring {
+ public:
+  Ring() : data_(std::make_unique<uint8_t[]>(kRingSize)) {}
+
+  void write(const uint8_t* ptr, size_t length) {
+    while (length > 0) {
+      uint64_t head = head_.load(std::memory_order_relaxed);
+      uint64_t tail = tail_.load(std::memory_order_acquire);
+      size_t chunk = std::min(
+          {length, kRingSize - (head - tail), kRingSize - head % kRingSize});
+      if (chunk == 0) {
+        continue;
+      }
+      std::memcpy(&data_[head % kRingSize], ptr, chunk);
+      head_.store(head + chunk, std::memory_order_release);
+      ptr += chunk;
+      length -= chunk;
+    }
+  }
+
+  void read(uint8_t* ptr, size_t length) {
+    while (length > 0) {
+      uint64_t tail = tail_.load(std::memory_order_relaxed);
+      uint64_t head = head_.load(std::memory_order_acquire);
+      size_t chunk =
+          std::min({length, head - tail, kRingSize - tail % kRingSize});
+      if (chunk == 0) {
+        continue;
+      }
+      std::memcpy(ptr, &data_[tail % kRingSize], chunk);
+      tail_.store(tail + chunk, std::memory_order_release);
+      ptr += chunk;
+      length -= chunk;
+    }
+  }
+
+ private:
+  Data data_;
+  alignas(64) std::atomic<uint64_t> head_{0};
+  alignas(64) std::atomic<uint64_t> tail_{0};
+};
+
+double measureRingCopy(size_t size, size_t numIterations) {
+  Ring ring;
+  Data src = createData(size);
+  Data dst = std::make_unique<uint8_t[]>(size);
+
+  clock::time_point start = clock::now();
+  std::thread writer([&]() {
+    for (size_t iterIdx = 0; iterIdx < numIterations; iterIdx++) {
+      ring.write(src.get(), size);
+    }
+  });
+  for (size_t iterIdx = 0; iterIdx < numIterations; iterIdx++) {
+    ring.read(dst.get(), size);
+  }
+  clock::duration elapsed = clock::now() - start;
+  writer.join();
+  return toBandwidth(size * numIterations, elapsed);
+}
+
+measure_fn getRawPrimitive(const std::string& name) {
+  if (name == "xth") {
+    return measureMemcpy;
+  }
+  if (name == "cma") {
+    return measureProcessVmReadv;
+  }
+  if (name == "shm") {
+    return measureRingCopy;
+  }
+  if (name.compare(0, 2, "uv") == 0) {
+    return measureTcpLoopback;
+  }
+  return nullptr;
+}
+
+std::string getListenAddress(const std::string& transport) {
+  // The shm transport picks a unique name when given an empty one.
+  if (transport == "shm") {
+    return "";
+  }
+  return "127.0.0.1";
+}
+
+// Tensorpipe paths
+
+class TransportPath {
+ public:
+  explicit TransportPath(const std::string& name)
+      : context_(TensorpipeTransportRegistry().create(name)) {
+    validateTransportContext(context_);
+    std::shared_ptr<transport::Listener> listener =
+        context_->listen(getListenAddress(name));
+    std::promise<std::shared_ptr<transport::Connection>> connProm;
+    listener->accept([&](const Error& error,
+                         std::shared_ptr<transport::Connection> conn) {
+      TP_THROW_ASSERT_IF(error) << error.what();
+      connProm.set_value(std::move(conn));
+    });
+    writer_ = context_->connect(listener->addr());
+    reader_ = connProm.get_future().get();
+  }
+
+  // All writes are issued at once, as the transport queues them without
+  // copying, and each read is issued as soon as the previous one completes.
+  double measure(size_t size, size_t numIterations) {
+    Data src = createData(size);
+    Data dst = std::make_unique<uint8_t[]>(size);
+    std::promise<void> doneProm;
+    size_t numReadsDone = 0;
+
+    std::function<void()> readNext = [&]() {
+      reader_->read(
+          dst.get(), size, [&](const Error& error, const void*, size_t len) {
+            TP_THROW_ASSERT_IF(error) << error.what();
+            TP_DCHECK_EQ(len, size);
+            if (++numReadsDone == numIterations) {
+              doneProm.set_value();
+              return;
+            }
+            readNext();
+          });
+    };
+
+    clock::time_point start = clock::now();
+    for (size_t iterIdx = 0; iterIdx < numIterations; iterIdx++) {
+      writer_->write(src.get(), size, [](const Error& error) {
+        TP_THROW_ASSERT_IF(error) << error.what();
+      });
+    }
+    readNext();
+    doneProm.get_future().get();
+    return toBandwidth(size * numIterations, clock::now() - start);
+  }
+
+  ~TransportPath() {
+    context_->join();
+  }
+
+ private:
+  std::shared_ptr<transport::Context> context_;
+  std::shared_ptr<transport::Connection> writer_;
+  std::shared_ptr<transport::Connection> reader_;
+};
+
+class ChannelPath {
+ public:
+  ChannelPath(const std::string& name, const std::string& transport)
+      : context_(std::make_shared<Context>()) {
+    auto transportContext = TensorpipeTransportRegistry().create(transport);
+    validateTransportContext(transportContext);
+    context_->registerTransport(0, transport, transportContext);
+    auto channelContext = TensorpipeChannelRegistry().create(name);
+    validateChannelContext(channelContext);
+    context_->registerChannel(0, name, channelContext);
+
+    std::shared_ptr<Listener> listener =
+        context_->listen({transport + "://" + getListenAddress(transport)});
+    std::promise<std::shared_ptr<Pipe>> pipeProm;
+    listener->accept([&](const Error& error, std::shared_ptr<Pipe> pipe) {
+      TP_THROW_ASSERT_IF(error) << error.what();
+      pipeProm.set_value(std::move(pipe));
+    });
+    writer_ = context_->connect(listener->url(transport));
+    reader_ = pipeProm.get_future().get();
+  }
+
+  // Each message holds a single CPU tensor. As above, all writes are issued at
+  // once, whereas reads are issued as descriptors come in.
+  double measure(size_t size, size_t numIterations) {
+    Data src = createData(size);
+    Data dst = std::make_unique<uint8_t[]>(size);
+    std::promise<void> doneProm;
+    size_t numDescriptorsRead = 0;
+    size_t numReadsDone = 0;
+
+    std::function<void()> readNext = [&]() {
+      reader_->readDescriptor([&](const Error& error, Descriptor descriptor) {
+        TP_THROW_ASSERT_IF(error) << error.what();
+        TP_DCHECK_EQ(descriptor.tensors.size(), 1);
+        Allocation allocation;
+        allocation.tensors.resize(1);
+        allocation.tensors[0].buffer = CpuBuffer{.ptr = dst.get()};
+        reader_->read(std::move(allocation), [&](const Error& error) {
+          TP_THROW_ASSERT_IF(error) << error.what();
+          if (++numReadsDone == numIterations) {
+            doneProm.set_value();
+          }
+        });
+        if (++numDescriptorsRead < numIterations) {
+          readNext();
+        }
+      });
+    };
+
+    clock::time_point start = clock::now();
+    for (size_t iterIdx = 0; iterIdx < numIterations; iterIdx++) {
+      Message message;
+      Message::Tensor tensor;
+      tensor.buffer = CpuBuffer{.ptr = src.get()};
+      tensor.length = size;
+      tensor.targetDevice = Device(kCpuDeviceType, 0);
+      message.tensors.push_back(std::move(tensor));
+      writer_->write(std::move(message), [](const Error& error) {
+        TP_THROW_ASSERT_IF(error) << error.what();
+      });
+    }
+    readNext();
+    doneProm.get_future().get();
+    return toBandwidth(size * numIterations, clock::now() - start);
+  }
+
+  ~ChannelPath() {
+    context_->join();
+  }
+
+ private:
+  std::shared_ptr<Context> context_;
+  std::shared_ptr<Pipe> writer_;
+  std::shared_ptr<Pipe> reader_;
+};
+
+template <typename TCtx>
+bool isViable(std::shared_ptr<TCtx> context) {
+  bool viable = context->isViable();
+  context->join();
+  return viable;
+}
+
+// Reporting
+
+void printHeader() {
+  fprintf(
+      stderr,
+      "%-10s %-15s %-12s %-12s %-12s %-10s\n",
+      "kind",
+      "name",
+      "size",
+      "raw (MB/s)",
+      "tp (MB/s)",
+      "efficiency");
+}
+
+void printRow(
+    const char* kind,
+    const std::string& name,
+    size_t size,
+    double raw,
+    double tp) {
+  if (raw > 0) {
+    fprintf(
+        stderr,
+        "%-10s %-15s %-12lu %-12.1f %-12.1f %.1f%%\n",
+        kind,
+        name.c_str(),
+        size,
+        raw / 1000 / 1000,
+        tp / 1000 / 1000,
+        100 * tp / raw);
+  } else {
+    fprintf(
+        stderr,
+        "%-10s %-15s %-12lu %-12s %-12.1f %s\n",
+        kind,
+        name.c_str(),
+        size,
+        "n/a",
+        tp / 1000 / 1000,
+        "n/a");
+  }
+}
+
+template <typename TPath>
+void runBackend(
+    const char* kind,
+    const std::string& name,
+    measure_fn raw,
+    TPath& path,
+    const Options& options) {
+  for (size_t size = options.minSize; size <= options.maxSize; size *= 4) {
+    size_t numIterations =
+        std::max(options.bytesPerSize / size, kMinIterations);
+    double rawBandwidth = raw ? raw(size, numIterations) : 0;
+    double tpBandwidth = path.measure(size, numIterations);
+    printRow(kind, name, size, rawBandwidth, tpBandwidth);
+  }
+}
+
+void usage(int status, const char* argv0) {
+  fprintf(stderr, "Usage: %s [OPTIONS]\n", argv0);
+#define X(x) fputs(x "\n", stderr);
+  X("Unless some transports or channels are given, all the registered ones");
+  X("which have a known raw primitive are measured.");
+  X("");
+  X("--transport=TRANSPORT [repeat]   Measure this transport");
+  X("--channel=CHANNEL [repeat]       Measure this channel");
+  X("--pipe-transport=TRANSPORT       Transport of the pipes (default uv)");
+  X("--min-size=SIZE                  Smallest size (default 4096)");
+  X("--max-size=SIZE                  Largest size (default 64MiB)");
+  X("--bytes-per-size=BYTES           Data sent per size (default 512MiB)");
+#undef X
+  exit(status);
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options options;
+  enum Flags : int {
+    TRANSPORT,
+    CHANNEL,
+    PIPE_TRANSPORT,
+    MIN_SIZE,
+    MAX_SIZE,
+    BYTES_PER_SIZE,
+    HELP,
+  };
+
+  static struct option longOptions[] = {
+      {"transport", required_argument, nullptr, TRANSPORT},
+      {"channel", required_argument, nullptr, CHANNEL},
+      {"pipe-transport", required_argument, nullptr, PIPE_TRANSPORT},
+      {"min-size", required_argument, nullptr, MIN_SIZE},
+      {"max-size", required_argument, nullptr, MAX_SIZE},
+      {"bytes-per-size", required_argument, nullptr, BYTES_PER_SIZE},
+      {"help", no_argument, nullptr, HELP},
+      {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (opt) {
+      case TRANSPORT:
+        options.transports.emplace_back(optarg);
+        break;
+      case CHANNEL:
+        options.channels.emplace_back(optarg);
+        break;
+      case PIPE_TRANSPORT:
+        options.pipeTransport = optarg;
+        break;
+      case MIN_SIZE:
+        options.minSize = std::strtoull(optarg, nullptr, 10);
+        break;
+      case MAX_SIZE:
+        options.maxSize = std::strtoull(optarg, nullptr, 10);
+        break;
+      case BYTES_PER_SIZE:
+        options.bytesPerSize = std::strtoull(optarg, nullptr, 10);
+        break;
+      case HELP:
+        usage(EXIT_SUCCESS, argv[0]);
+        break;
+      default:
+        usage(EXIT_FAILURE, argv[0]);
+        break;
+    }
+  }
+
+  if (options.minSize == 0 || options.minSize > options.maxSize) {
+    fprintf(stderr, "Invalid range of sizes\n");
+    usage(EXIT_FAILURE, argv[0]);
+  }
+
+  if (options.transports.empty() && options.channels.empty()) {
+    for (const auto& name : TensorpipeTransportRegistry().keys()) {
+      if (getRawPrimitive(name)) {
+        options.transports.push_back(name);
+      }
+    }
+    for (const auto& name : TensorpipeChannelRegistry().keys()) {
+      if (name == "basic" || getRawPrimitive(name)) {
+        options.channels.push_back(name);
+      }
+    }
+  }
+
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options options = parseOptions(argc, argv);
+
+  printHeader();
+  for (const auto& name : options.transports) {
+    if (!isViable(TensorpipeTransportRegistry().create(name))) {
+      fprintf(stderr, "%-10s %-15s not viable\n", "transport", name.c_str());
+      continue;
+    }
+    TransportPath path(name);
+    runBackend("transport", name, getRawPrimitive(name), path, options);
+  }
+  for (const auto& name : options.channels) {
+    if (!isViable(TensorpipeChannelRegistry().create(name))) {
+      fprintf(stderr, "%-10s %-15s not viable\n", "channel", name.c_str());
+      continue;
+    }
+    // The basic channel sends its data over the connections of the pipe.
+    measure_fn raw = name == "basic" ? getRawPrimitive(options.pipeTransport)
+                                     : getRawPrimitive(name);
+    ChannelPath path(name, options.pipeTransport);
+    runBackend("channel", name, std::move(raw), path, options);
+  }
+
+  return 0;
+}
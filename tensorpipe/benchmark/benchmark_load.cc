@@ -0,0 +1,477 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cmath>
+#include <cstring>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <tensorpipe/benchmark/channel_registry.h>
+#include <tensorpipe/benchmark/measurements.h>
+#include <tensorpipe/benchmark/options.h>
+#include <tensorpipe/benchmark/transport_registry.h>
+#include <tensorpipe/common/cpu_buffer.h>
+#include <tensorpipe/common/defs.h>
+#include <tensorpipe/common/optional.h>
+#include <tensorpipe/core/context.h>
+#include <tensorpipe/core/listener.h>
+#include <tensorpipe/core/pipe.h>
+#include <tensorpipe/rpc/client.h>
+#include <tensorpipe/rpc/server.h>
+
+// This benchmark drives the RPC layer "open loop": calls are issued at a given
+// rate (at fixed intervals or following a Poisson process) by several threads,
+// regardless of whether the previous ones have completed. It sweeps the offered
+// load from --min-rate to --max-rate and, for each rate, reports the rate that
+// was actually achieved and the latency percentiles, which gives the curve of
+// latency versus throughput and the point where it bends (the "knee").
+//
+// Latencies are measured from the time at which each call was meant to be
+// issued rather than from when it actually was: when the sender falls behind
+// the calls it issues late would otherwise hide the time they spent waiting
+// (the so-called coordinated omission). The uncorrected p99 is also printed,
+// to show how much that matters.
+
+using namespace tensorpipe;
+using namespace tensorpipe::benchmark;
+
+using TimePoint = std::chrono::steady_clock::time_point;
+
+static constexpr int kNumWarmUpCalls = 5;
+
+// A step "keeps up" with its offered load if it achieves at least this much of
+// it. The knee is the highest such step.
+static constexpr double kKeepUpRatio = 0.95;
+
+// The client sends this, with no payloads or tensors, once it's done.
+static constexpr char kStopMetadata[] = "stop";
+
+using Data = std::unique_ptr<uint8_t[]>;
+
+static Data createEmptyCpuData(size_t size) {
+  return std::make_unique<uint8_t[]>(size);
+}
+
+static Data createFullCpuData(size_t size) {
+  Data data = createEmptyCpuData(size);
+  // Generate fake data
+  for (size_t i = 0; i < size; i++) {
+    data[i] = i % 256;
+  }
+  return data;
+}
+
+static std::shared_ptr<Context> createContext(const Options& options) {
+  std::shared_ptr<Context> context = std::make_shared<Context>();
+  auto transportContext =
+      TensorpipeTransportRegistry().create(options.transport);
+  validateTransportContext(transportContext);
+  context->registerTransport(0, options.transport, transportContext);
+
+  auto channelContext = TensorpipeChannelRegistry().create(options.channel);
+  validateChannelContext(channelContext);
+  context->registerChannel(0, options.channel, channelContext);
+  return context;
+}
+
+// The memory of a message, as seen by the receiver.
+struct Buffers {
+  std::vector<Data> payloads;
+  std::vector<Data> tensors;
+
+  Allocation toAllocation() {
+    Allocation allocation;
+    for (const auto& payload : payloads) {
+      allocation.payloads.push_back({.data = payload.get()});
+    }
+    for (const auto& tensor : tensors) {
+      allocation.tensors.push_back({.buffer = CpuBuffer{.ptr = tensor.get()}});
+    }
+    return allocation;
+  }
+};
+
+static Buffers createBuffers(
+    size_t numPayloads,
+    size_t payloadSize,
+    size_t numTensors,
+    size_t tensorSize,
+    bool full) {
+  Buffers buffers;
+  for (size_t payloadIdx = 0; payloadIdx < numPayloads; payloadIdx++) {
+    buffers.payloads.push_back(
+        full ? createFullCpuData(payloadSize)
+             : createEmptyCpuData(payloadSize));
+  }
+  for (size_t tensorIdx = 0; tensorIdx < numTensors; tensorIdx++) {
+    buffers.tensors.push_back(
+        full ? createFullCpuData(tensorSize) : createEmptyCpuData(tensorSize));
+  }
+  return buffers;
+}
+
+static void runServer(const Options& options) {
+  std::shared_ptr<Context> context = createContext(options);
+
+  std::promise<void> doneProm;
+  // The server echoes each request back, sending the response straight from
+  // the buffers that the request was received into.
+  auto server = std::make_shared<rpc::Server>(
+      [](const Descriptor& descriptor) {
+        Buffers buffers;
+        for (const auto& payload : descriptor.payloads) {
+          buffers.payloads.push_back(createEmptyCpuData(payload.length));
+        }
+        for (const auto& tensor : descriptor.tensors) {
+          TP_THROW_ASSERT_IF(tensor.sourceDevice.type != kCpuDeviceType)
+              << "This benchmark only supports CPU tensors";
+          buffers.tensors.push_back(createEmptyCpuData(tensor.length));
+        }
+        Allocation allocation = buffers.toAllocation();
+        // Ownership is taken back when the response has been sent.
+        for (auto& payload : buffers.payloads) {
+          payload.release();
+        }
+        for (auto& tensor : buffers.tensors) {
+          tensor.release();
+        }
+        return allocation;
+      },
+      [&](const Error& error,
+          Descriptor request,
+          Allocation allocation,
+          rpc::Responder responder) {
+        auto freeAllocation = [allocation]() {
+          for (const auto& payload : allocation.payloads) {
+            delete[] static_cast<uint8_t*>(payload.data);
+          }
+          for (const auto& tensor : allocation.tensors) {
+            delete[] static_cast<uint8_t*>(
+                tensor.buffer.unwrap<CpuBuffer>().ptr);
+          }
+        };
+        if (error) {
+          freeAllocation();
+          return;
+        }
+
+        Message response;
+        response.metadata = std::move(request.metadata);
+        for (size_t payloadIdx = 0; payloadIdx < request.payloads.size();
+             payloadIdx++) {
+          response.payloads.push_back({
+              .data = allocation.payloads[payloadIdx].data,
+              .length = request.payloads[payloadIdx].length,
+              .metadata = std::move(request.payloads[payloadIdx].metadata),
+          });
+        }
+        for (size_t tensorIdx = 0; tensorIdx < request.tensors.size();
+             tensorIdx++) {
+          response.tensors.push_back({
+              .buffer = allocation.tensors[tensorIdx].buffer,
+              .length = request.tensors[tensorIdx].length,
+              .metadata = std::move(request.tensors[tensorIdx].metadata),
+          });
+        }
+        const bool isStop = response.metadata == kStopMetadata;
+        responder.respond(
+            std::move(response),
+            [freeAllocation, isStop, &doneProm](const Error& error) {
+              TP_THROW_ASSERT_IF(error) << error.what();
+              freeAllocation();
+              if (isStop) {
+                doneProm.set_value();
+              }
+            });
+      },
+      options.numHandlerThreads);
+
+  std::shared_ptr<Listener> listener = context->listen({options.address});
+  listener->accept([&](const Error& error, std::shared_ptr<Pipe> pipe) {
+    TP_THROW_ASSERT_IF(error) << error.what();
+    server->serve(std::move(pipe));
+  });
+
+  doneProm.get_future().get();
+  listener->close();
+  server->close();
+  context->join();
+}
+
+// The outcome of issuing calls at one offered rate.
+struct StepResult {
+  double offeredRate;
+  double achievedRate;
+  Measurements correctedLatencies;
+  Measurements uncorrectedLatencies;
+};
+
+class LoadGenerator {
+ public:
+  LoadGenerator(const Options& options, rpc::Client& client)
+      : options_(options), client_(client) {
+    // All calls send the same data, as requests are never written to.
+    request_ = createBuffers(
+        options.numPayloads,
+        options.payloadSize,
+        options.numTensors,
+        options.tensorSize,
+        /*full=*/true);
+    metadata_ = std::string(options.metadataSize, 0x42);
+  }
+
+  void warmUp() {
+    for (int callIdx = 0; callIdx < kNumWarmUpCalls; callIdx++) {
+      std::promise<void> doneProm;
+      issueCall([&](TimePoint /* unused */) { doneProm.set_value(); });
+      doneProm.get_future().get();
+    }
+  }
+
+  // Issue the calls at the given aggregate rate (in calls per second), spread
+  // evenly across the sender threads, and wait for all of them to complete.
+  StepResult runStep(double rate) {
+    const size_t numThreads = options_.numSenderThreads;
+    const size_t numCalls = options_.numRoundTrips;
+
+    StepResult result;
+    result.offeredRate = rate;
+    result.correctedLatencies.reserve(numCalls);
+    result.uncorrectedLatencies.reserve(numCalls);
+
+    std::mutex mutex;
+    size_t numCallsLeft = numCalls;
+    TimePoint lastCallEnd;
+    std::promise<void> doneProm;
+
+    // Leave the threads some time to start before the first call is due.
+    const TimePoint stepStart =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+    const double threadRate = rate / numThreads;
+
+    std::vector<std::thread> threads;
+    for (size_t threadIdx = 0; threadIdx < numThreads; threadIdx++) {
+      threads.emplace_back([&, threadIdx]() {
+        std::mt19937_64 engine(threadIdx);
+        std::exponential_distribution<double> exponential(threadRate);
+        // Stagger the threads so that, with fixed intervals, their calls
+        // don't all come in bursts.
+        double offset = threadIdx / rate;
+        for (size_t callIdx = threadIdx; callIdx < numCalls;
+             callIdx += numThreads) {
+          const TimePoint intendedStart = stepStart +
+              std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::duration<double>(offset));
+          offset += options_.arrivalProcess == "poisson"
+              ? exponential(engine)
+              : 1.0 / threadRate;
+
+          // If the thread is behind schedule it doesn't sleep, but it still
+          // issues all its calls, which then queue up as they would if they
+          // came from independent users.
+          std::this_thread::sleep_until(intendedStart);
+          const TimePoint actualStart = std::chrono::steady_clock::now();
+          issueCall([&, intendedStart, actualStart](TimePoint end) {
+            bool done;
+            {
+              std::unique_lock<std::mutex> lock(mutex);
+              result.correctedLatencies.addSample(end - intendedStart);
+              result.uncorrectedLatencies.addSample(end - actualStart);
+              lastCallEnd = std::max(lastCallEnd, end);
+              done = --numCallsLeft == 0;
+            }
+            if (done) {
+              doneProm.set_value();
+            }
+          });
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    doneProm.get_future().get();
+
+    const double seconds =
+        std::chrono::duration<double>(lastCallEnd - stepStart).count();
+    result.achievedRate = numCalls / seconds;
+    result.correctedLatencies.sort();
+    result.uncorrectedLatencies.sort();
+    return result;
+  }
+
+ private:
+  const Options& options_;
+  rpc::Client& client_;
+  Buffers request_;
+  std::string metadata_;
+
+  void issueCall(std::function<void(TimePoint)> fn) {
+    Message request;
+    request.metadata = metadata_;
+    for (const auto& payload : request_.payloads) {
+      request.payloads.push_back({
+          .data = payload.get(),
+          .length = options_.payloadSize,
+          .metadata = metadata_,
+      });
+    }
+    for (const auto& tensor : request_.tensors) {
+      request.tensors.push_back({
+          .buffer = CpuBuffer{.ptr = tensor.get()},
+          .length = options_.tensorSize,
+          .metadata = metadata_,
+      });
+    }
+
+    // Each call needs its own buffers for the response, as any number of them
+    // may be in flight at the same time.
+    auto response = std::make_shared<Buffers>(createBuffers(
+        options_.numPayloads,
+        options_.payloadSize,
+        options_.numTensors,
+        options_.tensorSize,
+        /*full=*/false));
+    client_.call(
+        std::move(request),
+        [response](const Descriptor& /* unused */) {
+          return response->toAllocation();
+        },
+        [response, fn{std::move(fn)}](
+            const Error& error, Descriptor /* unused */) {
+          const TimePoint end = std::chrono::steady_clock::now();
+          TP_THROW_ASSERT_IF(error) << error.what();
+          fn(end);
+        });
+  }
+};
+
+static void printHeader() {
+  fprintf(
+      stderr,
+      "%-12s %-12s %-9s %-9s %-9s %-9s %-9s\n",
+      "offered/sec",
+      "achieved/sec",
+      "p50",
+      "p90",
+      "p99",
+      "p99.9",
+      "p99 (uncorrected)");
+}
+
+static void printStep(const StepResult& result) {
+  fprintf(
+      stderr,
+      "%-12.0f %-12.0f %-9.3f %-9.3f %-9.3f %-9.3f %-9.3f\n",
+      result.offeredRate,
+      result.achievedRate,
+      result.correctedLatencies.percentile(0.50).count() / 1000.0,
+      result.correctedLatencies.percentile(0.90).count() / 1000.0,
+      result.correctedLatencies.percentile(0.99).count() / 1000.0,
+      result.correctedLatencies.percentile(0.999).count() / 1000.0,
+      result.uncorrectedLatencies.percentile(0.99).count() / 1000.0);
+}
+
+static void runClient(const Options& options) {
+  TP_THROW_ASSERT_IF(options.tensorType != TensorType::kCpu)
+      << "This benchmark only supports CPU tensors";
+  TP_THROW_ASSERT_IF(options.numSenderThreads == 0)
+      << "There must be at least one sender thread";
+  TP_THROW_ASSERT_IF(options.numRateSteps == 0)
+      << "There must be at least one rate step";
+  TP_THROW_ASSERT_IF(options.maxRate <= 0)
+      << "The maximum rate must be given, and be positive";
+  TP_THROW_ASSERT_IF(options.numRoundTrips < options.numSenderThreads)
+      << "Each sender thread must issue at least one call per step";
+  const double minRate =
+      options.minRate > 0 ? std::min(options.minRate, options.maxRate)
+                          : options.maxRate;
+
+  std::shared_ptr<Context> context = createContext(options);
+  rpc::Client client(context->connect(options.address));
+
+  LoadGenerator generator(options, client);
+  generator.warmUp();
+
+  // The rates grow geometrically, as the interesting part of the curve is
+  // usually within an order of magnitude of the knee, wherever that is.
+  printHeader();
+  optional<double> knee;
+  for (size_t stepIdx = 0; stepIdx < options.numRateSteps; stepIdx++) {
+    const double rate = options.numRateSteps == 1
+        ? options.maxRate
+        : minRate *
+            std::pow(
+                options.maxRate / minRate,
+                static_cast<double>(stepIdx) / (options.numRateSteps - 1));
+    StepResult result = generator.runStep(rate);
+    printStep(result);
+    if (result.achievedRate >= kKeepUpRatio * result.offeredRate) {
+      knee = result.offeredRate;
+    }
+  }
+  if (knee.has_value()) {
+    fprintf(stderr, "knee: %.0f calls/sec\n", knee.value());
+  } else {
+    fprintf(stderr, "knee: below %.0f calls/sec\n", minRate);
+  }
+
+  std::promise<void> stopProm;
+  Message stop;
+  stop.metadata = kStopMetadata;
+  client.call(
+      std::move(stop),
+      [](const Descriptor& /* unused */) { return Allocation(); },
+      [&](const Error& error, Descriptor /* unused */) {
+        TP_THROW_ASSERT_IF(error) << error.what();
+        stopProm.set_value();
+      });
+  stopProm.get_future().get();
+
+  client.close();
+  context->join();
+}
+
+int main(int argc, char** argv) {
+  struct Options x = parseOptions(argc, argv);
+  std::cout << "mode = " << x.mode << "\n";
+  std::cout << "transport = " << x.transport << "\n";
+  std::cout << "channel = " << x.channel << "\n";
+  std::cout << "address = " << x.address << "\n";
+  std::cout << "num_round_trips = " << x.numRoundTrips << "\n";
+  std::cout << "num_payloads = " << x.numPayloads << "\n";
+  std::cout << "payload_size = " << x.payloadSize << "\n";
+  std::cout << "num_tensors = " << x.numTensors << "\n";
+  std::cout << "tensor_size = " << x.tensorSize << "\n";
+  std::cout << "metadata_size = " << x.metadataSize << "\n";
+  std::cout << "num_handler_threads = " << x.numHandlerThreads << "\n";
+  std::cout << "arrival_process = " << x.arrivalProcess << "\n";
+  std::cout << "num_sender_threads = " << x.numSenderThreads << "\n";
+  std::cout << "min_rate = " << x.minRate << "\n";
+  std::cout << "max_rate = " << x.maxRate << "\n";
+  std::cout << "num_rate_steps = " << x.numRateSteps << "\n";
+
+  if (x.mode == "listen") {
+    runServer(x);
+  } else if (x.mode == "connect") {
+    runClient(x);
+  } else {
+    // Should never be here
+    TP_THROW_ASSERT() << "unknown mode: " << x.mode;
+  }
+
+  return 0;
+}
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <dirent.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <tensorpipe/common/defs.h>
+#include <tensorpipe/common/loop_pool.h>
+#include <tensorpipe/config.h>
+#include <tensorpipe/transport/connection.h>
+#include <tensorpipe/transport/context.h>
+#include <tensorpipe/transport/listener.h>
+#include <tensorpipe/transport/uv/factory.h>
+
+#if TENSORPIPE_HAS_SHM_TRANSPORT
+#include <tensorpipe/transport/shm/factory.h>
+#endif // TENSORPIPE_HAS_SHM_TRANSPORT
+
+// Compare the number of threads and the aggregate throughput of a growing
+// number of transport contexts (from 1 to 16, by default) when each of them has
+// its own threads and when they all share the loops of a LoopPool. Each context
+// runs a ping-pong over a connection to itself, all of them at the same time.
+
+using namespace tensorpipe;
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string transport{"uv"};
+  size_t maxNumContexts{16};
+  size_t numLoops{2};
+  size_t numRoundTrips{1000};
+};
+
+size_t countThreads() {
+  DIR* dir = ::opendir("/proc/self/task");
+  TP_THROW_SYSTEM_IF(dir == nullptr, errno);
+  size_t numThreads = 0;
+  while (struct dirent* entry = ::readdir(dir)) {
+    if (entry->d_name[0] != '.') {
+      numThreads++;
+    }
+  }
+  ::closedir(dir);
+  return numThreads;
+}
+
+std::string getListenAddress(const std::string& transport) {
+  // The shm transport picks a unique name when given an empty one.
+  if (transport == "shm") {
+    return "";
+  }
+  return "127.0.0.1";
+}
+
+std::shared_ptr<transport::Context> createContext(
+    const std::string& transport,
+    LoopPool* loopPool) {
+  if (transport == "uv") {
+    return loopPool != nullptr ? transport::uv::create(*loopPool)
+                               : transport::uv::create();
+  }
+#if TENSORPIPE_HAS_SHM_TRANSPORT
+  if (transport == "shm") {
+    return loopPool != nullptr ? transport::shm::create(*loopPool)
+                               : transport::shm::create();
+  }
+#endif // TENSORPIPE_HAS_SHM_TRANSPORT
+  TP_THROW_ASSERT() << "Transport " << transport << " isn't supported";
+  return nullptr;
+}
+
+// The state of the ping-pong of one context. It's kept alive until the context
+// is joined, as the callbacks refer to it.
+struct PingPong {
+  std::shared_ptr<transport::Listener> listener;
+  std::shared_ptr<transport::Connection> client;
+  std::shared_ptr<transport::Connection> server;
+  uint64_t value{0};
+  size_t numRoundTripsLeft{0};
+  std::promise<void> doneProm;
+
+  void roundTrip() {
+    if (numRoundTripsLeft-- == 0) {
+      doneProm.set_value();
+      return;
+    }
+    client->write(&value, sizeof(value), [](const Error& error) {
+      TP_THROW_ASSERT_IF(error) << error.what();
+    });
+    server->read([this](const Error& error, const void* ptr, size_t len) {
+      TP_THROW_ASSERT_IF(error) << error.what();
+      server->write(ptr, len, [](const Error& error) {
+        TP_THROW_ASSERT_IF(error) << error.what();
+      });
+      client->read([this](const Error& error, const void*, size_t) {
+        TP_THROW_ASSERT_IF(error) << error.what();
+        roundTrip();
+      });
+    });
+  }
+};
+
+void measure(const Options& options, size_t numContexts, bool usePool) {
+  const size_t numThreadsBefore = countThreads();
+  std::unique_ptr<LoopPool> loopPool;
+  if (usePool) {
+    loopPool = std::make_unique<LoopPool>(options.numLoops);
+  }
+
+  std::vector<std::shared_ptr<transport::Context>> contexts;
+  std::vector<PingPong> pingPongs(numContexts);
+  for (size_t idx = 0; idx < numContexts; idx++) {
+    contexts.push_back(createContext(options.transport, loopPool.get()));
+    PingPong& pingPong = pingPongs[idx];
+    pingPong.listener =
+        contexts[idx]->listen(getListenAddress(options.transport));
+    std::promise<std::shared_ptr<transport::Connection>> serverProm;
+    pingPong.listener->accept(
+        [&](const Error& error, std::shared_ptr<transport::Connection> conn) {
+          TP_THROW_ASSERT_IF(error) << error.what();
+          serverProm.set_value(std::move(conn));
+        });
+    pingPong.client = contexts[idx]->connect(pingPong.listener->addr());
+    pingPong.server = serverProm.get_future().get();
+    pingPong.numRoundTripsLeft = options.numRoundTrips;
+  }
+
+  const clock::time_point start = clock::now();
+  for (PingPong& pingPong : pingPongs) {
+    pingPong.roundTrip();
+  }
+  for (PingPong& pingPong : pingPongs) {
+    pingPong.doneProm.get_future().get();
+  }
+  const double seconds =
+      std::chrono::duration<double>(clock::now() - start).count();
+  const size_t numThreads = countThreads() - numThreadsBefore;
+
+  for (auto& context : contexts) {
+    context->join();
+  }
+
+  fprintf(
+      stderr,
+      "%-12s %-12lu %-12s %-12lu %-12.0f\n",
+      options.transport.c_str(),
+      numContexts,
+      usePool ? "yes" : "no",
+      numThreads,
+      numContexts * options.numRoundTrips / seconds);
+}
+
+void usage(int status, const char* argv0) {
+  fprintf(stderr, "Usage: %s [OPTIONS]\n", argv0);
+#define X(x) fputs(x "\n", stderr);
+  X("--transport=TRANSPORT       Transport to measure (default uv)");
+  X("--max-num-contexts=N        Largest number of contexts (default 16)");
+  X("--num-loops=N               Number of loops of the pool (default 2)");
+  X("--num-round-trips=N         Round trips per context (default 1000)");
+#undef X
+  exit(status);
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options options;
+  enum Flags : int {
+    TRANSPORT,
+    MAX_NUM_CONTEXTS,
+    NUM_LOOPS,
+    NUM_ROUND_TRIPS,
+    HELP,
+  };
+
+  static struct option longOptions[] = {
+      {"transport", required_argument, nullptr, TRANSPORT},
+      {"max-num-contexts", required_argument, nullptr, MAX_NUM_CONTEXTS},
+      {"num-loops", required_argument, nullptr, NUM_LOOPS},
+      {"num-round-trips", required_argument, nullptr, NUM_ROUND_TRIPS},
+      {"help", no_argument, nullptr, HELP},
+      {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (opt) {
+      case TRANSPORT:
+        options.transport = optarg;
+        break;
+      case MAX_NUM_CONTEXTS:
+        options.maxNumContexts = std::strtoull(optarg, nullptr, 10);
+        break;
+      case NUM_LOOPS:
+        options.numLoops = std::strtoull(optarg, nullptr, 10);
+        break;
+      case NUM_ROUND_TRIPS:
+        options.numRoundTrips = std::strtoull(optarg, nullptr, 10);
+        break;
+      case HELP:
+        usage(EXIT_SUCCESS, argv[0]);
+        break;
+      default:
+        usage(EXIT_FAILURE, argv[0]);
+        break;
+    }
+  }
+
+  if (options.maxNumContexts == 0 || options.numLoops == 0) {
+    fprintf(stderr, "Need at least one context and one loop\n");
+    usage(EXIT_FAILURE, argv[0]);
+  }
+
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options options = parseOptions(argc, argv);
+
+  fprintf(
+      stderr,
+      "%-12s %-12s %-12s %-12s %-12s\n",
+      "transport",
+      "contexts",
+      "pooled",
+      "threads",
+      "round-trips/sec");
+  for (size_t numContexts = 1; numContexts <= options.maxNumContexts;
+       numContexts *= 2) {
+    measure(options, numContexts, /*usePool=*/false);
+    measure(options, numContexts, /*usePool=*/true);
+  }
+
+  return 0;
+}
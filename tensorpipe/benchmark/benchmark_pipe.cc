@@ -9,6 +9,7 @@
 #include <cstring>
 
 #include <future>
+#include <random>
 
 #include <tensorpipe/benchmark/channel_registry.h>
 #include <tensorpipe/benchmark/measurements.h>
@@ -84,6 +85,7 @@ struct Data {
   size_t numTensors;
   size_t tensorSize;
   TensorType tensorType;
+  optional<double> sparseEncodingThreshold;
   std::vector<CpuTensor> expectedCpuTensor;
   std::vector<CudaTensor> expectedCudaTensor;
   std::vector<std::string> expectedTensorMetadata;
@@ -150,6 +152,21 @@ static std::unique_ptr<uint8_t[]> createFullCpuData(size_t size) {
   return data;
 }
 
+static std::unique_ptr<uint8_t[]> createSparseCpuData(
+    size_t size,
+    double sparsity) {
+  std::unique_ptr<uint8_t[]> data = createFullCpuData(size);
+  // The sequence of a seeded mt19937 is fixed by the standard, hence both peers
+  // zero out the same 4-byte words.
+  std::mt19937 gen(42);
+  for (size_t i = 0; i + sizeof(uint32_t) <= size; i += sizeof(uint32_t)) {
+    if (gen() < sparsity * std::mt19937::max()) {
+      std::memset(&data[i], 0, sizeof(uint32_t));
+    }
+  }
+  return data;
+}
+
 static CudaTensor createEmptyCudaData(size_t size) {
   uint8_t* ptr;
   TP_CUDA_CHECK(cudaMalloc(&ptr, size));
@@ -306,6 +323,8 @@ static void serverPongPingNonBlock(
                       .targetDevice =
                           descriptor.tensors[tensorIdx].sourceDevice,
                   };
+                  message.tensors[tensorIdx].sparseEncodingThreshold =
+                      data.sparseEncodingThreshold;
                 }
               } else {
                 TP_DCHECK_EQ(allocation.tensors.size(), 0);
@@ -359,11 +378,15 @@ static void runServer(const Options& options) {
   data.numTensors = options.numTensors;
   data.tensorSize = options.tensorSize;
   data.tensorType = options.tensorType;
+  if (options.sparseEncodingThreshold > 0) {
+    data.sparseEncodingThreshold = options.sparseEncodingThreshold;
+  }
   for (size_t tensorIdx = 0; tensorIdx < options.numTensors; tensorIdx++) {
     data.expectedTensorMetadata.push_back(
         std::string(options.metadataSize, 0x42));
     if (options.tensorType == TensorType::kCpu) {
-      data.expectedCpuTensor.push_back(createFullCpuData(options.tensorSize));
+      data.expectedCpuTensor.push_back(
+          createSparseCpuData(options.tensorSize, options.tensorSparsity));
       data.temporaryCpuTensor.push_back(createEmptyCpuData(options.tensorSize));
     } else if (options.tensorType == TensorType::kCuda) {
       data.expectedCudaTensor.push_back(createFullCudaData(options.tensorSize));
@@ -486,6 +509,7 @@ static void clientPingPongNonBlock(
         tensor.buffer =
             CpuBuffer{.ptr = data.expectedCpuTensor[tensorIdx].get()};
         tensor.targetDevice = Device(kCpuDeviceType, 0);
+        tensor.sparseEncodingThreshold = data.sparseEncodingThreshold;
       } else if (data.tensorType == TensorType::kCuda) {
         tensor.buffer = CudaBuffer{
             .ptr = data.expectedCudaTensor[tensorIdx].get(),
@@ -653,11 +677,15 @@ static void runClient(const Options& options) {
   data.numTensors = options.numTensors;
   data.tensorSize = options.tensorSize;
   data.tensorType = options.tensorType;
+  if (options.sparseEncodingThreshold > 0) {
+    data.sparseEncodingThreshold = options.sparseEncodingThreshold;
+  }
   for (size_t tensorIdx = 0; tensorIdx < options.numTensors; tensorIdx++) {
     data.expectedTensorMetadata.push_back(
         std::string(options.metadataSize, 0x42));
     if (data.tensorType == TensorType::kCpu) {
-      data.expectedCpuTensor.push_back(createFullCpuData(options.tensorSize));
+      data.expectedCpuTensor.push_back(
+          createSparseCpuData(options.tensorSize, options.tensorSparsity));
       data.temporaryCpuTensor.push_back(createEmptyCpuData(options.tensorSize));
     } else if (data.tensorType == TensorType::kCuda) {
       data.expectedCudaTensor.push_back(createFullCudaData(options.tensorSize));
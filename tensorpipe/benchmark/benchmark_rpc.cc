@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <cstring>
+
+#include <chrono>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <mutex>
+
+#include <tensorpipe/benchmark/channel_registry.h>
+#include <tensorpipe/benchmark/measurements.h>
+#include <tensorpipe/benchmark/options.h>
+#include <tensorpipe/benchmark/transport_registry.h>
+#include <tensorpipe/common/cpu_buffer.h>
+#include <tensorpipe/common/defs.h>
+#include <tensorpipe/core/context.h>
+#include <tensorpipe/core/listener.h>
+#include <tensorpipe/core/pipe.h>
+#include <tensorpipe/rpc/client.h>
+#include <tensorpipe/rpc/server.h>
+
+// This benchmark measures the latency and the throughput of the RPC layer when
+// several calls are kept in flight at the same time on a single pipe. With one
+// outstanding call it does the same work as benchmark_pipe (with CPU tensors)
+// and can thus be compared to it to measure the overhead of the RPC layer.
+
+using namespace tensorpipe;
+using namespace tensorpipe::benchmark;
+
+static constexpr int kNumWarmUpCalls = 5;
+
+// The client sends this, with no payloads or tensors, once it's done.
+static constexpr char kStopMetadata[] = "stop";
+
+using Data = std::unique_ptr<uint8_t[]>;
+
+static Data createEmptyCpuData(size_t size) {
+  return std::make_unique<uint8_t[]>(size);
+}
+
+static Data createFullCpuData(size_t size) {
+  Data data = createEmptyCpuData(size);
+  // Generate fake data
+  for (size_t i = 0; i < size; i++) {
+    data[i] = i % 256;
+  }
+  return data;
+}
+
+static std::shared_ptr<Context> createContext(const Options& options) {
+  std::shared_ptr<Context> context = std::make_shared<Context>();
+  auto transportContext =
+      TensorpipeTransportRegistry().create(options.transport);
+  validateTransportContext(transportContext);
+  context->registerTransport(0, options.transport, transportContext);
+
+  auto channelContext = TensorpipeChannelRegistry().create(options.channel);
+  validateChannelContext(channelContext);
+  context->registerChannel(0, options.channel, channelContext);
+  return context;
+}
+
+// The memory of a message, as seen by the receiver.
+struct Buffers {
+  std::vector<Data> payloads;
+  std::vector<Data> tensors;
+
+  Allocation toAllocation() {
+    Allocation allocation;
+    for (const auto& payload : payloads) {
+      allocation.payloads.push_back({.data = payload.get()});
+    }
+    for (const auto& tensor : tensors) {
+      allocation.tensors.push_back({.buffer = CpuBuffer{.ptr = tensor.get()}});
+    }
+    return allocation;
+  }
+};
+
+static Buffers createBuffers(
+    size_t numPayloads,
+    size_t payloadSize,
+    size_t numTensors,
+    size_t tensorSize,
+    bool full) {
+  Buffers buffers;
+  for (size_t payloadIdx = 0; payloadIdx < numPayloads; payloadIdx++) {
+    buffers.payloads.push_back(
+        full ? createFullCpuData(payloadSize)
+             : createEmptyCpuData(payloadSize));
+  }
+  for (size_t tensorIdx = 0; tensorIdx < numTensors; tensorIdx++) {
+    buffers.tensors.push_back(
+        full ? createFullCpuData(tensorSize) : createEmptyCpuData(tensorSize));
+  }
+  return buffers;
+}
+
+static void runServer(const Options& options) {
+  std::shared_ptr<Context> context = createContext(options);
+
+  std::promise<void> doneProm;
+  // The server echoes each request back, sending the response straight from
+  // the buffers that the request was received into.
+  auto server = std::make_shared<rpc::Server>(
+      [](const Descriptor& descriptor) {
+        Buffers buffers;
+        for (const auto& payload : descriptor.payloads) {
+          buffers.payloads.push_back(createEmptyCpuData(payload.length));
+        }
+        for (const auto& tensor : descriptor.tensors) {
+          TP_THROW_ASSERT_IF(tensor.sourceDevice.type != kCpuDeviceType)
+              << "This benchmark only supports CPU tensors";
+          buffers.tensors.push_back(createEmptyCpuData(tensor.length));
+        }
+        Allocation allocation = buffers.toAllocation();
+        // Ownership is taken back when the response has been sent.
+        for (auto& payload : buffers.payloads) {
+          payload.release();
+        }
+        for (auto& tensor : buffers.tensors) {
+          tensor.release();
+        }
+        return allocation;
+      },
+      [&](const Error& error,
+          Descriptor request,
+          Allocation allocation,
+          rpc::Responder responder) {
+        auto freeAllocation = [allocation]() {
+          for (const auto& payload : allocation.payloads) {
+            delete[] static_cast<uint8_t*>(payload.data);
+          }
+          for (const auto& tensor : allocation.tensors) {
+            delete[] static_cast<uint8_t*>(
+                tensor.buffer.unwrap<CpuBuffer>().ptr);
+          }
+        };
+        if (error) {
+          freeAllocation();
+          return;
+        }
+
+        Message response;
+        response.metadata = std::move(request.metadata);
+        for (size_t payloadIdx = 0; payloadIdx < request.payloads.size();
+             payloadIdx++) {
+          response.payloads.push_back({
+              .data = allocation.payloads[payloadIdx].data,
+              .length = request.payloads[payloadIdx].length,
+              .metadata = std::move(request.payloads[payloadIdx].metadata),
+          });
+        }
+        for (size_t tensorIdx = 0; tensorIdx < request.tensors.size();
+             tensorIdx++) {
+          response.tensors.push_back({
+              .buffer = allocation.tensors[tensorIdx].buffer,
+              .length = request.tensors[tensorIdx].length,
+              .metadata = std::move(request.tensors[tensorIdx].metadata),
+          });
+        }
+        const bool isStop = response.metadata == kStopMetadata;
+        responder.respond(
+            std::move(response),
+            [freeAllocation, isStop, &doneProm](const Error& error) {
+              TP_THROW_ASSERT_IF(error) << error.what();
+              freeAllocation();
+              if (isStop) {
+                doneProm.set_value();
+              }
+            });
+      },
+      options.numHandlerThreads);
+
+  std::shared_ptr<Listener> listener = context->listen({options.address});
+  listener->accept([&](const Error& error, std::shared_ptr<Pipe> pipe) {
+    TP_THROW_ASSERT_IF(error) << error.what();
+    server->serve(std::move(pipe));
+  });
+
+  doneProm.get_future().get();
+  listener->close();
+  server->close();
+  context->join();
+}
+
+// The state of one of the "lanes" of the client, which each have one call in
+// flight at any time and have their own buffers.
+struct Lane {
+  Buffers request;
+  Buffers response;
+  std::string metadata;
+  std::chrono::steady_clock::time_point start;
+};
+
+class ClientLoop {
+ public:
+  ClientLoop(const Options& options, rpc::Client& client)
+      : options_(options), client_(client) {
+    for (size_t laneIdx = 0; laneIdx < options.numOutstandingCalls;
+         laneIdx++) {
+      lanes_.emplace_back();
+      Lane& lane = lanes_.back();
+      lane.request = createBuffers(
+          options.numPayloads,
+          options.payloadSize,
+          options.numTensors,
+          options.tensorSize,
+          /*full=*/true);
+      lane.response = createBuffers(
+          options.numPayloads,
+          options.payloadSize,
+          options.numTensors,
+          options.tensorSize,
+          /*full=*/false);
+      lane.metadata = std::string(options.metadataSize, 0x42);
+    }
+    numCallsToIssue_ = kNumWarmUpCalls + options.numRoundTrips;
+    latencies_.reserve(options.numRoundTrips);
+  }
+
+  void run() {
+    for (auto& lane : lanes_) {
+      issueCall(lane);
+    }
+    doneProm_.get_future().get();
+  }
+
+  void printMeasurements() {
+    const double seconds =
+        std::chrono::duration<double>(lastCallEnd_ - firstCallStart_).count();
+    const size_t bytesPerCall = options_.numPayloads * options_.payloadSize +
+        options_.numTensors * options_.tensorSize;
+    latencies_.sort();
+    fprintf(
+        stderr,
+        "%-15s %-12s %-12s %-12s %-7s %-7s %-7s %-7s %-7s\n",
+        "chunk-size",
+        "# calls",
+        "calls/sec",
+        "avg (usec)",
+        "p50",
+        "p75",
+        "p90",
+        "p95",
+        "p99");
+    fprintf(
+        stderr,
+        "%-15lu %-12lu %-12.0f %-12.3f %-7.3f %-7.3f %-7.3f %-7.3f %-7.3f\n",
+        bytesPerCall,
+        latencies_.size(),
+        latencies_.size() / seconds,
+        latencies_.sum().count() / (float)latencies_.size() / 1000.0,
+        latencies_.percentile(0.50).count() / 1000.0,
+        latencies_.percentile(0.75).count() / 1000.0,
+        latencies_.percentile(0.90).count() / 1000.0,
+        latencies_.percentile(0.95).count() / 1000.0,
+        latencies_.percentile(0.99).count() / 1000.0);
+  }
+
+ private:
+  const Options& options_;
+  rpc::Client& client_;
+  std::deque<Lane> lanes_;
+
+  std::mutex mutex_;
+  size_t numCallsToIssue_;
+  size_t numCallsIssued_{0};
+  size_t numCallsCompleted_{0};
+  Measurements latencies_;
+  std::chrono::steady_clock::time_point firstCallStart_;
+  std::chrono::steady_clock::time_point lastCallEnd_;
+  std::promise<void> doneProm_;
+
+  void issueCall(Lane& lane) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (numCallsIssued_ == numCallsToIssue_) {
+        return;
+      }
+      numCallsIssued_++;
+    }
+
+    Message request;
+    request.metadata = lane.metadata;
+    for (const auto& payload : lane.request.payloads) {
+      request.payloads.push_back({
+          .data = payload.get(),
+          .length = options_.payloadSize,
+          .metadata = lane.metadata,
+      });
+    }
+    for (const auto& tensor : lane.request.tensors) {
+      request.tensors.push_back({
+          .buffer = CpuBuffer{.ptr = tensor.get()},
+          .length = options_.tensorSize,
+          .metadata = lane.metadata,
+      });
+    }
+
+    lane.start = std::chrono::steady_clock::now();
+    client_.call(
+        std::move(request),
+        [&lane](const Descriptor& /* unused */) {
+          return lane.response.toAllocation();
+        },
+        [this, &lane](const Error& error, Descriptor /* unused */) {
+          TP_THROW_ASSERT_IF(error) << error.what();
+          onCallCompleted(lane);
+        });
+  }
+
+  void onCallCompleted(Lane& lane) {
+    const auto end = std::chrono::steady_clock::now();
+    bool done;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      numCallsCompleted_++;
+      if (numCallsCompleted_ == kNumWarmUpCalls) {
+        firstCallStart_ = end;
+      } else if (numCallsCompleted_ > kNumWarmUpCalls) {
+        latencies_.addSample(end - lane.start);
+        lastCallEnd_ = end;
+      }
+      done = numCallsCompleted_ == numCallsToIssue_;
+    }
+    if (done) {
+      doneProm_.set_value();
+      return;
+    }
+    issueCall(lane);
+  }
+};
+
+static void runClient(const Options& options) {
+  TP_THROW_ASSERT_IF(options.tensorType != TensorType::kCpu)
+      << "This benchmark only supports CPU tensors";
+  TP_THROW_ASSERT_IF(options.numOutstandingCalls == 0)
+      << "There must be at least one outstanding call";
+
+  std::shared_ptr<Context> context = createContext(options);
+  rpc::Client client(context->connect(options.address));
+
+  ClientLoop loop(options, client);
+  loop.run();
+  loop.printMeasurements();
+
+  std::promise<void> stopProm;
+  Message stop;
+  stop.metadata = kStopMetadata;
+  client.call(
+      std::move(stop),
+      [](const Descriptor& /* unused */) { return Allocation(); },
+      [&](const Error& error, Descriptor /* unused */) {
+        TP_THROW_ASSERT_IF(error) << error.what();
+        stopProm.set_value();
+      });
+  stopProm.get_future().get();
+
+  client.close();
+  context->join();
+}
+
+int main(int argc, char** argv) {
+  struct Options x = parseOptions(argc, argv);
+  std::cout << "mode = " << x.mode << "\n";
+  std::cout << "transport = " << x.transport << "\n";
+  std::cout << "channel = " << x.channel << "\n";
+  std::cout << "address = " << x.address << "\n";
+  std::cout << "num_round_trips = " << x.numRoundTrips << "\n";
+  std::cout << "num_payloads = " << x.numPayloads << "\n";
+  std::cout << "payload_size = " << x.payloadSize << "\n";
+  std::cout << "num_tensors = " << x.numTensors << "\n";
+  std::cout << "tensor_size = " << x.tensorSize << "\n";
+  std::cout << "metadata_size = " << x.metadataSize << "\n";
+  std::cout << "num_outstanding_calls = " << x.numOutstandingCalls << "\n";
+  std::cout << "num_handler_threads = " << x.numHandlerThreads << "\n";
+
+  if (x.mode == "listen") {
+    runServer(x);
+  } else if (x.mode == "connect") {
+    runClient(x);
+  } else {
+    // Should never be here
+    TP_THROW_ASSERT() << "unknown mode: " << x.mode;
+  }
+
+  return 0;
+}
@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <tensorpipe/common/defs.h>
+#include <tensorpipe/common/sparse_encoding.h>
+#include <tensorpipe/config.h>
+#include <tensorpipe/transport/connection.h>
+#include <tensorpipe/transport/context.h>
+#include <tensorpipe/transport/listener.h>
+#include <tensorpipe/transport/uv/factory.h>
+
+#if TENSORPIPE_HAS_SHM_TRANSPORT
+#include <tensorpipe/transport/shm/factory.h>
+#endif // TENSORPIPE_HAS_SHM_TRANSPORT
+
+// Find out, for a range of tensor sizes and fractions of zero words, whether
+// sending a tensor in the sparse encoding (counting its non-zero words,
+// encoding it, sending the encoding and decoding it, as the pipe does) is
+// faster than sending it as is, in order to pick a sparseEncodingThreshold.
+// Both are sent over a connection of the given transport to itself, and the
+// median of the end-to-end times is reported. As that connection is usually
+// faster than the one to a remote peer, the bandwidth of a link below which the
+// encoding would pay off (i.e., at which the time it saves in sending equals the
+// time spent encoding and decoding) is reported too.
+
+using namespace tensorpipe;
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string transport{"uv"};
+  size_t minSize{4 * 1024};
+  size_t maxSize{16 * 1024 * 1024};
+  size_t numRoundTrips{50};
+};
+
+const double kZeroFractions[] = {0.5, 0.75, 0.9, 0.95, 0.99, 0.999};
+
+std::string getListenAddress(const std::string& transport) {
+  // The shm transport picks a unique name when given an empty one.
+  if (transport == "shm") {
+    return "";
+  }
+  return "127.0.0.1";
+}
+
+std::shared_ptr<transport::Context> createContext(
+    const std::string& transport) {
+  if (transport == "uv") {
+    return transport::uv::create();
+  }
+#if TENSORPIPE_HAS_SHM_TRANSPORT
+  if (transport == "shm") {
+    return transport::shm::create();
+  }
+#endif // TENSORPIPE_HAS_SHM_TRANSPORT
+  TP_THROW_ASSERT() << "Transport " << transport << " isn't supported";
+  return nullptr;
+}
+
+// Fill the buffer with zeros except for a random subset of its 4-byte words,
+// chosen so that the given fraction of them is zero.
+void fillSparse(std::vector<uint8_t>& buffer, double zeroFraction) {
+  std::fill(buffer.begin(), buffer.end(), 0);
+  std::mt19937 gen(0);
+  std::bernoulli_distribution isNonZero(1 - zeroFraction);
+  const uint32_t value = 0x3f800000; // 1.0f
+  for (size_t offset = 0; offset + sizeof(value) <= buffer.size();
+       offset += sizeof(value)) {
+    if (isNonZero(gen)) {
+      std::memcpy(&buffer[offset], &value, sizeof(value));
+    }
+  }
+}
+
+class Sender {
+ public:
+  explicit Sender(const std::string& transport) {
+    context_ = createContext(transport);
+    listener_ = context_->listen(getListenAddress(transport));
+    std::promise<std::shared_ptr<transport::Connection>> serverProm;
+    listener_->accept(
+        [&](const Error& error, std::shared_ptr<transport::Connection> conn) {
+          TP_THROW_ASSERT_IF(error) << error.what();
+          serverProm.set_value(std::move(conn));
+        });
+    client_ = context_->connect(listener_->addr());
+    server_ = serverProm.get_future().get();
+  }
+
+  // Send the buffer from one end of the connection to the other and return
+  // once it has been fully received.
+  void send(const void* src, void* dst, size_t length) {
+    std::promise<void> doneProm;
+    client_->write(src, length, [](const Error& error) {
+      TP_THROW_ASSERT_IF(error) << error.what();
+    });
+    server_->read(
+        dst, length, [&](const Error& error, const void*, size_t) {
+          TP_THROW_ASSERT_IF(error) << error.what();
+          doneProm.set_value();
+        });
+    doneProm.get_future().get();
+  }
+
+  ~Sender() {
+    context_->join();
+  }
+
+ private:
+  std::shared_ptr<transport::Context> context_;
+  std::shared_ptr<transport::Listener> listener_;
+  std::shared_ptr<transport::Connection> client_;
+  std::shared_ptr<transport::Connection> server_;
+};
+
+double median(std::vector<double> samples) {
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+void measure(
+    const Options& options,
+    Sender& sender,
+    size_t size,
+    double zeroFraction) {
+  std::vector<uint8_t> src(size);
+  fillSparse(src, zeroFraction);
+  std::vector<uint8_t> dst(size);
+  std::vector<uint8_t> encoded(sparseEncodedLength(size, size / 4));
+  std::vector<uint8_t> received(encoded.size());
+
+  auto microseconds = [](clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+  };
+
+  std::vector<double> denseSamples;
+  std::vector<double> sparseSamples;
+  std::vector<double> codecSamples;
+  size_t encodedLength = 0;
+  for (size_t idx = 0; idx < options.numRoundTrips; idx++) {
+    const clock::time_point denseStart = clock::now();
+    sender.send(src.data(), dst.data(), size);
+    denseSamples.push_back(microseconds(clock::now() - denseStart));
+
+    const clock::time_point encodeStart = clock::now();
+    const size_t numNonZeroWords = countNonZeroWords(src.data(), size);
+    encodedLength = sparseEncodedLength(size, numNonZeroWords);
+    encodeSparse(src.data(), size, encoded.data());
+    const clock::time_point sendStart = clock::now();
+    sender.send(encoded.data(), received.data(), encodedLength);
+    const clock::time_point decodeStart = clock::now();
+    const bool success =
+        decodeSparse(received.data(), encodedLength, dst.data(), size);
+    const clock::time_point decodeStop = clock::now();
+    TP_THROW_ASSERT_IF(!success) << "Couldn't decode the sparse encoding";
+    sparseSamples.push_back(microseconds(decodeStop - encodeStart));
+    codecSamples.push_back(microseconds(
+        (sendStart - encodeStart) + (decodeStop - decodeStart)));
+  }
+
+  const double denseUs = median(std::move(denseSamples));
+  const double sparseUs = median(std::move(sparseSamples));
+  const double codecUs = median(std::move(codecSamples));
+  // Bytes per microsecond are megabytes per second.
+  const double breakEvenMBps = encodedLength < size
+      ? (size - encodedLength) / codecUs
+      : 0;
+  fprintf(
+      stderr,
+      "%-12s %-12lu %-12.3f %-12lu %-12.1f %-12.1f %-12.2f %-12.0f\n",
+      options.transport.c_str(),
+      size,
+      zeroFraction,
+      encodedLength,
+      denseUs,
+      sparseUs,
+      denseUs / sparseUs,
+      breakEvenMBps);
+}
+
+void usage(int status, const char* argv0) {
+  fprintf(stderr, "Usage: %s [OPTIONS]\n", argv0);
+#define X(x) fputs(x "\n", stderr);
+  X("--transport=TRANSPORT       Transport to measure (default uv)");
+  X("--min-size=N                Smallest tensor size (default 4096)");
+  X("--max-size=N                Largest tensor size (default 16777216)");
+  X("--num-round-trips=N         Sends per data point (default 50)");
+#undef X
+  exit(status);
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options options;
+  enum Flags : int {
+    TRANSPORT,
+    MIN_SIZE,
+    MAX_SIZE,
+    NUM_ROUND_TRIPS,
+    HELP,
+  };
+
+  static struct option longOptions[] = {
+      {"transport", required_argument, nullptr, TRANSPORT},
+      {"min-size", required_argument, nullptr, MIN_SIZE},
+      {"max-size", required_argument, nullptr, MAX_SIZE},
+      {"num-round-trips", required_argument, nullptr, NUM_ROUND_TRIPS},
+      {"help", no_argument, nullptr, HELP},
+      {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (opt) {
+      case TRANSPORT:
+        options.transport = optarg;
+        break;
+      case MIN_SIZE:
+        options.minSize = std::strtoull(optarg, nullptr, 10);
+        break;
+      case MAX_SIZE:
+        options.maxSize = std::strtoull(optarg, nullptr, 10);
+        break;
+      case NUM_ROUND_TRIPS:
+        options.numRoundTrips = std::strtoull(optarg, nullptr, 10);
+        break;
+      case HELP:
+        usage(EXIT_SUCCESS, argv[0]);
+        break;
+      default:
+        usage(EXIT_FAILURE, argv[0]);
+        break;
+    }
+  }
+
+  if (options.minSize == 0 || options.numRoundTrips == 0) {
+    fprintf(stderr, "Need a non-zero size and at least one round trip\n");
+    usage(EXIT_FAILURE, argv[0]);
+  }
+
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  Options options = parseOptions(argc, argv);
+  Sender sender(options.transport);
+
+  fprintf(
+      stderr,
+      "%-12s %-12s %-12s %-12s %-12s %-12s %-12s %-12s\n",
+      "transport",
+      "size",
+      "zeros",
+      "encoded",
+      "dense (us)",
+      "sparse (us)",
+      "speedup",
+      "break-even (MB/s)");
+  for (size_t size = options.minSize; size <= options.maxSize; size *= 4) {
+    for (double zeroFraction : kZeroFractions) {
+      measure(options, sender, size, zeroFraction);
+    }
+  }
+
+  return 0;
+}
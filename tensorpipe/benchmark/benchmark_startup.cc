@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <string>
+#include <vector>
+
+#include <tensorpipe/benchmark/channel_registry.h>
+#include <tensorpipe/benchmark/transport_registry.h>
+#include <tensorpipe/common/defs.h>
+
+// Measure how long it takes to create (and tear down) the context of each
+// transport and channel, which is dominated by their viability checks. The
+// first creation in a process pays for the probing, whereas subsequent ones
+// should hit the per-process cache. With --parallel, all the first creations
+// are performed concurrently, as a process setting up a full context could.
+
+using namespace tensorpipe;
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+
+struct Result {
+  std::string name;
+  bool viable{false};
+  bool failed{false};
+  std::chrono::nanoseconds firstCreate{0};
+  std::chrono::nanoseconds secondCreate{0};
+  std::chrono::nanoseconds join{0};
+};
+
+template <typename TCtx>
+Result measureBackend(
+    const std::string& name,
+    std::function<std::shared_ptr<TCtx>()> creator) {
+  Result result;
+  result.name = name;
+  try {
+    clock::time_point start = clock::now();
+    std::shared_ptr<TCtx> context = creator();
+    result.firstCreate = clock::now() - start;
+    result.viable = context->isViable();
+
+    start = clock::now();
+    std::shared_ptr<TCtx> otherContext = creator();
+    result.secondCreate = clock::now() - start;
+
+    start = clock::now();
+    context->join();
+    otherContext->join();
+    result.join = (clock::now() - start) / 2;
+  } catch (const std::exception& e) {
+    // Some backends (e.g., mpt) can't be created without arguments.
+    result.failed = true;
+  }
+  return result;
+}
+
+void printResults(const std::string& kind, const std::vector<Result>& results) {
+  fprintf(
+      stderr,
+      "%-10s %-15s %-8s %-18s %-18s %-12s\n",
+      kind.c_str(),
+      "name",
+      "viable",
+      "1st create (usec)",
+      "2nd create (usec)",
+      "join (usec)");
+  for (const auto& result : results) {
+    if (result.failed) {
+      fprintf(
+          stderr, "%-10s %-15s %-8s\n", "", result.name.c_str(), "skipped");
+      continue;
+    }
+    fprintf(
+        stderr,
+        "%-10s %-15s %-8s %-18.3f %-18.3f %-12.3f\n",
+        "",
+        result.name.c_str(),
+        result.viable ? "yes" : "no",
+        result.firstCreate.count() / 1000.0,
+        result.secondCreate.count() / 1000.0,
+        result.join.count() / 1000.0);
+  }
+}
+
+void usage(int status, const char* argv0) {
+  fprintf(stderr, "Usage: %s [OPTIONS]\n", argv0);
+#define X(x) fputs(x "\n", stderr);
+  X("");
+  X("--parallel [optional]            Probe all backends concurrently");
+#undef X
+  exit(status);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  bool parallel = false;
+
+  static struct option longOptions[] = {
+      {"parallel", no_argument, nullptr, 'p'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0}};
+  int opt;
+  while ((opt = getopt_long(argc, argv, "", longOptions, nullptr)) != -1) {
+    switch (opt) {
+      case 'p':
+        parallel = true;
+        break;
+      case 'h':
+        usage(EXIT_SUCCESS, argv[0]);
+        break;
+      default:
+        usage(EXIT_FAILURE, argv[0]);
+        break;
+    }
+  }
+
+  std::vector<std::future<Result>> transportFutures;
+  std::vector<std::future<Result>> channelFutures;
+  const auto launchPolicy =
+      parallel ? std::launch::async : std::launch::deferred;
+
+  clock::time_point start = clock::now();
+  for (const auto& name : TensorpipeTransportRegistry().keys()) {
+    transportFutures.push_back(std::async(launchPolicy, [name]() {
+      return measureBackend<transport::Context>(name, [name]() {
+        return TensorpipeTransportRegistry().create(name);
+      });
+    }));
+  }
+  for (const auto& name : TensorpipeChannelRegistry().keys()) {
+    channelFutures.push_back(std::async(launchPolicy, [name]() {
+      return measureBackend<channel::Context>(name, [name]() {
+        return TensorpipeChannelRegistry().create(name);
+      });
+    }));
+  }
+
+  std::vector<Result> transportResults;
+  for (auto& future : transportFutures) {
+    transportResults.push_back(future.get());
+  }
+  std::vector<Result> channelResults;
+  for (auto& future : channelFutures) {
+    channelResults.push_back(future.get());
+  }
+  std::chrono::nanoseconds total = clock::now() - start;
+
+  printResults("transport", transportResults);
+  printResults("channel", channelResults);
+  fprintf(
+      stderr,
+      "total (%s): %.3f usec\n",
+      parallel ? "parallel" : "sequential",
+      total.count() / 1000.0);
+
+  return 0;
+}
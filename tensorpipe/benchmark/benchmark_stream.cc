@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+
+#include <tensorpipe/benchmark/channel_registry.h>
+#include <tensorpipe/benchmark/options.h>
+#include <tensorpipe/benchmark/transport_registry.h>
+#include <tensorpipe/common/defs.h>
+#include <tensorpipe/core/context.h>
+#include <tensorpipe/core/error.h>
+#include <tensorpipe/core/listener.h>
+#include <tensorpipe/core/pipe.h>
+#include <tensorpipe/core/stream.h>
+
+// This benchmark measures the throughput of a one-way flow of chunks of data,
+// sent first as one message per chunk and then over a stream. The connecting
+// side produces the chunks (whose number is given by --num-round-trips and
+// whose size is given by --payload-size) and the listening side consumes them
+// and reports the results.
+
+using namespace tensorpipe;
+using namespace tensorpipe::benchmark;
+
+using Data = std::unique_ptr<uint8_t[]>;
+
+static constexpr uint64_t kStreamId = 0;
+
+static std::shared_ptr<Context> createContext(const Options& options) {
+  std::shared_ptr<Context> context =
+      std::make_shared<Context>(ContextOptions().enableStreams());
+  auto transportContext =
+      TensorpipeTransportRegistry().create(options.transport);
+  validateTransportContext(transportContext);
+  context->registerTransport(0, options.transport, transportContext);
+
+  auto channelContext = TensorpipeChannelRegistry().create(options.channel);
+  validateChannelContext(channelContext);
+  context->registerChannel(0, options.channel, channelContext);
+  return context;
+}
+
+// Measured on the receiver, between the arrival of the first and of the last
+// chunk, to exclude the time it takes for the sender to get started.
+class Throughput {
+  using clock = std::chrono::steady_clock;
+
+ public:
+  void markChunk() {
+    clock::time_point now = clock::now();
+    if (numChunks_ == 0) {
+      first_ = now;
+    }
+    last_ = now;
+    numChunks_++;
+  }
+
+  void print(const char* mode, size_t chunkSize) const {
+    const double seconds =
+        std::chrono::duration<double>(last_ - first_).count();
+    const size_t numChunks = numChunks_ - 1;
+    fprintf(
+        stderr,
+        "%-10s %-15lu %-12lu %-15.0f %-12.3f\n",
+        mode,
+        chunkSize,
+        numChunks,
+        numChunks / seconds,
+        numChunks * chunkSize / seconds / 1000 / 1000);
+  }
+
+ private:
+  clock::time_point first_;
+  clock::time_point last_;
+  size_t numChunks_{0};
+};
+
+static void receiveMessages(
+    Pipe& pipe,
+    size_t numChunks,
+    std::vector<Data>& buffers,
+    Throughput& throughput) {
+  std::promise<void> doneProm;
+  // These are only accessed from the pipe's event loop.
+  size_t numDescriptorsRequested = 0;
+  size_t numChunksReceived = 0;
+
+  std::function<void()> readNextDescriptor = [&]() {
+    numDescriptorsRequested++;
+    pipe.readDescriptor([&](const Error& error, Descriptor descriptor) {
+      TP_THROW_ASSERT_IF(error) << error.what();
+      TP_DCHECK_EQ(descriptor.payloads.size(), 1);
+      Allocation allocation;
+      allocation.payloads.push_back(
+          {.data = buffers[numDescriptorsRequested % buffers.size()].get()});
+      pipe.read(std::move(allocation), [&](const Error& error) {
+        TP_THROW_ASSERT_IF(error) << error.what();
+        throughput.markChunk();
+        if (++numChunksReceived == numChunks) {
+          doneProm.set_value();
+        }
+      });
+      if (numDescriptorsRequested < numChunks) {
+        readNextDescriptor();
+      }
+    });
+  };
+
+  readNextDescriptor();
+  doneProm.get_future().get();
+}
+
+static void receiveStream(
+    Stream& stream,
+    size_t chunkSize,
+    std::vector<Data>& buffers,
+    Throughput& throughput) {
+  std::promise<void> doneProm;
+  // This is only accessed from the pipe's event loop.
+  size_t numBuffersDone = 0;
+
+  // Each buffer is posted again as soon as it's filled, until the end.
+  std::function<void(uint8_t*)> readIntoBuffer = [&](uint8_t* ptr) {
+    stream.read(ptr, chunkSize, [&, ptr](const Error& error, size_t length) {
+      if (error) {
+        TP_THROW_ASSERT_IF(!error.isOfType<StreamEndedError>())
+            << error.what();
+        if (++numBuffersDone == buffers.size()) {
+          doneProm.set_value();
+        }
+        return;
+      }
+      TP_DCHECK_EQ(length, chunkSize);
+      throughput.markChunk();
+      readIntoBuffer(ptr);
+    });
+  };
+
+  for (const auto& buffer : buffers) {
+    readIntoBuffer(buffer.get());
+  }
+  doneProm.get_future().get();
+}
+
+static void runServer(const Options& options) {
+  std::shared_ptr<Context> context = createContext(options);
+
+  std::promise<std::shared_ptr<Pipe>> pipeProm;
+  std::shared_ptr<Listener> listener = context->listen({options.address});
+  listener->accept([&](const Error& error, std::shared_ptr<Pipe> pipe) {
+    TP_THROW_ASSERT_IF(error) << error.what();
+    pipeProm.set_value(std::move(pipe));
+  });
+  std::shared_ptr<Pipe> pipe = pipeProm.get_future().get();
+
+  std::vector<Data> buffers;
+  for (size_t bufferIdx = 0; bufferIdx < options.numChunksInFlight;
+       bufferIdx++) {
+    buffers.push_back(std::make_unique<uint8_t[]>(options.payloadSize));
+  }
+
+  Throughput messageThroughput;
+  receiveMessages(*pipe, options.numRoundTrips, buffers, messageThroughput);
+
+  Throughput streamThroughput;
+  Stream stream = pipe->openStream(kStreamId);
+  receiveStream(stream, options.payloadSize, buffers, streamThroughput);
+
+  fprintf(
+      stderr,
+      "%-10s %-15s %-12s %-15s %-12s\n",
+      "mode",
+      "chunk-size",
+      "# chunks",
+      "chunks/sec",
+      "MB/sec");
+  messageThroughput.print("message", options.payloadSize);
+  streamThroughput.print("stream", options.payloadSize);
+
+  // Let the client know that it can exit.
+  std::promise<void> doneProm;
+  pipe->write(Message(), [&](const Error& error) {
+    TP_THROW_ASSERT_IF(error) << error.what();
+    doneProm.set_value();
+  });
+  doneProm.get_future().get();
+
+  listener.reset();
+  context->join();
+}
+
+// Issue the given function for each chunk, keeping at most the given number of
+// them in flight, until all of them completed. The function is given the index
+// of the chunk and the callback to invoke once it completes.
+static void runWithWindow(
+    size_t numChunks,
+    size_t numChunksInFlight,
+    std::function<void(size_t, std::function<void()>)> fn) {
+  std::promise<void> doneProm;
+  std::atomic<size_t> numChunksIssued{0};
+  std::atomic<size_t> numChunksCompleted{0};
+
+  std::function<void()> issueNext = [&]() {
+    size_t chunkIdx = numChunksIssued++;
+    if (chunkIdx >= numChunks) {
+      return;
+    }
+    fn(chunkIdx, [&]() {
+      if (++numChunksCompleted == numChunks) {
+        doneProm.set_value();
+        return;
+      }
+      issueNext();
+    });
+  };
+
+  for (size_t idx = 0; idx < numChunksInFlight; idx++) {
+    issueNext();
+  }
+  doneProm.get_future().get();
+}
+
+static void runClient(const Options& options) {
+  std::shared_ptr<Context> context = createContext(options);
+  std::shared_ptr<Pipe> pipe = context->connect(options.address);
+
+  Data data = std::make_unique<uint8_t[]>(options.payloadSize);
+  for (size_t i = 0; i < options.payloadSize; i++) {
+    data[i] = i % 256;
+  }
+
+  runWithWindow(
+      options.numRoundTrips,
+      options.numChunksInFlight,
+      [&](size_t /* unused */, std::function<void()> done) {
+        Message message;
+        message.payloads.push_back({
+            .data = data.get(),
+            .length = options.payloadSize,
+        });
+        pipe->write(
+            std::move(message), [done{std::move(done)}](const Error& error) {
+              TP_THROW_ASSERT_IF(error) << error.what();
+              done();
+            });
+      });
+
+  Stream stream = pipe->openStream(kStreamId);
+  runWithWindow(
+      options.numRoundTrips,
+      options.numChunksInFlight,
+      [&](size_t chunkIdx, std::function<void()> done) {
+        stream.write(
+            data.get(),
+            options.payloadSize,
+            [done{std::move(done)}](const Error& error) {
+              TP_THROW_ASSERT_IF(error) << error.what();
+              done();
+            });
+        if (chunkIdx == options.numRoundTrips - 1) {
+          stream.end();
+        }
+      });
+
+  std::promise<void> doneProm;
+  pipe->readDescriptor([&](const Error& error, Descriptor /* unused */) {
+    TP_THROW_ASSERT_IF(error) << error.what();
+    pipe->read(Allocation(), [&](const Error& error) {
+      TP_THROW_ASSERT_IF(error) << error.what();
+      doneProm.set_value();
+    });
+  });
+  doneProm.get_future().get();
+
+  context->join();
+}
+
+int main(int argc, char** argv) {
+  struct Options x = parseOptions(argc, argv);
+  std::cout << "mode = " << x.mode << "\n";
+  std::cout << "transport = " << x.transport << "\n";
+  std::cout << "channel = " << x.channel << "\n";
+  std::cout << "address = " << x.address << "\n";
+  std::cout << "num_round_trips = " << x.numRoundTrips << "\n";
+  std::cout << "payload_size = " << x.payloadSize << "\n";
+  std::cout << "num_chunks_in_flight = " << x.numChunksInFlight << "\n";
+
+  TP_THROW_ASSERT_IF(x.numRoundTrips < 2) << "Need at least two chunks";
+  TP_THROW_ASSERT_IF(x.payloadSize == 0) << "Chunks can't be empty";
+  TP_THROW_ASSERT_IF(x.numChunksInFlight == 0)
+      << "Need at least one chunk in flight";
+
+  if (x.mode == "listen") {
+    runServer(x);
+  } else if (x.mode == "connect") {
+    runClient(x);
+  } else {
+    // Should never be here
+    TP_THROW_ASSERT() << "unknown mode: " << x.mode;
+  }
+
+  return 0;
+}
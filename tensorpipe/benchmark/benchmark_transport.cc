@@ -6,9 +6,15 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <sys/resource.h>
+
 #include <cstring>
 
+#include <chrono>
 #include <future>
+#include <random>
+#include <thread>
+#include <vector>
 
 #include <tensorpipe/benchmark/measurements.h>
 #include <tensorpipe/benchmark/options.h>
@@ -21,6 +27,8 @@ using namespace tensorpipe;
 using namespace tensorpipe::benchmark;
 using namespace tensorpipe::transport;
 
+using TimePoint = std::chrono::steady_clock::time_point;
+
 struct Data {
   std::unique_ptr<uint8_t[]> expected;
   std::unique_ptr<uint8_t[]> temporary;
@@ -51,6 +59,28 @@ static void printMeasurements(Measurements& measurements, size_t dataLen) {
       measurements.percentile(0.95).count() / 1000.0);
 }
 
+// The CPU time consumed by the whole process (by all its threads, including the
+// transport's event loop), which matters when comparing busy-polling modes.
+static std::chrono::microseconds getProcessCpuTime() {
+  struct rusage usage;
+  auto rv = ::getrusage(RUSAGE_SELF, &usage);
+  TP_THROW_SYSTEM_IF(rv < 0, errno);
+  return std::chrono::seconds(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+      std::chrono::microseconds(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec);
+}
+
+static void printCpuTime(
+    std::chrono::microseconds cpuTime,
+    size_t numRoundTrips) {
+  fprintf(
+      stderr,
+      "%-15s %-15s\n%-15.3f %-15.3f\n",
+      "cpu (msec)",
+      "cpu/rt (usec)",
+      cpuTime.count() / 1000.0,
+      cpuTime.count() / (float)numRoundTrips);
+}
+
 static std::unique_ptr<uint8_t[]> createData(const int size) {
   auto data = std::make_unique<uint8_t[]>(size);
   // Generate fixed data for validation between peers
@@ -154,6 +184,78 @@ static void clientPingPongNonBlock(
       });
 }
 
+// Issue the pings at the rate given by --max-rate (at fixed intervals or
+// following a Poisson process) without waiting for the previous pongs, which
+// the connection delivers in order. As in benchmark_load, each round trip is
+// measured from the time at which its ping was due rather than from when it was
+// actually written, so that the pings issued late don't hide the time they
+// spent waiting (the so-called coordinated omission).
+static void clientOpenLoop(
+    std::shared_ptr<Connection> conn,
+    const Options& options,
+    Data& data) {
+  const size_t numRoundTrips = options.numRoundTrips;
+  Measurements correctedLatencies;
+  correctedLatencies.reserve(numRoundTrips);
+  Measurements uncorrectedLatencies;
+  uncorrectedLatencies.reserve(numRoundTrips);
+  // Written by this thread before issuing each ping, and read by the loop when
+  // its pong arrives.
+  std::vector<TimePoint> intendedStarts(numRoundTrips);
+  std::vector<TimePoint> actualStarts(numRoundTrips);
+  // Only accessed from the loop.
+  size_t numRoundTripsLeft = numRoundTrips;
+  TimePoint lastEnd;
+  std::promise<void> doneProm;
+
+  std::mt19937_64 engine(0);
+  std::exponential_distribution<double> exponential(options.maxRate);
+  const TimePoint start =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+  double offset = 0;
+  for (size_t roundTripIdx = 0; roundTripIdx < numRoundTrips; roundTripIdx++) {
+    intendedStarts[roundTripIdx] = start +
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::duration<double>(offset));
+    offset += options.arrivalProcess == "poisson" ? exponential(engine)
+                                                  : 1.0 / options.maxRate;
+    std::this_thread::sleep_until(intendedStarts[roundTripIdx]);
+    actualStarts[roundTripIdx] = std::chrono::steady_clock::now();
+
+    conn->write(data.expected.get(), data.size, [](const Error& error) {
+      TP_THROW_ASSERT_IF(error) << error.what();
+    });
+    // All pongs are received into the same buffer, as they're all the same.
+    conn->read(
+        data.temporary.get(),
+        data.size,
+        [&, roundTripIdx](const Error& error, const void* ptr, size_t len) {
+          const TimePoint end = std::chrono::steady_clock::now();
+          TP_THROW_ASSERT_IF(error) << error.what();
+          TP_DCHECK_EQ(len, data.size);
+          correctedLatencies.addSample(end - intendedStarts[roundTripIdx]);
+          uncorrectedLatencies.addSample(end - actualStarts[roundTripIdx]);
+          lastEnd = end;
+          if (--numRoundTripsLeft == 0) {
+            doneProm.set_value();
+          }
+        });
+  }
+  doneProm.get_future().get();
+
+  uncorrectedLatencies.sort();
+  printMeasurements(correctedLatencies, data.size);
+  fprintf(
+      stderr,
+      "%-15s %-15s %-17s\n%-15.0f %-15.0f %-17.3f\n",
+      "offered/sec",
+      "achieved/sec",
+      "p99 (uncorrected)",
+      options.maxRate,
+      numRoundTrips / std::chrono::duration<double>(lastEnd - start).count(),
+      uncorrectedLatencies.percentile(0.99).count() / 1000.0);
+}
+
 // Start with sending ping
 static void runClient(const Options& options) {
   std::string addr = options.address;
@@ -170,11 +272,17 @@ static void runClient(const Options& options) {
   validateTransportContext(context);
   std::shared_ptr<Connection> conn = context->connect(addr);
 
-  std::promise<void> doneProm;
-  clientPingPongNonBlock(
-      std::move(conn), numRoundTrips, doneProm, data, measurements);
-
-  doneProm.get_future().get();
+  std::chrono::microseconds cpuTimeBefore = getProcessCpuTime();
+  if (options.maxRate > 0) {
+    clientOpenLoop(std::move(conn), options, data);
+  } else {
+    std::promise<void> doneProm;
+    clientPingPongNonBlock(
+        std::move(conn), numRoundTrips, doneProm, data, measurements);
+    doneProm.get_future().get();
+  }
+  std::chrono::microseconds cpuTimeAfter = getProcessCpuTime();
+  printCpuTime(cpuTimeAfter - cpuTimeBefore, options.numRoundTrips);
   context->join();
 }
 
@@ -185,6 +293,10 @@ int main(int argc, char** argv) {
   std::cout << "address = " << x.address << "\n";
   std::cout << "num_round_trips = " << x.numRoundTrips << "\n";
   std::cout << "payload_size = " << x.payloadSize << "\n";
+  if (x.maxRate > 0) {
+    std::cout << "arrival_process = " << x.arrivalProcess << "\n";
+    std::cout << "rate = " << x.maxRate << "\n";
+  }
 
   if (x.mode == "listen") {
     runServer(x);
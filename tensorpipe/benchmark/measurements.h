@@ -28,6 +28,10 @@ class Measurements {
     samples_.push_back((clock::now() - start_) / count);
   }
 
+  void addSample(nanoseconds sample) {
+    samples_.push_back(sample);
+  }
+
   void sort() {
     std::sort(samples_.begin(), samples_.end());
   }
@@ -25,7 +25,8 @@ static void usage(int status, const char* argv0) {
 #define X(x) fputs(x "\n", stderr);
   X("");
   X("--mode=MODE                      Running mode [listen|connect]");
-  X("--transport=TRANSPORT            Transport backend [shm|uv]");
+  X("--transport=TRANSPORT            Transport backend");
+  X("                                   [ibv|ibv_loopback|shm|uv|uv_busy_poll]");
   X("--channel=CHANNEL                Channel backend [basic]");
   X("--address=ADDRESS                Address to listen or connect to");
   X("--num-round-trips=NUM            Number of write/read pairs to perform");
@@ -34,8 +35,19 @@ static void usage(int status, const char* argv0) {
   X("--num-tensors=NUM [optional]     Number of tensors of each write/read pair");
   X("--tensor-size=SIZE [optional]    Size of tensor of each write/read pair");
   X("--tensor-type=TYPE [optional]    Type of tensor (cpu or cuda)");
+  X("--tensor-sparsity=FRAC [optional]      Fraction of zeros in cpu tensors");
+  X("--sparse-encoding-threshold=FRAC [optional] Sparsity above which tensors are encoded");
   X("--metadata-size=SIZE [optional]  Size of metadata of each write/read pair");
   X("--cuda-sync-period=NUM [optiona] Number of round-trips between two stream syncs");
+  X("--num-outstanding-calls=NUM [optional] Number of calls in flight (rpc only)");
+  X("--num-handler-threads=NUM [optional]   Number of server threads (rpc only)");
+  X("--num-chunks-in-flight=NUM [optional]  Number of chunks in flight (stream only)");
+  X("--arrival-process=PROC [optional]      When to issue calls [fixed|poisson] (load and transport)");
+  X("--num-sender-threads=NUM [optional]    Number of threads issuing calls (load only)");
+  X("--min-rate=RATE [optional]             Lowest offered load, in calls/sec (load only)");
+  X("--max-rate=RATE [optional]             Highest offered load, in calls/sec (load only)");
+  X("                                         or, if set, open-loop rate (transport only)");
+  X("--num-rate-steps=NUM [optional]        Number of offered loads to try (load only)");
 
   exit(status);
 }
@@ -79,8 +91,18 @@ struct Options parseOptions(int argc, char** argv) {
     NUM_TENSORS,
     TENSOR_SIZE,
     TENSOR_TYPE,
+    TENSOR_SPARSITY,
+    SPARSE_ENCODING_THRESHOLD,
     METADATA_SIZE,
     CUDA_SYNC_PERIOD,
+    NUM_OUTSTANDING_CALLS,
+    NUM_HANDLER_THREADS,
+    NUM_CHUNKS_IN_FLIGHT,
+    ARRIVAL_PROCESS,
+    NUM_SENDER_THREADS,
+    MIN_RATE,
+    MAX_RATE,
+    NUM_RATE_STEPS,
     HELP,
   };
 
@@ -95,8 +117,24 @@ struct Options parseOptions(int argc, char** argv) {
       {"num-tensors", required_argument, &flag, NUM_TENSORS},
       {"tensor-size", required_argument, &flag, TENSOR_SIZE},
       {"tensor-type", required_argument, &flag, TENSOR_TYPE},
+      {"tensor-sparsity", required_argument, &flag, TENSOR_SPARSITY},
+      {"sparse-encoding-threshold",
+       required_argument,
+       &flag,
+       SPARSE_ENCODING_THRESHOLD},
       {"metadata-size", required_argument, &flag, METADATA_SIZE},
       {"cuda-sync-period", required_argument, &flag, CUDA_SYNC_PERIOD},
+      {"num-outstanding-calls",
+       required_argument,
+       &flag,
+       NUM_OUTSTANDING_CALLS},
+      {"num-handler-threads", required_argument, &flag, NUM_HANDLER_THREADS},
+      {"num-chunks-in-flight", required_argument, &flag, NUM_CHUNKS_IN_FLIGHT},
+      {"arrival-process", required_argument, &flag, ARRIVAL_PROCESS},
+      {"num-sender-threads", required_argument, &flag, NUM_SENDER_THREADS},
+      {"min-rate", required_argument, &flag, MIN_RATE},
+      {"max-rate", required_argument, &flag, MAX_RATE},
+      {"num-rate-steps", required_argument, &flag, NUM_RATE_STEPS},
       {"help", no_argument, &flag, HELP},
       {nullptr, 0, nullptr, 0}};
 
@@ -153,12 +191,48 @@ struct Options parseOptions(int argc, char** argv) {
           exit(EXIT_FAILURE);
         }
         break;
+      case TENSOR_SPARSITY:
+        options.tensorSparsity = std::strtod(optarg, nullptr);
+        break;
+      case SPARSE_ENCODING_THRESHOLD:
+        options.sparseEncodingThreshold = std::strtod(optarg, nullptr);
+        break;
       case METADATA_SIZE:
         options.metadataSize = std::strtoull(optarg, nullptr, 10);
         break;
       case CUDA_SYNC_PERIOD:
         options.cudaSyncPeriod = std::strtoull(optarg, nullptr, 10);
         break;
+      case NUM_OUTSTANDING_CALLS:
+        options.numOutstandingCalls = std::strtoull(optarg, nullptr, 10);
+        break;
+      case NUM_HANDLER_THREADS:
+        options.numHandlerThreads = std::strtoull(optarg, nullptr, 10);
+        break;
+      case NUM_CHUNKS_IN_FLIGHT:
+        options.numChunksInFlight = std::strtoull(optarg, nullptr, 10);
+        break;
+      case ARRIVAL_PROCESS:
+        options.arrivalProcess = std::string(optarg);
+        if (options.arrivalProcess != "fixed" &&
+            options.arrivalProcess != "poisson") {
+          fprintf(stderr, "Error:\n");
+          fprintf(stderr, "  --arrival-process must be [fixed|poisson]\n");
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case NUM_SENDER_THREADS:
+        options.numSenderThreads = std::strtoull(optarg, nullptr, 10);
+        break;
+      case MIN_RATE:
+        options.minRate = std::strtod(optarg, nullptr);
+        break;
+      case MAX_RATE:
+        options.maxRate = std::strtod(optarg, nullptr);
+        break;
+      case NUM_RATE_STEPS:
+        options.numRateSteps = std::strtoull(optarg, nullptr, 10);
+        break;
       case HELP:
         usage(EXIT_SUCCESS, argv[0]);
         break;
@@ -32,8 +32,18 @@ struct Options {
   size_t numTensors{0};
   size_t tensorSize{0};
   TensorType tensorType{TensorType::kCpu};
+  double tensorSparsity{0}; // fraction of zeros in cpu tensors
+  double sparseEncodingThreshold{0}; // zero means disabled
   size_t metadataSize{0};
   size_t cudaSyncPeriod{1};
+  size_t numOutstandingCalls{1}; // rpc only
+  size_t numHandlerThreads{0}; // rpc only
+  size_t numChunksInFlight{1}; // stream only
+  std::string arrivalProcess{"poisson"}; // load and transport only
+  size_t numSenderThreads{1}; // load only
+  double minRate{0}; // load only, in calls per second
+  double maxRate{0}; // load and transport only, in calls per second
+  size_t numRateSteps{1}; // load only
 };
 
 struct Options parseOptions(int argc, char** argv);
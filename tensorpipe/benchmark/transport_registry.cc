@@ -22,6 +22,15 @@ std::shared_ptr<tensorpipe::transport::Context> makeIbvContext() {
 }
 
 TP_REGISTER_CREATOR(TensorpipeTransportRegistry, ibv, makeIbvContext);
+
+std::shared_ptr<tensorpipe::transport::Context> makeIbvLoopbackContext() {
+  return tensorpipe::transport::ibv::createLoopback();
+}
+
+TP_REGISTER_CREATOR(
+    TensorpipeTransportRegistry,
+    ibv_loopback,
+    makeIbvLoopbackContext);
 #endif // TENSORPIPE_HAS_IBV_TRANSPORT
 
 // SHM
@@ -32,6 +41,15 @@ std::shared_ptr<tensorpipe::transport::Context> makeShmContext() {
 }
 
 TP_REGISTER_CREATOR(TensorpipeTransportRegistry, shm, makeShmContext);
+
+std::shared_ptr<tensorpipe::transport::Context> makeShmSingleThreadContext() {
+  return tensorpipe::transport::shm::createSingleThreaded();
+}
+
+TP_REGISTER_CREATOR(
+    TensorpipeTransportRegistry,
+    shm_single_thread,
+    makeShmSingleThreadContext);
 #endif // TENSORPIPE_HAS_SHM_TRANSPORT
 
 // UV
@@ -42,6 +60,29 @@ std::shared_ptr<tensorpipe::transport::Context> makeUvContext() {
 
 TP_REGISTER_CREATOR(TensorpipeTransportRegistry, uv, makeUvContext);
 
+// UV with busy polling
+
+std::shared_ptr<tensorpipe::transport::Context> makeUvBusyPollContext() {
+  return tensorpipe::transport::uv::createWithBusyPolling(
+      std::chrono::microseconds(50));
+}
+
+TP_REGISTER_CREATOR(
+    TensorpipeTransportRegistry,
+    uv_busy_poll,
+    makeUvBusyPollContext);
+
+// UV with zero-copy receive
+
+std::shared_ptr<tensorpipe::transport::Context> makeUvZeroCopyContext() {
+  return tensorpipe::transport::uv::createWithZeroCopyReceive(256 * 1024);
+}
+
+TP_REGISTER_CREATOR(
+    TensorpipeTransportRegistry,
+    uv_zero_copy_receive,
+    makeUvZeroCopyContext);
+
 void validateTransportContext(
     std::shared_ptr<tensorpipe::transport::Context> context) {
   if (!context) {
@@ -11,6 +11,7 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <nop/serializer.h>
 #include <nop/structure.h>
@@ -27,10 +28,17 @@ namespace cma {
 
 namespace {
 
+// The pointers of several tensors, sent in a single frame, in order.
 struct Descriptor {
   uint32_t pid;
-  uint64_t ptr;
-  NOP_STRUCTURE(Descriptor, pid, ptr);
+  std::vector<uint64_t> ptrs;
+  NOP_STRUCTURE(Descriptor, pid, ptrs);
+};
+
+// Acknowledges the copies of the next numOps tensors (in order).
+struct Completion {
+  uint64_t numOps;
+  NOP_STRUCTURE(Completion, numOps);
 };
 
 } // namespace
@@ -88,8 +96,7 @@ void ChannelImpl::advanceSendOperation(
       /*from=*/SendOperation::UNINITIALIZED,
       /*to=*/SendOperation::READING_COMPLETION,
       /*cond=*/!error_ && prevOpState >= SendOperation::READING_COMPLETION,
-      /*actions=*/
-      {&ChannelImpl::writeDescriptor, &ChannelImpl::readCompletion});
+      /*actions=*/{&ChannelImpl::writeDescriptor});
 
   sendOps_.attemptTransition(
       opIter,
@@ -100,41 +107,89 @@ void ChannelImpl::advanceSendOperation(
 }
 
 void ChannelImpl::writeDescriptor(SendOpIter opIter) {
-  SendOperation& op = *opIter;
+  pendingDescriptors_.push_back(opIter);
+  if (!writingDescriptors_) {
+    writePendingDescriptors();
+  }
+}
+
+void ChannelImpl::writePendingDescriptors() {
+  if (pendingDescriptors_.empty()) {
+    return;
+  }
+
+  std::vector<SendOpIter> opIters = std::move(pendingDescriptors_);
+  pendingDescriptors_.clear();
 
   auto nopHolder = std::make_shared<NopHolder<Descriptor>>();
   Descriptor& nopDescriptor = nopHolder->getObject();
   // TODO: Store the PID upon channel/context instantiation.
   nopDescriptor.pid = ::getpid();
-  nopDescriptor.ptr = reinterpret_cast<uint64_t>(op.ptr);
-
-  TP_VLOG(6) << "Channel " << id_ << " is writing descriptor (#"
-             << op.sequenceNumber << ")";
+  for (SendOpIter opIter : opIters) {
+    nopDescriptor.ptrs.push_back(reinterpret_cast<uint64_t>(opIter->ptr));
+  }
+
+  const uint64_t firstSequenceNumber = opIters.front()->sequenceNumber;
+  const uint64_t lastSequenceNumber = opIters.back()->sequenceNumber;
+  TP_VLOG(6) << "Channel " << id_ << " is writing descriptors (#"
+             << firstSequenceNumber << " to #" << lastSequenceNumber << ")";
+  writingDescriptors_ = true;
   descriptorConnection_->write(
       *nopHolder,
-      callbackWrapper_([sequenceNumber{op.sequenceNumber},
-                        nopHolder](ChannelImpl& impl) {
-        TP_VLOG(6) << "Channel " << impl.id_ << " done writing descriptor (#"
-                   << sequenceNumber << ")";
+      callbackWrapper_([firstSequenceNumber, lastSequenceNumber, nopHolder](
+                           ChannelImpl& impl) {
+        TP_VLOG(6) << "Channel " << impl.id_ << " done writing descriptors (#"
+                   << firstSequenceNumber << " to #" << lastSequenceNumber
+                   << ")";
+        impl.writingDescriptors_ = false;
+        impl.writePendingDescriptors();
       }));
-}
 
-void ChannelImpl::readCompletion(SendOpIter opIter) {
-  SendOperation& op = *opIter;
+  for (SendOpIter opIter : opIters) {
+    opsAwaitingCompletion_.push_back(opIter);
+  }
+  if (!readingCompletion_) {
+    readCompletion();
+  }
+}
 
+void ChannelImpl::readCompletion() {
   TP_VLOG(6) << "Channel " << id_ << " is reading completion (#"
-             << op.sequenceNumber << ")";
+             << opsAwaitingCompletion_.front()->sequenceNumber << " onwards)";
+  readingCompletion_ = true;
+  auto nopHolderIn = std::make_shared<NopHolder<Completion>>();
   completionConnection_->read(
-      nullptr,
-      0,
-      callbackWrapper_([opIter](
-                           ChannelImpl& impl,
-                           const void* /* unused */,
-                           size_t /* unused */) {
+      *nopHolderIn, callbackWrapper_([nopHolderIn](ChannelImpl& impl) {
+        impl.readingCompletion_ = false;
+        const SendOpIter firstOpIter = impl.opsAwaitingCompletion_.front();
+        // No more completions will come, hence all the ops are done waiting.
+        if (impl.error_) {
+          for (SendOpIter opIter : impl.opsAwaitingCompletion_) {
+            opIter->doneReadingCompletion = true;
+          }
+          impl.opsAwaitingCompletion_.clear();
+          impl.sendOps_.advanceOperation(firstOpIter);
+          return;
+        }
+        const uint64_t numOps = nopHolderIn->getObject().numOps;
+        TP_THROW_ASSERT_IF(
+            numOps == 0 || numOps > impl.opsAwaitingCompletion_.size())
+            << "Received completion for " << numOps << " ops while "
+            << impl.opsAwaitingCompletion_.size() << " are pending";
         TP_VLOG(6) << "Channel " << impl.id_ << " done reading completion (#"
-                   << opIter->sequenceNumber << ")";
-        opIter->doneReadingCompletion = true;
-        impl.sendOps_.advanceOperation(opIter);
+                   << firstOpIter->sequenceNumber << " to #"
+                   << impl.opsAwaitingCompletion_[numOps - 1]->sequenceNumber
+                   << ")";
+        for (uint64_t opIdx = 0; opIdx < numOps; opIdx++) {
+          impl.opsAwaitingCompletion_.front()->doneReadingCompletion = true;
+          impl.opsAwaitingCompletion_.pop_front();
+        }
+        if (!impl.opsAwaitingCompletion_.empty()) {
+          impl.readCompletion();
+        }
+        // This carries on to the following ops, which may then be finished and
+        // gone, hence their iterators mustn't be used past this point.
+        impl.sendOps_.advanceOperation(firstOpIter);
       }));
 }
 
@@ -167,20 +222,25 @@ void ChannelImpl::advanceRecvOperation(
 
   RecvOperation& op = *opIter;
 
+  // Empty ops still wait for the previous op to have its descriptor, so that
+  // the following ops can rely on that when they are past it.
   recvOps_.attemptTransition(
       opIter,
       /*from=*/RecvOperation::UNINITIALIZED,
       /*to=*/RecvOperation::FINISHED,
-      /*cond=*/error_ || op.length == 0,
+      /*cond=*/error_ ||
+          (op.length == 0 && prevOpState >= RecvOperation::COPYING),
       /*actions=*/{&ChannelImpl::callRecvCallback});
 
-  // Needs to go after previous op to ensure predictable and consistent ordering
-  // of read calls on the descriptor control connection.
+  // Needs to go after previous op has received its descriptor, as this op's
+  // one may have come in the same frame, and otherwise it must be read next
+  // from the descriptor control connection.
   recvOps_.attemptTransition(
       opIter,
       /*from=*/RecvOperation::UNINITIALIZED,
       /*to=*/RecvOperation::READING_DESCRIPTOR,
-      /*cond=*/!error_ && prevOpState >= RecvOperation::READING_DESCRIPTOR,
+      /*cond=*/!error_ && op.length > 0 &&
+          prevOpState >= RecvOperation::COPYING,
       /*actions=*/{&ChannelImpl::readDescriptor});
 
   recvOps_.attemptTransition(
@@ -219,6 +279,18 @@ void ChannelImpl::advanceRecvOperation(
 void ChannelImpl::readDescriptor(RecvOpIter opIter) {
   RecvOperation& op = *opIter;
 
+  // The rest of a frame is already at hand, hence the op can move on as soon as
+  // this action returns.
+  if (!receivedPtrs_.empty()) {
+    TP_VLOG(6) << "Channel " << id_ << " is taking descriptor (#"
+               << op.sequenceNumber << ") from a received frame";
+    op.doneReadingDescriptor = true;
+    op.remotePid = receivedPid_;
+    op.remotePtr = reinterpret_cast<void*>(receivedPtrs_.front());
+    receivedPtrs_.pop_front();
+    return;
+  }
+
   TP_VLOG(6) << "Channel " << id_ << " is reading descriptor (#"
              << op.sequenceNumber << ")";
   auto nopHolderIn = std::make_shared<NopHolder<Descriptor>>();
@@ -229,8 +301,13 @@ void ChannelImpl::readDescriptor(RecvOpIter opIter) {
         opIter->doneReadingDescriptor = true;
         if (!impl.error_) {
           Descriptor& nopDescriptor = nopHolderIn->getObject();
+          TP_THROW_ASSERT_IF(nopDescriptor.ptrs.empty())
+              << "Received empty descriptor frame";
           opIter->remotePid = nopDescriptor.pid;
-          opIter->remotePtr = reinterpret_cast<void*>(nopDescriptor.ptr);
+          opIter->remotePtr = reinterpret_cast<void*>(nopDescriptor.ptrs[0]);
+          impl.receivedPid_ = nopDescriptor.pid;
+          impl.receivedPtrs_.assign(
+              nopDescriptor.ptrs.begin() + 1, nopDescriptor.ptrs.end());
         }
         impl.recvOps_.advanceOperation(opIter);
       }));
@@ -239,18 +316,57 @@ void ChannelImpl::readDescriptor(RecvOpIter opIter) {
 void ChannelImpl::copy(RecvOpIter opIter) {
   RecvOperation& op = *opIter;
 
-  TP_VLOG(6) << "Channel " << id_ << " is copying payload (#"
+  TP_VLOG(6) << "Channel " << id_ << " will copy payload (#"
              << op.sequenceNumber << ")";
+  // All the ops of a frame usually become ready at once, hence deferring the
+  // copy until the end of this loop iteration allows to batch them.
+  if (pendingCopies_.empty()) {
+    context_->deferToLoop([impl{this->shared_from_this()}]() {
+      impl->performPendingCopies();
+    });
+  }
+  pendingCopies_.push_back(opIter);
+}
+
+void ChannelImpl::performPendingCopies() {
+  TP_DCHECK(context_->inLoop());
+
+  std::vector<RecvOpIter> opIters = std::move(pendingCopies_);
+  pendingCopies_.clear();
+  TP_DCHECK(!opIters.empty());
+
+  // The ops were flagged as copying, hence they wait for this to finish.
+  if (error_) {
+    for (RecvOpIter opIter : opIters) {
+      opIter->doneCopying = true;
+    }
+    recvOps_.advanceOperation(opIters.front());
+    return;
+  }
+
+  const pid_t remotePid = opIters.front()->remotePid;
+  std::vector<ContextImpl::CopySegment> segments;
+  for (RecvOpIter opIter : opIters) {
+    TP_DCHECK_EQ(opIter->remotePid, remotePid);
+    segments.push_back({opIter->remotePtr, opIter->ptr, opIter->length});
+  }
+
+  TP_VLOG(6) << "Channel " << id_ << " is copying payloads (#"
+             << opIters.front()->sequenceNumber << " to #"
+             << opIters.back()->sequenceNumber << ")";
   context_->requestCopy(
-      op.remotePid,
-      op.remotePtr,
-      op.ptr,
-      op.length,
-      callbackWrapper_([opIter](ChannelImpl& impl) {
-        TP_VLOG(6) << "Channel " << impl.id_ << " done copying payload (#"
-                   << opIter->sequenceNumber << ")";
-        opIter->doneCopying = true;
-        impl.recvOps_.advanceOperation(opIter);
+      remotePid,
+      std::move(segments),
+      callbackWrapper_([opIters{std::move(opIters)}](ChannelImpl& impl) {
+        TP_VLOG(6) << "Channel " << impl.id_ << " done copying payloads (#"
+                   << opIters.front()->sequenceNumber << " to #"
+                   << opIters.back()->sequenceNumber << ")";
+        for (RecvOpIter opIter : opIters) {
+          opIter->doneCopying = true;
+        }
+        // This carries on to the following ops, which may then be finished and
+        // gone, hence their iterators mustn't be used past this point.
+        impl.recvOps_.advanceOperation(opIters.front());
       }));
 }
 
@@ -262,17 +378,35 @@ void ChannelImpl::callRecvCallback(RecvOpIter opIter) {
   op.callback = nullptr;
 }
 
-void ChannelImpl::writeCompletion(RecvOpIter opIter) {
-  RecvOperation& op = *opIter;
+void ChannelImpl::writeCompletion(RecvOpIter /* unused */) {
+  // The ops that finish together (usually the ones copied by the same request)
+  // are acknowledged at once, at the end of this loop iteration.
+  if (numPendingCompletions_++ == 0) {
+    context_->deferToLoop([impl{this->shared_from_this()}]() {
+      impl->writePendingCompletions();
+    });
+  }
+}
 
-  TP_VLOG(6) << "Channel " << id_ << " is writing completion (#"
-             << op.sequenceNumber << ")";
+void ChannelImpl::writePendingCompletions() {
+  TP_DCHECK(context_->inLoop());
+
+  const uint64_t numOps = numPendingCompletions_;
+  numPendingCompletions_ = 0;
+  TP_DCHECK_GT(numOps, 0);
+  if (error_) {
+    return;
+  }
+
+  TP_VLOG(6) << "Channel " << id_ << " is writing completion (" << numOps
+             << " ops)";
+  auto nopHolderOut = std::make_shared<NopHolder<Completion>>();
+  nopHolderOut->getObject().numOps = numOps;
   completionConnection_->write(
-      nullptr,
-      0,
-      callbackWrapper_([sequenceNumber{op.sequenceNumber}](ChannelImpl& impl) {
-        TP_VLOG(6) << "Channel " << impl.id_ << " done writing completion (#"
-                   << sequenceNumber << ")";
+      *nopHolderOut,
+      callbackWrapper_([numOps, nopHolderOut](ChannelImpl& impl) {
+        TP_VLOG(6) << "Channel " << impl.id_ << " done writing completion ("
+                   << numOps << " ops)";
       }));
 }
 
@@ -8,8 +8,10 @@
 
 #pragma once
 
+#include <deque>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <tensorpipe/channel/channel_impl_boilerplate.h>
 #include <tensorpipe/common/state_machine.h>
@@ -96,6 +98,33 @@ class ChannelImpl final
       &ChannelImpl::advanceRecvOperation};
   using RecvOpIter = decltype(recvOps_)::Iter;
 
+  // The descriptors of several send ops are written as a single frame. A
+  // descriptor is written right away if no frame is being written, otherwise
+  // it waits for that write to complete, together with all the ones that come
+  // in the meantime.
+  std::vector<SendOpIter> pendingDescriptors_;
+  bool writingDescriptors_{false};
+
+  // The send ops whose descriptor was written, in order, which the receiver
+  // acknowledges as it copies them, with completions that carry how many of
+  // them are done (independently of how they were framed, so that an op never
+  // waits for the recv of a later one). A single completion is read at a time.
+  std::deque<SendOpIter> opsAwaitingCompletion_;
+  bool readingCompletion_{false};
+
+  // The descriptors of the last frame that was received which haven't been
+  // handed to a recv op yet.
+  pid_t receivedPid_{0};
+  std::deque<uint64_t> receivedPtrs_;
+
+  // The recv ops that became ready to copy during the current iteration of the
+  // loop, which are then copied by a single request at the end of it.
+  std::vector<RecvOpIter> pendingCopies_;
+
+  // How many recv ops finished since the last completion was written. They are
+  // acknowledged by a single completion at the end of the loop iteration.
+  uint64_t numPendingCompletions_{0};
+
   // State machines for send and recv ops.
   void advanceSendOperation(
       SendOpIter opIter,
@@ -107,13 +136,17 @@ class ChannelImpl final
   // Actions (i.e., methods that begin a state transition).
   // For send operations:
   void writeDescriptor(SendOpIter opIter);
-  void readCompletion(SendOpIter opIter);
   void callSendCallback(SendOpIter opIter);
   // For recv operations:
   void readDescriptor(RecvOpIter opIter);
   void copy(RecvOpIter opIter);
   void callRecvCallback(RecvOpIter opIter);
   void writeCompletion(RecvOpIter opIter);
+
+  void writePendingDescriptors();
+  void readCompletion();
+  void performPendingCopies();
+  void writePendingCompletions();
 };
 
 } // namespace cma
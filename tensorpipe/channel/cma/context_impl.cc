@@ -16,12 +16,15 @@
 
 #include <functional>
 #include <limits>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <thread>
 #include <utility>
+#include <vector>
 
 #include <tensorpipe/channel/cma/channel_impl.h>
+#include <tensorpipe/channel/helpers.h>
 #include <tensorpipe/common/defs.h>
 #include <tensorpipe/common/strings.h>
 #include <tensorpipe/common/system.h>
@@ -36,25 +39,21 @@ namespace {
 // disambiguate descriptors when debugging.
 const std::string kDomainDescriptorPrefix{"cma:"};
 
+// The length is the total one of all the (matching) local and remote iovecs.
 Error callProcessVmReadv(
-    void* localPtr,
-    void* remotePtr,
+    const struct iovec* localIovs,
+    const struct iovec* remoteIovs,
+    size_t numIovs,
     size_t length,
     pid_t pid) {
 #ifdef SYS_process_vm_readv
-  struct iovec localIov {
-    .iov_base = localPtr, .iov_len = length
-  };
-  struct iovec remoteIov {
-    .iov_base = remotePtr, .iov_len = length
-  };
   ssize_t nread = static_cast<ssize_t>(::syscall(
       SYS_process_vm_readv,
       pid,
-      &localIov,
-      /*liovcnt=*/static_cast<unsigned long>(1),
-      &remoteIov,
-      /*riovcnt=*/static_cast<unsigned long>(1),
+      localIovs,
+      /*liovcnt=*/static_cast<unsigned long>(numIovs),
+      remoteIovs,
+      /*riovcnt=*/static_cast<unsigned long>(numIovs),
       /*flags=*/static_cast<unsigned long>(0)));
   if (nread < 0) {
     return TP_CREATE_ERROR(SystemError, "process_vm_readv", errno);
@@ -67,6 +66,20 @@ Error callProcessVmReadv(
 #endif
 }
 
+Error callProcessVmReadv(
+    void* localPtr,
+    void* remotePtr,
+    size_t length,
+    pid_t pid) {
+  struct iovec localIov {
+    .iov_base = localPtr, .iov_len = length
+  };
+  struct iovec remoteIov {
+    .iov_base = remotePtr, .iov_len = length
+  };
+  return callProcessVmReadv(&localIov, &remoteIov, 1, length, pid);
+}
+
 class BadReadError final : public BaseError {
  public:
   BadReadError(uint64_t expected, uint64_t actual)
@@ -126,9 +139,65 @@ Error performCopy(
   return Error::kSuccess;
 }
 
-} // namespace
+// The maximum number of iovecs that process_vm_readv accepts (i.e., IOV_MAX).
+constexpr size_t kMaxIovsAtOnce = 1024;
 
-std::shared_ptr<ContextImpl> ContextImpl::create() {
+// Perform the copies of several segments by passing as many of them as possible
+// to each call to process_vm_readv.
+Error performCopies(
+    const std::vector<ContextImpl::CopySegment>& segments,
+    pid_t remotePid) {
+  std::vector<struct iovec> localIovs;
+  std::vector<struct iovec> remoteIovs;
+  size_t length = 0;
+  auto flush = [&]() {
+    if (localIovs.empty()) {
+      return Error::kSuccess;
+    }
+    Error error = callProcessVmReadv(
+        localIovs.data(), remoteIovs.data(), localIovs.size(), length, remotePid);
+    localIovs.clear();
+    remoteIovs.clear();
+    length = 0;
+    return error;
+  };
+
+  for (const ContextImpl::CopySegment& segment : segments) {
+    if (segment.length == 0) {
+      continue;
+    }
+    if (segment.length > kMaxBytesReadableAtOnce) {
+      Error error = flush();
+      if (error) {
+        return error;
+      }
+      error = performCopy(
+          segment.localPtr, segment.remotePtr, segment.length, remotePid);
+      if (error) {
+        return error;
+      }
+      continue;
+    }
+    if (localIovs.size() == kMaxIovsAtOnce ||
+        length + segment.length > kMaxBytesReadableAtOnce) {
+      Error error = flush();
+      if (error) {
+        return error;
+      }
+    }
+    localIovs.push_back({.iov_base = segment.localPtr, .iov_len = segment.length});
+    remoteIovs.push_back(
+        {.iov_base = segment.remotePtr, .iov_len = segment.length});
+    length += segment.length;
+  }
+  return flush();
+}
+
+// What domain descriptor CMA has only depends on properties of the process
+// (its namespaces, credentials, security modules, ...) which we don't expect to
+// change during its lifetime. Hence, once these checks succeed, their outcome
+// is shared among all later contexts.
+optional<std::string> probeDomainDescriptor() {
   int rv;
   std::ostringstream oss;
   oss << kDomainDescriptorPrefix;
@@ -145,7 +214,7 @@ std::shared_ptr<ContextImpl> ContextImpl::create() {
   optional<std::string> pidNsID = getLinuxNamespaceId(LinuxNamespace::kPid);
   if (!pidNsID.has_value()) {
     TP_VLOG(5) << "Unable to read pid namespace ID";
-    return nullptr;
+    return nullopt;
   }
   oss << '_' << pidNsID.value();
 
@@ -170,7 +239,7 @@ std::shared_ptr<ContextImpl> ContextImpl::create() {
   optional<std::string> userNsID = getLinuxNamespaceId(LinuxNamespace::kUser);
   if (!userNsID.has_value()) {
     TP_VLOG(5) << "Unable to read user namespace ID";
-    return nullptr;
+    return nullopt;
   }
   oss << '_' << userNsID.value();
 
@@ -193,7 +262,7 @@ std::shared_ptr<ContextImpl> ContextImpl::create() {
                << " (saved-set). Group IDs are " << realGroupId << " (real), "
                << effectiveGroupId << " (effective) and " << savedSetGroupId
                << " (saved-set).";
-    return nullptr;
+    return nullopt;
   }
   oss << '_' << realUserId << '_' << realGroupId;
 
@@ -204,7 +273,7 @@ std::shared_ptr<ContextImpl> ContextImpl::create() {
   // SUID_DUMP_USER has a value of 1.
   if (rv != 1) {
     TP_VLOG(5) << "Process isn't dumpable";
-    return nullptr;
+    return nullopt;
   }
 
   // Next the Linux Security Modules (LSMs) kick in. Since users could register
@@ -271,10 +340,10 @@ std::shared_ptr<ContextImpl> ContextImpl::create() {
           break;
         case YamaPtraceScope::kAdminOnlyAttach:
           TP_VLOG(5) << "YAMA ptrace scope set to admin-only attach";
-          return nullptr;
+          return nullopt;
         case YamaPtraceScope::kNoAttach:
           TP_VLOG(5) << "YAMA ptrace scope set to no attach";
-          return nullptr;
+          return nullopt;
         default:
           TP_THROW_ASSERT() << "Unknown YAMA ptrace scope";
       }
@@ -289,24 +358,70 @@ std::shared_ptr<ContextImpl> ContextImpl::create() {
     TP_VLOG(5)
         << "The process_vm_readv syscall appears to be unavailable or blocked: "
         << error.what();
-    return nullptr;
+    return nullopt;
   }
 
   std::string domainDescriptor = oss.str();
   TP_VLOG(5) << "The domain descriptor for CMA is " << domainDescriptor;
+  return domainDescriptor;
+}
+
+optional<std::string> getDomainDescriptor() {
+  // Only success is cached: a failure may be transient (e.g., the process may
+  // not be ptrace-able yet during its startup, or a seccomp probe may be
+  // racing with it), hence it's retried by the next context. The mutex makes
+  // contexts that are created concurrently wait for a single probe.
+  static std::mutex mutex;
+  static optional<std::string> domainDescriptor;
+  std::unique_lock<std::mutex> lock(mutex);
+  if (!domainDescriptor.has_value()) {
+    domainDescriptor = probeDomainDescriptor();
+  }
+  return domainDescriptor;
+}
+
+std::shared_ptr<WorkerThread> createWorker() {
+  return std::make_shared<WorkerThread>("TP_CMA_loop");
+}
+
+} // namespace
+
+std::shared_ptr<ContextImpl> ContextImpl::create() {
+  const optional<std::string> domainDescriptor = getDomainDescriptor();
+  if (!domainDescriptor.has_value()) {
+    return nullptr;
+  }
 
   std::unordered_map<Device, std::string> deviceDescriptors = {
-      {Device{kCpuDeviceType, 0}, std::move(domainDescriptor)}};
+      {Device{kCpuDeviceType, 0}, domainDescriptor.value()}};
 
-  return std::make_shared<ContextImpl>(std::move(deviceDescriptors));
+  return std::make_shared<ContextImpl>(
+      std::move(deviceDescriptors), createWorker(), /*isWorkerShared=*/false);
+}
+
+std::shared_ptr<ContextImpl> ContextImpl::create(LoopPool& loopPool) {
+  const optional<std::string> domainDescriptor = getDomainDescriptor();
+  if (!domainDescriptor.has_value()) {
+    return nullptr;
+  }
+
+  std::unordered_map<Device, std::string> deviceDescriptors = {
+      {Device{kCpuDeviceType, 0}, domainDescriptor.value()}};
+
+  return std::make_shared<ContextImpl>(
+      std::move(deviceDescriptors),
+      loopPool.getLoop<WorkerThread>("cma", createWorker),
+      /*isWorkerShared=*/true);
 }
 
 ContextImpl::ContextImpl(
-    std::unordered_map<Device, std::string> deviceDescriptors)
+    std::unordered_map<Device, std::string> deviceDescriptors,
+    std::shared_ptr<WorkerThread> worker,
+    bool isWorkerShared)
     : ContextImplBoilerplate<ContextImpl, ChannelImpl>(
-          std::move(deviceDescriptors)) {
-  thread_ = std::thread(&ContextImpl::handleCopyRequests, this);
-}
+          std::move(deviceDescriptors)),
+      worker_(std::move(worker)),
+      isWorkerShared_(isWorkerShared) {}
 
 std::shared_ptr<Channel> ContextImpl::createChannel(
     std::vector<std::shared_ptr<transport::Connection>> connections,
@@ -321,12 +436,19 @@ size_t ContextImpl::numConnectionsNeeded() const {
 }
 
 void ContextImpl::handleErrorImpl() {
-  requests_.push(nullopt);
+  if (!isWorkerShared_) {
+    worker_->close();
+  }
 }
 
 void ContextImpl::joinImpl() {
-  thread_.join();
-  // TP_DCHECK(requests_.empty());
+  if (!isWorkerShared_) {
+    worker_->join();
+    return;
+  }
+  std::unique_lock<std::mutex> lock(numRequestsInFlightMutex_);
+  numRequestsInFlightCv_.wait(
+      lock, [&]() { return numRequestsInFlight_ == 0; });
 }
 
 bool ContextImpl::inLoop() const {
@@ -339,9 +461,7 @@ void ContextImpl::deferToLoop(std::function<void()> fn) {
 
 void ContextImpl::requestCopy(
     pid_t remotePid,
-    void* remotePtr,
-    void* localPtr,
-    size_t length,
+    std::vector<CopySegment> segments,
     std::function<void(const Error&)> fn) {
   uint64_t requestId = nextRequestId_++;
   TP_VLOG(4) << "Channel context " << id_ << " received a copy request (#"
@@ -356,25 +476,35 @@ void ContextImpl::requestCopy(
                << ")";
   };
 
-  requests_.push(
-      CopyRequest{remotePid, remotePtr, localPtr, length, std::move(fn)});
-}
-
-void ContextImpl::handleCopyRequests() {
-  setThreadName("TP_CMA_loop");
-  while (true) {
-    auto maybeRequest = requests_.pop();
-    if (!maybeRequest.has_value()) {
-      break;
-    }
-    CopyRequest request = std::move(maybeRequest).value();
+  size_t length = 0;
+  for (const CopySegment& segment : segments) {
+    length += segment.length;
+  }
+  CopyRequest request{remotePid, std::move(segments), std::move(fn)};
+
+  // Handing a small copy to the worker takes longer than the copy itself, hence
+  // it's done right away. This only saves the hop to the worker: the callback
+  // still goes through the channel's callback wrapper, which defers it to the
+  // loop, as it would if it came from the worker.
+  if (length <= kMaxInlineCopyLength) {
+    handleCopyRequest(std::move(request));
+    return;
+  }
 
-    request.callback(performCopy(
-        request.localPtr,
-        request.remotePtr,
-        request.length,
-        request.remotePid));
+  {
+    std::unique_lock<std::mutex> lock(numRequestsInFlightMutex_);
+    numRequestsInFlight_++;
   }
+  worker_->post([this, request{std::move(request)}]() mutable {
+    handleCopyRequest(std::move(request));
+    std::unique_lock<std::mutex> lock(numRequestsInFlightMutex_);
+    numRequestsInFlight_--;
+    numRequestsInFlightCv_.notify_all();
+  });
+}
+
+void ContextImpl::handleCopyRequest(CopyRequest request) {
+  request.callback(performCopies(request.segments, request.remotePid));
 }
 
 } // namespace cma
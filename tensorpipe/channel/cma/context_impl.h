@@ -9,15 +9,17 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
 #include <functional>
-#include <thread>
+#include <mutex>
+#include <vector>
 
 #include <tensorpipe/channel/context_impl_boilerplate.h>
 #include <tensorpipe/common/deferred_executor.h>
 #include <tensorpipe/common/device.h>
 #include <tensorpipe/common/error.h>
-#include <tensorpipe/common/optional.h>
-#include <tensorpipe/common/queue.h>
+#include <tensorpipe/common/loop_pool.h>
+#include <tensorpipe/common/worker_thread.h>
 
 namespace tensorpipe {
 namespace channel {
@@ -30,8 +32,12 @@ class ContextImpl final
  public:
   static std::shared_ptr<ContextImpl> create();
 
-  explicit ContextImpl(
-      std::unordered_map<Device, std::string> deviceDescriptors);
+  static std::shared_ptr<ContextImpl> create(LoopPool& loopPool);
+
+  ContextImpl(
+      std::unordered_map<Device, std::string> deviceDescriptors,
+      std::shared_ptr<WorkerThread> worker,
+      bool isWorkerShared);
 
   std::shared_ptr<Channel> createChannel(
       std::vector<std::shared_ptr<transport::Connection>> connections,
@@ -45,11 +51,17 @@ class ContextImpl final
 
   using copy_request_callback_fn = std::function<void(const Error&)>;
 
+  struct CopySegment {
+    void* remotePtr;
+    void* localPtr;
+    size_t length;
+  };
+
+  // Copy all the segments from the given process, with as few system calls as
+  // possible, and then invoke the callback once.
   void requestCopy(
       pid_t remotePid,
-      void* remotePtr,
-      void* localPtr,
-      size_t length,
+      std::vector<CopySegment> segments,
       copy_request_callback_fn fn);
 
  protected:
@@ -62,19 +74,23 @@ class ContextImpl final
 
   struct CopyRequest {
     pid_t remotePid;
-    void* remotePtr;
-    void* localPtr;
-    size_t length;
+    std::vector<CopySegment> segments;
     copy_request_callback_fn callback;
   };
 
-  std::thread thread_;
-  Queue<optional<CopyRequest>> requests_{std::numeric_limits<int>::max()};
+  const std::shared_ptr<WorkerThread> worker_;
+
+  // A worker shared with other contexts can't be closed and joined with this
+  // one, hence we wait for the requests of this context to be done instead.
+  const bool isWorkerShared_;
+  std::mutex numRequestsInFlightMutex_;
+  std::condition_variable numRequestsInFlightCv_;
+  size_t numRequestsInFlight_{0};
 
   // This is atomic because it may be accessed from outside the loop.
   std::atomic<uint64_t> nextRequestId_{0};
 
-  void handleCopyRequests();
+  void handleCopyRequest(CopyRequest request);
 };
 
 } // namespace cma
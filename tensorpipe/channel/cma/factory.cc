@@ -20,6 +20,11 @@ std::shared_ptr<Context> create() {
   return std::make_shared<ContextBoilerplate<ContextImpl, ChannelImpl>>();
 }
 
+std::shared_ptr<Context> create(LoopPool& loopPool) {
+  return std::make_shared<ContextBoilerplate<ContextImpl, ChannelImpl>>(
+      loopPool);
+}
+
 } // namespace cma
 } // namespace channel
 } // namespace tensorpipe
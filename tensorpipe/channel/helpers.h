@@ -10,6 +10,7 @@
 
 // Note: never include this file from headers!
 
+#include <cstddef>
 #include <string>
 
 #include <tensorpipe/common/nop.h>
@@ -17,6 +18,13 @@
 namespace tensorpipe {
 namespace channel {
 
+// Copies of up to this many bytes are performed inline by the xth and cma
+// channels, on the thread that requests them, rather than on their worker (see
+// benchmark_channel for a sweep of the copy sizes around this value). Up to
+// this size, a memcpy or process_vm_readv takes about as long as a round trip
+// to the worker thread, which hence bounds how long the loop is held up.
+constexpr size_t kMaxInlineCopyLength = 32 * 1024;
+
 std::string saveDescriptor(const AbstractNopHolder& object);
 
 void loadDescriptor(AbstractNopHolder& object, const std::string& in);
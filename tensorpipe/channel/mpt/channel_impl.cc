@@ -8,6 +8,7 @@
 
 #include <tensorpipe/channel/mpt/channel_impl.h>
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <utility>
@@ -28,7 +29,8 @@ ChannelImpl::ChannelImpl(
     std::string id,
     std::shared_ptr<transport::Connection> connection,
     Endpoint endpoint,
-    uint64_t numLanes)
+    uint64_t numLanes,
+    optional<ElasticLanesOptions> elasticOptions)
     : ChannelImplBoilerplate<ContextImpl, ChannelImpl>(
           token,
           std::move(context),
@@ -36,7 +38,16 @@ ChannelImpl::ChannelImpl(
       connection_(std::move(connection)),
       endpoint_(endpoint),
       numLanes_(numLanes),
-      lanes_(numLanes_) {}
+      lanes_(numLanes_),
+      elasticOptions_(std::move(elasticOptions)),
+      targetNumLanes_(isElastic() ? 1 : numLanes_),
+      numLanesOpen_(targetNumLanes_),
+      numSendLanes_(targetNumLanes_),
+      numRecvLanes_(targetNumLanes_),
+      numChunksInFlightOnLane_(numLanes_, 0),
+      wantedNumLanes_(targetNumLanes_),
+      peerWantedNumLanes_(targetNumLanes_),
+      lastTimeWantedLanesWereNeeded_(std::chrono::steady_clock::now()) {}
 
 void ChannelImpl::initImplFromLoop() {
   context_->enroll(*this);
@@ -56,35 +67,14 @@ void ChannelImpl::initImplFromLoop() {
         }));
   } else if (endpoint_ == Endpoint::kListen) {
     state_ = SERVER_ACCEPTING_LANES;
-    const std::vector<std::string>& addresses = context_->addresses();
-    TP_DCHECK_EQ(addresses.size(), numLanes_);
+    TP_DCHECK_EQ(context_->addresses().size(), numLanes_);
     auto nopHolderOut = std::make_shared<NopHolder<Packet>>();
     Packet& nopPacket = nopHolderOut->getObject();
     nopPacket.Become(nopPacket.index_of<ServerHello>());
     ServerHello& nopServerHello = *nopPacket.get<ServerHello>();
-    for (uint64_t laneIdx = 0; laneIdx < numLanes_; ++laneIdx) {
+    for (uint64_t laneIdx = 0; laneIdx < numLanesOpen_; ++laneIdx) {
       nopServerHello.laneAdvertisements.emplace_back();
-      LaneAdvertisement& nopLaneAdvertisement =
-          nopServerHello.laneAdvertisements.back();
-      nopLaneAdvertisement.address = addresses[laneIdx];
-      TP_VLOG(6) << "Channel " << id_ << " requesting connection (for lane "
-                 << laneIdx << ")";
-      uint64_t token = context_->registerConnectionRequest(
-          laneIdx,
-          callbackWrapper_(
-              [laneIdx](
-                  ChannelImpl& impl,
-                  std::shared_ptr<transport::Connection> connection) {
-                TP_VLOG(6) << "Channel " << impl.id_
-                           << " done requesting connection (for lane "
-                           << laneIdx << ")";
-                if (!impl.error_) {
-                  impl.onServerAcceptOfLane(laneIdx, std::move(connection));
-                }
-              }));
-      laneRegistrationIds_.emplace(laneIdx, token);
-      nopLaneAdvertisement.registrationId = token;
-      numLanesBeingAccepted_++;
+      requestLane(laneIdx, nopServerHello.laneAdvertisements.back());
     }
     TP_VLOG(6) << "Channel " << id_ << " writing nop object (server hello)";
     connection_->write(
@@ -92,66 +82,161 @@ void ChannelImpl::initImplFromLoop() {
           TP_VLOG(6) << "Channel " << impl.id_
                      << " done writing nop object (server hello)";
         }));
+    if (isElastic()) {
+      // Operations will wait for the lanes they need, hence there's no reason
+      // to hold back the control packets until the first lane is accepted.
+      state_ = ESTABLISHED;
+      readControlPacket();
+    } else {
+      numLanesBeingAccepted_ = numLanesOpen_;
+    }
   } else {
     TP_THROW_ASSERT() << "unknown endpoint";
   }
 }
 
+void ChannelImpl::requestLane(
+    uint64_t laneIdx,
+    LaneAdvertisement& nopLaneAdvertisement) {
+  nopLaneAdvertisement.address = context_->addresses()[laneIdx];
+  TP_VLOG(6) << "Channel " << id_ << " requesting connection (for lane "
+             << laneIdx << ")";
+  uint64_t token = context_->registerConnectionRequest(
+      laneIdx,
+      callbackWrapper_(
+          [laneIdx](
+              ChannelImpl& impl,
+              std::shared_ptr<transport::Connection> connection) {
+            TP_VLOG(6) << "Channel " << impl.id_
+                       << " done requesting connection (for lane " << laneIdx
+                       << ")";
+            if (!impl.error_) {
+              impl.onServerAcceptOfLane(laneIdx, std::move(connection));
+            }
+          }));
+  laneRegistrationIds_.emplace(laneIdx, token);
+  nopLaneAdvertisement.registrationId = token;
+}
+
 void ChannelImpl::onClientReadHelloOnConnection(const Packet& nopPacketIn) {
   TP_DCHECK(context_->inLoop());
   TP_DCHECK_EQ(state_, CLIENT_READING_HELLO);
   TP_DCHECK_EQ(nopPacketIn.index(), nopPacketIn.index_of<ServerHello>());
 
   const ServerHello& nopServerHello = *nopPacketIn.get<ServerHello>();
-  TP_DCHECK_EQ(nopServerHello.laneAdvertisements.size(), numLanes_);
-  lanes_.resize(numLanes_);
-  for (uint64_t laneIdx = 0; laneIdx < numLanes_; ++laneIdx) {
-    const LaneAdvertisement& nopLaneAdvertisement =
-        nopServerHello.laneAdvertisements[laneIdx];
-    std::shared_ptr<transport::Connection> lane =
-        context_->connect(laneIdx, nopLaneAdvertisement.address);
-    auto nopHolderOut = std::make_shared<NopHolder<Packet>>();
-    Packet& nopPacket = nopHolderOut->getObject();
-    nopPacket.Become(nopPacket.index_of<ClientHello>());
-    ClientHello& nopClientHello = *nopPacket.get<ClientHello>();
-    nopClientHello.registrationId = nopLaneAdvertisement.registrationId;
-    TP_VLOG(6) << "Channel " << id_
-               << " writing nop object (client hello) on lane " << laneIdx;
-    lane->write(
-        *nopHolderOut,
-        callbackWrapper_([laneIdx, nopHolderOut](ChannelImpl& impl) {
-          TP_VLOG(6) << "Channel " << impl.id_
-                     << " done writing nop object (client hello) on lane "
-                     << laneIdx;
-        }));
-    lanes_[laneIdx] = std::move(lane);
+  TP_DCHECK_EQ(nopServerHello.laneAdvertisements.size(), numLanesOpen_);
+  for (uint64_t laneIdx = 0; laneIdx < numLanesOpen_; ++laneIdx) {
+    openLane(laneIdx, nopServerHello.laneAdvertisements[laneIdx]);
   }
 
   state_ = ESTABLISHED;
+  if (isElastic()) {
+    readControlPacket();
+  }
   sendOps_.advanceAllOperations();
   recvOps_.advanceAllOperations();
+  updateLanes();
+}
+
+void ChannelImpl::openLane(
+    uint64_t laneIdx,
+    const LaneAdvertisement& nopLaneAdvertisement) {
+  TP_DCHECK(!lanes_[laneIdx]);
+  std::shared_ptr<transport::Connection> lane =
+      context_->connect(laneIdx, nopLaneAdvertisement.address);
+  auto nopHolderOut = std::make_shared<NopHolder<Packet>>();
+  Packet& nopPacket = nopHolderOut->getObject();
+  nopPacket.Become(nopPacket.index_of<ClientHello>());
+  ClientHello& nopClientHello = *nopPacket.get<ClientHello>();
+  nopClientHello.registrationId = nopLaneAdvertisement.registrationId;
+  TP_VLOG(6) << "Channel " << id_
+             << " writing nop object (client hello) on lane " << laneIdx;
+  lane->write(
+      *nopHolderOut,
+      callbackWrapper_([laneIdx, nopHolderOut](ChannelImpl& impl) {
+        TP_VLOG(6) << "Channel " << impl.id_
+                   << " done writing nop object (client hello) on lane "
+                   << laneIdx;
+      }));
+  lanes_[laneIdx] = std::move(lane);
+  numLanesActuallyOpen_++;
+  context_->onLanesOpened(1);
 }
 
 void ChannelImpl::onServerAcceptOfLane(
     uint64_t laneIdx,
     std::shared_ptr<transport::Connection> connection) {
   TP_DCHECK(context_->inLoop());
-  TP_DCHECK_EQ(state_, SERVER_ACCEPTING_LANES);
+  TP_DCHECK(state_ == SERVER_ACCEPTING_LANES || isElastic());
 
-  TP_DCHECK(!lanes_[laneIdx]);
   TP_DCHECK_LT(laneIdx, lanes_.size());
+  TP_DCHECK(!lanes_[laneIdx]);
   lanes_[laneIdx] = std::move(connection);
+  numLanesActuallyOpen_++;
+  context_->onLanesOpened(1);
   auto laneRegistrationIter = laneRegistrationIds_.find(laneIdx);
   TP_DCHECK(laneRegistrationIter != laneRegistrationIds_.end());
   context_->unregisterConnectionRequest(laneRegistrationIter->second);
   laneRegistrationIds_.erase(laneRegistrationIter);
-  numLanesBeingAccepted_--;
 
-  if (numLanesBeingAccepted_ == 0) {
+  if (state_ == SERVER_ACCEPTING_LANES) {
+    numLanesBeingAccepted_--;
+    if (numLanesBeingAccepted_ > 0) {
+      return;
+    }
     state_ = ESTABLISHED;
-    sendOps_.advanceAllOperations();
-    recvOps_.advanceAllOperations();
   }
+  sendOps_.advanceAllOperations();
+  recvOps_.advanceAllOperations();
+}
+
+uint64_t ChannelImpl::numLanesForOperation(
+    uint64_t sequenceNumber,
+    uint64_t numLanes,
+    const std::deque<LaneBoundary>& boundaries) {
+  for (const LaneBoundary& boundary : boundaries) {
+    if (boundary.sequenceNumber > sequenceNumber) {
+      break;
+    }
+    numLanes = boundary.numLanes;
+  }
+  return numLanes;
+}
+
+bool ChannelImpl::canStartOperation(
+    uint64_t sequenceNumber,
+    uint64_t numLanes,
+    const std::deque<LaneBoundary>& boundaries) const {
+  if (laneChangeState_ == LANES_AWAITING_ACK) {
+    return false;
+  }
+  // While this endpoint is waiting for more lanes, hold back the operations
+  // whose number of lanes hasn't been pinned yet, so that they can use them.
+  if (wantedNumLanes_ > targetNumLanes_ &&
+      (boundaries.empty() ||
+       sequenceNumber >= boundaries.back().sequenceNumber)) {
+    return false;
+  }
+  uint64_t opNumLanes =
+      numLanesForOperation(sequenceNumber, numLanes, boundaries);
+  for (uint64_t laneIdx = 0; laneIdx < opNumLanes; ++laneIdx) {
+    if (!lanes_[laneIdx]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t ChannelImpl::startOperationOnLanes(
+    uint64_t sequenceNumber,
+    uint64_t& numLanes,
+    std::deque<LaneBoundary>& boundaries) {
+  while (!boundaries.empty() &&
+         boundaries.front().sequenceNumber <= sequenceNumber) {
+    numLanes = boundaries.front().numLanes;
+    boundaries.pop_front();
+  }
+  return numLanes;
 }
 
 void ChannelImpl::sendImplFromLoop(
@@ -164,7 +249,9 @@ void ChannelImpl::sendImplFromLoop(
   op.ptr = buffer.unwrap<CpuBuffer>().ptr;
   op.length = length;
   op.callback = std::move(callback);
+  numBytesQueued_ += length;
 
+  updateLanes();
   sendOps_.advanceOperation(opIter);
 }
 
@@ -175,11 +262,13 @@ void ChannelImpl::advanceSendOperation(
 
   SendOperation& op = *opIter;
 
+  // In elastic mode even empty operations must go through the lanes, in order,
+  // so that each endpoint knows which operations have been started.
   sendOps_.attemptTransition(
       opIter,
       /*from=*/SendOperation::UNINITIALIZED,
       /*to=*/SendOperation::FINISHED,
-      /*cond=*/error_ || op.length == 0,
+      /*cond=*/error_ || (op.length == 0 && !isElastic()),
       /*actions=*/{&ChannelImpl::callSendCallback});
 
   // Needs to go after previous op to ensure predictable and consistent ordering
@@ -189,7 +278,9 @@ void ChannelImpl::advanceSendOperation(
       /*from=*/SendOperation::UNINITIALIZED,
       /*to=*/SendOperation::WRITING_CHUNKS,
       /*cond=*/!error_ && state_ == ESTABLISHED &&
-          prevOpState >= SendOperation::WRITING_CHUNKS,
+          prevOpState >= SendOperation::WRITING_CHUNKS &&
+          canStartOperation(
+              op.sequenceNumber, numSendLanes_, sendLaneBoundaries_),
       /*actions=*/{&ChannelImpl::writeChunks});
 
   sendOps_.attemptTransition(
@@ -203,11 +294,18 @@ void ChannelImpl::advanceSendOperation(
 void ChannelImpl::writeChunks(SendOpIter opIter) {
   SendOperation& op = *opIter;
 
-  for (uint64_t laneIdx = 0; laneIdx < lanes_.size(); laneIdx++) {
+  op.numLanes = startOperationOnLanes(
+      op.sequenceNumber, numSendLanes_, sendLaneBoundaries_);
+  nextSendSequenceNumberToStart_ = op.sequenceNumber + 1;
+  if (op.length == 0) {
+    return;
+  }
+
+  for (uint64_t laneIdx = 0; laneIdx < op.numLanes; laneIdx++) {
     // Insert "cutpoints" at equally-spaced intervals in the buffer, rounding
     // them down if they don't end up being at an integer position.
-    uint64_t offsetStart = op.length * laneIdx / lanes_.size();
-    uint64_t offsetEnd = op.length * (laneIdx + 1) / lanes_.size();
+    uint64_t offsetStart = op.length * laneIdx / op.numLanes;
+    uint64_t offsetEnd = op.length * (laneIdx + 1) / op.numLanes;
     // As void "has no size" we cannot do pointer arithmetic on it. We need to
     // temporarily convert the pointer to a type that has a size of 1 byte.
     const void* ptr = reinterpret_cast<const uint8_t*>(op.ptr) + offsetStart;
@@ -221,15 +319,19 @@ void ChannelImpl::writeChunks(SendOpIter opIter) {
           TP_VLOG(6) << "Channel " << impl.id_ << " done writing payload #"
                      << opIter->sequenceNumber << " on lane " << laneIdx;
           --opIter->numChunksBeingWritten;
+          --impl.numChunksInFlightOnLane_[laneIdx];
           impl.sendOps_.advanceOperation(opIter);
+          impl.updateLanes();
         }));
     ++op.numChunksBeingWritten;
+    ++numChunksInFlightOnLane_[laneIdx];
   }
 }
 
 void ChannelImpl::callSendCallback(SendOpIter opIter) {
   SendOperation& op = *opIter;
 
+  numBytesQueued_ -= op.length;
   op.callback(error_);
   // Reset callback to release the resources it was holding.
   op.callback = nullptr;
@@ -245,7 +347,9 @@ void ChannelImpl::recvImplFromLoop(
   op.ptr = buffer.unwrap<CpuBuffer>().ptr;
   op.length = length;
   op.callback = std::move(callback);
+  numBytesQueued_ += length;
 
+  updateLanes();
   recvOps_.advanceOperation(opIter);
 }
 
@@ -256,11 +360,13 @@ void ChannelImpl::advanceRecvOperation(
 
   RecvOperation& op = *opIter;
 
+  // In elastic mode even empty operations must go through the lanes, in order,
+  // so that each endpoint knows which operations have been started.
   recvOps_.attemptTransition(
       opIter,
       /*from=*/RecvOperation::UNINITIALIZED,
       /*to=*/RecvOperation::FINISHED,
-      /*cond=*/error_ || op.length == 0,
+      /*cond=*/error_ || (op.length == 0 && !isElastic()),
       /*actions=*/{&ChannelImpl::callRecvCallback});
 
   // Needs to go after previous op to ensure predictable and consistent ordering
@@ -270,7 +376,9 @@ void ChannelImpl::advanceRecvOperation(
       /*from=*/RecvOperation::UNINITIALIZED,
       /*to=*/RecvOperation::READING_CHUNKS,
       /*cond=*/!error_ && state_ == ESTABLISHED &&
-          prevOpState >= RecvOperation::READING_CHUNKS,
+          prevOpState >= RecvOperation::READING_CHUNKS &&
+          canStartOperation(
+              op.sequenceNumber, numRecvLanes_, recvLaneBoundaries_),
       /*actions=*/{&ChannelImpl::readChunks});
 
   recvOps_.attemptTransition(
@@ -284,11 +392,18 @@ void ChannelImpl::advanceRecvOperation(
 void ChannelImpl::readChunks(RecvOpIter opIter) {
   RecvOperation& op = *opIter;
 
-  for (uint64_t laneIdx = 0; laneIdx < lanes_.size(); laneIdx++) {
+  op.numLanes = startOperationOnLanes(
+      op.sequenceNumber, numRecvLanes_, recvLaneBoundaries_);
+  nextRecvSequenceNumberToStart_ = op.sequenceNumber + 1;
+  if (op.length == 0) {
+    return;
+  }
+
+  for (uint64_t laneIdx = 0; laneIdx < op.numLanes; laneIdx++) {
     // Insert "cutpoints" at equally-spaced intervals in the buffer, rounding
     // them down if they don't end up being at an integer position.
-    uint64_t offsetStart = op.length * laneIdx / lanes_.size();
-    uint64_t offsetEnd = op.length * (laneIdx + 1) / lanes_.size();
+    uint64_t offsetStart = op.length * laneIdx / op.numLanes;
+    uint64_t offsetEnd = op.length * (laneIdx + 1) / op.numLanes;
     // As void "has no size" we cannot do pointer arithmetic on it. We need to
     // temporarily convert the pointer to a type that has a size of 1 byte.
     void* ptr = reinterpret_cast<uint8_t*>(op.ptr) + offsetStart;
@@ -307,20 +422,289 @@ void ChannelImpl::readChunks(RecvOpIter opIter) {
           TP_VLOG(6) << "Channel " << impl.id_ << " done reading payload #"
                      << opIter->sequenceNumber << " on lane " << laneIdx;
           --opIter->numChunksBeingRead;
+          --impl.numChunksInFlightOnLane_[laneIdx];
           impl.recvOps_.advanceOperation(opIter);
+          impl.updateLanes();
         }));
     ++op.numChunksBeingRead;
+    ++numChunksInFlightOnLane_[laneIdx];
   }
 }
 
 void ChannelImpl::callRecvCallback(RecvOpIter opIter) {
   RecvOperation& op = *opIter;
 
+  numBytesQueued_ -= op.length;
   op.callback(error_);
   // Reset callback to release the resources it was holding.
   op.callback = nullptr;
 }
 
+void ChannelImpl::readControlPacket() {
+  auto nopHolderIn = std::make_shared<NopHolder<Packet>>();
+  TP_VLOG(6) << "Channel " << id_ << " reading nop object (control packet)";
+  connection_->read(
+      *nopHolderIn, callbackWrapper_([nopHolderIn](ChannelImpl& impl) {
+        TP_VLOG(6) << "Channel " << impl.id_
+                   << " done reading nop object (control packet)";
+        if (!impl.error_) {
+          impl.onControlPacket(nopHolderIn->getObject());
+          impl.readControlPacket();
+        }
+      }));
+}
+
+void ChannelImpl::writeControlPacket(
+    std::shared_ptr<NopHolder<Packet>> nopHolderOut) {
+  TP_VLOG(6) << "Channel " << id_ << " writing nop object (control packet)";
+  connection_->write(
+      *nopHolderOut, callbackWrapper_([nopHolderOut](ChannelImpl& impl) {
+        TP_VLOG(6) << "Channel " << impl.id_
+                   << " done writing nop object (control packet)";
+      }));
+}
+
+void ChannelImpl::onControlPacket(const Packet& nopPacketIn) {
+  TP_DCHECK(context_->inLoop());
+
+  if (nopPacketIn.is<LaneChange>()) {
+    onLaneChange(*nopPacketIn.get<LaneChange>());
+  } else if (nopPacketIn.is<LaneChangeAck>()) {
+    onLaneChangeAck(*nopPacketIn.get<LaneChangeAck>());
+  } else if (nopPacketIn.is<LaneChangeRequest>()) {
+    onLaneChangeRequest(*nopPacketIn.get<LaneChangeRequest>());
+  } else if (nopPacketIn.is<LanesDrained>()) {
+    onLanesDrained(*nopPacketIn.get<LanesDrained>());
+  } else {
+    TP_THROW_ASSERT() << "unexpected nop object (index " << nopPacketIn.index()
+                      << ")";
+  }
+}
+
+void ChannelImpl::onLaneChange(const LaneChange& nopLaneChange) {
+  TP_DCHECK(endpoint_ == Endpoint::kListen);
+  // The client only starts a change once both endpoints are done with the
+  // previous one.
+  TP_DCHECK_EQ(laneChangeState_, LANES_STABLE);
+  TP_DCHECK_GE(nopLaneChange.numLanes, 1);
+  TP_DCHECK_LE(nopLaneChange.numLanes, numLanes_);
+
+  // The change can't apply to the operations that we, or the client, already
+  // started with the previous number of lanes.
+  uint64_t clientToServerSequenceNumber = std::max(
+      nopLaneChange.firstSendSequenceNumber, nextRecvSequenceNumberToStart_);
+  uint64_t serverToClientSequenceNumber = std::max(
+      nopLaneChange.firstRecvSequenceNumber, nextSendSequenceNumberToStart_);
+
+  auto nopHolderOut = std::make_shared<NopHolder<Packet>>();
+  Packet& nopPacket = nopHolderOut->getObject();
+  nopPacket.Become(nopPacket.index_of<LaneChangeAck>());
+  LaneChangeAck& nopLaneChangeAck = *nopPacket.get<LaneChangeAck>();
+  nopLaneChangeAck.numLanes = nopLaneChange.numLanes;
+  nopLaneChangeAck.clientToServerSequenceNumber = clientToServerSequenceNumber;
+  nopLaneChangeAck.serverToClientSequenceNumber = serverToClientSequenceNumber;
+  nopLaneChangeAck.firstNewLaneIdx = numLanesOpen_;
+  for (uint64_t laneIdx = numLanesOpen_; laneIdx < nopLaneChange.numLanes;
+       ++laneIdx) {
+    nopLaneChangeAck.laneAdvertisements.emplace_back();
+    requestLane(laneIdx, nopLaneChangeAck.laneAdvertisements.back());
+  }
+
+  applyLaneChange(
+      nopLaneChange.numLanes,
+      /*firstSendSequenceNumber=*/serverToClientSequenceNumber,
+      /*firstRecvSequenceNumber=*/clientToServerSequenceNumber);
+  writeControlPacket(std::move(nopHolderOut));
+
+  sendOps_.advanceAllOperations();
+  recvOps_.advanceAllOperations();
+  updateLanes();
+}
+
+void ChannelImpl::onLaneChangeAck(const LaneChangeAck& nopLaneChangeAck) {
+  TP_DCHECK(endpoint_ == Endpoint::kConnect);
+  TP_DCHECK_EQ(laneChangeState_, LANES_AWAITING_ACK);
+
+  for (uint64_t idx = 0; idx < nopLaneChangeAck.laneAdvertisements.size();
+       ++idx) {
+    openLane(
+        nopLaneChangeAck.firstNewLaneIdx + idx,
+        nopLaneChangeAck.laneAdvertisements[idx]);
+  }
+
+  applyLaneChange(
+      nopLaneChangeAck.numLanes,
+      /*firstSendSequenceNumber=*/nopLaneChangeAck.clientToServerSequenceNumber,
+      /*firstRecvSequenceNumber=*/
+      nopLaneChangeAck.serverToClientSequenceNumber);
+
+  sendOps_.advanceAllOperations();
+  recvOps_.advanceAllOperations();
+  updateLanes();
+}
+
+void ChannelImpl::onLaneChangeRequest(
+    const LaneChangeRequest& nopLaneChangeRequest) {
+  TP_DCHECK(endpoint_ == Endpoint::kConnect);
+
+  peerWantedNumLanes_ = nopLaneChangeRequest.numLanes;
+  updateLanes();
+}
+
+void ChannelImpl::onLanesDrained(const LanesDrained& nopLanesDrained) {
+  TP_DCHECK_EQ(laneChangeState_, LANES_DRAINING);
+  TP_DCHECK_EQ(nopLanesDrained.numLanes, targetNumLanes_);
+
+  receivedLanesDrained_ = true;
+  updateLanes();
+}
+
+void ChannelImpl::applyLaneChange(
+    uint64_t numLanes,
+    uint64_t firstSendSequenceNumber,
+    uint64_t firstRecvSequenceNumber) {
+  TP_VLOG(6) << "Channel " << id_ << " changing number of lanes from "
+             << targetNumLanes_ << " to " << numLanes
+             << " (starting at send #" << firstSendSequenceNumber
+             << " and recv #" << firstRecvSequenceNumber << ")";
+  sendLaneBoundaries_.push_back(
+      LaneBoundary{firstSendSequenceNumber, numLanes});
+  recvLaneBoundaries_.push_back(
+      LaneBoundary{firstRecvSequenceNumber, numLanes});
+  targetNumLanes_ = numLanes;
+  numLanesOpen_ = std::max(numLanesOpen_, numLanes);
+  context_->onLaneChange();
+
+  if (targetNumLanes_ < numLanesOpen_) {
+    laneChangeState_ = LANES_DRAINING;
+    drainSendSequenceNumber_ = firstSendSequenceNumber;
+    drainRecvSequenceNumber_ = firstRecvSequenceNumber;
+    sentLanesDrained_ = false;
+    receivedLanesDrained_ = false;
+  } else {
+    laneChangeState_ = LANES_STABLE;
+  }
+}
+
+void ChannelImpl::updateLanes() {
+  if (!isElastic() || error_ || state_ != ESTABLISHED) {
+    return;
+  }
+
+  uint64_t prevWantedNumLanes = wantedNumLanes_;
+  updateWantedNumLanes();
+  maybeFinishDraining();
+  maybeStartLaneChange();
+
+  // Operations may have been held back waiting for more lanes.
+  if (wantedNumLanes_ < prevWantedNumLanes) {
+    sendOps_.advanceAllOperations();
+    recvOps_.advanceAllOperations();
+  }
+}
+
+void ChannelImpl::updateWantedNumLanes() {
+  const ElasticLanesOptions& options = elasticOptions_.value();
+  uint64_t neededNumLanes =
+      (numBytesQueued_ + options.bytesPerLane - 1) / options.bytesPerLane;
+  neededNumLanes = std::min(std::max(neededNumLanes, uint64_t(1)), numLanes_);
+
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (neededNumLanes >= wantedNumLanes_) {
+    wantedNumLanes_ = neededNumLanes;
+    lastTimeWantedLanesWereNeeded_ = now;
+  } else if (
+      now - lastTimeWantedLanesWereNeeded_ >= options.idleTimeout) {
+    wantedNumLanes_ = neededNumLanes;
+    lastTimeWantedLanesWereNeeded_ = now;
+  }
+}
+
+void ChannelImpl::maybeStartLaneChange() {
+  if (endpoint_ == Endpoint::kListen) {
+    // Only the client can start a change: let it know what we want.
+    if (wantedNumLanes_ != peerWantedNumLanes_) {
+      peerWantedNumLanes_ = wantedNumLanes_;
+      auto nopHolderOut = std::make_shared<NopHolder<Packet>>();
+      Packet& nopPacket = nopHolderOut->getObject();
+      nopPacket.Become(nopPacket.index_of<LaneChangeRequest>());
+      nopPacket.get<LaneChangeRequest>()->numLanes = wantedNumLanes_;
+      writeControlPacket(std::move(nopHolderOut));
+    }
+    return;
+  }
+
+  if (laneChangeState_ != LANES_STABLE) {
+    return;
+  }
+  uint64_t numLanes = std::max(wantedNumLanes_, peerWantedNumLanes_);
+  if (numLanes == targetNumLanes_) {
+    return;
+  }
+
+  laneChangeState_ = LANES_AWAITING_ACK;
+  auto nopHolderOut = std::make_shared<NopHolder<Packet>>();
+  Packet& nopPacket = nopHolderOut->getObject();
+  nopPacket.Become(nopPacket.index_of<LaneChange>());
+  LaneChange& nopLaneChange = *nopPacket.get<LaneChange>();
+  nopLaneChange.numLanes = numLanes;
+  nopLaneChange.firstSendSequenceNumber = nextSendSequenceNumberToStart_;
+  nopLaneChange.firstRecvSequenceNumber = nextRecvSequenceNumberToStart_;
+  writeControlPacket(std::move(nopHolderOut));
+}
+
+void ChannelImpl::maybeFinishDraining() {
+  if (laneChangeState_ != LANES_DRAINING) {
+    return;
+  }
+
+  if (!sentLanesDrained_) {
+    // All the operations that use the old number of lanes must have started
+    // and be done with the lanes that are going away.
+    if (nextSendSequenceNumberToStart_ < drainSendSequenceNumber_ ||
+        nextRecvSequenceNumberToStart_ < drainRecvSequenceNumber_) {
+      return;
+    }
+    for (uint64_t laneIdx = targetNumLanes_; laneIdx < numLanesOpen_;
+         ++laneIdx) {
+      if (numChunksInFlightOnLane_[laneIdx] > 0) {
+        return;
+      }
+    }
+    sentLanesDrained_ = true;
+    auto nopHolderOut = std::make_shared<NopHolder<Packet>>();
+    Packet& nopPacket = nopHolderOut->getObject();
+    nopPacket.Become(nopPacket.index_of<LanesDrained>());
+    nopPacket.get<LanesDrained>()->numLanes = targetNumLanes_;
+    writeControlPacket(std::move(nopHolderOut));
+  }
+
+  if (receivedLanesDrained_) {
+    closeDrainedLanes();
+    laneChangeState_ = LANES_STABLE;
+  }
+}
+
+void ChannelImpl::closeDrainedLanes() {
+  for (uint64_t laneIdx = targetNumLanes_; laneIdx < numLanesOpen_;
+       ++laneIdx) {
+    TP_VLOG(6) << "Channel " << id_ << " closing lane " << laneIdx;
+    if (lanes_[laneIdx]) {
+      lanes_[laneIdx]->close();
+      lanes_[laneIdx].reset();
+      numLanesActuallyOpen_--;
+      context_->onLanesClosed(1);
+    }
+    // The client may not have gotten to open it.
+    auto laneRegistrationIter = laneRegistrationIds_.find(laneIdx);
+    if (laneRegistrationIter != laneRegistrationIds_.end()) {
+      context_->unregisterConnectionRequest(laneRegistrationIter->second);
+      laneRegistrationIds_.erase(laneRegistrationIter);
+    }
+  }
+  numLanesOpen_ = targetNumLanes_;
+}
+
 void ChannelImpl::handleErrorImpl() {
   sendOps_.advanceAllOperations();
   recvOps_.advanceAllOperations();
@@ -333,6 +717,8 @@ void ChannelImpl::handleErrorImpl() {
       lane->close();
     }
   }
+  context_->onLanesClosed(numLanesActuallyOpen_);
+  numLanesActuallyOpen_ = 0;
 
   for (const auto& iter : laneRegistrationIds_) {
     context_->unregisterConnectionRequest(iter.second);
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <chrono>
 #include <deque>
 #include <memory>
 #include <string>
@@ -15,7 +16,10 @@
 #include <vector>
 
 #include <tensorpipe/channel/channel_impl_boilerplate.h>
+#include <tensorpipe/channel/mpt/factory.h>
 #include <tensorpipe/channel/mpt/nop_types.h>
+#include <tensorpipe/common/nop.h>
+#include <tensorpipe/common/optional.h>
 #include <tensorpipe/common/state_machine.h>
 #include <tensorpipe/transport/context.h>
 
@@ -36,6 +40,9 @@ struct SendOperation {
   // Progress flags
   int64_t numChunksBeingWritten{0};
 
+  // The number of lanes the data is split over, decided when it starts.
+  uint64_t numLanes{0};
+
   // Arguments at creation
   const void* ptr;
   size_t length;
@@ -53,6 +60,9 @@ struct RecvOperation {
   // Progress flags
   int64_t numChunksBeingRead{0};
 
+  // The number of lanes the data is split over, decided when it starts.
+  uint64_t numLanes{0};
+
   // Arguments at creation
   void* ptr;
   size_t length;
@@ -68,7 +78,8 @@ class ChannelImpl final
       std::string id,
       std::shared_ptr<transport::Connection> connection,
       Endpoint endpoint,
-      uint64_t numLanes);
+      uint64_t numLanes,
+      optional<ElasticLanesOptions> elasticOptions);
 
  protected:
   // Implement the entry points called by ChannelImplBoilerplate.
@@ -101,6 +112,14 @@ class ChannelImpl final
       uint64_t laneIdx,
       std::shared_ptr<transport::Connection> connection);
 
+  // Server-side: register a connection request for a lane and fill in the
+  // advertisement the client will need to open it.
+  void requestLane(uint64_t laneIdx, LaneAdvertisement& nopLaneAdvertisement);
+  // Client-side: open a lane and identify it to the server.
+  void openLane(
+      uint64_t laneIdx,
+      const LaneAdvertisement& nopLaneAdvertisement);
+
   const std::shared_ptr<transport::Connection> connection_;
   const Endpoint endpoint_;
   State state_{UNINITIALIZED};
@@ -109,6 +128,102 @@ class ChannelImpl final
   std::vector<std::shared_ptr<transport::Connection>> lanes_;
   std::unordered_map<uint64_t, uint64_t> laneRegistrationIds_;
 
+  // Elastic lanes.
+  //
+  // The two directions are handled separately, as each of them has its own
+  // sequence numbers, but a change always applies to both of them. A change
+  // starts applying at a different sequence number on each direction, and those
+  // operations that come before still use the previous number of lanes. Lanes
+  // are always opened and closed in order, hence the ones in use are always a
+  // prefix of all of them. This is only used if the context is elastic.
+  const optional<ElasticLanesOptions> elasticOptions_;
+
+  struct LaneBoundary {
+    uint64_t sequenceNumber;
+    uint64_t numLanes;
+  };
+
+  enum LaneChangeState {
+    LANES_STABLE,
+    // Client-side only: a change has been proposed and no operation can start
+    // until the server has replied.
+    LANES_AWAITING_ACK,
+    // The number of lanes went down and the extra ones will be closed once
+    // neither endpoint is using them anymore.
+    LANES_DRAINING,
+  };
+
+  LaneChangeState laneChangeState_{LANES_STABLE};
+  // The number of lanes agreed upon in the last change, and the number of lanes
+  // that are open or being opened, which is larger while draining.
+  uint64_t targetNumLanes_;
+  uint64_t numLanesOpen_;
+  uint64_t numLanesActuallyOpen_{0};
+  // The number of lanes in use by the next operation to start, and the changes
+  // that will apply to later ones.
+  uint64_t numSendLanes_;
+  uint64_t numRecvLanes_;
+  std::deque<LaneBoundary> sendLaneBoundaries_;
+  std::deque<LaneBoundary> recvLaneBoundaries_;
+  uint64_t nextSendSequenceNumberToStart_{0};
+  uint64_t nextRecvSequenceNumberToStart_{0};
+  std::vector<uint64_t> numChunksInFlightOnLane_;
+  // Where the ongoing draining ends in each direction.
+  uint64_t drainSendSequenceNumber_{0};
+  uint64_t drainRecvSequenceNumber_{0};
+  bool sentLanesDrained_{false};
+  bool receivedLanesDrained_{false};
+
+  // The demand for lanes of this endpoint, and the one last reported by the
+  // server (client-side) or to the client (server-side).
+  uint64_t numBytesQueued_{0};
+  uint64_t wantedNumLanes_;
+  uint64_t peerWantedNumLanes_;
+  std::chrono::steady_clock::time_point lastTimeWantedLanesWereNeeded_;
+
+  bool isElastic() const {
+    return elasticOptions_.has_value();
+  }
+
+  // The number of lanes that the operation with the given sequence number will
+  // use, according to the changes known so far.
+  static uint64_t numLanesForOperation(
+      uint64_t sequenceNumber,
+      uint64_t numLanes,
+      const std::deque<LaneBoundary>& boundaries);
+  // Whether an operation with the given sequence number and number of lanes is
+  // allowed to start.
+  bool canStartOperation(
+      uint64_t sequenceNumber,
+      uint64_t numLanes,
+      const std::deque<LaneBoundary>& boundaries) const;
+  // Assign the number of lanes to the operation that is starting and apply the
+  // changes that start with it.
+  static uint64_t startOperationOnLanes(
+      uint64_t sequenceNumber,
+      uint64_t& numLanes,
+      std::deque<LaneBoundary>& boundaries);
+
+  void readControlPacket();
+  void onControlPacket(const Packet& nopPacketIn);
+  void writeControlPacket(std::shared_ptr<NopHolder<Packet>> nopHolderOut);
+  void onLaneChange(const LaneChange& nopLaneChange);
+  void onLaneChangeAck(const LaneChangeAck& nopLaneChangeAck);
+  void onLaneChangeRequest(const LaneChangeRequest& nopLaneChangeRequest);
+  void onLanesDrained(const LanesDrained& nopLanesDrained);
+  void applyLaneChange(
+      uint64_t numLanes,
+      uint64_t firstSendSequenceNumber,
+      uint64_t firstRecvSequenceNumber);
+  void closeDrainedLanes();
+
+  // Re-evaluate the demand for lanes and act on it, and check whether draining
+  // lanes can be closed. Called whenever operations are issued or progress.
+  void updateLanes();
+  void updateWantedNumLanes();
+  void maybeStartLaneChange();
+  void maybeFinishDraining();
+
   OpsStateMachine<ChannelImpl, SendOperation> sendOps_{
       *this,
       &ChannelImpl::advanceSendOperation};
@@ -28,11 +28,16 @@ namespace mpt {
 namespace {
 
 std::string generateDomainDescriptor(
-    const std::vector<std::shared_ptr<transport::Context>>& contexts) {
+    const std::vector<std::shared_ptr<transport::Context>>& contexts,
+    bool elastic) {
   // FIXME Escape the contexts' domain descriptors in case they contain a colon?
   // Or put them all in a nop object, that'll do the escaping for us.
   // But is it okay to compare nop objects by equality bitwise?
   std::ostringstream ss;
+  // Elastic and non-elastic channels speak different protocols.
+  if (elastic) {
+    ss << "elastic:";
+  }
   ss << contexts.size();
   for (const auto& context : contexts) {
     ss << ":" << context->domainDescriptor();
@@ -44,7 +49,8 @@ std::string generateDomainDescriptor(
 
 std::shared_ptr<ContextImpl> ContextImpl::create(
     std::vector<std::shared_ptr<transport::Context>> contexts,
-    std::vector<std::shared_ptr<transport::Listener>> listeners) {
+    std::vector<std::shared_ptr<transport::Listener>> listeners,
+    optional<ElasticLanesOptions> elasticOptions) {
   for (const auto& context : contexts) {
     if (!context->isViable()) {
       return nullptr;
@@ -52,20 +58,26 @@ std::shared_ptr<ContextImpl> ContextImpl::create(
   }
 
   std::unordered_map<Device, std::string> deviceDescriptors = {
-      {Device{kCpuDeviceType, 0}, generateDomainDescriptor(contexts)}};
+      {Device{kCpuDeviceType, 0},
+       generateDomainDescriptor(contexts, elasticOptions.has_value())}};
 
   return std::make_shared<ContextImpl>(
-      std::move(contexts), std::move(listeners), std::move(deviceDescriptors));
+      std::move(contexts),
+      std::move(listeners),
+      std::move(elasticOptions),
+      std::move(deviceDescriptors));
 }
 
 ContextImpl::ContextImpl(
     std::vector<std::shared_ptr<transport::Context>> contexts,
     std::vector<std::shared_ptr<transport::Listener>> listeners,
+    optional<ElasticLanesOptions> elasticOptions,
     std::unordered_map<Device, std::string> deviceDescriptors)
     : ContextImplBoilerplate<ContextImpl, ChannelImpl>(
           std::move(deviceDescriptors)),
       contexts_(std::move(contexts)),
-      listeners_(std::move(listeners)) {
+      listeners_(std::move(listeners)),
+      elasticOptions_(std::move(elasticOptions)) {
   TP_THROW_ASSERT_IF(contexts_.size() != listeners_.size());
   numLanes_ = contexts_.size();
 
@@ -85,7 +97,8 @@ std::shared_ptr<Channel> ContextImpl::createChannel(
     std::vector<std::shared_ptr<transport::Connection>> connections,
     Endpoint endpoint) {
   TP_DCHECK_EQ(numConnectionsNeeded(), connections.size());
-  return createChannelInternal(std::move(connections[0]), endpoint, numLanes_);
+  return createChannelInternal(
+      std::move(connections[0]), endpoint, numLanes_, elasticOptions_);
 }
 
 const std::vector<std::string>& ContextImpl::addresses() const {
@@ -144,6 +157,29 @@ std::shared_ptr<transport::Connection> ContextImpl::connect(
   return contexts_[laneIdx]->connect(std::move(address));
 }
 
+void ContextImpl::onLanesOpened(uint64_t numLanes) {
+  numLanesOpen_ += numLanes;
+  numLanesOpened_ += numLanes;
+}
+
+void ContextImpl::onLanesClosed(uint64_t numLanes) {
+  numLanesOpen_ -= numLanes;
+  numLanesClosed_ += numLanes;
+}
+
+void ContextImpl::onLaneChange() {
+  numLaneChanges_++;
+}
+
+LaneStats ContextImpl::getLaneStats() const {
+  LaneStats stats;
+  stats.numLanesOpen = numLanesOpen_.load();
+  stats.numLanesOpened = numLanesOpened_.load();
+  stats.numLanesClosed = numLanesClosed_.load();
+  stats.numLaneChanges = numLaneChanges_.load();
+  return stats;
+}
+
 void ContextImpl::acceptLane(uint64_t laneIdx) {
   TP_DCHECK(loop_.inLoop());
 
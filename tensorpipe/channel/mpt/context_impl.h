@@ -17,10 +17,12 @@
 #include <vector>
 
 #include <tensorpipe/channel/context_impl_boilerplate.h>
+#include <tensorpipe/channel/mpt/factory.h>
 #include <tensorpipe/channel/mpt/nop_types.h>
 #include <tensorpipe/common/callback.h>
 #include <tensorpipe/common/deferred_executor.h>
 #include <tensorpipe/common/device.h>
+#include <tensorpipe/common/optional.h>
 #include <tensorpipe/transport/context.h>
 
 namespace tensorpipe {
@@ -34,11 +36,13 @@ class ContextImpl final
  public:
   static std::shared_ptr<ContextImpl> create(
       std::vector<std::shared_ptr<transport::Context>> contexts,
-      std::vector<std::shared_ptr<transport::Listener>> listeners);
+      std::vector<std::shared_ptr<transport::Listener>> listeners,
+      optional<ElasticLanesOptions> elasticOptions);
 
   ContextImpl(
       std::vector<std::shared_ptr<transport::Context>> contexts,
       std::vector<std::shared_ptr<transport::Listener>> listeners,
+      optional<ElasticLanesOptions> elasticOptions,
       std::unordered_map<Device, std::string> deviceDescriptors);
 
   std::shared_ptr<Channel> createChannel(
@@ -64,6 +68,13 @@ class ContextImpl final
       uint64_t laneIdx,
       std::string address);
 
+  // Called by the channels to keep the stats up to date.
+  void onLanesOpened(uint64_t numLanes);
+  void onLanesClosed(uint64_t numLanes);
+  void onLaneChange();
+
+  LaneStats getLaneStats() const;
+
  protected:
   // Implement the entry points called by ContextImplBoilerplate.
   void initImplFromLoop() override;
@@ -82,6 +93,7 @@ class ContextImpl final
 
   const std::vector<std::shared_ptr<transport::Context>> contexts_;
   const std::vector<std::shared_ptr<transport::Listener>> listeners_;
+  const optional<ElasticLanesOptions> elasticOptions_;
 
   uint64_t numLanes_{0};
   std::vector<std::string> addresses_;
@@ -94,6 +106,11 @@ class ContextImpl final
 
   std::unordered_map<uint64_t, connection_request_callback_fn>
       connectionRequestRegistrations_;
+
+  std::atomic<uint64_t> numLanesOpen_{0};
+  std::atomic<uint64_t> numLanesOpened_{0};
+  std::atomic<uint64_t> numLanesClosed_{0};
+  std::atomic<uint64_t> numLaneChanges_{0};
 };
 
 } // namespace mpt
@@ -11,16 +11,49 @@
 #include <tensorpipe/channel/context_boilerplate.h>
 #include <tensorpipe/channel/mpt/channel_impl.h>
 #include <tensorpipe/channel/mpt/context_impl.h>
+#include <tensorpipe/common/defs.h>
+#include <tensorpipe/common/optional.h>
 
 namespace tensorpipe {
 namespace channel {
 namespace mpt {
 
+namespace {
+
+// Gives access to the implementation, for the stats.
+class MptContext final : public ContextBoilerplate<ContextImpl, ChannelImpl> {
+ public:
+  using ContextBoilerplate<ContextImpl, ChannelImpl>::ContextBoilerplate;
+
+  LaneStats getLaneStats() const {
+    if (unlikely(!impl_)) {
+      return LaneStats();
+    }
+    return impl_->getLaneStats();
+  }
+};
+
+} // namespace
+
 std::shared_ptr<Context> create(
     std::vector<std::shared_ptr<transport::Context>> contexts,
     std::vector<std::shared_ptr<transport::Listener>> listeners) {
-  return std::make_shared<ContextBoilerplate<ContextImpl, ChannelImpl>>(
-      std::move(contexts), std::move(listeners));
+  return std::make_shared<MptContext>(
+      std::move(contexts), std::move(listeners), nullopt);
+}
+
+std::shared_ptr<Context> createElastic(
+    std::vector<std::shared_ptr<transport::Context>> contexts,
+    std::vector<std::shared_ptr<transport::Listener>> listeners,
+    ElasticLanesOptions options) {
+  return std::make_shared<MptContext>(
+      std::move(contexts), std::move(listeners), std::move(options));
+}
+
+LaneStats getLaneStats(const std::shared_ptr<Context>& context) {
+  auto mptContext = std::dynamic_pointer_cast<MptContext>(context);
+  TP_THROW_ASSERT_IF(!mptContext) << "Not a context of the mpt channel";
+  return mptContext->getLaneStats();
 }
 
 } // namespace mpt
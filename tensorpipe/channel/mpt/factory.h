@@ -8,6 +8,9 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -22,6 +25,43 @@ std::shared_ptr<Context> create(
     std::vector<std::shared_ptr<transport::Context>> contexts,
     std::vector<std::shared_ptr<transport::Listener>> listeners);
 
+struct ElasticLanesOptions {
+  // Each endpoint wants as many lanes as needed for each of them to have at
+  // most this many bytes queued on it, counting the ones of all the pending
+  // send and recv operations.
+  size_t bytesPerLane{1024 * 1024};
+  // Once an endpoint needs fewer lanes than are open, it waits for this long
+  // before closing the extra ones, in case they're needed again.
+  std::chrono::milliseconds idleTimeout{1000};
+};
+
+// Create a context whose channels start with a single lane and open more (up
+// to one per given transport context) when the amount of data queued on them
+// grows, closing them again once they've been idle for a while. Changes in the
+// number of lanes are negotiated by the two endpoints and can't affect the
+// operations that have already started, hence they only benefit the following
+// ones. As there are no timers, idle lanes are only closed when some other
+// operation is issued or completes after the timeout has expired. Both ends of
+// a channel must use an elastic context.
+std::shared_ptr<Context> createElastic(
+    std::vector<std::shared_ptr<transport::Context>> contexts,
+    std::vector<std::shared_ptr<transport::Listener>> listeners,
+    ElasticLanesOptions options = ElasticLanesOptions());
+
+// Counters aggregated over all the channels of a context. For a non-elastic
+// context, each channel opens all lanes at once and never closes them.
+struct LaneStats {
+  uint64_t numLanesOpen{0};
+  uint64_t numLanesOpened{0};
+  uint64_t numLanesClosed{0};
+  uint64_t numLaneChanges{0};
+};
+
+// The counters are updated from the event loop, hence they may lag behind the
+// callbacks that have been invoked. The context must have been created by one
+// of the functions above.
+LaneStats getLaneStats(const std::shared_ptr<Context>& context);
+
 } // namespace mpt
 } // namespace channel
 } // namespace tensorpipe
@@ -40,7 +40,62 @@ struct ClientHello {
   NOP_STRUCTURE(ClientHello, registrationId);
 };
 
-using Packet = nop::Variant<ServerHello, ClientHello>;
+// Sent by the client to the server to change the number of lanes used by both
+// directions. The client includes the sequence numbers of its first send and
+// recv operations that haven't started yet, and won't start any new ones until
+// it gets the server's reply.
+struct LaneChange {
+  uint64_t numLanes;
+  uint64_t firstSendSequenceNumber;
+  uint64_t firstRecvSequenceNumber;
+  NOP_STRUCTURE(
+      LaneChange,
+      numLanes,
+      firstSendSequenceNumber,
+      firstRecvSequenceNumber);
+};
+
+// The server's reply to a LaneChange, with the sequence numbers, in each
+// direction, of the first operation that uses the new number of lanes, and with
+// the advertisements of the lanes that must be opened, starting at the given
+// index.
+struct LaneChangeAck {
+  uint64_t numLanes;
+  uint64_t clientToServerSequenceNumber;
+  uint64_t serverToClientSequenceNumber;
+  uint64_t firstNewLaneIdx;
+  std::vector<LaneAdvertisement> laneAdvertisements;
+  NOP_STRUCTURE(
+      LaneChangeAck,
+      numLanes,
+      clientToServerSequenceNumber,
+      serverToClientSequenceNumber,
+      firstNewLaneIdx,
+      laneAdvertisements);
+};
+
+// Sent by the server to let the client know how many lanes it wants, as only
+// the client can initiate a change.
+struct LaneChangeRequest {
+  uint64_t numLanes;
+  NOP_STRUCTURE(LaneChangeRequest, numLanes);
+};
+
+// Sent by each endpoint, after a change that reduced the number of lanes, once
+// none of its operations are using the lanes that are going away anymore. Each
+// endpoint closes them when it has both sent and received this.
+struct LanesDrained {
+  uint64_t numLanes;
+  NOP_STRUCTURE(LanesDrained, numLanes);
+};
+
+using Packet = nop::Variant<
+    ServerHello,
+    ClientHello,
+    LaneChange,
+    LaneChangeAck,
+    LaneChangeRequest,
+    LanesDrained>;
 
 } // namespace mpt
 } // namespace channel
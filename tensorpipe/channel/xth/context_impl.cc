@@ -18,6 +18,7 @@
 #include <thread>
 #include <utility>
 
+#include <tensorpipe/channel/helpers.h>
 #include <tensorpipe/channel/xth/channel_impl.h>
 #include <tensorpipe/common/defs.h>
 #include <tensorpipe/common/system.h>
@@ -26,7 +27,9 @@ namespace tensorpipe {
 namespace channel {
 namespace xth {
 
-std::shared_ptr<ContextImpl> ContextImpl::create() {
+namespace {
+
+optional<std::unordered_map<Device, std::string>> getDeviceDescriptors() {
   std::ostringstream oss;
   auto bootID = getBootID();
   TP_THROW_ASSERT_IF(!bootID) << "Unable to read boot_id";
@@ -34,23 +37,54 @@ std::shared_ptr<ContextImpl> ContextImpl::create() {
   if (!nsID.has_value()) {
     TP_VLOG(5)
         << "XTH channel is not viable because it couldn't determine the PID namespace ID";
-    return nullptr;
+    return nullopt;
   }
   oss << bootID.value() << "_" << nsID.value() << "_" << ::getpid();
   const std::string domainDescriptor = oss.str();
 
   std::unordered_map<Device, std::string> deviceDescriptors = {
       {Device{kCpuDeviceType, 0}, domainDescriptor}};
-  return std::make_shared<ContextImpl>(std::move(deviceDescriptors));
+  return deviceDescriptors;
+}
+
+std::shared_ptr<WorkerThread> createWorker() {
+  return std::make_shared<WorkerThread>("TP_XTH_loop");
+}
+
+} // namespace
+
+std::shared_ptr<ContextImpl> ContextImpl::create() {
+  optional<std::unordered_map<Device, std::string>> deviceDescriptors =
+      getDeviceDescriptors();
+  if (!deviceDescriptors.has_value()) {
+    return nullptr;
+  }
+  return std::make_shared<ContextImpl>(
+      std::move(deviceDescriptors).value(),
+      createWorker(),
+      /*isWorkerShared=*/false);
+}
+
+std::shared_ptr<ContextImpl> ContextImpl::create(LoopPool& loopPool) {
+  optional<std::unordered_map<Device, std::string>> deviceDescriptors =
+      getDeviceDescriptors();
+  if (!deviceDescriptors.has_value()) {
+    return nullptr;
+  }
+  return std::make_shared<ContextImpl>(
+      std::move(deviceDescriptors).value(),
+      loopPool.getLoop<WorkerThread>("xth", createWorker),
+      /*isWorkerShared=*/true);
 }
 
 ContextImpl::ContextImpl(
-    std::unordered_map<Device, std::string> deviceDescriptors)
+    std::unordered_map<Device, std::string> deviceDescriptors,
+    std::shared_ptr<WorkerThread> worker,
+    bool isWorkerShared)
     : ContextImplBoilerplate<ContextImpl, ChannelImpl>(
           std::move(deviceDescriptors)),
-      requests_(std::numeric_limits<int>::max()) {
-  thread_ = std::thread(&ContextImpl::handleCopyRequests, this);
-}
+      worker_(std::move(worker)),
+      isWorkerShared_(isWorkerShared) {}
 
 std::shared_ptr<Channel> ContextImpl::createChannel(
     std::vector<std::shared_ptr<transport::Connection>> connections,
@@ -65,12 +99,19 @@ size_t ContextImpl::numConnectionsNeeded() const {
 }
 
 void ContextImpl::handleErrorImpl() {
-  requests_.push(nullopt);
+  if (!isWorkerShared_) {
+    worker_->close();
+  }
 }
 
 void ContextImpl::joinImpl() {
-  thread_.join();
-  // TP_DCHECK(requests_.empty());
+  if (!isWorkerShared_) {
+    worker_->join();
+    return;
+  }
+  std::unique_lock<std::mutex> lock(numRequestsInFlightMutex_);
+  numRequestsInFlightCv_.wait(
+      lock, [&]() { return numRequestsInFlight_ == 0; });
 }
 
 bool ContextImpl::inLoop() const {
@@ -99,27 +140,38 @@ void ContextImpl::requestCopy(
                << ")";
   };
 
-  requests_.push(CopyRequest{remotePtr, localPtr, length, std::move(fn)});
+  CopyRequest request{remotePtr, localPtr, length, std::move(fn)};
+
+  // Handing a small copy to the worker takes longer than the copy itself, hence
+  // it's done right away. This only saves the hop to the worker: the callback
+  // still goes through the channel's callback wrapper, which defers it to the
+  // loop, as it would if it came from the worker.
+  if (length <= kMaxInlineCopyLength) {
+    handleCopyRequest(std::move(request));
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(numRequestsInFlightMutex_);
+    numRequestsInFlight_++;
+  }
+  worker_->post([this, request{std::move(request)}]() mutable {
+    handleCopyRequest(std::move(request));
+    std::unique_lock<std::mutex> lock(numRequestsInFlightMutex_);
+    numRequestsInFlight_--;
+    numRequestsInFlightCv_.notify_all();
+  });
 }
 
-void ContextImpl::handleCopyRequests() {
-  setThreadName("TP_XTH_loop");
-  while (true) {
-    auto maybeRequest = requests_.pop();
-    if (!maybeRequest.has_value()) {
-      break;
-    }
-    CopyRequest request = std::move(maybeRequest).value();
-
-    // Don't even call memcpy on a length of 0 to avoid issues with the pointer
-    // possibly being null.
-    if (request.length > 0) {
-      // Perform copy.
-      std::memcpy(request.localPtr, request.remotePtr, request.length);
-    }
-
-    request.callback(Error::kSuccess);
+void ContextImpl::handleCopyRequest(CopyRequest request) {
+  // Don't even call memcpy on a length of 0 to avoid issues with the pointer
+  // possibly being null.
+  if (request.length > 0) {
+    // Perform copy.
+    std::memcpy(request.localPtr, request.remotePtr, request.length);
   }
+
+  request.callback(Error::kSuccess);
 }
 
 } // namespace xth
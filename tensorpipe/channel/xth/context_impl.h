@@ -9,15 +9,16 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
 #include <functional>
-#include <thread>
+#include <mutex>
 
 #include <tensorpipe/channel/context_impl_boilerplate.h>
 #include <tensorpipe/common/deferred_executor.h>
 #include <tensorpipe/common/device.h>
 #include <tensorpipe/common/error.h>
-#include <tensorpipe/common/optional.h>
-#include <tensorpipe/common/queue.h>
+#include <tensorpipe/common/loop_pool.h>
+#include <tensorpipe/common/worker_thread.h>
 
 namespace tensorpipe {
 namespace channel {
@@ -30,8 +31,12 @@ class ContextImpl final
  public:
   static std::shared_ptr<ContextImpl> create();
 
-  explicit ContextImpl(
-      std::unordered_map<Device, std::string> deviceDescriptors);
+  static std::shared_ptr<ContextImpl> create(LoopPool& loopPool);
+
+  ContextImpl(
+      std::unordered_map<Device, std::string> deviceDescriptors,
+      std::shared_ptr<WorkerThread> worker,
+      bool isWorkerShared);
 
   std::shared_ptr<Channel> createChannel(
       std::vector<std::shared_ptr<transport::Connection>> connections,
@@ -66,13 +71,19 @@ class ContextImpl final
     copy_request_callback_fn callback;
   };
 
-  std::thread thread_;
-  Queue<optional<CopyRequest>> requests_;
+  const std::shared_ptr<WorkerThread> worker_;
+
+  // A worker shared with other contexts can't be closed and joined with this
+  // one, hence we wait for the requests of this context to be done instead.
+  const bool isWorkerShared_;
+  std::mutex numRequestsInFlightMutex_;
+  std::condition_variable numRequestsInFlightCv_;
+  size_t numRequestsInFlight_{0};
 
   // This is atomic because it may be accessed from outside the loop.
   std::atomic<uint64_t> nextRequestId_{0};
 
-  void handleCopyRequests();
+  void handleCopyRequest(CopyRequest request);
 };
 
 } // namespace xth
@@ -11,6 +11,7 @@
 #include <memory>
 
 #include <tensorpipe/channel/context.h>
+#include <tensorpipe/common/loop_pool.h>
 
 namespace tensorpipe {
 namespace channel {
@@ -18,6 +19,10 @@ namespace xth {
 
 std::shared_ptr<Context> create();
 
+// Create a context that performs its copies on one of the threads of the given
+// pool, shared with other contexts, rather than on a thread of its own.
+std::shared_ptr<Context> create(LoopPool& loopPool);
+
 } // namespace xth
 } // namespace channel
 } // namespace tensorpipe
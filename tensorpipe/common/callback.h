@@ -20,6 +20,7 @@
 #include <tensorpipe/common/deferred_executor.h>
 #include <tensorpipe/common/defs.h>
 #include <tensorpipe/common/error.h>
+#include <tensorpipe/common/loop_stats.h>
 #include <tensorpipe/common/optional.h>
 
 namespace tensorpipe {
@@ -142,6 +143,7 @@ class CallbackWrapper {
       Args&&... args) {
     TP_DCHECK(loop_.inLoop());
 
+    LoopStats::HandlerScope scope(subject.id_, "callback");
     subject.setError(error);
     // Proceed regardless of any error: this is why it's called "eager".
     fn(subject, std::forward<Args>(args)...);
@@ -21,6 +21,8 @@
 #include <vector>
 
 #include <tensorpipe/common/defs.h>
+#include <tensorpipe/common/loop_stats.h>
+#include <tensorpipe/common/mutex.h>
 #include <tensorpipe/common/system.h>
 
 namespace tensorpipe {
@@ -75,6 +77,23 @@ class DeferredExecutor {
   }
 
   virtual ~DeferredExecutor() = default;
+
+ protected:
+  // When loop stats are enabled, wrap a task that is being deferred so that,
+  // once it runs, it records how long it waited in the queue and how long it
+  // took. It inherits the label of the handler that deferred it, if any.
+  static TTask wrapTaskForLoopStats(TTask fn) {
+    return [fn{std::move(fn)},
+            label{LoopStats::currentLabel()},
+            deferredAt{LoopStats::TClock::now()}]() {
+      LoopStats* stats = LoopStats::current();
+      if (stats != nullptr) {
+        stats->recordLag("deferToLoop", LoopStats::TClock::now() - deferredAt);
+      }
+      LoopStats::HandlerScope scope(label, "deferred");
+      fn();
+    };
+  }
 };
 
 // Transports typically have their own thread they can use as deferred executors
@@ -99,8 +118,12 @@ class OnDemandDeferredExecutor : public DeferredExecutor {
   }
 
   void deferToLoop(TTask fn) override {
+    if (unlikely(loopStats_.isEnabled())) {
+      fn = wrapTaskForLoopStats(std::move(fn));
+    }
+
     {
-      std::unique_lock<std::mutex> lock(mutex_);
+      std::unique_lock<Mutex> lock(mutex_);
       pendingTasks_.push_back(std::move(fn));
       if (currentLoop_ != std::thread::id()) {
         return;
@@ -108,10 +131,11 @@ class OnDemandDeferredExecutor : public DeferredExecutor {
       currentLoop_ = std::this_thread::get_id();
     }
 
+    LoopStats::Activation activation(loopStats_);
     while (true) {
       TTask task;
       {
-        std::unique_lock<std::mutex> lock(mutex_);
+        std::unique_lock<Mutex> lock(mutex_);
         if (pendingTasks_.empty()) {
           currentLoop_ = std::thread::id();
           return;
@@ -123,17 +147,26 @@ class OnDemandDeferredExecutor : public DeferredExecutor {
     }
   }
 
+  LoopStats& getLoopStats() {
+    return loopStats_;
+  }
+
  private:
-  std::mutex mutex_;
+  Mutex mutex_{"on_demand_deferred_executor"};
   std::atomic<std::thread::id> currentLoop_{std::thread::id()};
   std::deque<TTask> pendingTasks_;
+  LoopStats loopStats_{"on_demand"};
 };
 
 class EventLoopDeferredExecutor : public virtual DeferredExecutor {
  public:
   void deferToLoop(TTask fn) override {
+    if (unlikely(loopStats_.isEnabled())) {
+      fn = wrapTaskForLoopStats(std::move(fn));
+    }
+
     {
-      std::unique_lock<std::mutex> lock(mutex_);
+      std::unique_lock<Mutex> lock(mutex_);
       if (likely(isThreadConsumingDeferredFunctions_)) {
         fns_.push_back(std::move(fn));
         wakeupEventLoopToDeferFunction();
@@ -147,7 +180,7 @@ class EventLoopDeferredExecutor : public virtual DeferredExecutor {
 
   inline bool inLoop() const override {
     {
-      std::unique_lock<std::mutex> lock(mutex_);
+      std::unique_lock<Mutex> lock(mutex_);
       if (likely(isThreadConsumingDeferredFunctions_)) {
         return std::this_thread::get_id() == thread_.get_id();
       }
@@ -155,6 +188,12 @@ class EventLoopDeferredExecutor : public virtual DeferredExecutor {
     return onDemandLoop_.inLoop();
   }
 
+  // The stats of the event loop. Those of the on-demand loop that takes over
+  // once the event loop has terminated are kept separately.
+  LoopStats& getLoopStats() {
+    return loopStats_;
+  }
+
  protected:
   // This is the actual long-running event loop, which is implemented by
   // subclasses and called inside the thread owned by this parent class.
@@ -185,12 +224,13 @@ class EventLoopDeferredExecutor : public virtual DeferredExecutor {
     // isThreadConsumingDeferredFunctions_ branch the thread is joinable, i.e.,
     // up and still running.
     {
-      std::unique_lock<std::mutex> lock(mutex_);
+      std::unique_lock<Mutex> lock(mutex_);
       TP_DCHECK(!isThreadConsumingDeferredFunctions_);
       TP_DCHECK(!thread_.joinable());
       TP_DCHECK(fns_.empty());
       isThreadConsumingDeferredFunctions_ = true;
     }
+    loopStats_.setName(threadName);
     thread_ = std::thread(
         &EventLoopDeferredExecutor::loop, this, std::move(threadName));
   }
@@ -212,7 +252,7 @@ class EventLoopDeferredExecutor : public virtual DeferredExecutor {
     decltype(fns_) fns;
 
     {
-      std::unique_lock<std::mutex> lock(mutex_);
+      std::unique_lock<Mutex> lock(mutex_);
       std::swap(fns, fns_);
     }
 
@@ -227,6 +267,8 @@ class EventLoopDeferredExecutor : public virtual DeferredExecutor {
   void loop(std::string threadName) {
     setThreadName(std::move(threadName));
 
+    LoopStats::Activation activation(loopStats_);
+
     eventLoop();
 
     // The loop is winding down and "handing over" control to the on demand
@@ -236,7 +278,7 @@ class EventLoopDeferredExecutor : public virtual DeferredExecutor {
       decltype(fns_) fns;
 
       {
-        std::unique_lock<std::mutex> lock(mutex_);
+        std::unique_lock<Mutex> lock(mutex_);
         if (fns_.empty()) {
           isThreadConsumingDeferredFunctions_ = false;
           break;
@@ -271,10 +313,12 @@ class EventLoopDeferredExecutor : public virtual DeferredExecutor {
   OnDemandDeferredExecutor onDemandLoop_;
 
   // Mutex to guard the deferring and the running of functions.
-  mutable std::mutex mutex_;
+  mutable Mutex mutex_{"event_loop_deferred_executor"};
 
   // List of deferred functions to run when the loop is ready.
   std::vector<std::function<void()>> fns_;
+
+  LoopStats loopStats_;
 };
 
 } // namespace tensorpipe
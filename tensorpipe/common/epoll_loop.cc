@@ -10,11 +10,14 @@
 
 #include <sys/eventfd.h>
 
+#include <array>
+
+#include <tensorpipe/common/loop_stats.h>
 #include <tensorpipe/common/system.h>
 
 namespace tensorpipe {
 
-EpollLoop::EpollLoop(DeferredExecutor& deferredExecutor)
+EpollLoop::EpollLoop(DeferredExecutor& deferredExecutor, bool runOwnThread)
     : deferredExecutor_(deferredExecutor) {
   {
     auto rv = ::epoll_create(1);
@@ -37,7 +40,9 @@ EpollLoop::EpollLoop(DeferredExecutor& deferredExecutor)
   }
 
   // Start epoll(2) thread.
-  thread_ = std::thread(&EpollLoop::loop, this);
+  if (runOwnThread) {
+    thread_ = std::thread(&EpollLoop::loop, this);
+  }
 }
 
 void EpollLoop::close() {
@@ -49,7 +54,7 @@ void EpollLoop::close() {
 void EpollLoop::join() {
   close();
 
-  if (!joined_.exchange(true)) {
+  if (!joined_.exchange(true) && thread_.joinable()) {
     thread_.join();
   }
 }
@@ -70,7 +75,7 @@ void EpollLoop::registerDescriptor(
     std::shared_ptr<EventHandler> h) {
   TP_DCHECK(deferredExecutor_.inLoop());
 
-  std::lock_guard<std::mutex> lock(handlersMutex_);
+  std::lock_guard<Mutex> lock(handlersMutex_);
 
   uint64_t record = nextRecord_++;
 
@@ -99,7 +104,7 @@ void EpollLoop::registerDescriptor(
 void EpollLoop::unregisterDescriptor(int fd) {
   TP_DCHECK(deferredExecutor_.inLoop());
 
-  std::lock_guard<std::mutex> lock(handlersMutex_);
+  std::lock_guard<Mutex> lock(handlersMutex_);
 
   auto fdIter = fdToRecord_.find(fd);
   TP_DCHECK(fdIter != fdToRecord_.end());
@@ -123,7 +128,7 @@ void EpollLoop::wakeup() {
 }
 
 bool EpollLoop::hasRegisteredHandlers() {
-  std::lock_guard<std::mutex> lock(handlersMutex_);
+  std::lock_guard<Mutex> lock(handlersMutex_);
   TP_DCHECK_EQ(fdToRecord_.size(), recordToHandler_.size());
   return !fdToRecord_.empty();
 }
@@ -146,34 +151,71 @@ void EpollLoop::loop() {
       }
       TP_THROW_SYSTEM(errno);
     }
+    const auto readyAt = LoopStats::TClock::now();
 
-    // Always immediately read from the eventfd so that it is no longer readable
-    // on the next call to epoll_wait(2). As it's opened in non-blocking mode,
-    // reading from it if its value is zero just return EAGAIN. Reset it before
-    // invoking any of the callbacks, so that if they perform a wakeup they will
-    // wake up the next iteration of epoll_wait(2).
-    {
-      uint64_t val;
-      auto rv = eventFd_.read(reinterpret_cast<void*>(&val), sizeof(val));
-      TP_DCHECK(
-          (rv == -1 && errno == EAGAIN) || (rv == sizeof(val) && val > 0));
-    }
+    drainEventFd();
 
     // Resize based on actual number of events.
     epollEvents.resize(nfds);
 
     // Defer handling to reactor and wait for it to process these events.
     deferredExecutor_.runInLoop(
-        [this, epollEvents{std::move(epollEvents)}]() mutable {
-          handleEpollEventsFromLoop(std::move(epollEvents));
+        [this, epollEvents{std::move(epollEvents)}, readyAt]() {
+          handleEpollEventsFromLoop(epollEvents, readyAt);
         });
   }
 }
 
+bool EpollLoop::pollFromLoop() {
+  TP_DCHECK(!thread_.joinable());
+  TP_DCHECK(deferredExecutor_.inLoop());
+
+  // This is called at every idle iteration of a busy-polling loop, hence avoid
+  // allocating unless there are events.
+  std::array<struct epoll_event, kCapacity> epollEvents;
+  auto nfds =
+      ::epoll_wait(epollFd_.fd(), epollEvents.data(), epollEvents.size(), 0);
+  if (nfds == -1) {
+    if (errno == EINTR) {
+      return false;
+    }
+    TP_THROW_SYSTEM(errno);
+  }
+  if (nfds == 0) {
+    return false;
+  }
+  const auto readyAt = LoopStats::TClock::now();
+
+  drainEventFd();
+
+  handleEpollEventsFromLoop(
+      std::vector<struct epoll_event>(
+          epollEvents.begin(), epollEvents.begin() + nfds),
+      readyAt);
+  return true;
+}
+
+void EpollLoop::drainEventFd() {
+  // Always immediately read from the eventfd so that it is no longer readable
+  // on the next call to epoll_wait(2). As it's opened in non-blocking mode,
+  // reading from it if its value is zero just return EAGAIN. Reset it before
+  // invoking any of the callbacks, so that if they perform a wakeup they will
+  // wake up the next iteration of epoll_wait(2).
+  uint64_t val;
+  auto rv = eventFd_.read(reinterpret_cast<void*>(&val), sizeof(val));
+  TP_DCHECK((rv == -1 && errno == EAGAIN) || (rv == sizeof(val) && val > 0));
+}
+
 void EpollLoop::handleEpollEventsFromLoop(
-    std::vector<struct epoll_event> epollEvents) {
+    const std::vector<struct epoll_event>& epollEvents,
+    LoopStats::TClock::time_point readyAt) {
   TP_DCHECK(deferredExecutor_.inLoop());
 
+  LoopStats* stats = LoopStats::current();
+  if (stats != nullptr) {
+    stats->recordLag("epoll", LoopStats::TClock::now() - readyAt);
+  }
+
   // Process events returned by epoll_wait(2).
   for (const auto& event : epollEvents) {
     const uint64_t record = event.data.u64;
@@ -182,7 +224,7 @@ void EpollLoop::handleEpollEventsFromLoop(
     // still be kept alive by our copy of the shared_ptr.
     std::shared_ptr<EventHandler> handler;
     {
-      std::unique_lock<std::mutex> handlersLock(handlersMutex_);
+      std::unique_lock<Mutex> handlersLock(handlersMutex_);
       const auto recordIter = recordToHandler_.find(record);
       if (recordIter == recordToHandler_.end()) {
         continue;
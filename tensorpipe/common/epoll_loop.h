@@ -20,6 +20,8 @@
 
 #include <tensorpipe/common/deferred_executor.h>
 #include <tensorpipe/common/fd.h>
+#include <tensorpipe/common/loop_stats.h>
+#include <tensorpipe/common/mutex.h>
 
 namespace tensorpipe {
 
@@ -37,7 +39,12 @@ class EpollLoop final {
     virtual void handleEventsFromLoop(int events) = 0;
   };
 
-  explicit EpollLoop(DeferredExecutor& deferredExecutor);
+  // By default the loop starts a thread of its own to wait for events. When
+  // told not to, the owner of the deferred executor must instead poll it from
+  // its loop (see pollFromLoop), which saves a thread and a handoff per event.
+  explicit EpollLoop(
+      DeferredExecutor& deferredExecutor,
+      bool runOwnThread = true);
 
   // Register file descriptor with event loop.
   //
@@ -60,9 +67,18 @@ class EpollLoop final {
   //
   void unregisterDescriptor(int fd);
 
+  // Check for events without blocking and, if there are any, run their
+  // handlers inline. Only for loops that don't run their own thread. Returns
+  // whether any handler was run.
+  bool pollFromLoop();
+
+  // Check whether some handlers are currently registered.
+  bool hasRegisteredHandlers();
+
   void close();
 
-  // Tell loop to terminate when no more handlers remain.
+  // Tell loop to terminate when no more handlers remain. For loops that don't
+  // run their own thread, that's up to whoever polls them.
   void join();
 
   ~EpollLoop();
@@ -81,8 +97,8 @@ class EpollLoop final {
   // Main loop function.
   void loop();
 
-  // Check whether some handlers are currently registered.
-  bool hasRegisteredHandlers();
+  // Reset the eventfd after epoll_wait(2) returned.
+  void drainEventFd();
 
   Fd epollFd_;
   Fd eventFd_;
@@ -131,10 +147,13 @@ class EpollLoop final {
   std::unordered_map<int, uint64_t> fdToRecord_;
   std::unordered_map<uint64_t, std::shared_ptr<EventHandler>> recordToHandler_;
   uint64_t nextRecord_{1}; // Reserve record 0 for the eventfd
-  std::mutex handlersMutex_;
+  Mutex handlersMutex_{"epoll_loop_handlers"};
 
   // Deferred to the reactor to handle the events received by epoll_wait(2).
-  void handleEpollEventsFromLoop(std::vector<struct epoll_event> epollEvents);
+  // The time at which epoll_wait(2) returned is used to measure the loop lag.
+  void handleEpollEventsFromLoop(
+      const std::vector<struct epoll_event>& epollEvents,
+      LoopStats::TClock::time_point readyAt);
 };
 
 } // namespace tensorpipe
@@ -622,6 +622,9 @@ class IbvLib {
   TP_FORALL_IBV_SYMBOLS(TP_DECLARE_FIELD)
 #undef TP_DECLARE_FIELD
 
+  // The software emulation fills in the function pointers with its own ones.
+  friend IbvLib createLoopbackIbvLib();
+
  public:
   IbvLib() = default;
 
@@ -0,0 +1,706 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <tensorpipe/common/ibv_loopback.h>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <tensorpipe/common/defs.h>
+#include <tensorpipe/common/fd.h>
+
+namespace tensorpipe {
+
+namespace {
+
+// The emulated objects embed the "public" struct that is handed out to the
+// users as their first member, so that we can go from one to the other.
+
+constexpr uint64_t kLoopbackSubnetPrefix = 0x7470696276000000; // "tpibv"
+constexpr uint8_t kLoopbackPortNum = 1;
+constexpr int kSendSignaled = 1 << 1; // IBV_SEND_SIGNALED
+constexpr int kSocketBufferSize = 4 * 1024 * 1024;
+
+std::atomic<uint32_t> contextCounter{0};
+
+// What gets sent to the peer's context to notify it of an incoming operation.
+struct Packet {
+  uint32_t destQpn;
+  uint32_t srcQpn;
+  IbvLib::wc_opcode opcode;
+  uint32_t immData;
+  uint32_t byteLen;
+};
+
+struct RecvQueue {
+  std::deque<uint64_t> wrIds;
+};
+
+struct LoopbackCq {
+  IbvLib::cq base;
+  std::deque<IbvLib::wc> completions;
+};
+
+struct LoopbackSrq {
+  IbvLib::srq base;
+  RecvQueue recvQueue;
+};
+
+struct LoopbackQp {
+  IbvLib::qp base;
+  bool sqSigAll;
+  IbvLib::gid destGid;
+  uint32_t destQpn;
+  RecvQueue recvQueue;
+};
+
+struct LoopbackPd {
+  IbvLib::pd base;
+};
+
+struct LoopbackMr {
+  IbvLib::mr base;
+};
+
+// A packet that is waiting to be accepted by the peer's socket, together with
+// the completion to produce for the sender once it is.
+struct OutgoingPacket {
+  LoopbackQp* qp;
+  IbvLib::gid destGid;
+  Packet packet;
+  IbvLib::wc completion;
+  bool signaled;
+};
+
+struct LoopbackContext {
+  IbvLib::context base;
+  uint32_t index;
+  Fd socket;
+  std::mutex mutex;
+  uint32_t nextQpn{1};
+  uint32_t nextKey{1};
+  std::unordered_map<uint32_t, LoopbackQp*> qps;
+  std::deque<OutgoingPacket> outgoingPackets;
+  std::deque<Packet> incomingPackets;
+};
+
+LoopbackContext* toLoopback(IbvLib::context* ctx) {
+  return reinterpret_cast<LoopbackContext*>(ctx);
+}
+
+LoopbackCq* toLoopback(IbvLib::cq* cq) {
+  return reinterpret_cast<LoopbackCq*>(cq);
+}
+
+LoopbackSrq* toLoopback(IbvLib::srq* srq) {
+  return reinterpret_cast<LoopbackSrq*>(srq);
+}
+
+LoopbackQp* toLoopback(IbvLib::qp* qp) {
+  return reinterpret_cast<LoopbackQp*>(qp);
+}
+
+IbvLib::gid makeGid(pid_t pid, uint32_t index) {
+  IbvLib::gid gid;
+  gid.global.subnet_prefix = kLoopbackSubnetPrefix;
+  gid.global.interface_id = (static_cast<uint64_t>(pid) << 32) | index;
+  return gid;
+}
+
+pid_t pidFromGid(const IbvLib::gid& gid) {
+  return static_cast<pid_t>(gid.global.interface_id >> 32);
+}
+
+socklen_t makeSocketAddress(const IbvLib::gid& gid, struct sockaddr_un& addr) {
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  // Use the abstract namespace, so that no file is left behind.
+  int len = std::snprintf(
+      &addr.sun_path[1],
+      sizeof(addr.sun_path) - 1,
+      "tensorpipe_ibv_loopback_%d_%u",
+      pidFromGid(gid),
+      static_cast<uint32_t>(gid.global.interface_id & 0xffffffff));
+  return offsetof(struct sockaddr_un, sun_path) + 1 + len;
+}
+
+bool writeToPeer(
+    pid_t pid,
+    uint64_t remoteAddr,
+    const IbvLib::sge* sgList,
+    int numSge) {
+  for (int sgeIdx = 0; sgeIdx < numSge; sgeIdx++) {
+    const IbvLib::sge& sge = sgList[sgeIdx];
+    if (pid == ::getpid()) {
+      std::memcpy(
+          reinterpret_cast<void*>(remoteAddr),
+          reinterpret_cast<const void*>(sge.addr),
+          sge.length);
+    } else {
+      struct iovec local {
+        reinterpret_cast<void*>(sge.addr), sge.length
+      };
+      struct iovec remote {
+        reinterpret_cast<void*>(remoteAddr), sge.length
+      };
+      ssize_t rv = ::process_vm_writev(pid, &local, 1, &remote, 1, 0);
+      if (rv != static_cast<ssize_t>(sge.length)) {
+        return false;
+      }
+    }
+    remoteAddr += sge.length;
+  }
+  return true;
+}
+
+IbvLib::wc makeCompletion(
+    uint64_t wrId,
+    IbvLib::wc_status status,
+    IbvLib::wc_opcode opcode,
+    uint32_t qpNum) {
+  IbvLib::wc wc;
+  std::memset(&wc, 0, sizeof(wc));
+  wc.wr_id = wrId;
+  wc.status = status;
+  wc.opcode = opcode;
+  wc.qp_num = qpNum;
+  return wc;
+}
+
+void completeSend(OutgoingPacket& outgoing, IbvLib::wc_status status) {
+  if (status != IbvLib::WC_SUCCESS) {
+    outgoing.completion.status = status;
+    outgoing.qp->base.state = IbvLib::QPS_ERR;
+  }
+  // Failed work requests always generate a completion.
+  if (outgoing.signaled || status != IbvLib::WC_SUCCESS) {
+    toLoopback(outgoing.qp->base.send_cq)
+        ->completions.push_back(outgoing.completion);
+  }
+}
+
+// Try to hand over the queued packets to the sockets of their destinations, in
+// order, stopping at the first one that would block. Must hold the lock.
+void flushOutgoingPackets(LoopbackContext& ctx) {
+  while (!ctx.outgoingPackets.empty()) {
+    OutgoingPacket& outgoing = ctx.outgoingPackets.front();
+    struct sockaddr_un addr;
+    socklen_t addrLen = makeSocketAddress(outgoing.destGid, addr);
+    ssize_t rv = ::sendto(
+        ctx.socket.fd(),
+        &outgoing.packet,
+        sizeof(outgoing.packet),
+        MSG_DONTWAIT,
+        reinterpret_cast<struct sockaddr*>(&addr),
+        addrLen);
+    if (rv < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return;
+    }
+    // A peer that went away is akin to a remote that doesn't respond anymore.
+    completeSend(
+        outgoing,
+        rv == sizeof(outgoing.packet) ? IbvLib::WC_SUCCESS
+                                      : IbvLib::WC_RETRY_EXC_ERR);
+    ctx.outgoingPackets.pop_front();
+  }
+}
+
+// Retrieve the packets that peers sent us and turn them into work completions
+// as long as there are receive requests to match them. Must hold the lock.
+void processIncomingPackets(LoopbackContext& ctx) {
+  while (true) {
+    Packet packet;
+    ssize_t rv =
+        ::recv(ctx.socket.fd(), &packet, sizeof(packet), MSG_DONTWAIT);
+    if (rv < 0) {
+      TP_THROW_SYSTEM_IF(errno != EAGAIN && errno != EWOULDBLOCK, errno);
+      break;
+    }
+    TP_THROW_ASSERT_IF(rv != sizeof(packet));
+    ctx.incomingPackets.push_back(packet);
+  }
+
+  // Packets that can't be delivered yet are held back, as a real device would
+  // have the sender retry them. This happens when the queue pair hasn't been
+  // made ready to receive yet (its peer may get there before it does) or when
+  // no receive request is available. Later packets for the same queue pair must
+  // then be held back too, in order to preserve ordering.
+  std::unordered_set<uint32_t> blockedQpns;
+  for (auto packetIter = ctx.incomingPackets.begin();
+       packetIter != ctx.incomingPackets.end();) {
+    const Packet& packet = *packetIter;
+    auto qpIter = ctx.qps.find(packet.destQpn);
+    if (qpIter == ctx.qps.end() ||
+        qpIter->second->base.state == IbvLib::QPS_ERR) {
+      // Silently drop what is addressed to queue pairs that can't receive.
+      packetIter = ctx.incomingPackets.erase(packetIter);
+      continue;
+    }
+    LoopbackQp& qp = *qpIter->second;
+    RecvQueue& recvQueue = qp.base.srq != nullptr
+        ? toLoopback(qp.base.srq)->recvQueue
+        : qp.recvQueue;
+    if (blockedQpns.count(packet.destQpn) > 0 ||
+        (qp.base.state != IbvLib::QPS_RTR &&
+         qp.base.state != IbvLib::QPS_RTS) ||
+        recvQueue.wrIds.empty()) {
+      blockedQpns.insert(packet.destQpn);
+      ++packetIter;
+      continue;
+    }
+    IbvLib::wc wc = makeCompletion(
+        recvQueue.wrIds.front(),
+        IbvLib::WC_SUCCESS,
+        packet.opcode,
+        packet.destQpn);
+    recvQueue.wrIds.pop_front();
+    wc.byte_len = packet.byteLen;
+    wc.imm_data = packet.immData;
+    wc.wc_flags = IbvLib::WC_WITH_IMM;
+    wc.src_qp = packet.srcQpn;
+    toLoopback(qp.base.recv_cq)->completions.push_back(wc);
+    packetIter = ctx.incomingPackets.erase(packetIter);
+  }
+}
+
+// Fast-path operations, normally provided by the driver through the context.
+
+int loopbackPollCq(IbvLib::cq* cq, int numEntries, IbvLib::wc* wc) {
+  LoopbackContext& ctx = *toLoopback(cq->context);
+  LoopbackCq& loopbackCq = *toLoopback(cq);
+  std::unique_lock<std::mutex> lock(ctx.mutex);
+  flushOutgoingPackets(ctx);
+  processIncomingPackets(ctx);
+  int numPolled = 0;
+  while (numPolled < numEntries && !loopbackCq.completions.empty()) {
+    wc[numPolled] = loopbackCq.completions.front();
+    loopbackCq.completions.pop_front();
+    numPolled++;
+  }
+  return numPolled;
+}
+
+int loopbackPostSend(
+    IbvLib::qp* qp,
+    IbvLib::send_wr* wr,
+    IbvLib::send_wr** badWr) {
+  LoopbackContext& ctx = *toLoopback(qp->context);
+  LoopbackQp& loopbackQp = *toLoopback(qp);
+  std::unique_lock<std::mutex> lock(ctx.mutex);
+  for (; wr != nullptr; wr = wr->next) {
+    OutgoingPacket outgoing;
+    outgoing.qp = &loopbackQp;
+    outgoing.destGid = loopbackQp.destGid;
+    outgoing.signaled = loopbackQp.sqSigAll || (wr->send_flags & kSendSignaled);
+
+    uint32_t length = 0;
+    for (int sgeIdx = 0; sgeIdx < wr->num_sge; sgeIdx++) {
+      length += wr->sg_list[sgeIdx].length;
+    }
+
+    bool hasImm;
+    IbvLib::wc_opcode localOpcode;
+    IbvLib::wc_opcode remoteOpcode;
+    switch (wr->opcode) {
+      case IbvLib::WR_RDMA_WRITE:
+      case IbvLib::WR_RDMA_WRITE_WITH_IMM:
+        hasImm = wr->opcode == IbvLib::WR_RDMA_WRITE_WITH_IMM;
+        localOpcode = IbvLib::WC_RDMA_WRITE;
+        remoteOpcode = IbvLib::WC_RECV_RDMA_WITH_IMM;
+        break;
+      case IbvLib::WR_SEND:
+      case IbvLib::WR_SEND_WITH_IMM:
+        if (length > 0) {
+          *badWr = wr;
+          return ENOTSUP;
+        }
+        hasImm = true;
+        localOpcode = IbvLib::WC_SEND;
+        remoteOpcode = IbvLib::WC_RECV;
+        break;
+      default:
+        *badWr = wr;
+        return ENOTSUP;
+    }
+    outgoing.completion =
+        makeCompletion(wr->wr_id, IbvLib::WC_SUCCESS, localOpcode, qp->qp_num);
+    outgoing.completion.byte_len = length;
+
+    if (qp->state == IbvLib::QPS_ERR) {
+      completeSend(outgoing, IbvLib::WC_WR_FLUSH_ERR);
+      continue;
+    }
+    if (qp->state != IbvLib::QPS_RTS) {
+      *badWr = wr;
+      return EINVAL;
+    }
+
+    if (localOpcode == IbvLib::WC_RDMA_WRITE &&
+        !writeToPeer(
+            pidFromGid(loopbackQp.destGid),
+            wr->wr.rdma.remote_addr,
+            wr->sg_list,
+            wr->num_sge)) {
+      completeSend(outgoing, IbvLib::WC_REM_ACCESS_ERR);
+      continue;
+    }
+
+    if (!hasImm) {
+      // Plain RDMA writes are invisible to the remote side.
+      completeSend(outgoing, IbvLib::WC_SUCCESS);
+      continue;
+    }
+
+    outgoing.packet.destQpn = loopbackQp.destQpn;
+    outgoing.packet.srcQpn = qp->qp_num;
+    outgoing.packet.opcode = remoteOpcode;
+    outgoing.packet.immData = wr->imm_data;
+    outgoing.packet.byteLen = length;
+    ctx.outgoingPackets.push_back(outgoing);
+  }
+  flushOutgoingPackets(ctx);
+  return 0;
+}
+
+int postRecvOnQueue(
+    LoopbackContext& ctx,
+    RecvQueue& recvQueue,
+    IbvLib::recv_wr* wr) {
+  std::unique_lock<std::mutex> lock(ctx.mutex);
+  for (; wr != nullptr; wr = wr->next) {
+    recvQueue.wrIds.push_back(wr->wr_id);
+  }
+  return 0;
+}
+
+int loopbackPostRecv(
+    IbvLib::qp* qp,
+    IbvLib::recv_wr* wr,
+    IbvLib::recv_wr** /* unused */) {
+  return postRecvOnQueue(
+      *toLoopback(qp->context), toLoopback(qp)->recvQueue, wr);
+}
+
+int loopbackPostSrqRecv(
+    IbvLib::srq* srq,
+    IbvLib::recv_wr* wr,
+    IbvLib::recv_wr** /* unused */) {
+  return postRecvOnQueue(
+      *toLoopback(srq->context), toLoopback(srq)->recvQueue, wr);
+}
+
+// Control-path functions, normally exported by libibverbs.
+
+IbvLib::device** loopbackGetDeviceList(int* numDevices) {
+  static IbvLib::device device = []() {
+    IbvLib::device device;
+    std::memset(&device, 0, sizeof(device));
+    device.node_type = IbvLib::NODE_CA;
+    device.transport_type = IbvLib::TRANSPORT_IB;
+    std::strncpy(device.name, "loopback", sizeof(device.name) - 1);
+    std::strncpy(device.dev_name, "loopback", sizeof(device.dev_name) - 1);
+    return device;
+  }();
+  IbvLib::device** list = new IbvLib::device*[2];
+  list[0] = &device;
+  list[1] = nullptr;
+  if (numDevices != nullptr) {
+    *numDevices = 1;
+  }
+  return list;
+}
+
+void loopbackFreeDeviceList(IbvLib::device** list) {
+  delete[] list;
+}
+
+const char* loopbackGetDeviceName(IbvLib::device* device) {
+  return device->name;
+}
+
+IbvLib::context* loopbackOpenDevice(IbvLib::device* device) {
+  auto ctx = std::make_unique<LoopbackContext>();
+  std::memset(&ctx->base, 0, sizeof(ctx->base));
+  ctx->base.device = device;
+  ctx->base.ops.poll_cq = loopbackPollCq;
+  ctx->base.ops.post_send = loopbackPostSend;
+  ctx->base.ops.post_recv = loopbackPostRecv;
+  ctx->base.ops.post_srq_recv = loopbackPostSrqRecv;
+  ctx->base.cmd_fd = -1;
+  ctx->base.async_fd = -1;
+  ctx->index = contextCounter++;
+
+  int fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return nullptr;
+  }
+  ctx->socket = Fd(fd);
+  // Make room for many in-flight notifications, although running out of space
+  // isn't fatal as senders will just retry.
+  ::setsockopt(
+      fd, SOL_SOCKET, SO_RCVBUF, &kSocketBufferSize, sizeof(kSocketBufferSize));
+  ::setsockopt(
+      fd, SOL_SOCKET, SO_SNDBUF, &kSocketBufferSize, sizeof(kSocketBufferSize));
+
+  struct sockaddr_un addr;
+  socklen_t addrLen = makeSocketAddress(makeGid(::getpid(), ctx->index), addr);
+  if (::bind(fd, reinterpret_cast<struct sockaddr*>(&addr), addrLen) < 0) {
+    return nullptr;
+  }
+
+  return &ctx.release()->base;
+}
+
+int loopbackCloseDevice(IbvLib::context* ctx) {
+  delete toLoopback(ctx);
+  return 0;
+}
+
+int loopbackQueryPort(
+    IbvLib::context* /* unused */,
+    uint8_t portNum,
+    IbvLib::port_attr* attr) {
+  if (portNum != kLoopbackPortNum) {
+    errno = EINVAL;
+    return -1;
+  }
+  std::memset(attr, 0, sizeof(*attr));
+  attr->state = IbvLib::PORT_ACTIVE;
+  attr->max_mtu = IbvLib::MTU_4096;
+  attr->active_mtu = IbvLib::MTU_4096;
+  attr->gid_tbl_len = 1;
+  attr->max_msg_sz = 1U << 31;
+  // A LID of zero makes the users resort to GIDs, as with RoCE.
+  attr->lid = 0;
+  return 0;
+}
+
+int loopbackQueryGid(
+    IbvLib::context* ctx,
+    uint8_t portNum,
+    int index,
+    IbvLib::gid* gid) {
+  if (portNum != kLoopbackPortNum || index != 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  *gid = makeGid(::getpid(), toLoopback(ctx)->index);
+  return 0;
+}
+
+IbvLib::pd* loopbackAllocPd(IbvLib::context* ctx) {
+  LoopbackPd* pd = new LoopbackPd();
+  pd->base.context = ctx;
+  return &pd->base;
+}
+
+int loopbackDeallocPd(IbvLib::pd* pd) {
+  delete reinterpret_cast<LoopbackPd*>(pd);
+  return 0;
+}
+
+IbvLib::mr* loopbackRegMr(
+    IbvLib::pd* pd,
+    void* addr,
+    size_t length,
+    int /* unused */) {
+  LoopbackContext& ctx = *toLoopback(pd->context);
+  LoopbackMr* mr = new LoopbackMr();
+  mr->base.context = pd->context;
+  mr->base.pd = pd;
+  mr->base.addr = addr;
+  mr->base.length = length;
+  std::unique_lock<std::mutex> lock(ctx.mutex);
+  mr->base.handle = ctx.nextKey;
+  mr->base.lkey = ctx.nextKey;
+  mr->base.rkey = ctx.nextKey;
+  ctx.nextKey++;
+  return &mr->base;
+}
+
+int loopbackDeregMr(IbvLib::mr* mr) {
+  delete reinterpret_cast<LoopbackMr*>(mr);
+  return 0;
+}
+
+IbvLib::cq* loopbackCreateCq(
+    IbvLib::context* ctx,
+    int cqe,
+    void* cqContext,
+    IbvLib::comp_channel* channel,
+    int /* unused */) {
+  if (channel != nullptr) {
+    // Completion channels (i.e., event-driven polling) aren't supported.
+    errno = ENOTSUP;
+    return nullptr;
+  }
+  LoopbackCq* cq = new LoopbackCq();
+  cq->base.context = ctx;
+  cq->base.cq_context = cqContext;
+  cq->base.cqe = cqe;
+  return &cq->base;
+}
+
+int loopbackDestroyCq(IbvLib::cq* cq) {
+  delete toLoopback(cq);
+  return 0;
+}
+
+IbvLib::srq* loopbackCreateSrq(
+    IbvLib::pd* pd,
+    IbvLib::srq_init_attr* initAttr) {
+  LoopbackSrq* srq = new LoopbackSrq();
+  srq->base.context = pd->context;
+  srq->base.srq_context = initAttr->srq_context;
+  srq->base.pd = pd;
+  return &srq->base;
+}
+
+int loopbackDestroySrq(IbvLib::srq* srq) {
+  delete toLoopback(srq);
+  return 0;
+}
+
+IbvLib::qp* loopbackCreateQp(IbvLib::pd* pd, IbvLib::qp_init_attr* initAttr) {
+  if (initAttr->qp_type != IbvLib::QPT_RC) {
+    errno = ENOTSUP;
+    return nullptr;
+  }
+  LoopbackContext& ctx = *toLoopback(pd->context);
+  LoopbackQp* qp = new LoopbackQp();
+  qp->base.context = pd->context;
+  qp->base.qp_context = initAttr->qp_context;
+  qp->base.pd = pd;
+  qp->base.send_cq = initAttr->send_cq;
+  qp->base.recv_cq = initAttr->recv_cq;
+  qp->base.srq = initAttr->srq;
+  qp->base.state = IbvLib::QPS_RESET;
+  qp->base.qp_type = initAttr->qp_type;
+  qp->sqSigAll = initAttr->sq_sig_all != 0;
+  std::unique_lock<std::mutex> lock(ctx.mutex);
+  qp->base.qp_num = ctx.nextQpn++;
+  qp->base.handle = qp->base.qp_num;
+  ctx.qps.emplace(qp->base.qp_num, qp);
+  return &qp->base;
+}
+
+int loopbackModifyQp(IbvLib::qp* qp, IbvLib::qp_attr* attr, int attrMask) {
+  LoopbackContext& ctx = *toLoopback(qp->context);
+  LoopbackQp& loopbackQp = *toLoopback(qp);
+  std::unique_lock<std::mutex> lock(ctx.mutex);
+  if (attrMask & IbvLib::QP_AV) {
+    if (!attr->ah_attr.is_global ||
+        attr->ah_attr.grh.dgid.global.subnet_prefix != kLoopbackSubnetPrefix) {
+      // Only peers of the loopback provider can be reached.
+      errno = EINVAL;
+      return -1;
+    }
+    loopbackQp.destGid = attr->ah_attr.grh.dgid;
+  }
+  if (attrMask & IbvLib::QP_DEST_QPN) {
+    loopbackQp.destQpn = attr->dest_qp_num;
+  }
+  if (attrMask & IbvLib::QP_STATE) {
+    qp->state = attr->qp_state;
+  }
+  return 0;
+}
+
+int loopbackDestroyQp(IbvLib::qp* qp) {
+  LoopbackContext& ctx = *toLoopback(qp->context);
+  LoopbackQp* loopbackQp = toLoopback(qp);
+  {
+    std::unique_lock<std::mutex> lock(ctx.mutex);
+    ctx.qps.erase(qp->qp_num);
+    for (auto iter = ctx.outgoingPackets.begin();
+         iter != ctx.outgoingPackets.end();) {
+      if (iter->qp == loopbackQp) {
+        iter = ctx.outgoingPackets.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+  }
+  delete loopbackQp;
+  return 0;
+}
+
+int loopbackGetAsyncEvent(
+    IbvLib::context* /* unused */,
+    IbvLib::async_event* /* unused */) {
+  errno = ENOTSUP;
+  return -1;
+}
+
+void loopbackAckAsyncEvent(IbvLib::async_event* /* unused */) {}
+
+const char* loopbackEventTypeStr(IbvLib::event_type /* unused */) {
+  return "unknown event (loopback provider)";
+}
+
+const char* loopbackWcStatusStr(IbvLib::wc_status status) {
+  switch (status) {
+    case IbvLib::WC_SUCCESS:
+      return "success";
+    case IbvLib::WC_WR_FLUSH_ERR:
+      return "Work Request Flushed Error";
+    case IbvLib::WC_REM_ACCESS_ERR:
+      return "remote access error";
+    case IbvLib::WC_RETRY_EXC_ERR:
+      return "transport retry counter exceeded";
+    default:
+      return "unknown";
+  }
+}
+
+} // namespace
+
+IbvLib createLoopbackIbvLib() {
+  IbvLib lib;
+#define TP_SET_LOOPBACK_SYMBOL(function_name, loopback_function) \
+  lib.function_name##_ptr_ = loopback_function;
+  TP_SET_LOOPBACK_SYMBOL(ack_async_event, loopbackAckAsyncEvent);
+  TP_SET_LOOPBACK_SYMBOL(alloc_pd, loopbackAllocPd);
+  TP_SET_LOOPBACK_SYMBOL(close_device, loopbackCloseDevice);
+  TP_SET_LOOPBACK_SYMBOL(create_cq, loopbackCreateCq);
+  TP_SET_LOOPBACK_SYMBOL(create_qp, loopbackCreateQp);
+  TP_SET_LOOPBACK_SYMBOL(create_srq, loopbackCreateSrq);
+  TP_SET_LOOPBACK_SYMBOL(dealloc_pd, loopbackDeallocPd);
+  TP_SET_LOOPBACK_SYMBOL(dereg_mr, loopbackDeregMr);
+  TP_SET_LOOPBACK_SYMBOL(destroy_cq, loopbackDestroyCq);
+  TP_SET_LOOPBACK_SYMBOL(destroy_qp, loopbackDestroyQp);
+  TP_SET_LOOPBACK_SYMBOL(destroy_srq, loopbackDestroySrq);
+  TP_SET_LOOPBACK_SYMBOL(event_type_str, loopbackEventTypeStr);
+  TP_SET_LOOPBACK_SYMBOL(free_device_list, loopbackFreeDeviceList);
+  TP_SET_LOOPBACK_SYMBOL(get_async_event, loopbackGetAsyncEvent);
+  TP_SET_LOOPBACK_SYMBOL(get_device_list, loopbackGetDeviceList);
+  TP_SET_LOOPBACK_SYMBOL(get_device_name, loopbackGetDeviceName);
+  TP_SET_LOOPBACK_SYMBOL(modify_qp, loopbackModifyQp);
+  TP_SET_LOOPBACK_SYMBOL(open_device, loopbackOpenDevice);
+  TP_SET_LOOPBACK_SYMBOL(query_gid, loopbackQueryGid);
+  TP_SET_LOOPBACK_SYMBOL(query_port, loopbackQueryPort);
+  TP_SET_LOOPBACK_SYMBOL(reg_mr, loopbackRegMr);
+  TP_SET_LOOPBACK_SYMBOL(wc_status_str, loopbackWcStatusStr);
+#undef TP_SET_LOOPBACK_SYMBOL
+  return lib;
+}
+
+} // namespace tensorpipe
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <tensorpipe/common/ibv_lib.h>
+
+namespace tensorpipe {
+
+// Return a wrapper whose functions, instead of calling into libibverbs, are
+// backed by a software emulation of the subset of verbs that we use. This
+// allows to exercise (and benchmark) the code paths of the InfiniBand transport
+// on machines that don't have any RDMA hardware.
+//
+// The emulated provider exposes a single device with a single active port. Each
+// context opened on it binds a Unix domain datagram socket, whose abstract name
+// is derived from the process ID and a per-process sequence number, which are
+// also encoded in the GID that the port reports. This is how queue pairs reach
+// their peers, which can thus live in the same process or in another process
+// of the same machine.
+//
+// RDMA writes are performed eagerly, when they are posted, by copying the data
+// directly into the target buffer (using process_vm_writev(2) when the target
+// is in another process, which is subject to the same ptrace(2) permissions as
+// the CMA channel). Their immediate data, and sends, are delivered as datagrams
+// to the peer's context, where they consume a receive request posted on the
+// queue pair's shared receive queue and produce a work completion. If no
+// receive request is available, or if the queue pair isn't ready to receive
+// yet, they are held back until it is, like the sender's retries would do. The
+// sender's work completion is produced once the datagram was accepted by the
+// peer's socket.
+//
+// Some things are deliberately not emulated: remote keys aren't checked, sends
+// can't carry a payload, and there are no asynchronous events.
+IbvLib createLoopbackIbvLib();
+
+} // namespace tensorpipe
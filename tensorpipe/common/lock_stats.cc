@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <tensorpipe/common/lock_stats.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <utility>
+
+namespace tensorpipe {
+
+namespace {
+
+std::mutex& getRegistryMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// The stats are never destroyed, as mutexes (and thus references to the stats)
+// may still be around during static destruction.
+std::map<std::string, LockStats*>& getRegistry() {
+  static auto* registry = new std::map<std::string, LockStats*>();
+  return *registry;
+}
+
+size_t bucketForDuration(std::chrono::nanoseconds duration) {
+  const uint64_t ns = std::max<int64_t>(duration.count(), 0);
+  if (ns == 0) {
+    return 0;
+  }
+  const size_t bucket = 64 - __builtin_clzll(ns);
+  return std::min(bucket, LockStats::kNumBuckets - 1);
+}
+
+// Return the upper bound of the bucket that contains the given percentile.
+std::chrono::nanoseconds percentile(
+    const LockStats::Histogram& histogram,
+    double fraction) {
+  if (histogram.count == 0) {
+    return std::chrono::nanoseconds(0);
+  }
+  const uint64_t rank = static_cast<uint64_t>(fraction * histogram.count);
+  uint64_t seen = 0;
+  for (size_t bucket = 0; bucket < LockStats::kNumBuckets; bucket++) {
+    seen += histogram.buckets[bucket];
+    if (seen > rank) {
+      if (bucket == 0) {
+        return std::chrono::nanoseconds(0);
+      }
+      return bucket == LockStats::kNumBuckets - 1
+          ? histogram.maxTime
+          : std::chrono::nanoseconds(uint64_t(1) << bucket);
+    }
+  }
+  return histogram.maxTime;
+}
+
+void formatHistogram(
+    std::ostringstream& oss,
+    const char* title,
+    const LockStats::Histogram& histogram) {
+  oss << "\n  " << title << ": count=" << histogram.count;
+  if (histogram.count == 0) {
+    return;
+  }
+  oss << " avg=" << (histogram.totalTime / histogram.count).count()
+      << "ns p50<=" << percentile(histogram, 0.5).count()
+      << "ns p99<=" << percentile(histogram, 0.99).count()
+      << "ns max=" << histogram.maxTime.count() << "ns";
+}
+
+} // namespace
+
+LockStats& LockStats::forName(const std::string& name) {
+  std::unique_lock<std::mutex> lock(getRegistryMutex());
+  LockStats*& stats = getRegistry()[name];
+  if (stats == nullptr) {
+    stats = new LockStats(name);
+  }
+  return *stats;
+}
+
+void LockStats::recordAcquisition(
+    bool contended,
+    std::chrono::nanoseconds waitTime) {
+  numAcquisitions_.fetch_add(1, std::memory_order_relaxed);
+  if (contended) {
+    numContendedAcquisitions_.fetch_add(1, std::memory_order_relaxed);
+    waitTime_.record(waitTime);
+  }
+}
+
+void LockStats::recordRelease(std::chrono::nanoseconds holdTime) {
+  holdTime_.record(holdTime);
+}
+
+LockStats::Snapshot LockStats::getSnapshot() const {
+  Snapshot snapshot;
+  snapshot.name = name_;
+  snapshot.numAcquisitions = numAcquisitions_.load(std::memory_order_relaxed);
+  snapshot.numContendedAcquisitions =
+      numContendedAcquisitions_.load(std::memory_order_relaxed);
+  snapshot.waitTime = waitTime_.load();
+  snapshot.holdTime = holdTime_.load();
+  return snapshot;
+}
+
+void LockStats::reset() {
+  numAcquisitions_ = 0;
+  numContendedAcquisitions_ = 0;
+  waitTime_.reset();
+  holdTime_.reset();
+}
+
+std::vector<LockStats::Snapshot> LockStats::getAllSnapshots() {
+  std::vector<Snapshot> snapshots;
+  std::unique_lock<std::mutex> lock(getRegistryMutex());
+  for (const auto& iter : getRegistry()) {
+    snapshots.push_back(iter.second->getSnapshot());
+  }
+  return snapshots;
+}
+
+void LockStats::resetAll() {
+  std::unique_lock<std::mutex> lock(getRegistryMutex());
+  for (const auto& iter : getRegistry()) {
+    iter.second->reset();
+  }
+}
+
+std::string LockStats::format(const Snapshot& snapshot) {
+  std::ostringstream oss;
+  oss << "Lock stats for " << snapshot.name
+      << ": acquisitions=" << snapshot.numAcquisitions
+      << " contended=" << snapshot.numContendedAcquisitions;
+  formatHistogram(oss, "Wait time (contended only)", snapshot.waitTime);
+  formatHistogram(oss, "Hold time", snapshot.holdTime);
+  return oss.str();
+}
+
+void LockStats::AtomicHistogram::record(std::chrono::nanoseconds duration) {
+  buckets[bucketForDuration(duration)].fetch_add(1, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+  totalTime.fetch_add(duration.count(), std::memory_order_relaxed);
+  int64_t prevMax = maxTime.load(std::memory_order_relaxed);
+  while (prevMax < duration.count() &&
+         !maxTime.compare_exchange_weak(
+             prevMax, duration.count(), std::memory_order_relaxed)) {
+  }
+}
+
+LockStats::Histogram LockStats::AtomicHistogram::load() const {
+  Histogram histogram;
+  for (size_t bucket = 0; bucket < kNumBuckets; bucket++) {
+    histogram.buckets[bucket] = buckets[bucket].load(std::memory_order_relaxed);
+  }
+  histogram.count = count.load(std::memory_order_relaxed);
+  histogram.totalTime =
+      std::chrono::nanoseconds(totalTime.load(std::memory_order_relaxed));
+  histogram.maxTime =
+      std::chrono::nanoseconds(maxTime.load(std::memory_order_relaxed));
+  return histogram;
+}
+
+void LockStats::AtomicHistogram::reset() {
+  for (auto& bucket : buckets) {
+    bucket = 0;
+  }
+  count = 0;
+  totalTime = 0;
+  maxTime = 0;
+}
+
+} // namespace tensorpipe
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace tensorpipe {
+
+// Accounting of how contended the library's internal mutexes are.
+//
+// Stats are kept per name rather than per mutex, hence all the instances of the
+// same lock (e.g., the queues of all the workers) are aggregated together, and
+// they live for as long as the process. For each name they record how many
+// times the lock was acquired, how many of those acquisitions had to wait for
+// another thread to release it, and histograms of how long such waits took and
+// of how long the lock was then held.
+//
+// The stats are filled in by the InstrumentedMutex below, which the library
+// only uses in place of a plain mutex when built with TP_ENABLE_LOCK_STATS (see
+// common/mutex.h). They can be retrieved at any time through getAllSnapshots.
+class LockStats {
+ public:
+  using TClock = std::chrono::steady_clock;
+
+  // Durations are bucketed by powers of two of nanoseconds: the first bucket is
+  // for zero, the i-th one for [2^(i-1), 2^i), and the last one also takes all
+  // longer durations (i.e., from about one second on).
+  static constexpr size_t kNumBuckets = 32;
+
+  struct Histogram {
+    std::array<uint64_t, kNumBuckets> buckets{};
+    uint64_t count{0};
+    std::chrono::nanoseconds totalTime{0};
+    std::chrono::nanoseconds maxTime{0};
+  };
+
+  struct Snapshot {
+    std::string name;
+    uint64_t numAcquisitions{0};
+    uint64_t numContendedAcquisitions{0};
+    // Only contended acquisitions are accounted here.
+    Histogram waitTime;
+    Histogram holdTime;
+  };
+
+  // Return the stats for the given name, creating them the first time. The
+  // returned reference remains valid for the lifetime of the process.
+  static LockStats& forName(const std::string& name);
+
+  LockStats(const LockStats&) = delete;
+  LockStats(LockStats&&) = delete;
+  LockStats& operator=(const LockStats&) = delete;
+  LockStats& operator=(LockStats&&) = delete;
+
+  void recordAcquisition(bool contended, std::chrono::nanoseconds waitTime);
+  void recordRelease(std::chrono::nanoseconds holdTime);
+
+  Snapshot getSnapshot() const;
+  void reset();
+
+  // Return the stats of all the names that have been used so far.
+  static std::vector<Snapshot> getAllSnapshots();
+  static void resetAll();
+
+  // Produce a human-readable summary, including the percentiles of the
+  // histograms.
+  static std::string format(const Snapshot& snapshot);
+
+ private:
+  explicit LockStats(std::string name) : name_(std::move(name)) {}
+
+  // Recording only involves atomic increments, in order not to introduce any
+  // contention of its own.
+  struct AtomicHistogram {
+    std::array<std::atomic<uint64_t>, kNumBuckets> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<int64_t> totalTime{0};
+    std::atomic<int64_t> maxTime{0};
+
+    void record(std::chrono::nanoseconds duration);
+    Histogram load() const;
+    void reset();
+  };
+
+  const std::string name_;
+  std::atomic<uint64_t> numAcquisitions_{0};
+  std::atomic<uint64_t> numContendedAcquisitions_{0};
+  AtomicHistogram waitTime_;
+  AtomicHistogram holdTime_;
+};
+
+// A mutex that accounts its acquisitions on the stats of the given name. It
+// first tries to take the lock without blocking, and only measures the waiting
+// time when that fails, so that uncontended acquisitions stay cheap.
+class InstrumentedMutex {
+ public:
+  explicit InstrumentedMutex(const std::string& name)
+      : stats_(LockStats::forName(name)) {}
+
+  InstrumentedMutex(const InstrumentedMutex&) = delete;
+  InstrumentedMutex& operator=(const InstrumentedMutex&) = delete;
+
+  void lock() {
+    if (mutex_.try_lock()) {
+      lockedAt_ = LockStats::TClock::now();
+      stats_.recordAcquisition(
+          /*contended=*/false, std::chrono::nanoseconds(0));
+      return;
+    }
+    const LockStats::TClock::time_point start = LockStats::TClock::now();
+    mutex_.lock();
+    lockedAt_ = LockStats::TClock::now();
+    stats_.recordAcquisition(/*contended=*/true, lockedAt_ - start);
+  }
+
+  bool try_lock() {
+    if (!mutex_.try_lock()) {
+      return false;
+    }
+    lockedAt_ = LockStats::TClock::now();
+    stats_.recordAcquisition(/*contended=*/false, std::chrono::nanoseconds(0));
+    return true;
+  }
+
+  void unlock() {
+    const std::chrono::nanoseconds holdTime =
+        LockStats::TClock::now() - lockedAt_;
+    mutex_.unlock();
+    stats_.recordRelease(holdTime);
+  }
+
+ private:
+  std::mutex mutex_;
+  LockStats& stats_;
+  // Only accessed by the thread holding the lock.
+  LockStats::TClock::time_point lockedAt_;
+};
+
+} // namespace tensorpipe
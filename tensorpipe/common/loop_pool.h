@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace tensorpipe {
+
+// A fixed number of event loops (and of the threads that run them) on which
+// several transport and channel contexts can be constructed. By default each
+// context starts its own threads, hence a process with many contexts (e.g., one
+// per model or per tenant) ends up with a lot of mostly idle threads. Contexts
+// created from a pool instead share its loops, assigned in round-robin, so the
+// number of threads stays the same however many contexts there are.
+//
+// Each backend has its own kind of loop, which is only created the first time
+// a context of that backend asks for it. The loops are stopped and joined when
+// the pool is destroyed, hence the pool must outlive all the contexts that use
+// it, and must not be destroyed from within one of its loops.
+class LoopPool final {
+ public:
+  explicit LoopPool(size_t numLoops) : numLoops_(numLoops) {}
+
+  LoopPool(const LoopPool&) = delete;
+  LoopPool(LoopPool&&) = delete;
+  LoopPool& operator=(const LoopPool&) = delete;
+  LoopPool& operator=(LoopPool&&) = delete;
+
+  size_t numLoops() const {
+    return numLoops_;
+  }
+
+  // Return the next loop of the given kind, creating it with the given function
+  // if this is the first time it's handed out. Meant to be used by backends.
+  // The loop must have a join method, which closes it and waits for it to
+  // terminate, and which is called when the pool is destroyed. Contexts that
+  // still hold on to the loop after that must be able to cope with it.
+  template <typename T>
+  std::shared_ptr<T> getLoop(
+      const std::string& kind,
+      const std::function<std::shared_ptr<T>()>& fn) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    LoopsOfKind& loops = loops_[kind];
+    if (loops.loops.empty()) {
+      loops.loops.resize(std::max<size_t>(numLoops_, 1));
+    }
+    Slot& slot = loops.loops[loops.nextIdx];
+    loops.nextIdx = (loops.nextIdx + 1) % loops.loops.size();
+    if (slot.loop == nullptr) {
+      std::shared_ptr<T> loop = fn();
+      slot.join = [loop]() { loop->join(); };
+      slot.loop = std::move(loop);
+    }
+    return std::static_pointer_cast<T>(slot.loop);
+  }
+
+  ~LoopPool() {
+    // Joining the loops here, rather than when the last reference to them goes
+    // away, prevents that from happening within the loops themselves.
+    for (auto& iter : loops_) {
+      for (Slot& slot : iter.second.loops) {
+        if (slot.join) {
+          slot.join();
+        }
+      }
+    }
+  }
+
+ private:
+  struct Slot {
+    std::shared_ptr<void> loop;
+    std::function<void()> join;
+  };
+
+  struct LoopsOfKind {
+    std::vector<Slot> loops;
+    size_t nextIdx{0};
+  };
+
+  const size_t numLoops_;
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, LoopsOfKind> loops_;
+};
+
+} // namespace tensorpipe
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <tensorpipe/common/loop_stats.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <utility>
+
+#include <tensorpipe/common/defs.h>
+#include <tensorpipe/common/optional.h>
+
+namespace tensorpipe {
+
+namespace {
+
+thread_local LoopStats* currentStats = nullptr;
+thread_local LoopStats::HandlerScope* currentScope = nullptr;
+
+optional<std::chrono::milliseconds> getReportIntervalFromEnvInternal() {
+  char* intervalStr = std::getenv("TP_LOOP_STATS");
+  if (intervalStr == nullptr) {
+    return nullopt;
+  }
+  return std::chrono::milliseconds(
+      std::strtoul(intervalStr, /*str_end=*/nullptr, /*base=*/10));
+}
+
+const optional<std::chrono::milliseconds>& getReportIntervalFromEnv() {
+  static optional<std::chrono::milliseconds> interval =
+      getReportIntervalFromEnvInternal();
+  return interval;
+}
+
+// All the live instances, so that their stats can be collected at once. These
+// are leaked, as loops owned by other static objects (e.g., a LoopPool) may
+// still be destroyed during static destruction.
+std::mutex& getRegistryMutex() {
+  static auto* mutex = new std::mutex();
+  return *mutex;
+}
+
+std::set<LoopStats*>& getRegistry() {
+  static auto* registry = new std::set<LoopStats*>();
+  return *registry;
+}
+
+void addToEntry(LoopStats::Entry& entry, std::chrono::nanoseconds duration) {
+  entry.count++;
+  entry.totalTime += duration;
+  entry.maxTime = std::max(entry.maxTime, duration);
+}
+
+void formatEntries(
+    std::ostringstream& oss,
+    const char* title,
+    const std::map<std::string, LoopStats::Entry>& entries,
+    size_t n) {
+  std::vector<std::pair<std::string, LoopStats::Entry>> sorted(
+      entries.begin(), entries.end());
+  std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+    return a.second.totalTime > b.second.totalTime;
+  });
+  if (sorted.size() > n) {
+    sorted.resize(n);
+  }
+
+  oss << "\n  " << title << ":";
+  for (const auto& iter : sorted) {
+    const LoopStats::Entry& entry = iter.second;
+    oss << "\n    " << std::left << std::setw(40)
+        << (iter.first.empty() ? "(unattributed)" : iter.first) << std::right
+        << " count=" << entry.count << " total="
+        << std::chrono::duration_cast<std::chrono::microseconds>(
+               entry.totalTime)
+               .count()
+        << "us avg="
+        << std::chrono::duration_cast<std::chrono::microseconds>(
+               entry.totalTime / entry.count)
+               .count()
+        << "us max="
+        << std::chrono::duration_cast<std::chrono::microseconds>(
+               entry.maxTime)
+               .count()
+        << "us";
+  }
+}
+
+} // namespace
+
+LoopStats::LoopStats(std::string name) : name_(std::move(name)) {
+  const optional<std::chrono::milliseconds>& interval =
+      getReportIntervalFromEnv();
+  if (interval.has_value()) {
+    enable(interval.value());
+  }
+
+  std::unique_lock<std::mutex> lock(getRegistryMutex());
+  getRegistry().insert(this);
+}
+
+LoopStats::~LoopStats() {
+  std::unique_lock<std::mutex> lock(getRegistryMutex());
+  getRegistry().erase(this);
+}
+
+void LoopStats::setName(std::string name) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  name_ = std::move(name);
+}
+
+void LoopStats::enable(
+    std::chrono::milliseconds reportInterval,
+    size_t reportTopN) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  reportInterval_ = reportInterval;
+  reportTopN_ = reportTopN;
+  lastReport_ = TClock::now();
+  enabled_ = true;
+}
+
+void LoopStats::disable() {
+  enabled_ = false;
+}
+
+void LoopStats::recordHandler(
+    const std::string& label,
+    const char* type,
+    std::chrono::nanoseconds duration) {
+  const TClock::time_point now = TClock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  addToEntry(handlersByLabel_[label], duration);
+  addToEntry(handlersByType_[type], duration);
+  maybeReportLocked(now);
+}
+
+void LoopStats::recordLag(const char* type, std::chrono::nanoseconds lag) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  addToEntry(lagByType_[type], lag);
+}
+
+LoopStats::Snapshot LoopStats::getSnapshot() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return getSnapshotLocked();
+}
+
+LoopStats::Snapshot LoopStats::getSnapshotLocked() const {
+  Snapshot snapshot;
+  snapshot.name = name_;
+  snapshot.handlersByLabel = handlersByLabel_;
+  snapshot.handlersByType = handlersByType_;
+  snapshot.lagByType = lagByType_;
+  return snapshot;
+}
+
+void LoopStats::reset() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  handlersByLabel_.clear();
+  handlersByType_.clear();
+  lagByType_.clear();
+}
+
+void LoopStats::maybeReportLocked(TClock::time_point now) {
+  if (reportInterval_.count() == 0 || now - lastReport_ < reportInterval_) {
+    return;
+  }
+  lastReport_ = now;
+  TP_LOG_INFO() << formatTopN(getSnapshotLocked(), reportTopN_);
+}
+
+LoopStats* LoopStats::current() {
+  LoopStats* stats = currentStats;
+  if (stats != nullptr && stats->isEnabled()) {
+    return stats;
+  }
+  return nullptr;
+}
+
+const std::string& LoopStats::currentLabel() {
+  static const std::string kEmptyLabel;
+  if (currentScope != nullptr && currentScope->label_ != nullptr) {
+    return *currentScope->label_;
+  }
+  return kEmptyLabel;
+}
+
+std::vector<LoopStats::Snapshot> LoopStats::getAllSnapshots() {
+  std::vector<Snapshot> snapshots;
+  std::unique_lock<std::mutex> lock(getRegistryMutex());
+  for (LoopStats* stats : getRegistry()) {
+    if (stats->isEnabled()) {
+      snapshots.push_back(stats->getSnapshot());
+    }
+  }
+  return snapshots;
+}
+
+std::string LoopStats::formatTopN(const Snapshot& snapshot, size_t n) {
+  std::ostringstream oss;
+  oss << "Loop stats for " << (snapshot.name.empty() ? "N/A" : snapshot.name);
+  formatEntries(oss, "Handlers by label", snapshot.handlersByLabel, n);
+  formatEntries(oss, "Handlers by type", snapshot.handlersByType, n);
+  formatEntries(oss, "Lag by type", snapshot.lagByType, n);
+  return oss.str();
+}
+
+LoopStats::Activation::Activation(LoopStats& stats)
+    : prevStats_(currentStats), prevScope_(currentScope) {
+  currentStats = &stats;
+  // Scopes opened by an outer loop don't belong to this one.
+  currentScope = nullptr;
+}
+
+LoopStats::Activation::~Activation() {
+  currentStats = prevStats_;
+  currentScope = prevScope_;
+}
+
+LoopStats::HandlerScope::HandlerScope(const std::string& label, const char* type)
+    : stats_(LoopStats::current()) {
+  if (stats_ == nullptr) {
+    return;
+  }
+  label_ = &label;
+  type_ = type;
+  start_ = TClock::now();
+  parent_ = currentScope;
+  currentScope = this;
+}
+
+LoopStats::HandlerScope::~HandlerScope() {
+  if (stats_ == nullptr) {
+    return;
+  }
+  const std::chrono::nanoseconds duration = TClock::now() - start_;
+  TP_DCHECK(currentScope == this);
+  currentScope = parent_;
+  if (parent_ != nullptr) {
+    parent_->nestedTime_ += duration;
+  }
+  stats_->recordHandler(*label_, type_, duration - nestedTime_);
+}
+
+} // namespace tensorpipe
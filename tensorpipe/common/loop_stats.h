@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace tensorpipe {
+
+// Opt-in accounting of where the time of an event loop goes.
+//
+// Each loop (i.e., each deferred executor) owns an instance of this class. When
+// it is enabled, the loop measures how long each handler invocation takes and
+// attributes it both to a label (the identifier of the connection, pipe, ...
+// that the handler belongs to) and to a type (deferred function, epoll event,
+// callback, ...). It also measures the lag of the loop, which is the time that
+// elapses between a function being deferred (or a file descriptor becoming
+// ready) and the loop getting to it.
+//
+// Handlers are delimited using the HandlerScope RAII helper, which looks up the
+// stats of the loop that is running on the current thread. Scopes can be nested
+// and each of them is only accounted its own time (excluding the one of its
+// nested scopes) so that nothing is counted twice. Functions deferred while a
+// scope is active inherit its label, which allows to attribute the work that a
+// connection or pipe schedules for later to that connection or pipe.
+//
+// Accounting is disabled by default. It can be enabled for all loops by setting
+// the TP_LOOP_STATS environment variable to a reporting interval, in
+// milliseconds, in which case each loop will periodically log its top entries
+// (a value of zero enables accounting without logging). It can also be enabled
+// programmatically on a single loop, and the stats of all live loops can be
+// retrieved at any time through LoopStats::getAllSnapshots.
+class LoopStats {
+ public:
+  using TClock = std::chrono::steady_clock;
+
+  struct Entry {
+    uint64_t count{0};
+    std::chrono::nanoseconds totalTime{0};
+    std::chrono::nanoseconds maxTime{0};
+  };
+
+  struct Snapshot {
+    std::string name;
+    // Time spent in handlers, aggregated by label and by type.
+    std::map<std::string, Entry> handlersByLabel;
+    std::map<std::string, Entry> handlersByType;
+    // Delay between an event and the start of its handling, by type.
+    std::map<std::string, Entry> lagByType;
+  };
+
+  class Activation;
+  class HandlerScope;
+
+  explicit LoopStats(std::string name = "");
+
+  LoopStats(const LoopStats&) = delete;
+  LoopStats(LoopStats&&) = delete;
+  LoopStats& operator=(const LoopStats&) = delete;
+  LoopStats& operator=(LoopStats&&) = delete;
+
+  ~LoopStats();
+
+  void setName(std::string name);
+
+  // A report interval of zero disables the periodic logging.
+  void enable(
+      std::chrono::milliseconds reportInterval = std::chrono::milliseconds(0),
+      size_t reportTopN = kDefaultReportTopN);
+  void disable();
+
+  inline bool isEnabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  void recordHandler(
+      const std::string& label,
+      const char* type,
+      std::chrono::nanoseconds duration);
+  void recordLag(const char* type, std::chrono::nanoseconds lag);
+
+  Snapshot getSnapshot() const;
+  void reset();
+
+  // Return the stats of the loop that is running on the current thread, if any,
+  // provided they are enabled.
+  static LoopStats* current();
+
+  // Return the label of the innermost handler scope active on this thread, or
+  // an empty string if none is active.
+  static const std::string& currentLabel();
+
+  static std::vector<Snapshot> getAllSnapshots();
+
+  // Produce a human-readable summary of the top N entries of each category,
+  // sorted by total time.
+  static std::string formatTopN(const Snapshot& snapshot, size_t n);
+
+  static constexpr size_t kDefaultReportTopN = 10;
+
+ private:
+  std::atomic<bool> enabled_{false};
+
+  mutable std::mutex mutex_;
+  std::string name_;
+  std::map<std::string, Entry> handlersByLabel_;
+  std::map<std::string, Entry> handlersByType_;
+  std::map<std::string, Entry> lagByType_;
+
+  std::chrono::milliseconds reportInterval_{0};
+  size_t reportTopN_{kDefaultReportTopN};
+  TClock::time_point lastReport_;
+
+  void maybeReportLocked(TClock::time_point now);
+  Snapshot getSnapshotLocked() const;
+};
+
+// Mark the stats as belonging to the loop running on the current thread, for as
+// long as this object is alive. Activations can be nested (e.g., when an
+// on-demand loop runs inline within another loop's thread).
+class LoopStats::Activation {
+ public:
+  explicit Activation(LoopStats& stats);
+
+  Activation(const Activation&) = delete;
+  Activation& operator=(const Activation&) = delete;
+
+  ~Activation();
+
+ private:
+  LoopStats* prevStats_;
+  HandlerScope* prevScope_;
+};
+
+// Measure the time spent until this object is destroyed and account it to the
+// given label and type on the stats of the loop running on this thread. This
+// is a no-op (besides a thread-local lookup) if those stats are not enabled.
+// The label must outlive the scope.
+class LoopStats::HandlerScope {
+ public:
+  HandlerScope(const std::string& label, const char* type);
+
+  HandlerScope(const HandlerScope&) = delete;
+  HandlerScope& operator=(const HandlerScope&) = delete;
+
+  ~HandlerScope();
+
+ private:
+  LoopStats* stats_;
+  const std::string* label_{nullptr};
+  const char* type_{nullptr};
+  TClock::time_point start_;
+  std::chrono::nanoseconds nestedTime_{0};
+  HandlerScope* parent_{nullptr};
+
+  friend class LoopStats;
+};
+
+} // namespace tensorpipe
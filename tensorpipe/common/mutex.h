@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+
+#include <tensorpipe/common/lock_stats.h>
+#include <tensorpipe/config.h>
+
+namespace tensorpipe {
+
+// The mutex used on the hot paths of the library, which is given a name under
+// which its contention is accounted (see LockStats) when the library is built
+// with TP_ENABLE_LOCK_STATS. Otherwise it's a plain std::mutex and the name is
+// ignored. Locks on it must be taken as std::unique_lock<Mutex>, and waited on
+// through the ConditionVariable below.
+#if TENSORPIPE_HAS_LOCK_STATS
+
+using Mutex = InstrumentedMutex;
+
+using ConditionVariable = std::condition_variable_any;
+
+#else // TENSORPIPE_HAS_LOCK_STATS
+
+class Mutex : public std::mutex {
+ public:
+  explicit Mutex(const char* /* unused */) {}
+};
+
+// A std::condition_variable that accepts locks on the Mutex above, by handing
+// their ownership over to a lock on the underlying std::mutex while waiting.
+class ConditionVariable : public std::condition_variable {
+ public:
+  void wait(std::unique_lock<Mutex>& lock) {
+    Mutex* mutex = lock.release();
+    std::unique_lock<std::mutex> plainLock(*mutex, std::adopt_lock);
+    std::condition_variable::wait(plainLock);
+    plainLock.release();
+    lock = std::unique_lock<Mutex>(*mutex, std::adopt_lock);
+  }
+};
+
+#endif // TENSORPIPE_HAS_LOCK_STATS
+
+} // namespace tensorpipe
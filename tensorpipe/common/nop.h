@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include <chrono>
+
 #include <nop/serializer.h>
 #include <nop/status.h>
 #include <nop/utility/buffer_reader.h>
@@ -302,4 +304,61 @@ struct Encoding<tensorpipe::optional<T>> : EncodingIO<tensorpipe::optional<T>> {
   }
 };
 
+// Time points are transferred as a number of nanoseconds since the epoch of
+// their clock. This is only meaningful for clocks that have the same epoch on
+// both ends, such as the system clock.
+template <typename Clock, typename Duration>
+struct Encoding<std::chrono::time_point<Clock, Duration>>
+    : EncodingIO<std::chrono::time_point<Clock, Duration>> {
+  using Type = std::chrono::time_point<Clock, Duration>;
+  using Rep = std::chrono::nanoseconds::rep;
+
+  static constexpr Rep toRep(const Type& value) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               value.time_since_epoch())
+        .count();
+  }
+
+  // NOLINTNEXTLINE(readability-identifier-naming)
+  static constexpr EncodingByte Prefix(const Type& value) {
+    return Encoding<Rep>::Prefix(toRep(value));
+  }
+
+  // NOLINTNEXTLINE(readability-identifier-naming)
+  static constexpr std::size_t Size(const Type& value) {
+    return Encoding<Rep>::Size(toRep(value));
+  }
+
+  // NOLINTNEXTLINE(readability-identifier-naming)
+  static constexpr bool Match(EncodingByte prefix) {
+    return Encoding<Rep>::Match(prefix);
+  }
+
+  template <typename Writer>
+  // NOLINTNEXTLINE(readability-identifier-naming)
+  static constexpr Status<void> WritePayload(
+      EncodingByte prefix,
+      const Type& value,
+      Writer* writer) {
+    return Encoding<Rep>::WritePayload(prefix, toRep(value), writer);
+  }
+
+  template <typename Reader>
+  // NOLINTNEXTLINE(readability-identifier-naming)
+  static constexpr Status<void> ReadPayload(
+      EncodingByte prefix,
+      Type* value,
+      Reader* reader) {
+    Rep rep;
+    auto status = Encoding<Rep>::ReadPayload(prefix, &rep, reader);
+    if (!status) {
+      return status;
+    }
+
+    *value = Type(std::chrono::duration_cast<Duration>(
+        std::chrono::nanoseconds(rep)));
+    return {};
+  }
+};
+
 } // namespace nop
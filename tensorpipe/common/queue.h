@@ -8,10 +8,11 @@
 
 #pragma once
 
-#include <condition_variable>
 #include <deque>
 #include <mutex>
 
+#include <tensorpipe/common/mutex.h>
+
 namespace tensorpipe {
 
 template <typename T>
@@ -20,7 +21,7 @@ class Queue {
   explicit Queue(int capacity = 1) : capacity_(capacity) {}
 
   void push(T t) {
-    std::unique_lock<std::mutex> lock(mutex_);
+    std::unique_lock<Mutex> lock(mutex_);
     while (items_.size() >= capacity_) {
       cv_.wait(lock);
     }
@@ -29,7 +30,7 @@ class Queue {
   }
 
   T pop() {
-    std::unique_lock<std::mutex> lock(mutex_);
+    std::unique_lock<Mutex> lock(mutex_);
     while (items_.size() == 0) {
       cv_.wait(lock);
     }
@@ -40,8 +41,8 @@ class Queue {
   }
 
  private:
-  std::mutex mutex_;
-  std::condition_variable cv_;
+  Mutex mutex_{"queue"};
+  ConditionVariable cv_;
   const int capacity_;
   std::deque<T> items_;
 };
@@ -8,11 +8,13 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <functional>
 #include <memory>
 #include <tuple>
 #include <utility>
+#include <vector>
 
 #include <tensorpipe/common/defs.h>
 #include <tensorpipe/common/error.h>
@@ -21,6 +23,15 @@
 
 namespace tensorpipe {
 
+// A copy between a user buffer and a slice of a ringbuffer, which was reserved
+// by an operation so that it could be performed out of line (e.g., by helper
+// threads) rather than while holding a transaction on the ringbuffer.
+struct RingbufferCopy {
+  void* dst;
+  const void* src;
+  size_t len;
+};
+
 // Reads happen only if the user supplied a callback (and optionally
 // a destination buffer). The callback is run from the event loop
 // thread upon receiving a notification from our peer.
@@ -55,6 +66,42 @@ class RingbufferReadOperation {
     return (mode_ == READ_PAYLOAD && bytesRead_ == len_);
   }
 
+  // Out-of-line copies are only supported when reading into a user-provided
+  // buffer, whose length is thus known before the header is received.
+  bool supportsOutOfLineCopy() const {
+    return ptrProvided_ && ptr_ != nullptr;
+  }
+
+  size_t length() const {
+    return len_;
+  }
+
+  bool fullyReserved() const {
+    return mode_ == READ_PAYLOAD && bytesReserved_ == len_;
+  }
+
+  // Alternative to handleRead that doesn't copy the payload itself. It reads
+  // the length header if needed, and then reserves the next slice of the
+  // payload available in the inbox, if there are at least minLen bytes of it
+  // (or all the rest of them) but no more than maxLen, appending the copies to
+  // perform to the given vector. The inbox marker is left where it is until
+  // the copies are done and commitPayload is called. Returns the number of
+  // bytes consumed from the inbox.
+  template <int NumRoles, int RoleIdx>
+  inline size_t reservePayload(
+      RingBufferRole<NumRoles, RoleIdx>& inbox,
+      size_t minLen,
+      size_t maxLen,
+      std::vector<RingbufferCopy>& copies);
+
+  // Release the given number of reserved bytes from the inbox, in the order in
+  // which they were reserved, once their copies are done. Returns the number
+  // of bytes consumed from the inbox.
+  template <int NumRoles, int RoleIdx>
+  inline size_t commitPayload(
+      RingBufferRole<NumRoles, RoleIdx>& inbox,
+      size_t len);
+
   inline void handleError(const Error& error);
 
  private:
@@ -64,6 +111,7 @@ class RingbufferReadOperation {
   std::unique_ptr<uint8_t[]> buf_;
   size_t len_{0};
   size_t bytesRead_{0};
+  size_t bytesReserved_{0};
   read_callback_fn fn_;
   // Use a separare flag, rather than checking if ptr_ == nullptr, to catch the
   // case of a user explicitly passing in a nullptr with length zero, in which
@@ -72,6 +120,11 @@ class RingbufferReadOperation {
 
   template <int NumRoles, int RoleIdx>
   inline ssize_t readNopObject(RingBufferRole<NumRoles, RoleIdx>& inbox);
+
+  // Consume the data that's available, without copying it anywhere, when the
+  // user provided a length but no buffer.
+  template <int NumRoles, int RoleIdx>
+  inline ssize_t skipPayload(RingBufferRole<NumRoles, RoleIdx>& inbox);
 };
 
 // Writes happen only if the user supplied a memory pointer, the
@@ -106,6 +159,43 @@ class RingbufferWriteOperation {
     return (mode_ == WRITE_PAYLOAD && bytesWritten_ == len_);
   }
 
+  // Out-of-line copies are only supported when writing from a user-provided
+  // buffer, as libnop objects are serialized directly into the outbox.
+  bool supportsOutOfLineCopy() const {
+    return nopObject_ == nullptr;
+  }
+
+  size_t length() const {
+    return len_;
+  }
+
+  bool fullyReserved() const {
+    return mode_ == WRITE_PAYLOAD && bytesReserved_ == len_;
+  }
+
+  // Alternative to handleWrite that doesn't copy the payload itself. It writes
+  // the length header if needed, and then reserves space in the outbox for the
+  // next slice of the payload, if there is room for at least minLen bytes of
+  // it (or all the rest of them) but no more than maxLen, appending the copies
+  // to perform to the given vector. The outbox marker is left where it is
+  // until the copies are done and commitPayload is called, so that the peer
+  // doesn't see the data before then. Returns the number of bytes made
+  // available to the peer.
+  template <int NumRoles, int RoleIdx>
+  inline size_t reservePayload(
+      RingBufferRole<NumRoles, RoleIdx>& outbox,
+      size_t minLen,
+      size_t maxLen,
+      std::vector<RingbufferCopy>& copies);
+
+  // Publish the given number of reserved bytes to the peer, in the order in
+  // which they were reserved, once their copies are done. Returns the number
+  // of bytes made available to the peer.
+  template <int NumRoles, int RoleIdx>
+  inline size_t commitPayload(
+      RingBufferRole<NumRoles, RoleIdx>& outbox,
+      size_t len);
+
   inline void handleError(const Error& error);
 
  private:
@@ -114,6 +204,7 @@ class RingbufferWriteOperation {
   const AbstractNopHolder* nopObject_{nullptr};
   size_t len_{0};
   size_t bytesWritten_{0};
+  size_t bytesReserved_{0};
   write_callback_fn fn_;
 
   template <int NumRoles, int RoleIdx>
@@ -170,6 +261,8 @@ size_t RingbufferReadOperation::handleRead(
   if (mode_ == READ_PAYLOAD) {
     if (nopObject_ != nullptr) {
       ret = readNopObject(inbox);
+    } else if (ptrProvided_ && ptr_ == nullptr) {
+      ret = skipPayload(inbox);
     } else {
       ret = inbox.template readInTx</*AllowPartial=*/true>(
           reinterpret_cast<uint8_t*>(ptr_) + bytesRead_, len_ - bytesRead_);
@@ -217,6 +310,123 @@ ssize_t RingbufferReadOperation::readNopObject(
   return len_;
 }
 
+template <int NumRoles, int RoleIdx>
+ssize_t RingbufferReadOperation::skipPayload(
+    RingBufferRole<NumRoles, RoleIdx>& inbox) {
+  ssize_t numBuffers;
+  std::array<typename RingBufferRole<NumRoles, RoleIdx>::Buffer, 2> buffers;
+  std::tie(numBuffers, buffers) =
+      inbox.template accessContiguousInTx</*AllowPartial=*/true>(
+          len_ - bytesRead_);
+  if (unlikely(numBuffers < 0)) {
+    return numBuffers;
+  }
+
+  size_t len = 0;
+  for (ssize_t bufferIdx = 0; bufferIdx < numBuffers; bufferIdx++) {
+    len += buffers[bufferIdx].len;
+  }
+  return len;
+}
+
+template <int NumRoles, int RoleIdx>
+size_t RingbufferReadOperation::reservePayload(
+    RingBufferRole<NumRoles, RoleIdx>& inbox,
+    size_t minLen,
+    size_t maxLen,
+    std::vector<RingbufferCopy>& copies) {
+  TP_DCHECK(supportsOutOfLineCopy());
+  ssize_t ret;
+  size_t bytesReadNow = 0;
+
+  if (mode_ == READ_LENGTH) {
+    ret = inbox.startTx();
+    TP_THROW_SYSTEM_IF(ret < 0, -ret);
+    uint32_t length;
+    ret = inbox.template readInTx</*AllowPartial=*/false>(
+        &length, sizeof(length));
+    if (likely(ret >= 0)) {
+      mode_ = READ_PAYLOAD;
+      bytesReadNow += ret;
+      TP_DCHECK_EQ(length, len_);
+    } else if (unlikely(ret != -ENODATA)) {
+      TP_THROW_SYSTEM(-ret);
+    }
+    ret = inbox.commitTx();
+    TP_THROW_SYSTEM_IF(ret < 0, -ret);
+    if (mode_ == READ_LENGTH) {
+      return bytesReadNow;
+    }
+    if (completed()) {
+      fn_(Error::kSuccess, ptr_, len_);
+      return bytesReadNow;
+    }
+  }
+
+  const size_t bytesLeft = len_ - bytesReserved_;
+  if (bytesLeft == 0) {
+    return bytesReadNow;
+  }
+
+  ret = inbox.startTx();
+  TP_THROW_SYSTEM_IF(ret < 0, -ret);
+
+  // Skip over the data that was reserved earlier but that is still being
+  // copied, as it will only be released from the inbox once that's done.
+  ret = inbox.incMarkerInTx(bytesReserved_ - bytesRead_);
+  TP_THROW_SYSTEM_IF(ret < 0, -ret);
+
+  ssize_t numBuffers;
+  std::array<typename RingBufferRole<NumRoles, RoleIdx>::Buffer, 2> buffers;
+  std::tie(numBuffers, buffers) =
+      inbox.template accessContiguousInTx</*AllowPartial=*/true>(
+          std::min(bytesLeft, maxLen));
+  TP_THROW_SYSTEM_IF(numBuffers < 0, -numBuffers);
+
+  size_t bytesAvailable = 0;
+  for (ssize_t bufferIdx = 0; bufferIdx < numBuffers; bufferIdx++) {
+    bytesAvailable += buffers[bufferIdx].len;
+  }
+  if (bytesAvailable > 0 && bytesAvailable >= std::min(bytesLeft, minLen)) {
+    for (ssize_t bufferIdx = 0; bufferIdx < numBuffers; bufferIdx++) {
+      copies.push_back(RingbufferCopy{
+          .dst = reinterpret_cast<uint8_t*>(ptr_) + bytesReserved_,
+          .src = buffers[bufferIdx].ptr,
+          .len = buffers[bufferIdx].len,
+      });
+      bytesReserved_ += buffers[bufferIdx].len;
+    }
+  }
+
+  // The reservation is tracked by this operation, not by the ringbuffer.
+  ret = inbox.cancelTx();
+  TP_THROW_SYSTEM_IF(ret < 0, -ret);
+
+  return bytesReadNow;
+}
+
+template <int NumRoles, int RoleIdx>
+size_t RingbufferReadOperation::commitPayload(
+    RingBufferRole<NumRoles, RoleIdx>& inbox,
+    size_t len) {
+  TP_DCHECK_LE(bytesRead_ + len, bytesReserved_);
+  ssize_t ret;
+
+  ret = inbox.startTx();
+  TP_THROW_SYSTEM_IF(ret < 0, -ret);
+  ret = inbox.incMarkerInTx(len);
+  TP_THROW_SYSTEM_IF(ret < 0, -ret);
+  ret = inbox.commitTx();
+  TP_THROW_SYSTEM_IF(ret < 0, -ret);
+
+  bytesRead_ += len;
+  if (completed()) {
+    fn_(Error::kSuccess, ptr_, len_);
+  }
+
+  return len;
+}
+
 void RingbufferReadOperation::handleError(const Error& error) {
   fn_(error, nullptr, 0);
 }
@@ -307,6 +517,103 @@ ssize_t RingbufferWriteOperation::writeNopObject(
   return len_;
 }
 
+template <int NumRoles, int RoleIdx>
+size_t RingbufferWriteOperation::reservePayload(
+    RingBufferRole<NumRoles, RoleIdx>& outbox,
+    size_t minLen,
+    size_t maxLen,
+    std::vector<RingbufferCopy>& copies) {
+  TP_DCHECK(supportsOutOfLineCopy());
+  ssize_t ret;
+  size_t bytesWrittenNow = 0;
+
+  if (mode_ == WRITE_LENGTH) {
+    ret = outbox.startTx();
+    TP_THROW_SYSTEM_IF(ret < 0, -ret);
+    uint32_t length = len_;
+    ret = outbox.template writeInTx</*AllowPartial=*/false>(
+        &length, sizeof(length));
+    if (likely(ret >= 0)) {
+      mode_ = WRITE_PAYLOAD;
+      bytesWrittenNow += ret;
+    } else if (unlikely(ret != -ENODATA)) {
+      TP_THROW_SYSTEM(-ret);
+    }
+    ret = outbox.commitTx();
+    TP_THROW_SYSTEM_IF(ret < 0, -ret);
+    if (mode_ == WRITE_LENGTH) {
+      return bytesWrittenNow;
+    }
+    if (completed()) {
+      fn_(Error::kSuccess);
+      return bytesWrittenNow;
+    }
+  }
+
+  const size_t bytesLeft = len_ - bytesReserved_;
+  if (bytesLeft == 0) {
+    return bytesWrittenNow;
+  }
+
+  ret = outbox.startTx();
+  TP_THROW_SYSTEM_IF(ret < 0, -ret);
+
+  // Skip over the space that was reserved earlier but that is still being
+  // filled, as it will only be published to the peer once that's done.
+  ret = outbox.incMarkerInTx(bytesReserved_ - bytesWritten_);
+  TP_THROW_SYSTEM_IF(ret < 0, -ret);
+
+  ssize_t numBuffers;
+  std::array<typename RingBufferRole<NumRoles, RoleIdx>::Buffer, 2> buffers;
+  std::tie(numBuffers, buffers) =
+      outbox.template accessContiguousInTx</*AllowPartial=*/true>(
+          std::min(bytesLeft, maxLen));
+  TP_THROW_SYSTEM_IF(numBuffers < 0, -numBuffers);
+
+  size_t bytesAvailable = 0;
+  for (ssize_t bufferIdx = 0; bufferIdx < numBuffers; bufferIdx++) {
+    bytesAvailable += buffers[bufferIdx].len;
+  }
+  if (bytesAvailable > 0 && bytesAvailable >= std::min(bytesLeft, minLen)) {
+    for (ssize_t bufferIdx = 0; bufferIdx < numBuffers; bufferIdx++) {
+      copies.push_back(RingbufferCopy{
+          .dst = buffers[bufferIdx].ptr,
+          .src = reinterpret_cast<const uint8_t*>(ptr_) + bytesReserved_,
+          .len = buffers[bufferIdx].len,
+      });
+      bytesReserved_ += buffers[bufferIdx].len;
+    }
+  }
+
+  // The reservation is tracked by this operation, not by the ringbuffer.
+  ret = outbox.cancelTx();
+  TP_THROW_SYSTEM_IF(ret < 0, -ret);
+
+  return bytesWrittenNow;
+}
+
+template <int NumRoles, int RoleIdx>
+size_t RingbufferWriteOperation::commitPayload(
+    RingBufferRole<NumRoles, RoleIdx>& outbox,
+    size_t len) {
+  TP_DCHECK_LE(bytesWritten_ + len, bytesReserved_);
+  ssize_t ret;
+
+  ret = outbox.startTx();
+  TP_THROW_SYSTEM_IF(ret < 0, -ret);
+  ret = outbox.incMarkerInTx(len);
+  TP_THROW_SYSTEM_IF(ret < 0, -ret);
+  ret = outbox.commitTx();
+  TP_THROW_SYSTEM_IF(ret < 0, -ret);
+
+  bytesWritten_ += len;
+  if (completed()) {
+    fn_(Error::kSuccess);
+  }
+
+  return len;
+}
+
 void RingbufferWriteOperation::handleError(const Error& error) {
   fn_(error);
 }
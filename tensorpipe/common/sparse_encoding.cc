@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <tensorpipe/common/sparse_encoding.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace tensorpipe {
+
+namespace {
+
+constexpr size_t kWordSize = sizeof(uint32_t);
+constexpr size_t kWordsPerBlock = 64;
+constexpr size_t kBlockSize = sizeof(uint64_t);
+
+size_t numBlocksForWords(size_t numWords) {
+  return (numWords + kWordsPerBlock - 1) / kWordsPerBlock;
+}
+
+// The buffers have no alignment guarantees, hence all accesses go through
+// memcpy, which compilers turn into plain (unaligned) loads and stores.
+uint32_t loadWord(const uint8_t* ptr) {
+  uint32_t word;
+  std::memcpy(&word, ptr, kWordSize);
+  return word;
+}
+
+uint64_t loadBlock(const uint8_t* ptr) {
+  uint64_t block;
+  std::memcpy(&block, ptr, kBlockSize);
+  return block;
+}
+
+} // namespace
+
+size_t countNonZeroWords(const void* ptr, size_t length) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(ptr);
+  const size_t numWords = length / kWordSize;
+  size_t numNonZeroWords = 0;
+  for (size_t wordIdx = 0; wordIdx < numWords; wordIdx++) {
+    numNonZeroWords += loadWord(bytes + wordIdx * kWordSize) != 0 ? 1 : 0;
+  }
+  return numNonZeroWords;
+}
+
+size_t sparseEncodedLength(size_t length, size_t numNonZeroWords) {
+  const size_t numWords = length / kWordSize;
+  return numBlocksForWords(numWords) * kBlockSize +
+      numNonZeroWords * kWordSize + length % kWordSize;
+}
+
+void encodeSparse(const void* src, size_t length, void* dst) {
+  const uint8_t* srcBytes = reinterpret_cast<const uint8_t*>(src);
+  uint8_t* dstBytes = reinterpret_cast<uint8_t*>(dst);
+  const size_t numWords = length / kWordSize;
+  const size_t numBlocks = numBlocksForWords(numWords);
+
+  uint8_t* bitmap = dstBytes;
+  uint8_t* values = dstBytes + numBlocks * kBlockSize;
+  for (size_t blockIdx = 0; blockIdx < numBlocks; blockIdx++) {
+    const size_t firstWordIdx = blockIdx * kWordsPerBlock;
+    const size_t numWordsInBlock =
+        std::min(kWordsPerBlock, numWords - firstWordIdx);
+    const uint8_t* blockBytes = srcBytes + firstWordIdx * kWordSize;
+    uint64_t mask = 0;
+    for (size_t wordIdx = 0; wordIdx < numWordsInBlock; wordIdx++) {
+      mask |= static_cast<uint64_t>(
+                  loadWord(blockBytes + wordIdx * kWordSize) != 0)
+          << wordIdx;
+    }
+    std::memcpy(bitmap + blockIdx * kBlockSize, &mask, kBlockSize);
+    while (mask != 0) {
+      const size_t wordIdx = __builtin_ctzll(mask);
+      std::memcpy(values, blockBytes + wordIdx * kWordSize, kWordSize);
+      values += kWordSize;
+      mask &= mask - 1;
+    }
+  }
+
+  std::memcpy(values, srcBytes + numWords * kWordSize, length % kWordSize);
+}
+
+bool decodeSparse(
+    const void* src,
+    size_t encodedLength,
+    void* dst,
+    size_t length) {
+  const uint8_t* srcBytes = reinterpret_cast<const uint8_t*>(src);
+  uint8_t* dstBytes = reinterpret_cast<uint8_t*>(dst);
+  const size_t numWords = length / kWordSize;
+  const size_t numBlocks = numBlocksForWords(numWords);
+
+  // Check the encoding before writing anything, in order to never read or
+  // write out of bounds.
+  if (encodedLength < sparseEncodedLength(length, 0)) {
+    return false;
+  }
+  const uint8_t* bitmap = srcBytes;
+  size_t numNonZeroWords = 0;
+  for (size_t blockIdx = 0; blockIdx < numBlocks; blockIdx++) {
+    numNonZeroWords +=
+        __builtin_popcountll(loadBlock(bitmap + blockIdx * kBlockSize));
+  }
+  if (encodedLength != sparseEncodedLength(length, numNonZeroWords)) {
+    return false;
+  }
+  if (numBlocks > 0) {
+    const uint64_t lastMask =
+        loadBlock(bitmap + (numBlocks - 1) * kBlockSize);
+    const size_t numWordsInLastBlock =
+        numWords - (numBlocks - 1) * kWordsPerBlock;
+    // Bits past the end of the buffer would make us write out of bounds.
+    if (numWordsInLastBlock < kWordsPerBlock &&
+        (lastMask >> numWordsInLastBlock) != 0) {
+      return false;
+    }
+  }
+
+  std::memset(dstBytes, 0, numWords * kWordSize);
+  const uint8_t* values = srcBytes + numBlocks * kBlockSize;
+  for (size_t blockIdx = 0; blockIdx < numBlocks; blockIdx++) {
+    uint8_t* blockBytes = dstBytes + blockIdx * kWordsPerBlock * kWordSize;
+    uint64_t mask = loadBlock(bitmap + blockIdx * kBlockSize);
+    while (mask != 0) {
+      const size_t wordIdx = __builtin_ctzll(mask);
+      std::memcpy(blockBytes + wordIdx * kWordSize, values, kWordSize);
+      values += kWordSize;
+      mask &= mask - 1;
+    }
+  }
+
+  std::memcpy(dstBytes + numWords * kWordSize, values, length % kWordSize);
+  return true;
+}
+
+} // namespace tensorpipe
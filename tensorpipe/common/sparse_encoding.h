@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace tensorpipe {
+
+// A lossless encoding for buffers that are mostly made of zeros, which looks at
+// them as a sequence of 4-byte words (the size of the most common element
+// types) and stores a bitmap telling which words aren't zero, then the values
+// of those words, then the trailing bytes that don't make up a whole word. The
+// bitmap is made of 8-byte blocks, each covering 64 words.
+//
+// The loops that look at every word are written so that compilers vectorize
+// them, whereas the ones that only look at the non-zero words skip over the
+// others a block at a time.
+
+// Return how many 4-byte words of the buffer aren't zero.
+size_t countNonZeroWords(const void* ptr, size_t length);
+
+// Return the length of the encoding of a buffer of the given length with the
+// given number of non-zero words.
+size_t sparseEncodedLength(size_t length, size_t numNonZeroWords);
+
+// Encode the buffer into the destination, which must be as long as returned by
+// sparseEncodedLength.
+void encodeSparse(const void* src, size_t length, void* dst);
+
+// Reconstruct the buffer of the given length from its encoding. The encoding
+// usually comes from a peer, hence it's checked before anything is written: if
+// it isn't consistent with that length, return false and leave dst untouched.
+bool decodeSparse(
+    const void* src,
+    size_t encodedLength,
+    void* dst,
+    size_t length);
+
+} // namespace tensorpipe
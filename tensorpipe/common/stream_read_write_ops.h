@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <functional>
 #include <memory>
@@ -20,6 +21,10 @@
 
 namespace tensorpipe {
 
+// The largest chunk in which the data of a read with no destination buffer is
+// drained from the stream, which is all the memory it needs to do so.
+constexpr size_t kStreamDiscardWindowLength = 64 * 1024;
+
 // The read operation captures all state associated with reading a
 // fixed length chunk of data from the underlying connection. All
 // reads are required to include a word-sized header containing the
@@ -38,7 +43,13 @@ class StreamReadOperation {
   using read_callback_fn =
       std::function<void(const Error& error, const void* ptr, size_t len)>;
 
-  explicit inline StreamReadOperation(read_callback_fn fn);
+  // Allocate the buffer of the given length into which to read the payload, if
+  // no length was specified by the user. It's released after the callback.
+  using alloc_fn = std::function<std::shared_ptr<char>(size_t length)>;
+
+  explicit inline StreamReadOperation(
+      read_callback_fn fn,
+      alloc_fn allocFn = nullptr);
 
   inline StreamReadOperation(void* ptr, size_t length, read_callback_fn fn);
 
@@ -51,6 +62,10 @@ class StreamReadOperation {
   // Returns if this read operation is complete.
   inline bool completeFromLoop() const;
 
+  // Returns if the payload is being read into a buffer that this operation
+  // allocated, rather than into memory provided by the user.
+  inline bool readingPayloadIntoOwnBufferFromLoop() const;
+
   // Invoke user callback.
   inline void callbackFromLoop(const Error& error);
 
@@ -69,14 +84,23 @@ class StreamReadOperation {
   size_t bytesRead_{0};
 
   // Holds temporary allocation if no length was specified.
-  std::unique_ptr<char[]> buffer_{nullptr};
+  std::shared_ptr<char> buffer_{nullptr};
+
+  // Reused for each chunk of the data if it's being discarded, i.e., if a
+  // length but no pointer was specified.
+  std::unique_ptr<char[]> discardWindow_;
 
   // User callback.
   read_callback_fn fn_;
+
+  // Custom allocator for the temporary buffer, if any.
+  alloc_fn allocFn_;
 };
 
-StreamReadOperation::StreamReadOperation(read_callback_fn fn)
-    : fn_(std::move(fn)) {}
+StreamReadOperation::StreamReadOperation(
+    read_callback_fn fn,
+    alloc_fn allocFn)
+    : fn_(std::move(fn)), allocFn_(std::move(allocFn)) {}
 
 StreamReadOperation::StreamReadOperation(
     void* ptr,
@@ -91,9 +115,19 @@ void StreamReadOperation::allocFromLoop(char** base, size_t* len) {
     *len = sizeof(readLength_) - bytesRead_;
   } else if (mode_ == READ_PAYLOAD) {
     TP_DCHECK_LT(bytesRead_, readLength_);
-    TP_DCHECK(ptr_ != nullptr);
-    *base = ptr_ + bytesRead_;
-    *len = readLength_ - bytesRead_;
+    if (ptr_ == nullptr) {
+      TP_DCHECK(givenLength_.has_value());
+      const size_t windowLength =
+          std::min(readLength_, kStreamDiscardWindowLength);
+      if (discardWindow_ == nullptr) {
+        discardWindow_ = std::make_unique<char[]>(windowLength);
+      }
+      *base = discardWindow_.get();
+      *len = std::min(readLength_ - bytesRead_, windowLength);
+    } else {
+      *base = ptr_ + bytesRead_;
+      *len = readLength_ - bytesRead_;
+    }
   } else {
     TP_THROW_ASSERT() << "invalid mode " << mode_;
   }
@@ -105,11 +139,15 @@ void StreamReadOperation::readFromLoop(size_t nread) {
     TP_DCHECK_LE(bytesRead_, sizeof(readLength_));
     if (bytesRead_ == sizeof(readLength_)) {
       if (givenLength_.has_value()) {
-        TP_DCHECK(ptr_ != nullptr || givenLength_.value() == 0);
         TP_DCHECK_EQ(readLength_, givenLength_.value());
       } else {
         TP_DCHECK(ptr_ == nullptr);
-        buffer_ = std::make_unique<char[]>(readLength_);
+        if (allocFn_) {
+          buffer_ = allocFn_(readLength_);
+        } else {
+          buffer_ = std::shared_ptr<char>(
+              new char[readLength_](), std::default_delete<char[]>());
+        }
         ptr_ = buffer_.get();
       }
       if (readLength_ == 0) {
@@ -133,6 +171,10 @@ bool StreamReadOperation::completeFromLoop() const {
   return mode_ == COMPLETE;
 }
 
+bool StreamReadOperation::readingPayloadIntoOwnBufferFromLoop() const {
+  return mode_ == READ_PAYLOAD && !givenLength_.has_value();
+}
+
 void StreamReadOperation::callbackFromLoop(const Error& error) {
   fn_(error, ptr_, readLength_);
 }
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <tensorpipe/common/system.h>
+
+namespace tensorpipe {
+
+// A thread that runs each task it's given once its time has come, in order of
+// time, meant for the few deadlines that must be enforced even when no event
+// would otherwise wake up the loop. The tasks should be short, e.g., defer some
+// work to a loop, as they delay the ones that come after them.
+class TimerThread final {
+ public:
+  using TClock = std::chrono::steady_clock;
+
+  explicit TimerThread(std::string threadName) {
+    thread_ = std::thread([this, threadName{std::move(threadName)}]() {
+      setThreadName(threadName);
+      loop();
+    });
+  }
+
+  void schedule(TClock::time_point when, std::function<void()> fn) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (closed_) {
+      return;
+    }
+    tasks_.emplace(when, std::move(fn));
+    cv_.notify_all();
+  }
+
+  // The tasks that haven't run yet are dropped, as are the later ones.
+  void close() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    closed_ = true;
+    tasks_.clear();
+    cv_.notify_all();
+  }
+
+  void join() {
+    close();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (joined_) {
+      return;
+    }
+    joined_ = true;
+    lock.unlock();
+    thread_.join();
+  }
+
+  ~TimerThread() {
+    join();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool closed_{false};
+  bool joined_{false};
+  std::multimap<TClock::time_point, std::function<void()>> tasks_;
+  std::thread thread_;
+
+  void loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!closed_) {
+      if (tasks_.empty()) {
+        cv_.wait(lock);
+        continue;
+      }
+      const TClock::time_point when = tasks_.begin()->first;
+      if (TClock::now() < when) {
+        cv_.wait_until(lock, when);
+        continue;
+      }
+
+      std::function<void()> task = std::move(tasks_.begin()->second);
+      tasks_.erase(tasks_.begin());
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+  }
+};
+
+} // namespace tensorpipe
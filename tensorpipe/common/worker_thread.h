@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <tensorpipe/common/optional.h>
+#include <tensorpipe/common/queue.h>
+#include <tensorpipe/common/system.h>
+
+namespace tensorpipe {
+
+// A thread that runs the tasks it's given one after the other, meant for the
+// blocking operations (e.g., copies) that channels can't perform on a loop. It
+// can be owned by a single context or shared by several ones.
+class WorkerThread final {
+ public:
+  explicit WorkerThread(std::string threadName) {
+    thread_ = std::thread([this, threadName{std::move(threadName)}]() {
+      setThreadName(threadName);
+      loop();
+    });
+  }
+
+  void post(std::function<void()> fn) {
+    tasks_.push(std::move(fn));
+  }
+
+  // The tasks that were posted before closing are still run, the later ones
+  // are dropped.
+  void close() {
+    if (!closed_.exchange(true)) {
+      tasks_.push(nullopt);
+    }
+  }
+
+  void join() {
+    close();
+
+    if (!joined_.exchange(true)) {
+      thread_.join();
+    }
+  }
+
+  ~WorkerThread() {
+    join();
+  }
+
+ private:
+  Queue<optional<std::function<void()>>> tasks_{
+      std::numeric_limits<int>::max()};
+  std::atomic<bool> closed_{false};
+  std::atomic<bool> joined_{false};
+  std::thread thread_;
+
+  void loop() {
+    while (true) {
+      optional<std::function<void()>> task = tasks_.pop();
+      if (!task.has_value()) {
+        break;
+      }
+      task.value()();
+    }
+  }
+};
+
+} // namespace tensorpipe
@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <utility>
@@ -33,8 +35,50 @@ class ContextOptions {
     return std::move(*this);
   }
 
+  // Have the pipes of this context coalesce small messages (those without
+  // tensors and with at most maxBatchSize bytes of payloads) into batches that
+  // are sent with a single write. A message is written right away when nothing
+  // else is, otherwise it waits for the ongoing batch to have been written, for
+  // the pending one to reach maxBatchSize bytes, or for the oldest message in it
+  // to have waited for the window, which a thread of the context enforces. The
+  // payloads of a batch are copied one after the other into a single buffer, on
+  // the loop, and the remote pipe unpacks them by copying them again into the
+  // allocations it's given, which is only worth it for small messages. When
+  // neither end has enabled batching (nor warm-ups) each descriptor is sent on
+  // its own, without the framing that batches need, but this doesn't make the
+  // pipe compatible with older versions of TensorPipe (see nop_types.h).
+  ContextOptions&& writeBatching(
+      std::chrono::microseconds window,
+      size_t maxBatchSize) && {
+    writeBatchingWindow_ = window;
+    writeBatchingMaxBatchSize_ = maxBatchSize;
+    return std::move(*this);
+  }
+
+  // Allow the pipes of this context to carry streams (see Stream). These need
+  // a connection of their own, which is only opened, when the pipe is set up,
+  // if at least one of its two ends has enabled them. Otherwise the operations
+  // on streams fail with a StreamsNotEnabledError.
+  ContextOptions&& enableStreams() && {
+    enableStreams_ = true;
+    return std::move(*this);
+  }
+
+  // Allow the pipes of this context to be warmed up (see Pipe::warmup). The
+  // remote side needs to tell the warm-up messages apart, which changes how
+  // messages are framed on the pipes of which at least one end has enabled
+  // this. Otherwise warmup fails with a WarmupNotEnabledError.
+  ContextOptions&& enableWarmup() && {
+    enableWarmup_ = true;
+    return std::move(*this);
+  }
+
  private:
   std::string name_;
+  std::chrono::microseconds writeBatchingWindow_{0};
+  size_t writeBatchingMaxBatchSize_{0};
+  bool enableStreams_{false};
+  bool enableWarmup_{false};
 
   friend ContextImpl;
 };
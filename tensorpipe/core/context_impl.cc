@@ -49,12 +49,18 @@ std::string createContextId() {
 } // namespace
 
 ContextImpl::ContextImpl(ContextOptions opts)
-    : id_(createContextId()), name_(std::move(opts.name_)) {
+    : id_(createContextId()),
+      name_(std::move(opts.name_)),
+      writeBatchingWindow_(opts.writeBatchingWindow_),
+      writeBatchingMaxBatchSize_(opts.writeBatchingMaxBatchSize_),
+      streamsEnabled_(opts.enableStreams_),
+      warmupEnabled_(opts.enableWarmup_) {
   TP_VLOG(1) << "Context " << id_ << " created";
   if (name_ != "") {
     TP_VLOG(1) << "Context " << id_ << " aliased as " << name_;
     id_ = name_;
   }
+  loop_.getLoopStats().setName("context " + id_);
 }
 
 void ContextImpl::init() {
@@ -170,6 +176,22 @@ const std::string& ContextImpl::getName() {
   return name_;
 }
 
+std::chrono::microseconds ContextImpl::getWriteBatchingWindow() {
+  return writeBatchingWindow_;
+}
+
+size_t ContextImpl::getWriteBatchingMaxBatchSize() {
+  return writeBatchingMaxBatchSize_;
+}
+
+bool ContextImpl::getStreamsEnabled() {
+  return streamsEnabled_;
+}
+
+bool ContextImpl::getWarmupEnabled() {
+  return warmupEnabled_;
+}
+
 void ContextImpl::enroll(ListenerImpl& listener) {
   TP_DCHECK(inLoop());
   bool wasInserted;
@@ -198,6 +220,26 @@ void ContextImpl::unenroll(PipeImpl& pipe) {
   TP_DCHECK_EQ(numRemoved, 1);
 }
 
+void ContextImpl::postToWorker(std::function<void()> fn) {
+  TP_DCHECK(inLoop());
+  if (worker_ == nullptr) {
+    worker_ = std::make_unique<WorkerThread>("TP_CORE_worker");
+  }
+  worker_->post(std::move(fn));
+}
+
+void ContextImpl::deferToLoopAt(
+    TimerThread::TClock::time_point when,
+    TTask fn) {
+  TP_DCHECK(inLoop());
+  if (timer_ == nullptr) {
+    timer_ = std::make_unique<TimerThread>("TP_CORE_timer");
+  }
+  timer_->schedule(when, [this, fn{std::move(fn)}]() mutable {
+    deferToLoop(std::move(fn));
+  });
+}
+
 bool ContextImpl::closed() {
   TP_DCHECK(inLoop());
   return error_;
@@ -258,6 +300,9 @@ void ContextImpl::handleError() {
   for (auto& iter : channels_) {
     iter.second->close();
   }
+  if (timer_ != nullptr) {
+    timer_->close();
+  }
 }
 
 void ContextImpl::join() {
@@ -280,6 +325,12 @@ void ContextImpl::join() {
     for (auto& iter : channels_) {
       iter.second->join();
     }
+    if (worker_ != nullptr) {
+      worker_->join();
+    }
+    if (timer_ != nullptr) {
+      timer_->join();
+    }
 
     TP_VLOG(1) << "Context " << id_ << " done joining";
 
@@ -9,6 +9,8 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -18,6 +20,8 @@
 
 #include <tensorpipe/channel/context.h>
 #include <tensorpipe/common/callback.h>
+#include <tensorpipe/common/timer_thread.h>
+#include <tensorpipe/common/worker_thread.h>
 #include <tensorpipe/core/context.h>
 #include <tensorpipe/transport/context.h>
 
@@ -66,6 +70,13 @@ class ContextImpl final : public virtual DeferredExecutor,
   // by the pipes and listener in order to attach it to logged messages.
   const std::string& getName();
 
+  // Return the write batching settings given to the context's constructor. A
+  // batch size of zero means that the pipes shouldn't batch their writes.
+  std::chrono::microseconds getWriteBatchingWindow();
+  size_t getWriteBatchingMaxBatchSize();
+  bool getStreamsEnabled();
+  bool getWarmupEnabled();
+
   // Enrolling dependent objects (listeners and pipes) causes them to be kept
   // alive for as long as the context exists. These objects should enroll
   // themselves as soon as they're created (in their initFromLoop method) and
@@ -78,6 +89,17 @@ class ContextImpl final : public virtual DeferredExecutor,
   void unenroll(ListenerImpl& listener);
   void unenroll(PipeImpl& pipe);
 
+  // Run a task that's too expensive to be run on the loop (e.g., decoding a
+  // sparse tensor) on a thread of the context, which is started the first time
+  // it's needed. This must be called from within the loop.
+  void postToWorker(std::function<void()> fn);
+
+  // Defer a task to the loop once the given time has come, through a thread of
+  // the context that's started the first time it's needed. The tasks that are
+  // still pending when the context is closed are dropped. This must be called
+  // from within the loop.
+  void deferToLoopAt(TimerThread::TClock::time_point when, TTask fn);
+
   // Return whether the context is in a closed state. To avoid race conditions,
   // this must be called from within the loop.
   bool closed();
@@ -122,6 +144,16 @@ class ContextImpl final : public virtual DeferredExecutor,
   // identify the endpoints of a pipe.
   std::string name_;
 
+  // See ContextOptions::writeBatching.
+  const std::chrono::microseconds writeBatchingWindow_;
+  const size_t writeBatchingMaxBatchSize_;
+
+  // See ContextOptions::enableStreams.
+  const bool streamsEnabled_;
+
+  // See ContextOptions::enableWarmup.
+  const bool warmupEnabled_;
+
   std::unordered_map<std::string, std::shared_ptr<transport::Context>>
       transports_;
 
@@ -133,6 +165,13 @@ class ContextImpl final : public virtual DeferredExecutor,
 
   TOrderedChannels channelsByPriority_;
 
+  // See postToWorker. It's only created and used from within the loop, and is
+  // joined once the context is closed, hence no pipe can post to it anymore.
+  std::unique_ptr<WorkerThread> worker_;
+
+  // See deferToLoopAt. Its lifetime follows the same rules as the worker's.
+  std::unique_ptr<TimerThread> timer_;
+
   CallbackWrapper<ContextImpl> callbackWrapper_{*this, *this};
 
   void initFromLoop();
@@ -30,4 +30,24 @@ std::string PipeClosedError::what() const {
   return "pipe closed";
 }
 
+std::string MessageExpiredError::what() const {
+  return "message expired";
+}
+
+std::string StreamEndedError::what() const {
+  return "stream ended";
+}
+
+std::string StreamsNotEnabledError::what() const {
+  return "streams not enabled";
+}
+
+std::string WarmupNotEnabledError::what() const {
+  return "warmup not enabled";
+}
+
+std::string SparseEncodingError::what() const {
+  return "invalid sparse encoding";
+}
+
 } // namespace tensorpipe
@@ -45,4 +45,50 @@ class PipeClosedError final : public BaseError {
   std::string what() const override;
 };
 
+// Reported for a single message, whose deadline passed before it could be
+// written or delivered. Unlike the other errors, the pipe remains usable.
+class MessageExpiredError final : public BaseError {
+ public:
+  explicit MessageExpiredError() {}
+
+  std::string what() const override;
+};
+
+// Reported to the reads of a stream once the remote side has ended it and all
+// the data it wrote has been consumed. Unlike the other errors, the pipe and
+// its other streams remain usable.
+class StreamEndedError final : public BaseError {
+ public:
+  explicit StreamEndedError() {}
+
+  std::string what() const override;
+};
+
+// Reported to the operations on streams when neither end of the pipe has
+// enabled them (see ContextOptions::enableStreams).
+class StreamsNotEnabledError final : public BaseError {
+ public:
+  explicit StreamsNotEnabledError() {}
+
+  std::string what() const override;
+};
+
+// Reported to warmup when the context of the pipe doesn't allow it (see
+// ContextOptions::enableWarmup).
+class WarmupNotEnabledError final : public BaseError {
+ public:
+  explicit WarmupNotEnabledError() {}
+
+  std::string what() const override;
+};
+
+// Set on the pipe when the peer sent a tensor in the sparse encoding (see
+// Message::Tensor::sparseEncodingThreshold) that can't be decoded.
+class SparseEncodingError final : public BaseError {
+ public:
+  explicit SparseEncodingError() {}
+
+  std::string what() const override;
+};
+
 } // namespace tensorpipe
@@ -23,6 +23,13 @@
 
 namespace tensorpipe {
 
+// The wire format of pipes isn't versioned, and nop structures only decode if
+// they have the same fields as the ones they were encoded from. Hence the two
+// ends of a pipe must run the same version of TensorPipe. In particular, the
+// fields for streams and descriptor packets in the brochure, and the ones for
+// deadlines, tags and sparse tensors in the descriptor, are always sent, even
+// when unused, so pipes can't connect to versions from before they were added.
+
 struct SpontaneousConnection {
   std::string contextName;
   NOP_STRUCTURE(SpontaneousConnection, contextName);
@@ -39,7 +46,14 @@ struct Brochure {
   std::unordered_map<std::string, std::string> transportDomainDescriptors;
   std::unordered_map<std::string, std::unordered_map<Device, std::string>>
       channelDeviceDescriptors;
-  NOP_STRUCTURE(Brochure, transportDomainDescriptors, channelDeviceDescriptors);
+  bool streamsEnabled{false};
+  bool descriptorPacketsEnabled{false};
+  NOP_STRUCTURE(
+      Brochure,
+      transportDomainDescriptors,
+      channelDeviceDescriptors,
+      streamsEnabled,
+      descriptorPacketsEnabled);
 };
 
 struct BrochureAnswer {
@@ -52,6 +66,7 @@ struct BrochureAnswer {
       channelDeviceDescriptors;
   std::unordered_map<std::pair<Device, Device>, std::string>
       channelForDevicePair;
+  bool descriptorPacketsEnabled{false};
   NOP_STRUCTURE(
       BrochureAnswer,
       transport,
@@ -60,7 +75,8 @@ struct BrochureAnswer {
       transportDomainDescriptor,
       channelRegistrationIds,
       channelDeviceDescriptors,
-      channelForDevicePair);
+      channelForDevicePair,
+      descriptorPacketsEnabled);
 };
 
 NOP_EXTERNAL_STRUCTURE(Descriptor::Payload, length, metadata);
@@ -69,8 +85,44 @@ NOP_EXTERNAL_STRUCTURE(
     length,
     sourceDevice,
     targetDevice,
-    metadata);
-NOP_EXTERNAL_STRUCTURE(Descriptor, metadata, payloads, tensors);
+    metadata,
+    sparseLength);
+NOP_EXTERNAL_STRUCTURE(
+    Descriptor,
+    metadata,
+    payloads,
+    tensors,
+    deadline,
+    tag);
+
+// A small message sent as part of a batch (see ContextOptions::writeBatching),
+// with the contents of all its payloads, one after the other.
+struct BatchedMessage {
+  Descriptor descriptor;
+  std::string payloadData;
+  NOP_STRUCTURE(BatchedMessage, descriptor, payloadData);
+};
+
+struct DescriptorBatch {
+  std::vector<BatchedMessage> messages;
+  NOP_STRUCTURE(DescriptorBatch, messages);
+};
+
+// A synthetic message written by Pipe::warmup, which the receiver drains and
+// drops rather than delivering it to the user, and then writes back as an echo
+// (which isn't echoed in turn). Its payloads follow it.
+struct WarmupMessage {
+  Descriptor descriptor;
+  bool echo{false};
+  NOP_STRUCTURE(WarmupMessage, descriptor, echo);
+};
+
+// What's sent on the descriptor connection for each message (or batch of them)
+// that's written, if either end of the pipe needs it (i.e., has enabled write
+// batching or warm-ups), as otherwise the descriptors are sent on their own.
+// The payloads of a lone descriptor follow it separately.
+using DescriptorPacket =
+    nop::Variant<Descriptor, DescriptorBatch, WarmupMessage>;
 
 struct DescriptorReply {
   std::vector<Device> targetDevices;
@@ -79,4 +131,27 @@ struct DescriptorReply {
 
 using Packet = nop::Variant<SpontaneousConnection, RequestedConnection>;
 
+// Sent by the reader of a stream when it posts a buffer, of the given length.
+struct StreamCredit {
+  uint64_t streamId;
+  uint64_t length;
+  NOP_STRUCTURE(StreamCredit, streamId, length);
+};
+
+// Sent by the writer of a stream, followed by the given number of bytes, which
+// are destined to the oldest buffer for which no data has been sent yet.
+struct StreamData {
+  uint64_t streamId;
+  uint64_t length;
+  NOP_STRUCTURE(StreamData, streamId, length);
+};
+
+// Sent by the writer of a stream after all its data.
+struct StreamEnd {
+  uint64_t streamId;
+  NOP_STRUCTURE(StreamEnd, streamId);
+};
+
+using StreamPacket = nop::Variant<StreamCredit, StreamData, StreamEnd>;
+
 } // namespace tensorpipe
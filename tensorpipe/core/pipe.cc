@@ -37,6 +37,14 @@ const std::string& Pipe::getRemoteName() {
   return impl_->getRemoteName();
 }
 
+Pipe::ExpiryStats Pipe::getExpiryStats() {
+  return impl_->getExpiryStats();
+}
+
+Pipe::BatchingStats Pipe::getBatchingStats() {
+  return impl_->getBatchingStats();
+}
+
 Pipe::~Pipe() {
   close();
 }
@@ -53,8 +61,24 @@ void Pipe::read(Allocation allocation, read_callback_fn fn) {
   impl_->read(std::move(allocation), std::move(fn));
 }
 
+void Pipe::readDescriptor(uint64_t tag, read_descriptor_callback_fn fn) {
+  impl_->readDescriptor(tag, std::move(fn));
+}
+
+void Pipe::read(uint64_t tag, Allocation allocation, read_callback_fn fn) {
+  impl_->read(tag, std::move(allocation), std::move(fn));
+}
+
 void Pipe::write(Message message, write_callback_fn fn) {
   impl_->write(std::move(message), std::move(fn));
 }
 
+void Pipe::warmup(WarmupProfile profile, warmup_callback_fn fn) {
+  impl_->warmup(std::move(profile), std::move(fn));
+}
+
+Stream Pipe::openStream(uint64_t id) {
+  return Stream(impl_, id);
+}
+
 } // namespace tensorpipe
@@ -8,12 +8,15 @@
 
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <tensorpipe/common/error.h>
 #include <tensorpipe/core/message.h>
+#include <tensorpipe/core/stream.h>
 #include <tensorpipe/transport/context.h>
 
 namespace tensorpipe {
@@ -72,6 +75,84 @@ class Pipe final {
 
   void write(Message message, write_callback_fn fn);
 
+  // The synthetic messages that warmup writes: each round has one message of
+  // each size, made of a payload and of a CPU tensor of that size.
+  struct WarmupProfile {
+    std::vector<size_t> sizes;
+    size_t numRounds{1};
+  };
+
+  using warmup_callback_fn = std::function<void(const Error&)>;
+
+  // Bring the pipe to its steady-state performance before it's used, by having
+  // the callback fire only once the handshake is complete and the messages of
+  // the given profile made a round trip through the connection and the channel,
+  // hence faulting in the buffers of both (e.g., the rings of the shm
+  // transport) in both directions. The remote side receives each message into
+  // a scratch buffer, writes it back from there, and drops it, all on its own,
+  // without the user having to read anything. The messages are ordered with
+  // the ones written by the user on each side, hence it's better to not issue
+  // any writes before the callback fires. A profile without messages is a
+  // no-op, whose callback fires right away. This needs the context of this pipe
+  // to allow it (see ContextOptions::enableWarmup).
+  void warmup(WarmupProfile profile, warmup_callback_fn fn);
+
+  // Tagged reads, for pipes that carry several independent flows of messages
+  // (told apart by Message::tag), so that each flow can be consumed by its own
+  // thread without an intermediate demultiplexer. A tagged readDescriptor is
+  // matched with the next message that has that tag, and the following tagged
+  // read with the same tag provides the allocation for that message. Within a
+  // tag, messages are delivered in the order in which they were written.
+  //
+  // Messages that arrive before a readDescriptor for their tag was issued are
+  // received ahead of time into buffers owned by the pipe (up to a limit), so
+  // that they don't hold back the messages of other tags, and are copied into
+  // the user's allocation once it's provided. This is only possible if all
+  // their tensors can be received into host memory, and the descriptors of the
+  // messages buffered in this way ask for all their tensors to be allocated on
+  // the CPU. Beyond the limit, or for messages that can't be buffered, the pipe
+  // stops receiving until they are matched. The same holds while a matched
+  // message waits for its allocation, hence users should provide it promptly.
+  //
+  // Tagged and untagged reads can't be mixed on the same pipe.
+  void readDescriptor(uint64_t tag, read_descriptor_callback_fn fn);
+
+  void read(uint64_t tag, Allocation allocation, read_callback_fn fn);
+
+  // Obtain a handle to the stream with the given identifier. See Stream for
+  // how streams are used.
+  Stream openStream(uint64_t id);
+
+  // Counters of the messages that were dropped by this pipe because their
+  // deadline had passed (see Message::deadline). Writes are shed before any of
+  // their data is sent, whereas reads are shed after their data was received
+  // but before asking the user for an allocation.
+  struct ExpiryStats {
+    uint64_t numWritesShed{0};
+    uint64_t numBytesOfWritesShed{0};
+    uint64_t numReadsShed{0};
+    uint64_t numBytesOfReadsShed{0};
+  };
+
+  // The counters are updated from the event loop, hence they may lag behind
+  // the callbacks that have been invoked.
+  ExpiryStats getExpiryStats();
+
+  // Counters of the messages that this pipe wrote as part of a batch (see
+  // ContextOptions::writeBatching). The delay is the time a message spent
+  // waiting for its batch to be written, on top of what it'd otherwise take.
+  struct BatchingStats {
+    uint64_t numBatches{0};
+    uint64_t numMessagesBatched{0};
+    uint64_t numBytesBatched{0};
+    uint64_t totalBatchingDelayNs{0};
+    uint64_t maxBatchingDelayNs{0};
+  };
+
+  // The counters are updated from the event loop, hence they may lag behind
+  // the callbacks that have been invoked.
+  BatchingStats getBatchingStats();
+
   // Retrieve the user-defined name that was given to the constructor of the
   // context on the remote side, if any (if not, this will be the empty string).
   // This is intended to help in logging and debugging only.
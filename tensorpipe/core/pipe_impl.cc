@@ -8,6 +8,9 @@
 
 #include <tensorpipe/core/pipe_impl.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
 #include <map>
 #include <memory>
 #include <tuple>
@@ -15,8 +18,10 @@
 #include <utility>
 
 #include <tensorpipe/common/address.h>
+#include <tensorpipe/common/cpu_buffer.h>
 #include <tensorpipe/common/defs.h>
 #include <tensorpipe/common/error_macros.h>
+#include <tensorpipe/common/sparse_encoding.h>
 #include <tensorpipe/core/context_impl.h>
 #include <tensorpipe/core/error.h>
 #include <tensorpipe/core/listener.h>
@@ -64,15 +69,15 @@ void checkAllocationCompatibility(
   }
 }
 
-// Produce a nop object containing a message descriptor using the information
-// contained in the WriteOperation: number and sizes of payloads and tensors,
-// tensor descriptors, ...
-std::shared_ptr<NopHolder<Descriptor>> makeDescriptorForMessage(
-    const WriteOperation& op) {
-  auto nopHolderOut = std::make_shared<NopHolder<Descriptor>>();
-  Descriptor& nopDescriptor = nopHolderOut->getObject();
+// Produce a message descriptor using the information contained in the
+// WriteOperation: number and sizes of payloads and tensors, tensor
+// descriptors, ...
+Descriptor makeDescriptorForMessage(const WriteOperation& op) {
+  Descriptor nopDescriptor;
 
   nopDescriptor.metadata = op.message.metadata;
+  nopDescriptor.deadline = op.message.deadline;
+  nopDescriptor.tag = op.message.tag;
 
   for (int payloadIdx = 0; payloadIdx < op.message.payloads.size();
        ++payloadIdx) {
@@ -94,9 +99,44 @@ std::shared_ptr<NopHolder<Descriptor>> makeDescriptorForMessage(
       nopTensorDescriptor.targetDevice = tensor.targetDevice.value();
     }
     nopTensorDescriptor.length = tensor.length;
+    nopTensorDescriptor.sparseLength = op.tensors[tensorIdx].sparse.length;
   }
 
-  return nopHolderOut;
+  return nopDescriptor;
+}
+
+// Encode the tensors that are sparse enough for the threshold their sender set,
+// and have them be received in host memory, where they can be decoded. The
+// others are left empty.
+std::vector<SparseTensor> encodeSparseTensors(Message& message) {
+  std::vector<SparseTensor> sparseTensors(message.tensors.size());
+  for (size_t tensorIdx = 0; tensorIdx < message.tensors.size(); ++tensorIdx) {
+    Message::Tensor& tensor = message.tensors[tensorIdx];
+    if (!tensor.sparseEncodingThreshold.has_value() || tensor.length == 0 ||
+        tensor.buffer.device().type != kCpuDeviceType ||
+        (tensor.targetDevice.has_value() &&
+         tensor.targetDevice->type != kCpuDeviceType)) {
+      continue;
+    }
+    const void* ptr = tensor.buffer.unwrap<CpuBuffer>().ptr;
+    const size_t numWords = tensor.length / sizeof(uint32_t);
+    const size_t numNonZeroWords = countNonZeroWords(ptr, tensor.length);
+    const size_t encodedLength =
+        sparseEncodedLength(tensor.length, numNonZeroWords);
+    if (numWords == 0 ||
+        static_cast<double>(numWords - numNonZeroWords) / numWords <
+            tensor.sparseEncodingThreshold.value() ||
+        encodedLength >= tensor.length) {
+      continue;
+    }
+    SparseTensor& sparseTensor = sparseTensors[tensorIdx];
+    sparseTensor.data = std::shared_ptr<uint8_t>(
+        new uint8_t[encodedLength], std::default_delete<uint8_t[]>());
+    sparseTensor.length = encodedLength;
+    encodeSparse(ptr, tensor.length, sparseTensor.data.get());
+    tensor.targetDevice = Device{kCpuDeviceType, 0};
+  }
+  return sparseTensors;
 }
 
 std::shared_ptr<NopHolder<DescriptorReply>> makeDescriptorReplyForMessage(
@@ -115,6 +155,25 @@ std::shared_ptr<NopHolder<DescriptorReply>> makeDescriptorReplyForMessage(
   return nopHolderOut;
 }
 
+bool isPastDeadline(
+    const optional<std::chrono::system_clock::time_point>& deadline) {
+  return deadline.has_value() &&
+      std::chrono::system_clock::now() >= deadline.value();
+}
+
+// The total number of bytes carried by a message, in its payloads and tensors.
+template <typename TMessage>
+uint64_t totalLengthOfMessage(const TMessage& message) {
+  uint64_t length = 0;
+  for (const auto& payload : message.payloads) {
+    length += payload.length;
+  }
+  for (const auto& tensor : message.tensors) {
+    length += tensor.length;
+  }
+  return length;
+}
+
 struct SelectedTransport {
   std::string name;
   std::string address;
@@ -308,6 +367,9 @@ void PipeImpl::initFromLoop() {
       nopBrochure.channelDeviceDescriptors[channelName] =
           channelContext.deviceDescriptors();
     }
+    nopBrochure.streamsEnabled = context_->getStreamsEnabled();
+    nopBrochure.descriptorPacketsEnabled = context_->getWarmupEnabled() ||
+        context_->getWriteBatchingMaxBatchSize() > 0;
     TP_VLOG(3) << "Pipe " << id_ << " is writing nop object (brochure)";
     descriptorConnection_->write(
         *nopHolderOut2, callbackWrapper_([nopHolderOut2](PipeImpl& impl) {
@@ -345,6 +407,25 @@ const std::string& PipeImpl::getRemoteName() {
   return remoteName_;
 }
 
+Pipe::ExpiryStats PipeImpl::getExpiryStats() {
+  Pipe::ExpiryStats stats;
+  stats.numWritesShed = numWritesShed_.load();
+  stats.numBytesOfWritesShed = numBytesOfWritesShed_.load();
+  stats.numReadsShed = numReadsShed_.load();
+  stats.numBytesOfReadsShed = numBytesOfReadsShed_.load();
+  return stats;
+}
+
+Pipe::BatchingStats PipeImpl::getBatchingStats() {
+  Pipe::BatchingStats stats;
+  stats.numBatches = numBatches_.load();
+  stats.numMessagesBatched = numMessagesBatched_.load();
+  stats.numBytesBatched = numBytesBatched_.load();
+  stats.totalBatchingDelayNs = totalBatchingDelayNs_.load();
+  stats.maxBatchingDelayNs = maxBatchingDelayNs_.load();
+  return stats;
+}
+
 void PipeImpl::close() {
   context_->deferToLoop(
       [impl{this->shared_from_this()}]() { impl->closeFromLoop(); });
@@ -363,6 +444,9 @@ void PipeImpl::closeFromLoop() {
 void PipeImpl::readDescriptor(read_descriptor_callback_fn fn) {
   context_->deferToLoop(
       [impl{this->shared_from_this()}, fn{std::move(fn)}]() mutable {
+        TP_THROW_ASSERT_IF(impl->usingTaggedReads_)
+            << "Untagged reads can't be mixed with tagged ones";
+        impl->usingUntaggedReads_ = true;
         impl->readDescriptorFromLoop(std::move(fn));
       });
 }
@@ -395,6 +479,8 @@ void PipeImpl::read(Allocation allocation, read_callback_fn fn) {
   context_->deferToLoop([impl{this->shared_from_this()},
                          allocation{std::move(allocation)},
                          fn{std::move(fn)}]() mutable {
+    TP_THROW_ASSERT_IF(impl->usingTaggedReads_)
+        << "Untagged reads can't be mixed with tagged ones";
     impl->readFromLoop(std::move(allocation), std::move(fn));
   });
 }
@@ -445,27 +531,46 @@ void PipeImpl::readPayloadsOfMessage(ReadOpIter opIter) {
 
   TP_DCHECK_EQ(connectionState_, AWAITING_PAYLOADS);
   TP_DCHECK_EQ(messageBeingReadFromConnection_, op.sequenceNumber);
-  for (size_t payloadIdx = 0; payloadIdx < op.allocation.payloads.size();
-       payloadIdx++) {
-    Allocation::Payload& payload = op.allocation.payloads[payloadIdx];
-    Descriptor::Payload& payloadDescriptor = op.descriptor.payloads[payloadIdx];
-    TP_VLOG(3) << "Pipe " << id_ << " is reading payload #" << op.sequenceNumber
-               << "." << payloadIdx;
-    descriptorConnection_->read(
-        payload.data,
-        payloadDescriptor.length,
-        callbackWrapper_(
-            [opIter, payloadIdx](
-                PipeImpl& impl, const void* /* unused */, size_t /* unused */) {
-              TP_VLOG(3) << "Pipe " << impl.id_ << " done reading payload #"
-                         << opIter->sequenceNumber << "." << payloadIdx;
-              opIter->numPayloadsBeingRead--;
-              impl.readOps_.advanceOperation(opIter);
-            }));
-    ++op.numPayloadsBeingRead;
+  if (op.batched) {
+    // The payloads came along with the descriptor, one after the other.
+    size_t offset = 0;
+    for (size_t payloadIdx = 0; payloadIdx < op.allocation.payloads.size();
+         payloadIdx++) {
+      Allocation::Payload& payload = op.allocation.payloads[payloadIdx];
+      const size_t length = op.descriptor.payloads[payloadIdx].length;
+      if (length > 0 && payload.data != nullptr) {
+        std::memcpy(payload.data, op.batchedPayloadData.data() + offset, length);
+      }
+      offset += length;
+    }
+    TP_DCHECK_EQ(offset, op.batchedPayloadData.size());
+    op.batchedPayloadData = std::string();
+  } else {
+    for (size_t payloadIdx = 0; payloadIdx < op.allocation.payloads.size();
+         payloadIdx++) {
+      Allocation::Payload& payload = op.allocation.payloads[payloadIdx];
+      Descriptor::Payload& payloadDescriptor =
+          op.descriptor.payloads[payloadIdx];
+      TP_VLOG(3) << "Pipe " << id_ << " is reading payload #"
+                 << op.sequenceNumber << "." << payloadIdx;
+      descriptorConnection_->read(
+          payload.data,
+          payloadDescriptor.length,
+          callbackWrapper_([opIter, payloadIdx](
+                               PipeImpl& impl,
+                               const void* /* unused */,
+                               size_t /* unused */) {
+            TP_VLOG(3) << "Pipe " << impl.id_ << " done reading payload #"
+                       << opIter->sequenceNumber << "." << payloadIdx;
+            opIter->numPayloadsBeingRead--;
+            impl.readOps_.advanceOperation(opIter);
+          }));
+      ++op.numPayloadsBeingRead;
+    }
   }
   connectionState_ = AWAITING_DESCRIPTOR;
   ++messageBeingReadFromConnection_;
+  readAheadDescriptorPacket();
 }
 
 void PipeImpl::receiveTensorsOfMessage(ReadOpIter opIter) {
@@ -497,19 +602,80 @@ void PipeImpl::receiveTensorsOfMessage(ReadOpIter opIter) {
     TP_VLOG(3) << "Pipe " << id_ << " is receiving tensor #"
                << op.sequenceNumber << "." << tensorIdx;
 
+    // A tensor in the sparse encoding is received into a buffer of its own,
+    // and is expanded into the one provided by the user once it's complete.
+    // The sender made sure it's received in host memory.
+    std::shared_ptr<uint8_t> sparseData;
+    if (tensorDescriptor.sparseLength > 0 && !op.expired) {
+      sparseData = std::shared_ptr<uint8_t>(
+          new uint8_t[tensorDescriptor.sparseLength],
+          std::default_delete<uint8_t[]>());
+    }
+
     channel.recv(
-        tensor.buffer,
-        tensorDescriptor.length,
-        callbackWrapper_([opIter, tensorIdx](PipeImpl& impl) {
+        sparseData != nullptr ? CpuBuffer{.ptr = sparseData.get()}
+                              : tensor.buffer,
+        tensorDescriptor.sparseLength > 0 ? tensorDescriptor.sparseLength
+                                          : tensorDescriptor.length,
+        callbackWrapper_([opIter, tensorIdx, sparseData](PipeImpl& impl) {
           TP_VLOG(3) << "Pipe " << impl.id_ << " done receiving tensor #"
                      << opIter->sequenceNumber << "." << tensorIdx;
-          opIter->numTensorsBeingReceived--;
-          impl.readOps_.advanceOperation(opIter);
+          // Tensors that are being discarded aren't received into a buffer of
+          // their own, as there's no point in expanding them.
+          if (sparseData != nullptr && !impl.error_) {
+            impl.decodeSparseTensor(opIter, tensorIdx, std::move(sparseData));
+            return;
+          }
+          impl.onTensorReceived(opIter, tensorIdx);
         }));
     ++op.numTensorsBeingReceived;
   }
 }
 
+void PipeImpl::decodeSparseTensor(
+    ReadOpIter opIter,
+    size_t tensorIdx,
+    std::shared_ptr<uint8_t> sparseData) {
+  TP_DCHECK(context_->inLoop());
+
+  const Descriptor::Tensor& tensorDescriptor =
+      opIter->descriptor.tensors[tensorIdx];
+  const size_t sparseLength = tensorDescriptor.sparseLength;
+  const size_t length = tensorDescriptor.length;
+  void* ptr =
+      opIter->allocation.tensors[tensorIdx].buffer.unwrap<CpuBuffer>().ptr;
+  auto callback = callbackWrapper_([opIter, tensorIdx](PipeImpl& impl) {
+    TP_VLOG(3) << "Pipe " << impl.id_ << " done decoding tensor #"
+               << opIter->sequenceNumber << "." << tensorIdx;
+    impl.onTensorReceived(opIter, tensorIdx);
+  });
+
+  TP_VLOG(3) << "Pipe " << id_ << " is decoding tensor #"
+             << opIter->sequenceNumber << "." << tensorIdx;
+  // Decoding goes over the whole tensor, hence it's done on a worker so that
+  // the loop can keep serving the other pipes. The operation, and thus the
+  // user's buffer, stays pending until the decoding is done. The encoding was
+  // made by the peer, hence it's checked rather than trusted.
+  context_->postToWorker([sparseData{std::move(sparseData)},
+                          sparseLength,
+                          ptr,
+                          length,
+                          callback{std::move(callback)}]() mutable {
+    if (decodeSparse(sparseData.get(), sparseLength, ptr, length)) {
+      callback(Error::kSuccess);
+    } else {
+      callback(TP_CREATE_ERROR(SparseEncodingError));
+    }
+  });
+}
+
+void PipeImpl::onTensorReceived(ReadOpIter opIter, size_t tensorIdx) {
+  TP_DCHECK(context_->inLoop());
+
+  opIter->numTensorsBeingReceived--;
+  readOps_.advanceOperation(opIter);
+}
+
 void PipeImpl::writeDescriptorReplyOfMessage(ReadOpIter opIter) {
   TP_DCHECK(context_->inLoop());
 
@@ -533,15 +699,81 @@ void PipeImpl::writeDescriptorReplyOfMessage(ReadOpIter opIter) {
           }));
 }
 
+void PipeImpl::discardPayloadsAndTensorsOfMessage(ReadOpIter opIter) {
+  TP_DCHECK(context_->inLoop());
+
+  ReadOperation& op = *opIter;
+
+  TP_VLOG(1) << "Pipe " << id_ << " is discarding message #"
+             << op.sequenceNumber << " as its deadline has passed";
+
+  // The data still needs to be drained from the connection and the channels.
+  // The connection can do so chunk by chunk, without a buffer, but channels
+  // need one for each tensor as a whole, hence as it will be thrown away all
+  // tensors share the same one.
+  op.allocation.payloads.resize(op.descriptor.payloads.size());
+  for (auto& payload : op.allocation.payloads) {
+    payload.data = nullptr;
+  }
+
+  size_t maxLength = 0;
+  for (const auto& tensor : op.descriptor.tensors) {
+    maxLength = std::max({maxLength, tensor.length, tensor.sparseLength});
+  }
+  if (maxLength > tensorDiscardBufferLength_) {
+    tensorDiscardBuffer_ = std::shared_ptr<uint8_t>(
+        new uint8_t[maxLength], std::default_delete<uint8_t[]>());
+    tensorDiscardBufferLength_ = maxLength;
+  }
+  op.discardBuffer = tensorDiscardBuffer_;
+
+  op.allocation.tensors.resize(op.descriptor.tensors.size());
+  for (auto& tensor : op.allocation.tensors) {
+    tensor.buffer = CpuBuffer{.ptr = op.discardBuffer.get()};
+  }
+
+  numReadsShed_++;
+  numBytesOfReadsShed_ += totalLengthOfMessage(op.descriptor);
+
+  readPayloadsOfMessage(opIter);
+  if (op.hasMissingTargetDevices) {
+    writeDescriptorReplyOfMessage(opIter);
+  }
+  receiveTensorsOfMessage(opIter);
+}
+
 void PipeImpl::write(Message message, write_callback_fn fn) {
+  // The sparse tensors are encoded here, on the user's thread, as doing so on
+  // the loop would hold up all the other pipes that share it.
+  std::vector<SparseTensor> sparseTensors = encodeSparseTensors(message);
   context_->deferToLoop([impl{this->shared_from_this()},
                          message{std::move(message)},
-                         fn{std::move(fn)}]() mutable {
-    impl->writeFromLoop(std::move(message), std::move(fn));
+                         fn{std::move(fn)},
+                         sparseTensors{std::move(sparseTensors)}]() mutable {
+    impl->writeFromLoop(
+        std::move(message), std::move(fn), std::move(sparseTensors));
   });
 }
 
-void PipeImpl::writeFromLoop(Message message, write_callback_fn fn) {
+void PipeImpl::writeFromLoop(
+    Message message,
+    write_callback_fn fn,
+    std::vector<SparseTensor> sparseTensors) {
+  TP_DCHECK(context_->inLoop());
+
+  WriteOpIter opIter = emplaceWriteOperation(std::move(message), std::move(fn));
+  TP_DCHECK_EQ(opIter->tensors.size(), sparseTensors.size());
+  for (size_t tensorIdx = 0; tensorIdx < sparseTensors.size(); ++tensorIdx) {
+    opIter->tensors[tensorIdx].sparse = std::move(sparseTensors[tensorIdx]);
+  }
+  opIter->batched = canBatchMessage(opIter->message);
+
+  writeOps_.advanceOperation(opIter);
+}
+
+PipeImpl::WriteOpIter PipeImpl::emplaceWriteOperation(
+    Message message,
+    write_callback_fn fn) {
   TP_DCHECK(context_->inLoop());
 
   WriteOpIter opIter = writeOps_.emplaceBack(nextMessageBeingWritten_++);
@@ -577,7 +809,282 @@ void PipeImpl::writeFromLoop(Message message, write_callback_fn fn) {
   op.message = std::move(message);
   op.writeCallback = std::move(fn);
 
-  writeOps_.advanceOperation(opIter);
+  return opIter;
+}
+
+void PipeImpl::warmup(
+    Pipe::WarmupProfile profile,
+    Pipe::warmup_callback_fn fn) {
+  context_->deferToLoop([impl{this->shared_from_this()},
+                         profile{std::move(profile)},
+                         fn{std::move(fn)}]() mutable {
+    impl->warmupFromLoop(std::move(profile), std::move(fn));
+  });
+}
+
+void PipeImpl::warmupFromLoop(
+    Pipe::WarmupProfile profile,
+    Pipe::warmup_callback_fn fn) {
+  TP_DCHECK(context_->inLoop());
+
+  // The remote side could otherwise not tell the warm-up messages apart.
+  if (!context_->getWarmupEnabled()) {
+    fn(TP_CREATE_ERROR(WarmupNotEnabledError));
+    return;
+  }
+
+  if (error_) {
+    fn(error_);
+    return;
+  }
+
+  if (profile.sizes.empty() || profile.numRounds == 0) {
+    TP_VLOG(1) << "Pipe " << id_ << " received an empty warmup request";
+    fn(error_);
+    return;
+  }
+
+  TP_VLOG(1) << "Pipe " << id_ << " received a warmup request ("
+             << profile.numRounds << " rounds of " << profile.sizes.size()
+             << " messages)";
+
+  // All messages are written from the same buffer. Zeroing it faults it in.
+  const size_t maxSize =
+      *std::max_element(profile.sizes.begin(), profile.sizes.end());
+  std::shared_ptr<uint8_t> buffer(
+      new uint8_t[maxSize](), std::default_delete<uint8_t[]>());
+
+  pendingWarmups_.push_back(PendingWarmup{
+      .numEchoesLeft = profile.numRounds * profile.sizes.size(),
+      .fn = std::move(fn),
+  });
+  for (size_t roundIdx = 0; roundIdx < profile.numRounds; roundIdx++) {
+    for (size_t size : profile.sizes) {
+      writeWarmupMessage(buffer, {size}, {size}, /*echo=*/false);
+    }
+  }
+}
+
+void PipeImpl::writeToStream(
+    uint64_t streamId,
+    const void* ptr,
+    size_t length,
+    Stream::write_callback_fn fn) {
+  context_->deferToLoop([impl{this->shared_from_this()},
+                         streamId,
+                         ptr,
+                         length,
+                         fn{std::move(fn)}]() mutable {
+    impl->writeToStreamFromLoop(streamId, ptr, length, std::move(fn));
+  });
+}
+
+void PipeImpl::writeToStreamFromLoop(
+    uint64_t streamId,
+    const void* ptr,
+    size_t length,
+    Stream::write_callback_fn fn) {
+  TP_DCHECK(context_->inLoop());
+
+  TP_VLOG(1) << "Pipe " << id_ << " received a write request on stream "
+             << streamId << " (of " << length << " bytes)";
+
+  if (error_) {
+    fn(error_);
+    return;
+  }
+
+  if (state_ == ESTABLISHED && !streamConnection_) {
+    fn(TP_CREATE_ERROR(StreamsNotEnabledError));
+    return;
+  }
+
+  StreamWriter& writer = streamWriters_[streamId];
+  TP_THROW_ASSERT_IF(writer.ending)
+      << "Writing to stream " << streamId << " after it was ended";
+
+  writer.writes.emplace_back();
+  StreamWriteOperation& op = writer.writes.back();
+  op.ptr = reinterpret_cast<const uint8_t*>(ptr);
+  op.length = length;
+  op.callback = std::move(fn);
+
+  if (state_ == ESTABLISHED) {
+    dispatchStreamWrites(streamId, writer);
+  }
+}
+
+void PipeImpl::readFromStream(
+    uint64_t streamId,
+    void* ptr,
+    size_t length,
+    Stream::read_callback_fn fn) {
+  context_->deferToLoop([impl{this->shared_from_this()},
+                         streamId,
+                         ptr,
+                         length,
+                         fn{std::move(fn)}]() mutable {
+    impl->readFromStreamFromLoop(streamId, ptr, length, std::move(fn));
+  });
+}
+
+void PipeImpl::readFromStreamFromLoop(
+    uint64_t streamId,
+    void* ptr,
+    size_t length,
+    Stream::read_callback_fn fn) {
+  TP_DCHECK(context_->inLoop());
+
+  TP_VLOG(1) << "Pipe " << id_ << " received a read request on stream "
+             << streamId << " (of up to " << length << " bytes)";
+
+  if (error_) {
+    fn(error_, 0);
+    return;
+  }
+
+  if (state_ == ESTABLISHED && !streamConnection_) {
+    fn(TP_CREATE_ERROR(StreamsNotEnabledError), 0);
+    return;
+  }
+
+  StreamReader& reader = streamReaders_[streamId];
+  if (reader.ended) {
+    fn(TP_CREATE_ERROR(StreamEndedError), 0);
+    return;
+  }
+
+  // An empty buffer can't be filled, hence it's done as soon as the reads that
+  // came before it are (which is right away if there are none).
+  if (length == 0 && reader.reads.empty()) {
+    fn(Error::kSuccess, 0);
+    return;
+  }
+
+  reader.reads.emplace_back();
+  StreamReadOperation& op = reader.reads.back();
+  op.ptr = ptr;
+  op.length = length;
+  op.callback = std::move(fn);
+
+  if (state_ == ESTABLISHED) {
+    advertiseStreamCredits(streamId, reader);
+  }
+}
+
+void PipeImpl::endStream(uint64_t streamId) {
+  context_->deferToLoop([impl{this->shared_from_this()}, streamId]() {
+    impl->endStreamFromLoop(streamId);
+  });
+}
+
+void PipeImpl::endStreamFromLoop(uint64_t streamId) {
+  TP_DCHECK(context_->inLoop());
+
+  TP_VLOG(1) << "Pipe " << id_ << " received an end request on stream "
+             << streamId;
+
+  if (error_ || (state_ == ESTABLISHED && !streamConnection_)) {
+    return;
+  }
+
+  StreamWriter& writer = streamWriters_[streamId];
+  writer.ending = true;
+
+  if (state_ == ESTABLISHED) {
+    dispatchStreamWrites(streamId, writer);
+  }
+}
+
+void PipeImpl::readDescriptor(uint64_t tag, read_descriptor_callback_fn fn) {
+  context_->deferToLoop(
+      [impl{this->shared_from_this()}, tag, fn{std::move(fn)}]() mutable {
+        impl->readTaggedDescriptorFromLoop(tag, std::move(fn));
+      });
+}
+
+void PipeImpl::readTaggedDescriptorFromLoop(
+    uint64_t tag,
+    read_descriptor_callback_fn fn) {
+  TP_DCHECK(context_->inLoop());
+
+  TP_THROW_ASSERT_IF(usingUntaggedReads_)
+      << "Tagged reads can't be mixed with untagged ones";
+  usingTaggedReads_ = true;
+
+  TP_VLOG(1) << "Pipe " << id_
+             << " received a readDescriptor request for tag " << tag;
+
+  if (error_) {
+    fn(error_, Descriptor());
+    return;
+  }
+
+  TaggedReader& reader = taggedReaders_[tag];
+  reader.descriptorCallbacks.push_back(std::move(fn));
+  matchTaggedMessage(reader);
+  receiveNextTaggedMessage();
+}
+
+void PipeImpl::read(uint64_t tag, Allocation allocation, read_callback_fn fn) {
+  context_->deferToLoop([impl{this->shared_from_this()},
+                         tag,
+                         allocation{std::move(allocation)},
+                         fn{std::move(fn)}]() mutable {
+    impl->readTaggedFromLoop(tag, std::move(allocation), std::move(fn));
+  });
+}
+
+void PipeImpl::readTaggedFromLoop(
+    uint64_t tag,
+    Allocation allocation,
+    read_callback_fn fn) {
+  TP_DCHECK(context_->inLoop());
+
+  TP_THROW_ASSERT_IF(usingUntaggedReads_)
+      << "Tagged reads can't be mixed with untagged ones";
+
+  TP_VLOG(1) << "Pipe " << id_ << " received a read request for tag " << tag
+             << " (containing " << allocation.payloads.size()
+             << " payloads and " << allocation.tensors.size() << " tensors)";
+
+  auto readerIter = taggedReaders_.find(tag);
+  // As for untagged reads, this is a logical error on the user's side. However,
+  // after an error, the descriptor callbacks may have been flushed before the
+  // user issued the read call that they were expecting.
+  TP_THROW_ASSERT_IF(
+      !error_ &&
+      (readerIter == taggedReaders_.end() ||
+       readerIter->second.matchedMessages.empty()))
+      << "No message with tag " << tag << " is waiting for an allocation";
+  std::shared_ptr<TaggedMessage> message;
+  if (readerIter != taggedReaders_.end() &&
+      !readerIter->second.matchedMessages.empty()) {
+    message = std::move(readerIter->second.matchedMessages.front());
+    readerIter->second.matchedMessages.pop_front();
+    checkAllocationCompatibility(message->descriptor, allocation);
+  }
+
+  if (message != nullptr && !message->staged) {
+    // This is the message at which the pipe stopped receiving, which must get
+    // its allocation even after an error in order for its read to complete.
+    TP_DCHECK(receivingTaggedMessage_);
+    readFromLoop(std::move(allocation), std::move(fn));
+    receivingTaggedMessage_ = false;
+    receiveNextTaggedMessage();
+    return;
+  }
+
+  if (error_) {
+    fn(error_);
+    return;
+  }
+
+  message->allocation = std::move(allocation);
+  message->readCallback = std::move(fn);
+  if (message->doneStaging) {
+    completeStagedTaggedRead(*message);
+  }
 }
 
 //
@@ -589,7 +1096,11 @@ void PipeImpl::callReadDescriptorCallback(ReadOpIter opIter) {
 
   ReadOperation& op = *opIter;
 
-  op.readDescriptorCallback(error_, op.descriptor);
+  Error error = error_;
+  if (!error && op.expired) {
+    error = TP_CREATE_ERROR(MessageExpiredError);
+  }
+  op.readDescriptorCallback(error, op.descriptor);
   // Reset callback to release the resources it was holding.
   op.readDescriptorCallback = nullptr;
 }
@@ -599,6 +1110,14 @@ void PipeImpl::callReadCallback(ReadOpIter opIter) {
 
   ReadOperation& op = *opIter;
 
+  if (op.expired) {
+    // The user didn't provide an allocation for this message, hence there is
+    // no callback to invoke, but its turn must be accounted for.
+    TP_DCHECK(!op.readCallback);
+    nextReadCallbackToCall_++;
+    return;
+  }
+
   op.readCallback(error_);
   // Reset callback to release the resources it was holding.
   op.readCallback = nullptr;
@@ -609,7 +1128,11 @@ void PipeImpl::callWriteCallback(WriteOpIter opIter) {
 
   WriteOperation& op = *opIter;
 
-  op.writeCallback(error_);
+  Error error = error_;
+  if (!error && op.expired) {
+    error = TP_CREATE_ERROR(MessageExpiredError);
+  }
+  op.writeCallback(error);
   // Reset callback to release the resources it was holding.
   op.writeCallback = nullptr;
 }
@@ -639,6 +1162,10 @@ void PipeImpl::handleError() {
     descriptorReplyConnection_->close();
   }
 
+  if (streamConnection_) {
+    streamConnection_->close();
+  }
+
   for (auto& channelIter : channels_) {
     channelIter.second->close();
   }
@@ -657,7 +1184,11 @@ void PipeImpl::handleError() {
   channelReceivedConnections_.clear();
 
   readOps_.advanceAllOperations();
+  flushWriteBatch();
   writeOps_.advanceAllOperations();
+  flushStreams();
+  flushTaggedReads();
+  flushWarmups();
 
   context_->unenroll(*this);
 }
@@ -708,10 +1239,28 @@ void PipeImpl::advanceReadOperation(
       opIter,
       /*from=*/ReadOperation::ASKING_FOR_ALLOCATION,
       /*to=*/ReadOperation::ASKING_FOR_ALLOCATION_FIRST_IN_LINE,
-      /*cond=*/op.doneReadingDescriptor &&
+      /*cond=*/op.doneReadingDescriptor && !op.expired &&
           prevOpState >= ReadOperation::READING_PAYLOADS_AND_RECEIVING_TENSORS,
       /*actions=*/{&PipeImpl::expectReadCall});
 
+  // Expired messages don't wait for a read call. They still need to go after
+  // the previous op, as they read their payloads from the connection.
+  readOps_.attemptTransition(
+      opIter,
+      /*from=*/ReadOperation::ASKING_FOR_ALLOCATION,
+      /*to=*/ReadOperation::READING_PAYLOADS_AND_RECEIVING_TENSORS,
+      /*cond=*/!error_ && op.expired &&
+          prevOpState >= ReadOperation::READING_PAYLOADS_AND_RECEIVING_TENSORS,
+      /*actions=*/{&PipeImpl::discardPayloadsAndTensorsOfMessage});
+
+  // Needs to go after previous op to ensure ordering of callback invocations.
+  readOps_.attemptTransition(
+      opIter,
+      /*from=*/ReadOperation::ASKING_FOR_ALLOCATION,
+      /*to=*/ReadOperation::FINISHED,
+      /*cond=*/error_ && op.expired && prevOpState >= ReadOperation::FINISHED,
+      /*actions=*/{&PipeImpl::callReadCallback});
+
   // Needs to go after previous op to ensure ordering of callback invocations.
   readOps_.attemptTransition(
       opIter,
@@ -773,6 +1322,31 @@ void PipeImpl::advanceWriteOperation(
       /*cond=*/error_ && prevOpState >= WriteOperation::FINISHED,
       /*actions=*/{&PipeImpl::callWriteCallback});
 
+  // Messages whose deadline has passed are shed before anything is written,
+  // hence they don't need the pipe to be established. However they must wait
+  // for the previous op to have sent its tensors, as the next op will then be
+  // allowed to do the same. This is a best-effort check: the deadline is not
+  // enforced once the message started being written.
+  writeOps_.attemptTransition(
+      opIter,
+      /*from=*/WriteOperation::UNINITIALIZED,
+      /*to=*/WriteOperation::WRITING_PAYLOADS_AND_SENDING_TENSORS,
+      /*cond=*/!error_ &&
+          prevOpState >= WriteOperation::WRITING_PAYLOADS_AND_SENDING_TENSORS &&
+          isPastDeadline(op.message.deadline),
+      /*actions=*/{&PipeImpl::shedMessage});
+
+  // Needs to go after previous op to ensure predictable and consistent ordering
+  // of write calls on the connection. Small messages have no tensors, and they
+  // are only written once their batch is flushed.
+  writeOps_.attemptTransition(
+      opIter,
+      /*from=*/WriteOperation::UNINITIALIZED,
+      /*to=*/WriteOperation::WRITING_PAYLOADS_AND_SENDING_TENSORS,
+      /*cond=*/!error_ && state_ == ESTABLISHED && op.batched &&
+          prevOpState >= WriteOperation::WRITING_PAYLOADS_AND_SENDING_TENSORS,
+      /*actions=*/{&PipeImpl::addMessageToWriteBatch});
+
   // Needs to go after previous op to ensure predictable and consistent ordering
   // of write calls on the connection and send calls on the channels.
   // This transition shortcuts reading the target devices when they were all
@@ -781,7 +1355,7 @@ void PipeImpl::advanceWriteOperation(
       opIter,
       /*from=*/WriteOperation::UNINITIALIZED,
       /*to=*/WriteOperation::WRITING_PAYLOADS_AND_SENDING_TENSORS,
-      /*cond=*/!error_ && state_ == ESTABLISHED &&
+      /*cond=*/!error_ && state_ == ESTABLISHED && !op.batched &&
           !op.hasMissingTargetDevices &&
           prevOpState >= WriteOperation::WRITING_PAYLOADS_AND_SENDING_TENSORS,
       /*actions=*/
@@ -841,43 +1415,176 @@ void PipeImpl::readDescriptorOfMessage(ReadOpIter opIter) {
 
   TP_DCHECK_EQ(connectionState_, AWAITING_DESCRIPTOR);
   TP_DCHECK_EQ(messageBeingReadFromConnection_, op.sequenceNumber);
-  auto nopHolderIn = std::make_shared<NopHolder<Descriptor>>();
-  TP_VLOG(3) << "Pipe " << id_ << " is reading nop object (message descriptor #"
-             << op.sequenceNumber << ")";
-  descriptorConnection_->read(
-      *nopHolderIn, callbackWrapper_([opIter, nopHolderIn](PipeImpl& impl) {
-        TP_VLOG(3) << "Pipe " << impl.id_
-                   << " done reading nop object (message descriptor #"
-                   << opIter->sequenceNumber << ")";
-        opIter->doneReadingDescriptor = true;
-        if (!impl.error_) {
-          opIter->descriptor = std::move(nopHolderIn->getObject());
-          for (const auto& tensor : opIter->descriptor.tensors) {
-            if (!tensor.targetDevice.has_value()) {
-              opIter->hasMissingTargetDevices = true;
-            }
-          }
-        }
-        impl.readOps_.advanceOperation(opIter);
-      }));
   connectionState_ = AWAITING_PAYLOADS;
-}
 
-void PipeImpl::expectReadCall(ReadOpIter opIter) {
-  TP_DCHECK(context_->inLoop());
+  // The rest of a batch was already received, hence the descriptor is readily
+  // available and the op can move on as soon as this action returns.
+  if (!receivedBatch_.empty()) {
+    TP_VLOG(3) << "Pipe " << id_ << " is taking message descriptor #"
+               << op.sequenceNumber << " from a received batch";
+    BatchedMessage& nopMessage = receivedBatch_.front();
+    op.doneReadingDescriptor = true;
+    op.batched = true;
+    op.batchedPayloadData = std::move(nopMessage.payloadData);
+    parseDescriptorOfMessage(op, std::move(nopMessage.descriptor));
+    receivedBatch_.pop_front();
+    return;
+  }
 
-  ReadOperation& op = *opIter;
+  if (!descriptorPacketsEnabled_) {
+    auto nopHolderIn = std::make_shared<NopHolder<Descriptor>>();
+    TP_VLOG(3) << "Pipe " << id_
+               << " is reading nop object (message descriptor #"
+               << op.sequenceNumber << ")";
+    descriptorConnection_->read(
+        *nopHolderIn, callbackWrapper_([opIter, nopHolderIn](PipeImpl& impl) {
+          TP_VLOG(3) << "Pipe " << impl.id_
+                     << " done reading nop object (message descriptor #"
+                     << opIter->sequenceNumber << ")";
+          opIter->doneReadingDescriptor = true;
+          if (!impl.error_) {
+            impl.parseDescriptorOfMessage(
+                *opIter, std::move(nopHolderIn->getObject()));
+          }
+          impl.readOps_.advanceOperation(opIter);
+        }));
+    return;
+  }
 
-  TP_DCHECK(!nextMessageGettingAllocation_.has_value());
-  nextMessageGettingAllocation_ = opIter;
+  // The packets are read by the pipe itself (see readNextDescriptorPacket).
+  if (nextDescriptorPacket_.has_value()) {
+    TP_VLOG(3) << "Pipe " << id_ << " is taking message descriptor #"
+               << op.sequenceNumber << " from the packet that was read ahead";
+    DescriptorPacket nopPacket = std::move(nextDescriptorPacket_.value());
+    nextDescriptorPacket_.reset();
+    op.doneReadingDescriptor = true;
+    parseDescriptorPacketOfMessage(op, nopPacket);
+    return;
+  }
+  TP_DCHECK(!opAwaitingDescriptorPacket_.has_value());
+  opAwaitingDescriptorPacket_ = opIter;
+  if (!readingDescriptorPacket_) {
+    readNextDescriptorPacket();
+  }
 }
 
-void PipeImpl::sendTensorsOfMessage(WriteOpIter opIter) {
+void PipeImpl::readAheadDescriptorPacket() {
   TP_DCHECK(context_->inLoop());
 
-  WriteOperation& op = *opIter;
-
-  TP_VLOG(2) << "Pipe " << id_ << " is sending tensors of message #"
+  if (error_ || state_ != ESTABLISHED || !descriptorPacketsEnabled_ ||
+      connectionState_ != AWAITING_DESCRIPTOR || readingDescriptorPacket_ ||
+      nextDescriptorPacket_.has_value()) {
+    return;
+  }
+  readNextDescriptorPacket();
+}
+
+void PipeImpl::readNextDescriptorPacket() {
+  TP_DCHECK(context_->inLoop());
+  TP_DCHECK(descriptorPacketsEnabled_);
+  TP_DCHECK(!readingDescriptorPacket_);
+  TP_DCHECK(!nextDescriptorPacket_.has_value());
+
+  readingDescriptorPacket_ = true;
+  auto nopHolderIn = std::make_shared<NopHolder<DescriptorPacket>>();
+  TP_VLOG(3) << "Pipe " << id_ << " is reading nop object (descriptor packet)";
+  descriptorConnection_->read(
+      *nopHolderIn, callbackWrapper_([nopHolderIn](PipeImpl& impl) {
+        TP_VLOG(3) << "Pipe " << impl.id_
+                   << " done reading nop object (descriptor packet)";
+        impl.onDescriptorPacket(std::move(nopHolderIn->getObject()));
+      }));
+}
+
+void PipeImpl::onDescriptorPacket(DescriptorPacket nopPacket) {
+  TP_DCHECK(context_->inLoop());
+
+  readingDescriptorPacket_ = false;
+
+  // A message written by the remote's warmup isn't handed to a read operation.
+  // Once its payloads are queued to be read, the connection is at the packet
+  // after it, which is thus read right away.
+  if (!error_ && nopPacket.is<WarmupMessage>()) {
+    receiveWarmupMessage(*nopPacket.get<WarmupMessage>());
+    readNextDescriptorPacket();
+    return;
+  }
+
+  if (!opAwaitingDescriptorPacket_.has_value()) {
+    if (!error_) {
+      nextDescriptorPacket_ = std::move(nopPacket);
+    }
+    return;
+  }
+
+  ReadOpIter opIter = opAwaitingDescriptorPacket_.value();
+  opAwaitingDescriptorPacket_.reset();
+  opIter->doneReadingDescriptor = true;
+  if (!error_) {
+    parseDescriptorPacketOfMessage(*opIter, nopPacket);
+  }
+  readOps_.advanceOperation(opIter);
+}
+
+void PipeImpl::parseDescriptorPacketOfMessage(
+    ReadOperation& op,
+    DescriptorPacket& nopPacket) {
+  if (nopPacket.is<Descriptor>()) {
+    parseDescriptorOfMessage(op, std::move(*nopPacket.get<Descriptor>()));
+  } else if (nopPacket.is<DescriptorBatch>()) {
+    std::vector<BatchedMessage>& nopMessages =
+        nopPacket.get<DescriptorBatch>()->messages;
+    TP_THROW_ASSERT_IF(nopMessages.empty()) << "Received empty batch";
+    TP_VLOG(2) << "Pipe " << id_ << " received a batch of "
+               << nopMessages.size() << " messages";
+    op.batched = true;
+    op.batchedPayloadData = std::move(nopMessages[0].payloadData);
+    parseDescriptorOfMessage(op, std::move(nopMessages[0].descriptor));
+    for (size_t idx = 1; idx < nopMessages.size(); idx++) {
+      receivedBatch_.push_back(std::move(nopMessages[idx]));
+    }
+  } else {
+    TP_THROW_ASSERT() << "Unexpected packet type: " << nopPacket.index();
+  }
+}
+
+void PipeImpl::parseDescriptorOfMessage(
+    ReadOperation& op,
+    Descriptor descriptor) {
+  op.descriptor = std::move(descriptor);
+  if (op.batched) {
+    TP_THROW_ASSERT_IF(!op.descriptor.tensors.empty())
+        << "Received batched message with tensors";
+    TP_THROW_ASSERT_IF(
+        totalLengthOfMessage(op.descriptor) != op.batchedPayloadData.size())
+        << "Received batched message with inconsistent payload lengths";
+  }
+  for (const auto& tensor : op.descriptor.tensors) {
+    if (!tensor.targetDevice.has_value()) {
+      op.hasMissingTargetDevices = true;
+    }
+  }
+  if (isPastDeadline(op.descriptor.deadline) &&
+      canReceiveIntoHostMemory(op.descriptor)) {
+    op.expired = true;
+  }
+}
+
+void PipeImpl::expectReadCall(ReadOpIter opIter) {
+  TP_DCHECK(context_->inLoop());
+
+  ReadOperation& op = *opIter;
+
+  TP_DCHECK(!nextMessageGettingAllocation_.has_value());
+  nextMessageGettingAllocation_ = opIter;
+}
+
+void PipeImpl::sendTensorsOfMessage(WriteOpIter opIter) {
+  TP_DCHECK(context_->inLoop());
+
+  WriteOperation& op = *opIter;
+
+  TP_VLOG(2) << "Pipe " << id_ << " is sending tensors of message #"
              << op.sequenceNumber;
 
   TP_DCHECK_EQ(op.message.tensors.size(), op.tensors.size());
@@ -901,9 +1608,11 @@ void PipeImpl::sendTensorsOfMessage(WriteOpIter opIter) {
     TP_VLOG(3) << "Pipe " << id_ << " is sending tensor #" << op.sequenceNumber
                << "." << tensorIdx;
 
+    const SparseTensor& sparse = op.tensors[tensorIdx].sparse;
     channel.send(
-        tensor.buffer,
-        tensor.length,
+        sparse.data != nullptr ? CpuBuffer{.ptr = sparse.data.get()}
+                               : tensor.buffer,
+        sparse.data != nullptr ? sparse.length : tensor.length,
         callbackWrapper_([opIter, tensorIdx](PipeImpl& impl) {
           TP_VLOG(3) << "Pipe " << impl.id_ << " done sending tensor #"
                      << opIter->sequenceNumber << "." << tensorIdx;
@@ -915,12 +1624,110 @@ void PipeImpl::sendTensorsOfMessage(WriteOpIter opIter) {
   }
 }
 
+void PipeImpl::shedMessage(WriteOpIter opIter) {
+  TP_DCHECK(context_->inLoop());
+
+  WriteOperation& op = *opIter;
+
+  TP_VLOG(1) << "Pipe " << id_ << " is shedding message #" << op.sequenceNumber
+             << " as its deadline has passed";
+
+  op.expired = true;
+  numWritesShed_++;
+  numBytesOfWritesShed_ += totalLengthOfMessage(op.message);
+}
+
+void PipeImpl::addMessageToWriteBatch(WriteOpIter opIter) {
+  TP_DCHECK(context_->inLoop());
+
+  WriteOperation& op = *opIter;
+
+  const size_t length = totalLengthOfMessage(op.message);
+  const size_t maxBatchSize = context_->getWriteBatchingMaxBatchSize();
+  if (writeBatchLength_ + length > maxBatchSize) {
+    flushWriteBatch();
+  }
+
+  TP_VLOG(2) << "Pipe " << id_ << " is adding message #" << op.sequenceNumber
+             << " to a batch";
+
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  const bool startingBatch = writeBatch_.empty();
+  if (startingBatch) {
+    writeBatchStart_ = now;
+  }
+  op.batchedAt = now;
+  writeBatch_.push_back(opIter);
+  writeBatchLength_ += length;
+  // The whole batch is written at once, hence it counts as a single payload.
+  ++op.numPayloadsBeingWritten;
+
+  const std::chrono::microseconds window = context_->getWriteBatchingWindow();
+  if (numWriteBatchesBeingWritten_ == 0 || writeBatchLength_ >= maxBatchSize ||
+      now - writeBatchStart_ >= window) {
+    flushWriteBatch();
+  } else if (startingBatch) {
+    // Nothing else may come to flush the batch before the previous one has
+    // been written, which could take arbitrarily long.
+    context_->deferToLoopAt(
+        writeBatchStart_ + window, [impl{this->shared_from_this()}]() {
+          impl->flushWriteBatchIfWindowExpired();
+        });
+  }
+}
+
+void PipeImpl::flushWriteBatchIfWindowExpired() {
+  TP_DCHECK(context_->inLoop());
+
+  // The batch that armed the timer may have been flushed already, in which
+  // case any batch that's pending now armed a timer of its own.
+  if (writeBatch_.empty() ||
+      std::chrono::steady_clock::now() - writeBatchStart_ <
+          context_->getWriteBatchingWindow()) {
+    return;
+  }
+  TP_VLOG(2) << "Pipe " << id_ << " is flushing a batch as its window expired";
+  flushWriteBatch();
+}
+
 void PipeImpl::writeDescriptorOfMessage(WriteOpIter opIter) {
   TP_DCHECK(context_->inLoop());
 
   WriteOperation& op = *opIter;
 
-  std::shared_ptr<NopHolder<Descriptor>> holder = makeDescriptorForMessage(op);
+  // The messages that were batched before this one must precede it on the
+  // connection.
+  flushWriteBatch();
+
+  if (!descriptorPacketsEnabled_) {
+    TP_DCHECK(!op.warmup);
+    auto holder = std::make_shared<NopHolder<Descriptor>>();
+    holder->getObject() = makeDescriptorForMessage(op);
+    TP_VLOG(3) << "Pipe " << id_
+               << " is writing nop object (message descriptor #"
+               << op.sequenceNumber << ")";
+    descriptorConnection_->write(
+        *holder,
+        callbackWrapper_(
+            [sequenceNumber{op.sequenceNumber}, holder](PipeImpl& impl) {
+              TP_VLOG(3) << "Pipe " << impl.id_
+                         << " done writing nop object (message descriptor #"
+                         << sequenceNumber << ")";
+            }));
+    return;
+  }
+
+  auto holder = std::make_shared<NopHolder<DescriptorPacket>>();
+  DescriptorPacket& nopPacket = holder->getObject();
+  if (op.warmup) {
+    nopPacket.Become(nopPacket.index_of<WarmupMessage>());
+    nopPacket.get<WarmupMessage>()->descriptor = makeDescriptorForMessage(op);
+    nopPacket.get<WarmupMessage>()->echo = op.warmupEcho;
+  } else {
+    nopPacket.Become(nopPacket.index_of<Descriptor>());
+    *nopPacket.get<Descriptor>() = makeDescriptorForMessage(op);
+  }
 
   TP_VLOG(3) << "Pipe " << id_ << " is writing nop object (message descriptor #"
              << op.sequenceNumber << ")";
@@ -1005,6 +1812,17 @@ void PipeImpl::onReadWhileServerWaitingForBrochure(
   }
   nopBrochureAnswer.transportRegistrationIds[ConnectionId::DESCRIPTOR_REPLY] =
       registerTransport(ConnectionId::DESCRIPTOR_REPLY);
+  // The connection of the streams is only worth its cost if they'll be used.
+  if (nopBrochure.streamsEnabled || context_->getStreamsEnabled()) {
+    nopBrochureAnswer.transportRegistrationIds[ConnectionId::STREAM] =
+        registerTransport(ConnectionId::STREAM);
+  }
+
+  // The descriptors keep their plain framing unless either end needs packets.
+  descriptorPacketsEnabled_ = nopBrochure.descriptorPacketsEnabled ||
+      context_->getWarmupEnabled() ||
+      context_->getWriteBatchingMaxBatchSize() > 0;
+  nopBrochureAnswer.descriptorPacketsEnabled = descriptorPacketsEnabled_;
 
   nopBrochureAnswer.transport = transport.name;
   nopBrochureAnswer.address = transport.address;
@@ -1034,8 +1852,10 @@ void PipeImpl::onReadWhileServerWaitingForBrochure(
 
   if (!pendingRegistrations()) {
     state_ = ESTABLISHED;
+    readAheadDescriptorPacket();
     readOps_.advanceAllOperations();
     writeOps_.advanceAllOperations();
+    startStreams();
   } else {
     state_ = SERVER_WAITING_FOR_CONNECTIONS;
   }
@@ -1100,6 +1920,8 @@ void PipeImpl::onReadWhileClientWaitingForBrochureAnswer(
   TP_DCHECK(context_->inLoop());
   TP_DCHECK_EQ(state_, CLIENT_WAITING_FOR_BROCHURE_ANSWER);
 
+  descriptorPacketsEnabled_ = nopBrochureAnswer.descriptorPacketsEnabled;
+
   const std::string& transport = nopBrochureAnswer.transport;
   std::string address = nopBrochureAnswer.address;
   std::shared_ptr<transport::Context> transportContext =
@@ -1143,6 +1965,20 @@ void PipeImpl::onReadWhileClientWaitingForBrochureAnswer(
     descriptorReplyConnection_ = std::move(connection);
   }
 
+  // The server only asks for this connection if either end enabled streams.
+  const auto& streamRegistrationIter =
+      nopBrochureAnswer.transportRegistrationIds.find(ConnectionId::STREAM);
+  if (streamRegistrationIter !=
+      nopBrochureAnswer.transportRegistrationIds.end()) {
+    TP_VLOG(3) << "Pipe " << id_ << " is opening connection (stream)";
+    std::shared_ptr<transport::Connection> connection =
+        transportContext->connect(address);
+    connection->setId(id_ + ".s.tr_" + transport);
+    initConnection(*connection, streamRegistrationIter->second);
+
+    streamConnection_ = std::move(connection);
+  }
+
   // Recompute the channel map based on this side's channels and priorities.
   SelectedChannels selectedChannels = selectChannels(
       context_->getOrderedChannels(),
@@ -1201,8 +2037,10 @@ void PipeImpl::onReadWhileClientWaitingForBrochureAnswer(
   }
 
   state_ = ESTABLISHED;
+  readAheadDescriptorPacket();
   readOps_.advanceAllOperations();
   writeOps_.advanceAllOperations();
+  startStreams();
 }
 
 void PipeImpl::initConnection(
@@ -1245,14 +2083,20 @@ void PipeImpl::onAcceptWhileServerWaitingForConnection(
       receivedConnection->setId(id_ + ".r.tr_" + receivedTransport);
       descriptorReplyConnection_ = std::move(receivedConnection);
       break;
+    case ConnectionId::STREAM:
+      receivedConnection->setId(id_ + ".s.tr_" + receivedTransport);
+      streamConnection_ = std::move(receivedConnection);
+      break;
     default:
       TP_THROW_ASSERT() << "Unrecognized connection identifier";
   }
 
   if (!pendingRegistrations()) {
     state_ = ESTABLISHED;
+    readAheadDescriptorPacket();
     readOps_.advanceAllOperations();
     writeOps_.advanceAllOperations();
+    startStreams();
   }
 }
 
@@ -1298,8 +2142,10 @@ void PipeImpl::onAcceptWhileServerWaitingForChannel(
 
   if (!pendingRegistrations()) {
     state_ = ESTABLISHED;
+    readAheadDescriptorPacket();
     readOps_.advanceAllOperations();
     writeOps_.advanceAllOperations();
+    startStreams();
   }
 }
 
@@ -1315,4 +2161,720 @@ bool PipeImpl::pendingRegistrations() {
   return false;
 }
 
+bool PipeImpl::canReceiveIntoHostMemory(const Descriptor& descriptor) {
+  const Device cpuDevice{kCpuDeviceType, 0};
+  for (const auto& tensor : descriptor.tensors) {
+    if (tensor.targetDevice.has_value() &&
+        !(tensor.targetDevice.value() == cpuDevice)) {
+      return false;
+    }
+    if (channelForDevicePair_.find({cpuDevice, tensor.sourceDevice}) ==
+        channelForDevicePair_.end()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//
+// Streams
+//
+
+void PipeImpl::startStreams() {
+  TP_DCHECK(context_->inLoop());
+  TP_DCHECK_EQ(state_, ESTABLISHED);
+
+  // Fail the operations that were issued during the handshake if it turned out
+  // that neither end enabled streams.
+  if (!streamConnection_) {
+    std::unordered_map<uint64_t, StreamWriter> writers =
+        std::move(streamWriters_);
+    streamWriters_.clear();
+    for (auto& iter : writers) {
+      for (auto& op : iter.second.writes) {
+        op.callback(TP_CREATE_ERROR(StreamsNotEnabledError));
+      }
+    }
+    std::unordered_map<uint64_t, StreamReader> readers =
+        std::move(streamReaders_);
+    streamReaders_.clear();
+    for (auto& iter : readers) {
+      for (auto& op : iter.second.reads) {
+        op.callback(TP_CREATE_ERROR(StreamsNotEnabledError), 0);
+      }
+    }
+    return;
+  }
+
+  readStreamPacket();
+
+  // Catch up with the operations that were issued during the handshake.
+  for (auto& iter : streamReaders_) {
+    advertiseStreamCredits(iter.first, iter.second);
+  }
+  for (auto& iter : streamWriters_) {
+    dispatchStreamWrites(iter.first, iter.second);
+  }
+}
+
+void PipeImpl::readStreamPacket() {
+  TP_DCHECK(context_->inLoop());
+
+  auto nopHolderIn = std::make_shared<NopHolder<StreamPacket>>();
+  TP_VLOG(3) << "Pipe " << id_ << " is reading nop object (stream packet)";
+  streamConnection_->read(
+      *nopHolderIn, callbackWrapper_([nopHolderIn](PipeImpl& impl) {
+        TP_VLOG(3) << "Pipe " << impl.id_
+                   << " done reading nop object (stream packet)";
+        if (!impl.error_) {
+          impl.onReadStreamPacket(nopHolderIn->getObject());
+        }
+      }));
+}
+
+void PipeImpl::onReadStreamPacket(const StreamPacket& nopPacket) {
+  TP_DCHECK(context_->inLoop());
+
+  if (nopPacket.is<StreamCredit>()) {
+    onStreamCredit(*nopPacket.get<StreamCredit>());
+  } else if (nopPacket.is<StreamData>()) {
+    onStreamData(*nopPacket.get<StreamData>());
+  } else if (nopPacket.is<StreamEnd>()) {
+    onStreamEnd(*nopPacket.get<StreamEnd>());
+  } else {
+    TP_THROW_ASSERT() << "Unexpected packet type: " << nopPacket.index();
+  }
+}
+
+void PipeImpl::onStreamCredit(const StreamCredit& nopCredit) {
+  TP_DCHECK(context_->inLoop());
+
+  StreamWriter& writer = streamWriters_[nopCredit.streamId];
+  writer.credits.push_back(nopCredit.length);
+  dispatchStreamWrites(nopCredit.streamId, writer);
+
+  readStreamPacket();
+}
+
+void PipeImpl::onStreamData(const StreamData& nopData) {
+  TP_DCHECK(context_->inLoop());
+
+  const uint64_t streamId = nopData.streamId;
+  const uint64_t length = nopData.length;
+  auto iter = streamReaders_.find(streamId);
+  TP_THROW_ASSERT_IF(
+      iter == streamReaders_.end() || iter->second.numReadsAdvertised == 0)
+      << "Received data for stream " << streamId << " without giving credit";
+  StreamReadOperation& op = iter->second.reads.front();
+  TP_THROW_ASSERT_IF(length > op.length)
+      << "Received more data for stream " << streamId << " than given credit";
+
+  // The next packet is only read once this data has been consumed, so that the
+  // operation at the front of the queue is always the one being filled.
+  TP_VLOG(3) << "Pipe " << id_ << " is reading data of stream " << streamId;
+  streamConnection_->read(
+      op.ptr,
+      length,
+      callbackWrapper_([streamId, length](
+                           PipeImpl& impl,
+                           const void* /* unused */,
+                           size_t /* unused */) {
+        TP_VLOG(3) << "Pipe " << impl.id_ << " done reading data of stream "
+                   << streamId;
+        // On error, the operation was already failed by flushStreams.
+        if (impl.error_) {
+          return;
+        }
+        StreamReader& reader = impl.streamReaders_.at(streamId);
+        StreamReadOperation op = std::move(reader.reads.front());
+        reader.reads.pop_front();
+        reader.numReadsAdvertised--;
+        op.callback(Error::kSuccess, length);
+        impl.completeEmptyStreamReads(reader);
+
+        impl.readStreamPacket();
+      }));
+}
+
+void PipeImpl::onStreamEnd(const StreamEnd& nopEnd) {
+  TP_DCHECK(context_->inLoop());
+
+  TP_VLOG(2) << "Pipe " << id_ << " got the end of stream " << nopEnd.streamId;
+
+  // All the data of the stream has been received by now, hence the reads that
+  // are still pending will never be filled.
+  StreamReader& reader = streamReaders_[nopEnd.streamId];
+  reader.ended = true;
+  reader.numReadsAdvertised = 0;
+  std::deque<StreamReadOperation> reads = std::move(reader.reads);
+  reader.reads.clear();
+  for (auto& op : reads) {
+    op.callback(TP_CREATE_ERROR(StreamEndedError), 0);
+  }
+
+  readStreamPacket();
+}
+
+void PipeImpl::advertiseStreamCredits(uint64_t streamId, StreamReader& reader) {
+  TP_DCHECK(context_->inLoop());
+
+  while (reader.numReadsAdvertised < reader.reads.size()) {
+    const StreamReadOperation& op = reader.reads[reader.numReadsAdvertised];
+    // Empty buffers don't give the writer any credit.
+    if (op.length == 0) {
+      reader.numReadsAdvertised++;
+      continue;
+    }
+    auto nopHolderOut = std::make_shared<NopHolder<StreamPacket>>();
+    StreamPacket& nopPacket = nopHolderOut->getObject();
+    nopPacket.Become(nopPacket.index_of<StreamCredit>());
+    StreamCredit& nopCredit = *nopPacket.get<StreamCredit>();
+    nopCredit.streamId = streamId;
+    nopCredit.length = op.length;
+    TP_VLOG(3) << "Pipe " << id_
+               << " is writing nop object (stream credit for stream "
+               << streamId << ")";
+    streamConnection_->write(
+        *nopHolderOut,
+        callbackWrapper_([nopHolderOut, streamId](PipeImpl& impl) {
+          TP_VLOG(3) << "Pipe " << impl.id_
+                     << " done writing nop object (stream credit for stream "
+                     << streamId << ")";
+        }));
+    reader.numReadsAdvertised++;
+  }
+}
+
+void PipeImpl::completeEmptyStreamReads(StreamReader& reader) {
+  TP_DCHECK(context_->inLoop());
+
+  while (!reader.reads.empty() && reader.reads.front().length == 0) {
+    StreamReadOperation op = std::move(reader.reads.front());
+    reader.reads.pop_front();
+    if (reader.numReadsAdvertised > 0) {
+      reader.numReadsAdvertised--;
+    }
+    op.callback(Error::kSuccess, 0);
+  }
+}
+
+void PipeImpl::dispatchStreamWrites(uint64_t streamId, StreamWriter& writer) {
+  TP_DCHECK(context_->inLoop());
+
+  while (writer.numWritesDispatched < writer.writes.size()) {
+    StreamWriteOperation& op = writer.writes[writer.numWritesDispatched];
+    // Each chunk goes into a single buffer of the reader.
+    while (op.offset < op.length && !writer.credits.empty()) {
+      const uint64_t chunkLength =
+          std::min<uint64_t>(op.length - op.offset, writer.credits.front());
+      writer.credits.pop_front();
+
+      auto nopHolderOut = std::make_shared<NopHolder<StreamPacket>>();
+      StreamPacket& nopPacket = nopHolderOut->getObject();
+      nopPacket.Become(nopPacket.index_of<StreamData>());
+      StreamData& nopData = *nopPacket.get<StreamData>();
+      nopData.streamId = streamId;
+      nopData.length = chunkLength;
+      TP_VLOG(3) << "Pipe " << id_
+                 << " is writing nop object (stream data for stream "
+                 << streamId << ")";
+      streamConnection_->write(
+          *nopHolderOut,
+          callbackWrapper_([nopHolderOut, streamId](PipeImpl& impl) {
+            TP_VLOG(3) << "Pipe " << impl.id_
+                       << " done writing nop object (stream data for stream "
+                       << streamId << ")";
+          }));
+      TP_VLOG(3) << "Pipe " << id_ << " is writing data of stream "
+                 << streamId;
+      streamConnection_->write(
+          op.ptr + op.offset,
+          chunkLength,
+          callbackWrapper_([streamId](PipeImpl& impl) {
+            TP_VLOG(3) << "Pipe " << impl.id_ << " done writing data of stream "
+                       << streamId;
+            // On error, the operation was already failed by flushStreams.
+            if (impl.error_) {
+              return;
+            }
+            // Chunks complete in order, hence this one belongs to the oldest
+            // operation that still has some in flight.
+            StreamWriter& writer = impl.streamWriters_.at(streamId);
+            for (auto& op : writer.writes) {
+              if (op.numChunksBeingWritten > 0) {
+                op.numChunksBeingWritten--;
+                break;
+              }
+            }
+            impl.completeStreamWrites(writer);
+          }));
+      op.offset += chunkLength;
+      op.numChunksBeingWritten++;
+    }
+    if (op.offset < op.length) {
+      break;
+    }
+    writer.numWritesDispatched++;
+  }
+
+  // This completes the empty writes, which don't need any chunk.
+  completeStreamWrites(writer);
+
+  if (writer.ending && !writer.ended &&
+      writer.numWritesDispatched == writer.writes.size()) {
+    auto nopHolderOut = std::make_shared<NopHolder<StreamPacket>>();
+    StreamPacket& nopPacket = nopHolderOut->getObject();
+    nopPacket.Become(nopPacket.index_of<StreamEnd>());
+    StreamEnd& nopEnd = *nopPacket.get<StreamEnd>();
+    nopEnd.streamId = streamId;
+    TP_VLOG(3) << "Pipe " << id_
+               << " is writing nop object (stream end for stream " << streamId
+               << ")";
+    streamConnection_->write(
+        *nopHolderOut,
+        callbackWrapper_([nopHolderOut, streamId](PipeImpl& impl) {
+          TP_VLOG(3) << "Pipe " << impl.id_
+                     << " done writing nop object (stream end for stream "
+                     << streamId << ")";
+        }));
+    writer.ended = true;
+  }
+}
+
+void PipeImpl::completeStreamWrites(StreamWriter& writer) {
+  TP_DCHECK(context_->inLoop());
+
+  while (writer.numWritesDispatched > 0 &&
+         writer.writes.front().numChunksBeingWritten == 0) {
+    StreamWriteOperation op = std::move(writer.writes.front());
+    writer.writes.pop_front();
+    writer.numWritesDispatched--;
+    op.callback(Error::kSuccess);
+  }
+}
+
+void PipeImpl::flushStreams() {
+  TP_DCHECK(context_->inLoop());
+  TP_DCHECK(error_);
+
+  std::unordered_map<uint64_t, StreamWriter> writers =
+      std::move(streamWriters_);
+  streamWriters_.clear();
+  for (auto& iter : writers) {
+    for (auto& op : iter.second.writes) {
+      op.callback(error_);
+    }
+  }
+
+  std::unordered_map<uint64_t, StreamReader> readers =
+      std::move(streamReaders_);
+  streamReaders_.clear();
+  for (auto& iter : readers) {
+    for (auto& op : iter.second.reads) {
+      op.callback(error_, 0);
+    }
+  }
+}
+
+//
+// Tagged reads
+//
+
+void PipeImpl::receiveNextTaggedMessage() {
+  TP_DCHECK(context_->inLoop());
+
+  if (error_ || receivingTaggedMessage_) {
+    return;
+  }
+
+  // Once enough messages are buffered, only receive another one if it could be
+  // handed over right away, in the hope that it's the one that's awaited.
+  if (numUnmatchedTaggedMessages_ >= kMaxNumUnmatchedTaggedMessages &&
+      std::none_of(
+          taggedReaders_.begin(),
+          taggedReaders_.end(),
+          [](const std::pair<const uint64_t, TaggedReader>& iter) {
+            return !iter.second.descriptorCallbacks.empty();
+          })) {
+    return;
+  }
+
+  TP_VLOG(2) << "Pipe " << id_ << " is receiving the next tagged message";
+
+  receivingTaggedMessage_ = true;
+  readDescriptorFromLoop([this](const Error& error, Descriptor descriptor) {
+    onTaggedDescriptor(error, std::move(descriptor));
+  });
+}
+
+void PipeImpl::onTaggedDescriptor(const Error& error, Descriptor descriptor) {
+  TP_DCHECK(context_->inLoop());
+  TP_DCHECK(receivingTaggedMessage_);
+
+  if (error_) {
+    flushTaggedReads();
+    return;
+  }
+
+  if (error) {
+    // The message arrived past its deadline and was discarded by the pipe.
+    TP_DCHECK(error.isOfType<MessageExpiredError>());
+    receivingTaggedMessage_ = false;
+    receiveNextTaggedMessage();
+    return;
+  }
+
+  auto message = std::make_shared<TaggedMessage>();
+  message->descriptor = std::move(descriptor);
+  const uint64_t tag = message->descriptor.tag;
+  TaggedReader& reader = taggedReaders_[tag];
+
+  TP_VLOG(2) << "Pipe " << id_ << " received a message with tag " << tag;
+
+  if (reader.descriptorCallbacks.empty() &&
+      numUnmatchedTaggedMessages_ < kMaxNumUnmatchedTaggedMessages &&
+      canReceiveIntoHostMemory(message->descriptor)) {
+    // Tell the user to allocate the tensors where we are receiving them.
+    message->staged = true;
+    for (auto& tensor : message->descriptor.tensors) {
+      tensor.targetDevice = Device{kCpuDeviceType, 0};
+    }
+    // The pipe only expects the read call once this callback has returned.
+    context_->deferToLoop([impl{this->shared_from_this()}, message]() {
+      impl->stageTaggedMessage(message);
+    });
+    receivingTaggedMessage_ = false;
+  }
+
+  reader.unmatchedMessages.push_back(std::move(message));
+  numUnmatchedTaggedMessages_++;
+  matchTaggedMessage(reader);
+
+  receiveNextTaggedMessage();
+}
+
+void PipeImpl::stageTaggedMessage(std::shared_ptr<TaggedMessage> message) {
+  TP_DCHECK(context_->inLoop());
+
+  TP_VLOG(2) << "Pipe " << id_ << " is receiving a message with tag "
+             << message->descriptor.tag << " ahead of time";
+
+  Allocation allocation;
+  for (const auto& payload : message->descriptor.payloads) {
+    message->stagingPayloads.push_back(
+        std::make_unique<uint8_t[]>(payload.length));
+    allocation.payloads.push_back(
+        {.data = message->stagingPayloads.back().get()});
+  }
+  for (const auto& tensor : message->descriptor.tensors) {
+    message->stagingTensors.push_back(
+        std::make_unique<uint8_t[]>(tensor.length));
+    allocation.tensors.push_back(
+        {.buffer = CpuBuffer{.ptr = message->stagingTensors.back().get()}});
+  }
+
+  // The read is issued even after an error, as the pipe is waiting for it.
+  readFromLoop(std::move(allocation), [this, message](const Error& error) {
+    message->doneStaging = true;
+    message->stagingError = error;
+    if (message->readCallback) {
+      completeStagedTaggedRead(*message);
+    }
+  });
+}
+
+void PipeImpl::matchTaggedMessage(TaggedReader& reader) {
+  TP_DCHECK(context_->inLoop());
+
+  while (!reader.descriptorCallbacks.empty() &&
+         !reader.unmatchedMessages.empty()) {
+    std::shared_ptr<TaggedMessage> message =
+        std::move(reader.unmatchedMessages.front());
+    reader.unmatchedMessages.pop_front();
+    numUnmatchedTaggedMessages_--;
+    read_descriptor_callback_fn fn =
+        std::move(reader.descriptorCallbacks.front());
+    reader.descriptorCallbacks.pop_front();
+
+    reader.matchedMessages.push_back(message);
+    fn(Error::kSuccess, message->descriptor);
+  }
+}
+
+void PipeImpl::completeStagedTaggedRead(TaggedMessage& message) {
+  TP_DCHECK(context_->inLoop());
+  TP_DCHECK(message.doneStaging);
+
+  if (!message.stagingError) {
+    for (size_t payloadIdx = 0; payloadIdx < message.stagingPayloads.size();
+         payloadIdx++) {
+      std::memcpy(
+          message.allocation.payloads[payloadIdx].data,
+          message.stagingPayloads[payloadIdx].get(),
+          message.descriptor.payloads[payloadIdx].length);
+    }
+    for (size_t tensorIdx = 0; tensorIdx < message.stagingTensors.size();
+         tensorIdx++) {
+      std::memcpy(
+          message.allocation.tensors[tensorIdx]
+              .buffer.unwrap<CpuBuffer>()
+              .ptr,
+          message.stagingTensors[tensorIdx].get(),
+          message.descriptor.tensors[tensorIdx].length);
+    }
+  }
+  message.stagingPayloads.clear();
+  message.stagingTensors.clear();
+
+  read_callback_fn fn = std::move(message.readCallback);
+  message.readCallback = nullptr;
+  fn(message.stagingError);
+}
+
+void PipeImpl::flushTaggedReads() {
+  TP_DCHECK(context_->inLoop());
+  TP_DCHECK(error_);
+
+  // The messages that were already handed over are left in place, to match the
+  // read calls that the user will issue for them.
+  for (auto& iter : taggedReaders_) {
+    TaggedReader& reader = iter.second;
+    std::deque<read_descriptor_callback_fn> callbacks =
+        std::move(reader.descriptorCallbacks);
+    reader.descriptorCallbacks.clear();
+    reader.unmatchedMessages.clear();
+    for (auto& fn : callbacks) {
+      fn(error_, Descriptor());
+    }
+  }
+  numUnmatchedTaggedMessages_ = 0;
+}
+
+//
+// Warm-up
+//
+
+void PipeImpl::writeWarmupMessage(
+    std::shared_ptr<uint8_t> buffer,
+    const std::vector<size_t>& payloadLengths,
+    const std::vector<size_t>& tensorLengths,
+    bool echo) {
+  TP_DCHECK(context_->inLoop());
+
+  Message message;
+  for (size_t length : payloadLengths) {
+    message.payloads.push_back(
+        Message::Payload{.data = buffer.get(), .length = length});
+  }
+  for (size_t length : tensorLengths) {
+    Message::Tensor tensor;
+    tensor.buffer = CpuBuffer{.ptr = buffer.get()};
+    tensor.length = length;
+    tensor.targetDevice = Device{kCpuDeviceType, 0};
+    message.tensors.push_back(std::move(tensor));
+  }
+
+  // The outcome is reported by the echoes, or by the error that fails them.
+  WriteOpIter opIter = emplaceWriteOperation(
+      std::move(message), [buffer](const Error& /* unused */) {});
+  opIter->warmup = true;
+  opIter->warmupEcho = echo;
+  writeOps_.advanceOperation(opIter);
+}
+
+void PipeImpl::receiveWarmupMessage(const WarmupMessage& nopMessage) {
+  TP_DCHECK(context_->inLoop());
+
+  const Descriptor& descriptor = nopMessage.descriptor;
+  const bool echo = nopMessage.echo;
+  TP_VLOG(2) << "Pipe " << id_ << " is receiving a warm-up message"
+             << (echo ? " (echo)" : "");
+
+  // Its contents are thrown away, hence all payloads and tensors can share the
+  // same buffer.
+  size_t maxLength = 0;
+  for (const auto& payload : descriptor.payloads) {
+    maxLength = std::max(maxLength, payload.length);
+  }
+  for (const auto& tensor : descriptor.tensors) {
+    maxLength = std::max(maxLength, tensor.length);
+  }
+  std::shared_ptr<uint8_t> buffer(
+      new uint8_t[maxLength], std::default_delete<uint8_t[]>());
+
+  const size_t numPieces =
+      descriptor.payloads.size() + descriptor.tensors.size();
+  if (numPieces == 0) {
+    onWarmupMessageReceived(descriptor, std::move(buffer), echo);
+    return;
+  }
+  auto numPiecesLeft = std::make_shared<size_t>(numPieces);
+  auto onPieceReceived = [descriptor, buffer, echo, numPiecesLeft](
+                             PipeImpl& impl) {
+    if (--(*numPiecesLeft) == 0 && !impl.error_) {
+      impl.onWarmupMessageReceived(descriptor, buffer, echo);
+    }
+  };
+
+  for (const auto& payload : descriptor.payloads) {
+    descriptorConnection_->read(
+        buffer.get(),
+        payload.length,
+        callbackWrapper_([onPieceReceived](
+                             PipeImpl& impl,
+                             const void* /* unused */,
+                             size_t /* unused */) { onPieceReceived(impl); }));
+  }
+
+  for (const auto& tensor : descriptor.tensors) {
+    const Device localDevice{kCpuDeviceType, 0};
+    const auto& channelIter =
+        channelForDevicePair_.find({localDevice, tensor.sourceDevice});
+    TP_THROW_ASSERT_IF(channelIter == channelForDevicePair_.end())
+        << "Could not find suitable channel for sending from local device "
+        << localDevice.toString() << " to remote device "
+        << tensor.sourceDevice.toString();
+    channel::Channel& channel = *channels_.at(channelIter->second);
+    channel.recv(
+        CpuBuffer{.ptr = buffer.get()},
+        tensor.length,
+        callbackWrapper_(
+            [onPieceReceived](PipeImpl& impl) { onPieceReceived(impl); }));
+  }
+}
+
+void PipeImpl::onWarmupMessageReceived(
+    const Descriptor& descriptor,
+    std::shared_ptr<uint8_t> buffer,
+    bool echo) {
+  TP_DCHECK(context_->inLoop());
+
+  if (echo) {
+    TP_THROW_ASSERT_IF(pendingWarmups_.empty())
+        << "Received the echo of a warm-up that wasn't written";
+    PendingWarmup& warmup = pendingWarmups_.front();
+    if (--warmup.numEchoesLeft == 0) {
+      Pipe::warmup_callback_fn fn = std::move(warmup.fn);
+      pendingWarmups_.pop_front();
+      TP_VLOG(1) << "Pipe " << id_ << " is done with a warm-up";
+      fn(error_);
+    }
+    return;
+  }
+
+  // Writing the message back, from the buffer it was received into, warms up
+  // the other direction, and the buffers on this side that take part in it.
+  std::vector<size_t> payloadLengths;
+  for (const auto& payload : descriptor.payloads) {
+    payloadLengths.push_back(payload.length);
+  }
+  std::vector<size_t> tensorLengths;
+  for (const auto& tensor : descriptor.tensors) {
+    tensorLengths.push_back(tensor.length);
+  }
+  writeWarmupMessage(
+      std::move(buffer), payloadLengths, tensorLengths, /*echo=*/true);
+}
+
+void PipeImpl::flushWarmups() {
+  TP_DCHECK(context_->inLoop());
+
+  while (!pendingWarmups_.empty()) {
+    Pipe::warmup_callback_fn fn = std::move(pendingWarmups_.front().fn);
+    pendingWarmups_.pop_front();
+    fn(error_);
+  }
+}
+
+//
+// Write batching
+//
+
+bool PipeImpl::canBatchMessage(const Message& message) {
+  const size_t maxBatchSize = context_->getWriteBatchingMaxBatchSize();
+  return maxBatchSize > 0 && message.tensors.empty() &&
+      totalLengthOfMessage(message) <= maxBatchSize;
+}
+
+void PipeImpl::flushWriteBatch() {
+  TP_DCHECK(context_->inLoop());
+
+  if (writeBatch_.empty()) {
+    return;
+  }
+
+  std::vector<WriteOpIter> batch = std::move(writeBatch_);
+  writeBatch_.clear();
+  writeBatchLength_ = 0;
+
+  // Only happens when handling the error, which then fails the messages.
+  if (error_) {
+    for (WriteOpIter opIter : batch) {
+      opIter->numPayloadsBeingWritten--;
+    }
+    return;
+  }
+
+  // Batching is advertised during the handshake, hence packets are in use.
+  TP_DCHECK(descriptorPacketsEnabled_);
+  auto holder = std::make_shared<NopHolder<DescriptorPacket>>();
+  DescriptorPacket& nopPacket = holder->getObject();
+  nopPacket.Become(nopPacket.index_of<DescriptorBatch>());
+  DescriptorBatch& nopBatch = *nopPacket.get<DescriptorBatch>();
+
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  uint64_t numBytes = 0;
+  for (WriteOpIter opIter : batch) {
+    const WriteOperation& op = *opIter;
+    nopBatch.messages.emplace_back();
+    BatchedMessage& nopMessage = nopBatch.messages.back();
+    nopMessage.descriptor = makeDescriptorForMessage(op);
+    for (const Message::Payload& payload : op.message.payloads) {
+      nopMessage.payloadData.append(
+          reinterpret_cast<const char*>(payload.data), payload.length);
+    }
+    numBytes += nopMessage.payloadData.size();
+
+    const uint64_t delayNs =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - op.batchedAt)
+            .count();
+    totalBatchingDelayNs_ += delayNs;
+    if (delayNs > maxBatchingDelayNs_.load()) {
+      maxBatchingDelayNs_ = delayNs;
+    }
+  }
+  numBatches_++;
+  numMessagesBatched_ += batch.size();
+  numBytesBatched_ += numBytes;
+
+  TP_VLOG(2) << "Pipe " << id_ << " is writing a batch of messages (#"
+             << batch.front()->sequenceNumber << " to #"
+             << batch.back()->sequenceNumber << ")";
+  ++numWriteBatchesBeingWritten_;
+  descriptorConnection_->write(
+      *holder, callbackWrapper_([batch, holder](PipeImpl& impl) {
+        TP_VLOG(2) << "Pipe " << impl.id_
+                   << " done writing a batch of messages (#"
+                   << batch.front()->sequenceNumber << " to #"
+                   << batch.back()->sequenceNumber << ")";
+        impl.numWriteBatchesBeingWritten_--;
+        // The messages that were held back while this batch was being written
+        // can go now, rather than waiting for more to come.
+        impl.flushWriteBatch();
+        impl.onWriteBatchWritten(batch);
+      }));
+}
+
+void PipeImpl::onWriteBatchWritten(const std::vector<WriteOpIter>& batch) {
+  TP_DCHECK(context_->inLoop());
+
+  for (WriteOpIter opIter : batch) {
+    opIter->numPayloadsBeingWritten--;
+  }
+  // Advancing the first op carries on to the following ones, which may then be
+  // finished and gone, hence their iterators mustn't be used past this point.
+  writeOps_.advanceOperation(batch.front());
+}
+
 } // namespace tensorpipe
@@ -8,6 +8,9 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <deque>
 #include <map>
 #include <memory>
@@ -34,6 +37,14 @@ namespace tensorpipe {
 class ContextImpl;
 class ListenerImpl;
 
+// The encoded form of a tensor that's sent in the sparse encoding (see
+// Message::Tensor::sparseEncodingThreshold). It's shared so that it can be
+// captured by the (copyable) functions that are deferred to the loop.
+struct SparseTensor {
+  std::shared_ptr<uint8_t> data;
+  size_t length{0};
+};
+
 struct ReadOperation {
   enum State {
     UNINITIALIZED,
@@ -54,6 +65,17 @@ struct ReadOperation {
   uint64_t numPayloadsBeingRead{0};
   uint64_t numTensorsBeingReceived{0};
 
+  // Set when the message arrived past its deadline, in which case its payloads
+  // are drained by the connection and its tensors are received into a scratch
+  // buffer owned by the pipe, instead of into a user allocation.
+  bool expired{false};
+  std::shared_ptr<uint8_t> discardBuffer;
+
+  // Set when the message was received as part of a batch, in which case its
+  // payloads came along with its descriptor rather than after it.
+  bool batched{false};
+  std::string batchedPayloadData;
+
   // Callbacks.
   Pipe::read_descriptor_callback_fn readDescriptorCallback;
   Pipe::read_callback_fn readCallback;
@@ -83,6 +105,19 @@ struct WriteOperation {
   uint64_t numPayloadsBeingWritten{0};
   uint64_t numTensorsBeingSent{0};
 
+  // Set when the message's deadline passed before it could be written.
+  bool expired{false};
+
+  // Set when the message is small enough to be written as part of a batch, in
+  // which case its payloads are copied into the batch when it's flushed.
+  bool batched{false};
+  std::chrono::steady_clock::time_point batchedAt;
+
+  // Set for the synthetic messages written by Pipe::warmup, and for the echoes
+  // of the remote's ones.
+  bool warmup{false};
+  bool warmupEcho{false};
+
   // Callbacks.
   Pipe::write_callback_fn writeCallback;
 
@@ -94,10 +129,79 @@ struct WriteOperation {
   struct Tensor {
     Device sourceDevice;
     optional<Device> targetDevice;
+    // Set if the tensor is sent in the sparse encoding.
+    SparseTensor sparse;
   };
   std::vector<Tensor> tensors;
 };
 
+struct StreamReadOperation {
+  void* ptr{nullptr};
+  size_t length{0};
+  Stream::read_callback_fn callback;
+};
+
+// The receiving end of a stream.
+struct StreamReader {
+  std::deque<StreamReadOperation> reads;
+  // The reads at the front of the queue that were advertised as credits to the
+  // writer (which only happens once the pipe is established). Empty reads are
+  // counted too, although they don't give any credit.
+  size_t numReadsAdvertised{0};
+  bool ended{false};
+};
+
+struct StreamWriteOperation {
+  const uint8_t* ptr{nullptr};
+  size_t length{0};
+  // How much of the data has been handed to the connection.
+  size_t offset{0};
+  uint64_t numChunksBeingWritten{0};
+  Stream::write_callback_fn callback;
+};
+
+// The sending end of a stream.
+struct StreamWriter {
+  // The writes that haven't completed yet. The ones at the front of the queue
+  // have been entirely handed to the connection.
+  std::deque<StreamWriteOperation> writes;
+  size_t numWritesDispatched{0};
+  // The lengths of the buffers that the reader posted and that we haven't
+  // sent any data to yet.
+  std::deque<uint64_t> credits;
+  bool ending{false};
+  bool ended{false};
+};
+
+// A message received by a pipe that is consumed through tagged reads. It's
+// first waiting to be matched by a readDescriptor call for its tag, and then
+// for the read call that provides its allocation.
+struct TaggedMessage {
+  Descriptor descriptor;
+
+  // Set if the message was received ahead of being matched, into buffers owned
+  // by the pipe, from which it's then copied into the user's allocation.
+  bool staged{false};
+  bool doneStaging{false};
+  Error stagingError{Error::kSuccess};
+  std::vector<std::unique_ptr<uint8_t[]>> stagingPayloads;
+  std::vector<std::unique_ptr<uint8_t[]>> stagingTensors;
+
+  // Provided by the user's read call, for staged messages.
+  Allocation allocation;
+  Pipe::read_callback_fn readCallback;
+};
+
+// The receiving end of the messages with a given tag.
+struct TaggedReader {
+  // The readDescriptor calls that haven't been matched with a message yet.
+  std::deque<Pipe::read_descriptor_callback_fn> descriptorCallbacks;
+  // The messages that haven't been matched with a readDescriptor call yet.
+  std::deque<std::shared_ptr<TaggedMessage>> unmatchedMessages;
+  // The messages whose descriptor was handed to the user, awaiting a read call.
+  std::deque<std::shared_ptr<TaggedMessage>> matchedMessages;
+};
+
 class PipeImpl final : public std::enable_shared_from_this<PipeImpl> {
  public:
   PipeImpl(
@@ -124,9 +228,28 @@ class PipeImpl final : public std::enable_shared_from_this<PipeImpl> {
   void readDescriptor(read_descriptor_callback_fn fn);
   void read(Allocation allocation, read_callback_fn fn);
   void write(Message message, write_callback_fn fn);
+  void warmup(Pipe::WarmupProfile profile, Pipe::warmup_callback_fn fn);
+
+  void readDescriptor(uint64_t tag, read_descriptor_callback_fn fn);
+  void read(uint64_t tag, Allocation allocation, read_callback_fn fn);
+
+  void writeToStream(
+      uint64_t streamId,
+      const void* ptr,
+      size_t length,
+      Stream::write_callback_fn fn);
+  void readFromStream(
+      uint64_t streamId,
+      void* ptr,
+      size_t length,
+      Stream::read_callback_fn fn);
+  void endStream(uint64_t streamId);
 
   const std::string& getRemoteName();
 
+  Pipe::ExpiryStats getExpiryStats();
+  Pipe::BatchingStats getBatchingStats();
+
   void close();
 
  private:
@@ -136,7 +259,33 @@ class PipeImpl final : public std::enable_shared_from_this<PipeImpl> {
 
   void readFromLoop(Allocation allocation, read_callback_fn fn);
 
-  void writeFromLoop(Message message, write_callback_fn fn);
+  void writeFromLoop(
+      Message message,
+      write_callback_fn fn,
+      std::vector<SparseTensor> sparseTensors);
+
+  void warmupFromLoop(Pipe::WarmupProfile profile, Pipe::warmup_callback_fn fn);
+
+  void readTaggedDescriptorFromLoop(
+      uint64_t tag,
+      read_descriptor_callback_fn fn);
+
+  void readTaggedFromLoop(
+      uint64_t tag,
+      Allocation allocation,
+      read_callback_fn fn);
+
+  void writeToStreamFromLoop(
+      uint64_t streamId,
+      const void* ptr,
+      size_t length,
+      Stream::write_callback_fn fn);
+  void readFromStreamFromLoop(
+      uint64_t streamId,
+      void* ptr,
+      size_t length,
+      Stream::read_callback_fn fn);
+  void endStreamFromLoop(uint64_t streamId);
 
   void closeFromLoop();
 
@@ -165,9 +314,12 @@ class PipeImpl final : public std::enable_shared_from_this<PipeImpl> {
   std::string remoteName_;
 
   std::string transport_;
-  enum ConnectionId { DESCRIPTOR, DESCRIPTOR_REPLY };
+  enum ConnectionId { DESCRIPTOR, DESCRIPTOR_REPLY, STREAM };
   std::shared_ptr<transport::Connection> descriptorConnection_;
   std::shared_ptr<transport::Connection> descriptorReplyConnection_;
+  // Shared by all streams, in both directions. Only opened if either end of
+  // the pipe enabled streams.
+  std::shared_ptr<transport::Connection> streamConnection_;
 
   std::unordered_map<std::string, std::shared_ptr<channel::Channel>> channels_;
   std::unordered_map<std::pair<Device, Device>, std::string>
@@ -212,6 +364,15 @@ class PipeImpl final : public std::enable_shared_from_this<PipeImpl> {
   ConnectionState connectionState_{AWAITING_DESCRIPTOR};
   uint64_t messageBeingReadFromConnection_{0};
 
+  // When descriptors are framed as DescriptorPackets, the pipe reads the next
+  // packet on its own as soon as the connection is at a descriptor, so that
+  // the remote's warm-ups are drained even when nothing is being read. Any
+  // other packet is held until a read operation takes it. The operation that's
+  // waiting for the packet being read, if any, is stored here.
+  bool readingDescriptorPacket_{false};
+  optional<DescriptorPacket> nextDescriptorPacket_;
+  optional<ReadOpIter> opAwaitingDescriptorPacket_;
+
   // When reading, each message will be presented to the user in order for some
   // memory to be allocated for its payloads and tensors (this happens by
   // calling the readDescriptor callback and waiting for a read call). Under
@@ -224,8 +385,75 @@ class PipeImpl final : public std::enable_shared_from_this<PipeImpl> {
   // and store its iterator in this field.
   optional<ReadOpIter> nextMessageGettingAllocation_;
 
+  // How many messages with no matching tagged readDescriptor call can be
+  // received ahead of time before the pipe stops receiving.
+  static constexpr size_t kMaxNumUnmatchedTaggedMessages = 64;
+
+  // A pipe is consumed either through untagged or through tagged reads. In the
+  // latter case, the pipe issues the (untagged) reads of the messages itself,
+  // one at a time, and dispatches them to the tagged readers.
+  bool usingUntaggedReads_{false};
+  bool usingTaggedReads_{false};
+  std::unordered_map<uint64_t, TaggedReader> taggedReaders_;
+  size_t numUnmatchedTaggedMessages_{0};
+  // Whether the pipe is waiting for the descriptor of the next message, or for
+  // the allocation of a message that couldn't be received ahead of time.
+  bool receivingTaggedMessage_{false};
+
+  std::unordered_map<uint64_t, StreamReader> streamReaders_;
+  std::unordered_map<uint64_t, StreamWriter> streamWriters_;
+
   Error error_{Error::kSuccess};
 
+  // Counters for the messages that were shed because of their deadline. They
+  // are only modified from the loop but may be read from any thread.
+  std::atomic<uint64_t> numWritesShed_{0};
+  std::atomic<uint64_t> numBytesOfWritesShed_{0};
+  std::atomic<uint64_t> numReadsShed_{0};
+  std::atomic<uint64_t> numBytesOfReadsShed_{0};
+
+  // The buffer into which the tensors of expired messages are received, which
+  // is reused by all of them and only replaced by a larger one when needed (the
+  // older one being kept alive by the messages still using it). Their payloads
+  // don't need it, as the connection can drain them on its own.
+  std::shared_ptr<uint8_t> tensorDiscardBuffer_;
+  size_t tensorDiscardBufferLength_{0};
+
+  // Whether the descriptors are framed as DescriptorPackets, as agreed upon
+  // during the handshake, which is needed to send batches and warm-ups.
+  bool descriptorPacketsEnabled_{false};
+
+  // The warm-ups that were written and whose echoes haven't all come back yet,
+  // in the order in which they were written, which is also the order of the
+  // echoes. Each one's callback fires once its last echo is received.
+  struct PendingWarmup {
+    size_t numEchoesLeft;
+    Pipe::warmup_callback_fn fn;
+  };
+  std::deque<PendingWarmup> pendingWarmups_;
+
+  // The messages that will go in the next batch that's written, the total
+  // length of their payloads, and when the first of them was added. The next
+  // batch is flushed as soon as the previous one has been written, or once the
+  // window has passed since its first message was added (see
+  // ContextOptions::writeBatching for the other cases).
+  std::vector<WriteOpIter> writeBatch_;
+  size_t writeBatchLength_{0};
+  std::chrono::steady_clock::time_point writeBatchStart_;
+  size_t numWriteBatchesBeingWritten_{0};
+
+  // The messages of the last batch that was received that haven't been handed
+  // to a read operation yet.
+  std::deque<BatchedMessage> receivedBatch_;
+
+  // Counters for the messages that were written in batches. They are only
+  // modified from the loop but may be read from any thread.
+  std::atomic<uint64_t> numBatches_{0};
+  std::atomic<uint64_t> numMessagesBatched_{0};
+  std::atomic<uint64_t> numBytesBatched_{0};
+  std::atomic<uint64_t> totalBatchingDelayNs_{0};
+  std::atomic<uint64_t> maxBatchingDelayNs_{0};
+
   //
   // Helpers to prepare callbacks from transports and listener
   //
@@ -271,29 +499,112 @@ class PipeImpl final : public std::enable_shared_from_this<PipeImpl> {
   // Actions (i.e., methods that begin a state transition).
   // For read operations:
   void readDescriptorOfMessage(ReadOpIter opIter);
+  void readAheadDescriptorPacket();
+  void readNextDescriptorPacket();
+  void onDescriptorPacket(DescriptorPacket nopPacket);
+  void parseDescriptorPacketOfMessage(
+      ReadOperation& op,
+      DescriptorPacket& nopPacket);
   void callReadDescriptorCallback(ReadOpIter opIter);
   void expectReadCall(ReadOpIter opIter);
   void readPayloadsOfMessage(ReadOpIter opIter);
   void receiveTensorsOfMessage(ReadOpIter opIter);
   void writeDescriptorReplyOfMessage(ReadOpIter opIter);
+  void decodeSparseTensor(
+      ReadOpIter opIter,
+      size_t tensorIdx,
+      std::shared_ptr<uint8_t> sparseData);
+  void onTensorReceived(ReadOpIter opIter, size_t tensorIdx);
+  void discardPayloadsAndTensorsOfMessage(ReadOpIter opIter);
   void callReadCallback(ReadOpIter opIter);
   // For write operations:
+  void shedMessage(WriteOpIter opIter);
+  void addMessageToWriteBatch(WriteOpIter opIter);
   void writeDescriptorOfMessage(WriteOpIter opIter);
   void writePayloadsOfMessage(WriteOpIter opIter);
   void readDescriptorReplyOfMessage(WriteOpIter opIter);
   void sendTensorsOfMessage(WriteOpIter opIter);
   void callWriteCallback(WriteOpIter opIter);
 
+  //
+  // Streams
+  //
+
+  // Called once the pipe is established, to start exchanging stream packets.
+  void startStreams();
+  void readStreamPacket();
+  void onReadStreamPacket(const StreamPacket& nopPacket);
+  void onStreamCredit(const StreamCredit& nopCredit);
+  void onStreamData(const StreamData& nopData);
+  void onStreamEnd(const StreamEnd& nopEnd);
+  void advertiseStreamCredits(uint64_t streamId, StreamReader& reader);
+  void completeEmptyStreamReads(StreamReader& reader);
+  void dispatchStreamWrites(uint64_t streamId, StreamWriter& writer);
+  void completeStreamWrites(StreamWriter& writer);
+  void flushStreams();
+
+  //
+  // Tagged reads
+  //
+
+  void receiveNextTaggedMessage();
+  void onTaggedDescriptor(const Error& error, Descriptor descriptor);
+  void stageTaggedMessage(std::shared_ptr<TaggedMessage> message);
+  void matchTaggedMessage(TaggedReader& reader);
+  void completeStagedTaggedRead(TaggedMessage& message);
+  void flushTaggedReads();
+
+  //
+  // Warm-up
+  //
+
+  void writeWarmupMessage(
+      std::shared_ptr<uint8_t> buffer,
+      const std::vector<size_t>& payloadLengths,
+      const std::vector<size_t>& tensorLengths,
+      bool echo);
+  // Drain the payloads and tensors of a message written by the remote's
+  // warmup into a scratch buffer, and then echo it from that buffer (unless
+  // the message is itself an echo).
+  void receiveWarmupMessage(const WarmupMessage& nopMessage);
+  void onWarmupMessageReceived(
+      const Descriptor& descriptor,
+      std::shared_ptr<uint8_t> buffer,
+      bool echo);
+  void flushWarmups();
+
+  //
+  // Write batching
+  //
+
+  bool canBatchMessage(const Message& message);
+  void flushWriteBatch();
+  void flushWriteBatchIfWindowExpired();
+  void onWriteBatchWritten(const std::vector<WriteOpIter>& batch);
+
   //
   // Everything else
   //
 
+  // Add a write operation for the given message, without advancing it, so that
+  // its flags can be set first.
+  WriteOpIter emplaceWriteOperation(Message message, write_callback_fn fn);
+
+  // Fill in a read operation from the descriptor of its message, as received
+  // either on its own or as part of a batch.
+  void parseDescriptorOfMessage(ReadOperation& op, Descriptor descriptor);
+
   void initConnection(transport::Connection& connection, uint64_t token);
   uint64_t registerTransport(ConnectionId connId);
   std::vector<uint64_t>& registerChannel(const std::string& channelName);
 
   bool pendingRegistrations();
 
+  // Whether a message can be received without involving the user (e.g., to
+  // discard it because it arrived past its deadline), which requires receiving
+  // all its tensors on the CPU.
+  bool canReceiveIntoHostMemory(const Descriptor& descriptor);
+
   template <typename T>
   friend class CallbackWrapper;
 
@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <tensorpipe/core/stream.h>
+
+#include <utility>
+
+#include <tensorpipe/core/pipe_impl.h>
+
+namespace tensorpipe {
+
+Stream::Stream(std::shared_ptr<PipeImpl> impl, uint64_t id)
+    : impl_(std::move(impl)), id_(id) {}
+
+void Stream::write(const void* ptr, size_t length, write_callback_fn fn) {
+  impl_->writeToStream(id_, ptr, length, std::move(fn));
+}
+
+void Stream::read(void* ptr, size_t length, read_callback_fn fn) {
+  impl_->readFromStream(id_, ptr, length, std::move(fn));
+}
+
+void Stream::end() {
+  impl_->endStream(id_);
+}
+
+} // namespace tensorpipe
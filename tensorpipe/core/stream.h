@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include <tensorpipe/common/error.h>
+
+namespace tensorpipe {
+
+class Pipe;
+class PipeImpl;
+
+// A unidirectional stream of bytes, multiplexed on a pipe.
+//
+// Streams are meant for continuous flows of data (e.g., batches produced by a
+// data loader) for which sending each chunk as a separate message would be
+// wasteful, as each of them would have its own descriptor and require the
+// receiver to get involved to allocate its memory. Instead, the reader posts
+// buffers ahead of time, which are advertised to the writer as credits, and the
+// writer sends its data straight into them, with no intermediate copies. The
+// writer can't send more than the reader has asked for, hence no data is ever
+// buffered on the receiving side. Writes for which there isn't enough credit
+// are queued (without copying their data) until the reader posts more buffers.
+//
+// A stream is identified by a number, chosen by the user. To use a stream, both
+// ends obtain a handle with the same identifier from their pipe: then one end
+// writes to it and the other reads from it. The handles are lightweight and can
+// be copied, and obtaining one doesn't have any side effect. The same
+// identifier can thus also be used for another stream in the opposite
+// direction, where each end has the opposite role.
+//
+// Streams must be enabled on the context of at least one of the two ends (see
+// ContextOptions::enableStreams), otherwise their operations fail with a
+// StreamsNotEnabledError. All streams of a pipe share the same connection,
+// which is separate from the one used by messages, and thus they never hold
+// back messages (and vice versa). The data of a stream is always in CPU memory. Callbacks are invoked
+// in the order in which the corresponding operations were issued on the same
+// stream. If the pipe fails, or is closed, all operations fail with its error.
+class Stream final {
+ public:
+  using write_callback_fn = std::function<void(const Error&)>;
+
+  // Append the given bytes to the stream. The buffer must remain valid until
+  // the callback is invoked.
+  void write(const void* ptr, size_t length, write_callback_fn fn);
+
+  using read_callback_fn = std::function<void(const Error&, size_t)>;
+
+  // Post a buffer into which to receive the next bytes of the stream. The
+  // callback is invoked, with the number of bytes that were received, as soon
+  // as some data is placed into the buffer, even if it's not full. Hence
+  // posting larger buffers allows for fewer round-trips. An empty buffer
+  // receives nothing, and its callback is invoked once the reads that precede
+  // it have completed. Once the writer has ended the stream, and all its data
+  // has been read, reads fail with a StreamEndedError.
+  void read(void* ptr, size_t length, read_callback_fn fn);
+
+  // Signal to the reader that no more data will be written. This takes effect
+  // once all previous writes have been sent.
+  void end();
+
+  uint64_t getId() const {
+    return id_;
+  }
+
+ private:
+  Stream(std::shared_ptr<PipeImpl> impl, uint64_t id);
+
+  std::shared_ptr<PipeImpl> impl_;
+  uint64_t id_;
+
+  // Allow pipe to access constructor.
+  friend Pipe;
+};
+
+} // namespace tensorpipe
@@ -6,6 +6,8 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <vector>
@@ -16,6 +18,7 @@
 
 #include <tensorpipe/common/defs.h>
 #include <tensorpipe/common/optional.h>
+#include <tensorpipe/python/dlpack.h>
 #include <tensorpipe/tensorpipe.h>
 
 namespace py = pybind11;
@@ -76,13 +79,274 @@ class OutgoingPayload {
       : buffer(buffer, PyBUF_SIMPLE), metadata(metadata, PyBUF_SIMPLE) {}
 };
 
+// The element type and the shape of a tensor, which allow the receiver to
+// rebuild an array out of the raw bytes. They are carried at the start of the
+// tensor's metadata, before the user's one, and marked by a magic prefix so
+// that tensors sent as raw bytes (e.g., by C++ peers) are left alone.
+struct TensorLayout {
+  DLDataType dtype;
+  std::vector<int64_t> shape;
+
+  size_t numBytes() const {
+    size_t numBytes = (dtype.bits * dtype.lanes + 7) / 8;
+    for (int64_t dim : shape) {
+      numBytes *= dim;
+    }
+    return numBytes;
+  }
+};
+
+constexpr char kLayoutMagic[] = {'\0', 'T', 'P', 'D', 'L'};
+
+std::string encodeLayout(
+    const optional<TensorLayout>& layout,
+    const BufferWrapper& userMetadata) {
+  std::string metadata;
+  if (layout.has_value()) {
+    const uint32_t ndim = layout->shape.size();
+    metadata.append(kLayoutMagic, sizeof(kLayoutMagic));
+    metadata.append(
+        reinterpret_cast<const char*>(&layout->dtype), sizeof(DLDataType));
+    metadata.append(reinterpret_cast<const char*>(&ndim), sizeof(ndim));
+    metadata.append(
+        reinterpret_cast<const char*>(layout->shape.data()),
+        ndim * sizeof(int64_t));
+  }
+  metadata.append(
+      reinterpret_cast<char*>(userMetadata.ptr()), userMetadata.length());
+  return metadata;
+}
+
+// Extract the layout, if any, from the metadata, and return the user's part.
+std::string decodeLayout(
+    const std::string& metadata,
+    size_t length,
+    optional<TensorLayout>& layout) {
+  const size_t headerLength = sizeof(kLayoutMagic) + sizeof(DLDataType) +
+      sizeof(uint32_t);
+  if (metadata.size() < headerLength ||
+      std::memcmp(metadata.data(), kLayoutMagic, sizeof(kLayoutMagic)) != 0) {
+    return metadata;
+  }
+  const char* ptr = metadata.data() + sizeof(kLayoutMagic);
+  TensorLayout result;
+  std::memcpy(&result.dtype, ptr, sizeof(DLDataType));
+  ptr += sizeof(DLDataType);
+  uint32_t ndim;
+  std::memcpy(&ndim, ptr, sizeof(ndim));
+  ptr += sizeof(ndim);
+  if (metadata.size() < headerLength + ndim * sizeof(int64_t)) {
+    return metadata;
+  }
+  result.shape.resize(ndim);
+  std::memcpy(result.shape.data(), ptr, ndim * sizeof(int64_t));
+  ptr += ndim * sizeof(int64_t);
+  if (result.numBytes() != length) {
+    return metadata;
+  }
+  layout = std::move(result);
+  return std::string(ptr, metadata.data() + metadata.size());
+}
+
+// Map between DLPack data types and the type strings of NumPy's array
+// interface. Only little-endian hosts are supported.
+DLDataType dtypeFromTypestr(const std::string& typestr) {
+  TP_THROW_ASSERT_IF(
+      typestr.size() < 3 || (typestr[0] != '<' && typestr[0] != '|'))
+      << "Unsupported type string: " << typestr;
+  DLDataType dtype;
+  switch (typestr[1]) {
+    case 'b':
+      dtype.code = kDLBool;
+      break;
+    case 'i':
+      dtype.code = kDLInt;
+      break;
+    case 'u':
+      dtype.code = kDLUInt;
+      break;
+    case 'f':
+      dtype.code = kDLFloat;
+      break;
+    case 'c':
+      dtype.code = kDLComplex;
+      break;
+    default:
+      TP_THROW_ASSERT() << "Unsupported type string: " << typestr;
+  }
+  dtype.bits = std::stoi(typestr.substr(2)) * 8;
+  dtype.lanes = 1;
+  return dtype;
+}
+
+std::string typestrFromDtype(const DLDataType& dtype) {
+  TP_THROW_ASSERT_IF(dtype.lanes != 1 || dtype.bits % 8 != 0)
+      << "Unsupported data type";
+  std::string typestr = dtype.bits == 8 ? "|" : "<";
+  switch (dtype.code) {
+    case kDLBool:
+      typestr += 'b';
+      break;
+    case kDLInt:
+      typestr += 'i';
+      break;
+    case kDLUInt:
+      typestr += 'u';
+      break;
+    case kDLFloat:
+      typestr += 'f';
+      break;
+    case kDLComplex:
+      typestr += 'c';
+      break;
+    default:
+      TP_THROW_ASSERT() << "Data type has no type string: "
+                        << static_cast<int>(dtype.code);
+  }
+  typestr += std::to_string(dtype.bits / 8);
+  return typestr;
+}
+
+// Raise unless the strides (in elements) describe a C-contiguous tensor.
+void checkContiguous(
+    const std::vector<int64_t>& shape,
+    const std::vector<int64_t>& strides) {
+  int64_t expectedStride = 1;
+  for (size_t dimIdx = shape.size(); dimIdx-- > 0;) {
+    TP_THROW_ASSERT_IF(shape[dimIdx] != 1 && strides[dimIdx] != expectedStride)
+        << "Only contiguous tensors are supported";
+    expectedStride *= shape[dimIdx];
+  }
+}
+
+struct DLManagedTensorDeleter {
+  void operator()(DLManagedTensor* managedTensor) {
+    if (managedTensor->deleter != nullptr) {
+      // The producer's deleter typically releases Python objects, and the last
+      // reference to the tensor may be dropped by a TensorPipe thread.
+      py::gil_scoped_acquire acquire;
+      managedTensor->deleter(managedTensor);
+    }
+  }
+};
+
+// A tensor can be given as a DLPack capsule, as an object that can produce one
+// (i.e., that has a __dlpack__ method), as an object exposing NumPy's array
+// interface, or as any object supporting the buffer protocol. In all cases the
+// data is sent straight from the object's memory, which is kept alive until
+// the write completes. If sendLayout is set, the data type and the shape are
+// also sent, prepended to the metadata, so that the receiver can allocate an
+// array matching them (this requires one of the first three forms). Otherwise
+// the metadata is sent unchanged, as the receiver may not be expecting them.
 class OutgoingTensor {
  public:
-  BufferWrapper buffer;
   BufferWrapper metadata;
 
-  OutgoingTensor(const py::buffer& buffer, const py::buffer& metadata)
-      : buffer(buffer, PyBUF_SIMPLE), metadata(metadata, PyBUF_SIMPLE) {}
+  OutgoingTensor(
+      const py::object& tensor,
+      const py::buffer& metadata,
+      bool sendLayout)
+      : metadata(metadata, PyBUF_SIMPLE) {
+    if (!sendLayout && PyObject_CheckBuffer(tensor.ptr())) {
+      buffer_.emplace(py::reinterpret_borrow<py::buffer>(tensor), PyBUF_SIMPLE);
+      ptr_ = buffer_->ptr();
+      length_ = buffer_->length();
+    } else if (PyCapsule_CheckExact(tensor.ptr())) {
+      initFromDLPack(tensor);
+    } else if (py::hasattr(tensor, "__dlpack__")) {
+      initFromDLPack(tensor.attr("__dlpack__")());
+    } else if (py::hasattr(tensor, "__array_interface__")) {
+      initFromArrayInterface(tensor);
+    } else {
+      TP_THROW_ASSERT_IF(sendLayout)
+          << "The layout can only be sent for DLPack or array-interface tensors";
+      buffer_.emplace(py::reinterpret_borrow<py::buffer>(tensor), PyBUF_SIMPLE);
+      ptr_ = buffer_->ptr();
+      length_ = buffer_->length();
+    }
+    if (!sendLayout) {
+      layout_.reset();
+    }
+  }
+
+  void* ptr() const {
+    return ptr_;
+  }
+
+  size_t length() const {
+    return length_;
+  }
+
+  const optional<TensorLayout>& layout() const {
+    return layout_;
+  }
+
+ private:
+  void* ptr_{nullptr};
+  size_t length_{0};
+  optional<TensorLayout> layout_;
+
+  // What keeps the memory alive, depending on how it was given to us.
+  optional<BufferWrapper> buffer_;
+  std::unique_ptr<DLManagedTensor, DLManagedTensorDeleter> managedTensor_;
+  py::object arrayOwner_;
+
+  void initFromDLPack(const py::object& capsule) {
+    TP_THROW_ASSERT_IF(!PyCapsule_IsValid(capsule.ptr(), "dltensor"))
+        << "Not a DLPack capsule, or one that was already consumed";
+    // As prescribed by the DLPack protocol, we take ownership of the tensor
+    // and rename the capsule so that it won't free it.
+    managedTensor_.reset(static_cast<DLManagedTensor*>(
+        PyCapsule_GetPointer(capsule.ptr(), "dltensor")));
+    if (PyCapsule_SetName(capsule.ptr(), "used_dltensor") != 0) {
+      throw py::error_already_set();
+    }
+
+    const DLTensor& dlTensor = managedTensor_->dl_tensor;
+    TP_THROW_ASSERT_IF(dlTensor.device.device_type != kDLCPU)
+        << "Only CPU tensors are supported";
+    TensorLayout layout;
+    layout.dtype = dlTensor.dtype;
+    layout.shape.assign(dlTensor.shape, dlTensor.shape + dlTensor.ndim);
+    if (dlTensor.strides != nullptr) {
+      checkContiguous(
+          layout.shape,
+          std::vector<int64_t>(
+              dlTensor.strides, dlTensor.strides + dlTensor.ndim));
+    }
+    ptr_ = static_cast<uint8_t*>(dlTensor.data) + dlTensor.byte_offset;
+    length_ = layout.numBytes();
+    layout_ = std::move(layout);
+  }
+
+  void initFromArrayInterface(const py::object& array) {
+    py::dict interface = array.attr("__array_interface__").cast<py::dict>();
+    TensorLayout layout;
+    layout.dtype = dtypeFromTypestr(interface["typestr"].cast<std::string>());
+    layout.shape = interface["shape"].cast<std::vector<int64_t>>();
+    if (interface.contains("strides") && !interface["strides"].is_none()) {
+      const int64_t itemSize = layout.dtype.bits / 8;
+      std::vector<int64_t> strides =
+          interface["strides"].cast<std::vector<int64_t>>();
+      for (int64_t& stride : strides) {
+        TP_THROW_ASSERT_IF(stride % itemSize != 0)
+            << "Only contiguous tensors are supported";
+        stride /= itemSize;
+      }
+      checkContiguous(layout.shape, strides);
+    }
+    if (!interface.contains("data") || interface["data"].is_none()) {
+      // The memory is then exposed through the buffer protocol.
+      buffer_.emplace(py::reinterpret_borrow<py::buffer>(array), PyBUF_SIMPLE);
+      ptr_ = buffer_->ptr();
+    } else {
+      py::tuple data = interface["data"].cast<py::tuple>();
+      ptr_ = reinterpret_cast<void*>(data[0].cast<uintptr_t>());
+      arrayOwner_ = array;
+    }
+    length_ = layout.numBytes();
+    layout_ = std::move(layout);
+  }
 };
 
 class OutgoingMessage {
@@ -118,11 +382,9 @@ tensorpipe::Message prepareToWrite(std::shared_ptr<OutgoingMessage> pyMessage) {
   tpMessage.tensors.reserve(pyMessage->tensors.size());
   for (const auto& pyTensor : pyMessage->tensors) {
     tensorpipe::Message::Tensor tpTensor{
-        .buffer = tensorpipe::CpuBuffer{.ptr = pyTensor->buffer.ptr()},
-        .length = pyTensor->buffer.length(),
-        .metadata =
-            {reinterpret_cast<char*>(pyTensor->metadata.ptr()),
-             pyTensor->metadata.length()},
+        .buffer = tensorpipe::CpuBuffer{.ptr = pyTensor->ptr()},
+        .length = pyTensor->length(),
+        .metadata = encodeLayout(pyTensor->layout(), pyTensor->metadata),
     };
     tpMessage.tensors.push_back(std::move(tpTensor));
   }
@@ -148,23 +410,78 @@ class IncomingPayload {
   }
 };
 
+// Owns what an exported DLPack tensor points to.
+struct DLPackExport {
+  DLManagedTensor managedTensor;
+  std::vector<int64_t> shape;
+  std::shared_ptr<void> keepAlive;
+};
+
+void deleteDLPackExport(DLManagedTensor* managedTensor) {
+  delete static_cast<DLPackExport*>(managedTensor->manager_ctx);
+}
+
+// Free the tensor of a capsule that was never consumed.
+void deleteDLPackCapsule(PyObject* capsule) {
+  if (PyCapsule_IsValid(capsule, "dltensor")) {
+    DLManagedTensor* managedTensor = static_cast<DLManagedTensor*>(
+        PyCapsule_GetPointer(capsule, "dltensor"));
+    managedTensor->deleter(managedTensor);
+  }
+}
+
 class IncomingTensor {
  public:
   size_t length;
   optional<BufferWrapper> buffer;
+  // Memory allocated by the bindings, rather than provided by the user.
+  std::shared_ptr<uint8_t> storage;
   py::bytes metadata;
+  optional<TensorLayout> layout;
 
-  IncomingTensor(size_t length, py::bytes metadata)
-      : length(length), metadata(metadata) {}
+  IncomingTensor(
+      size_t length,
+      py::bytes metadata,
+      optional<TensorLayout> layout)
+      : length(length), metadata(metadata), layout(std::move(layout)) {}
 
   void set_buffer(const py::buffer& pyBuffer) {
-    TP_THROW_ASSERT_IF(buffer.has_value()) << "Buffer already set";
+    TP_THROW_ASSERT_IF(hasMemory()) << "Buffer already set";
     buffer.emplace(pyBuffer, PyBUF_SIMPLE | PyBUF_WRITABLE);
     if (buffer->length() != length) {
       buffer.reset();
       TP_THROW_ASSERT() << "Bad length";
     }
   }
+
+  // Receive the tensor into memory owned by this object, which can then be
+  // accessed as an array through DLPack or through the array interface.
+  void allocate() {
+    TP_THROW_ASSERT_IF(hasMemory()) << "Buffer already set";
+    storage = std::shared_ptr<uint8_t>(
+        new uint8_t[std::max<size_t>(length, 1)],
+        std::default_delete<uint8_t[]>());
+  }
+
+  bool hasMemory() const {
+    return buffer.has_value() || storage != nullptr;
+  }
+
+  void* ptr() const {
+    TP_THROW_ASSERT_IF(!hasMemory()) << "No buffer";
+    return buffer.has_value() ? buffer->ptr() : storage.get();
+  }
+
+  // Tensors that were sent as raw bytes are seen as 1-D arrays of bytes.
+  TensorLayout getLayout() const {
+    if (layout.has_value()) {
+      return layout.value();
+    }
+    TensorLayout bytesLayout;
+    bytesLayout.dtype = DLDataType{kDLUInt, 8, 1};
+    bytesLayout.shape = {static_cast<int64_t>(length)};
+    return bytesLayout;
+  }
 };
 
 class IncomingMessage {
@@ -191,8 +508,11 @@ std::shared_ptr<IncomingMessage> prepareToAllocate(
   std::vector<std::shared_ptr<IncomingTensor>> pyTensors;
   pyTensors.reserve(tpDescriptor.tensors.size());
   for (const auto& tpTensor : tpDescriptor.tensors) {
-    pyTensors.push_back(
-        std::make_shared<IncomingTensor>(tpTensor.length, tpTensor.metadata));
+    optional<TensorLayout> layout;
+    std::string metadata =
+        decodeLayout(tpTensor.metadata, tpTensor.length, layout);
+    pyTensors.push_back(std::make_shared<IncomingTensor>(
+        tpTensor.length, std::move(metadata), std::move(layout)));
   }
   auto pyMessage = std::make_shared<IncomingMessage>(
       tpDescriptor.metadata, std::move(pyPayloads), std::move(pyTensors));
@@ -212,9 +532,8 @@ tensorpipe::Allocation prepareToRead(
   }
   tpAllocation.tensors.reserve(pyMessage->tensors.size());
   for (const auto& pyTensor : pyMessage->tensors) {
-    TP_THROW_ASSERT_IF(!pyTensor->buffer.has_value()) << "No buffer";
     tensorpipe::Allocation::Tensor tpTensor{
-        .buffer = tensorpipe::CpuBuffer{.ptr = pyTensor->buffer.value().ptr()},
+        .buffer = tensorpipe::CpuBuffer{.ptr = pyTensor->ptr()},
     };
     tpAllocation.tensors.push_back(std::move(tpTensor));
   }
@@ -242,9 +561,10 @@ PYBIND11_MODULE(pytensorpipe, module) {
       py::arg("metadata"));
   shared_ptr_class_<OutgoingTensor> outgoingTensor(module, "OutgoingTensor");
   outgoingTensor.def(
-      py::init<py::buffer, py::buffer>(),
+      py::init<py::object, py::buffer, bool>(),
       py::arg("buffer"),
-      py::arg("metadata"));
+      py::arg("metadata"),
+      py::arg("send_layout") = false);
   shared_ptr_class_<OutgoingMessage> outgoingMessage(module, "OutgoingMessage");
   outgoingMessage.def(
       py::init<
@@ -277,6 +597,62 @@ PYBIND11_MODULE(pytensorpipe, module) {
         return pyTensor.buffer->getBuffer();
       },
       &IncomingTensor::set_buffer);
+  incomingTensor.def_property_readonly(
+      "dtype", [](IncomingTensor& pyTensor) -> py::object {
+        if (!pyTensor.layout.has_value()) {
+          return py::none();
+        }
+        return py::str(typestrFromDtype(pyTensor.layout->dtype));
+      });
+  incomingTensor.def_property_readonly(
+      "shape", [](IncomingTensor& pyTensor) -> py::object {
+        if (!pyTensor.layout.has_value()) {
+          return py::none();
+        }
+        return py::tuple(py::cast(pyTensor.layout->shape));
+      });
+  incomingTensor.def("allocate", &IncomingTensor::allocate);
+  incomingTensor.def(
+      "__dlpack__",
+      [](std::shared_ptr<IncomingTensor> pyTensor, py::object /* unused */) {
+        TensorLayout layout = pyTensor->getLayout();
+        auto dlpackExport = std::make_unique<DLPackExport>();
+        dlpackExport->shape = std::move(layout.shape);
+        // The memory may belong to this object or to the buffer it was given.
+        dlpackExport->keepAlive = pyTensor;
+        DLManagedTensor& managedTensor = dlpackExport->managedTensor;
+        managedTensor.dl_tensor.data = pyTensor->ptr();
+        managedTensor.dl_tensor.device = DLDevice{kDLCPU, 0};
+        managedTensor.dl_tensor.ndim = dlpackExport->shape.size();
+        managedTensor.dl_tensor.dtype = layout.dtype;
+        managedTensor.dl_tensor.shape = dlpackExport->shape.data();
+        managedTensor.dl_tensor.strides = nullptr;
+        managedTensor.dl_tensor.byte_offset = 0;
+        managedTensor.manager_ctx = dlpackExport.get();
+        managedTensor.deleter = deleteDLPackExport;
+        PyObject* capsule =
+            PyCapsule_New(&managedTensor, "dltensor", deleteDLPackCapsule);
+        if (capsule == nullptr) {
+          throw py::error_already_set();
+        }
+        dlpackExport.release();
+        return py::reinterpret_steal<py::object>(capsule);
+      },
+      py::arg("stream") = py::none());
+  incomingTensor.def("__dlpack_device__", [](IncomingTensor& /* unused */) {
+    return py::make_tuple(static_cast<int>(kDLCPU), 0);
+  });
+  incomingTensor.def_property_readonly(
+      "__array_interface__", [](IncomingTensor& pyTensor) {
+        TensorLayout layout = pyTensor.getLayout();
+        py::dict interface;
+        interface["shape"] = py::tuple(py::cast(layout.shape));
+        interface["typestr"] = typestrFromDtype(layout.dtype);
+        interface["data"] = py::make_tuple(
+            reinterpret_cast<uintptr_t>(pyTensor.ptr()), false);
+        interface["version"] = 3;
+        return interface;
+      });
   shared_ptr_class_<IncomingMessage> incomingMessage(
       module, "IncomingMessage", py::buffer_protocol());
   incomingMessage.def_readonly("metadata", &IncomingMessage::metadata);
@@ -390,26 +766,29 @@ PYBIND11_MODULE(pytensorpipe, module) {
       [](std::shared_ptr<tensorpipe::Pipe> pipe,
          std::shared_ptr<OutgoingMessage> pyMessage,
          py::object callback) {
-        tensorpipe::Message tpMessage = prepareToWrite(std::move(pyMessage));
+        tensorpipe::Message tpMessage = prepareToWrite(pyMessage);
+        // The message is kept alive until the write completes, as its data is
+        // sent straight from the memory of the objects it references.
         pipe->write(
             std::move(tpMessage),
-            [callback{std::move(callback)}](
+            [callback{std::move(callback)}, pyMessage{std::move(pyMessage)}](
                 const tensorpipe::Error& error) mutable {
+              py::gil_scoped_acquire acquire;
               if (error) {
                 TP_LOG_ERROR() << error.what();
-                return;
+              } else {
+                try {
+                  callback();
+                } catch (const py::error_already_set& err) {
+                  TP_LOG_ERROR() << "Callback raised exception: " << err.what();
+                }
               }
-              py::gil_scoped_acquire acquire;
-              try {
-                callback();
-              } catch (const py::error_already_set& err) {
-                TP_LOG_ERROR() << "Callback raised exception: " << err.what();
-              }
-              // Leaving the scope will decrease the refcount of callback which
-              // may cause it to get destructed, which might segfault since we
-              // won't be holding the GIL anymore. So we reset callback now,
-              // while we're still holding the GIL.
+              // Leaving the scope will decrease the refcount of callback and of
+              // the message, which may cause them to get destructed, which
+              // might segfault since we won't be holding the GIL anymore. So we
+              // reset them now, while we're still holding the GIL.
               callback = py::object();
+              pyMessage.reset();
             });
       });
 
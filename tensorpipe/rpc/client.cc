@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <tensorpipe/rpc/client.h>
+
+#include <utility>
+
+#include <tensorpipe/rpc/client_impl.h>
+
+namespace tensorpipe {
+namespace rpc {
+
+Client::Client(std::shared_ptr<Pipe> pipe)
+    : impl_(std::make_shared<ClientImpl>(std::move(pipe))) {
+  impl_->init();
+}
+
+Client::CallId Client::call(
+    Message request,
+    allocate_fn allocateResponse,
+    call_callback_fn fn,
+    optional<std::chrono::milliseconds> timeout) {
+  return impl_->call(
+      std::move(request),
+      std::move(allocateResponse),
+      std::move(fn),
+      std::move(timeout));
+}
+
+void Client::cancel(CallId callId) {
+  impl_->cancel(callId);
+}
+
+void Client::close() {
+  impl_->close();
+}
+
+Client::~Client() {
+  close();
+}
+
+} // namespace rpc
+} // namespace tensorpipe
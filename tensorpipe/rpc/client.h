@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include <tensorpipe/common/error.h>
+#include <tensorpipe/common/optional.h>
+#include <tensorpipe/core/message.h>
+
+namespace tensorpipe {
+
+class Pipe;
+
+namespace rpc {
+
+class ClientImpl;
+
+// The client side of a request/response protocol running on top of a pipe.
+//
+// Any number of calls can be outstanding at the same time: requests are written
+// to the pipe as soon as they are issued, and responses are matched to their
+// call using an identifier that is carried in the message's metadata, hence
+// they can arrive in any order. The payloads and tensors of requests and
+// responses are never copied: the ones of the request are sent straight from
+// the user's buffers, and the ones of the response are received into the
+// buffers that the user provides when the response's descriptor arrives.
+//
+// The pipe must be used exclusively by the client, and the other end of it
+// must be served by a rpc::Server.
+class Client final {
+ public:
+  explicit Client(std::shared_ptr<Pipe> pipe);
+
+  using CallId = uint64_t;
+
+  // Invoked, on the pipe's event loop, when the descriptor of the response
+  // arrives, to obtain the memory into which to receive its payloads and
+  // tensors. It must match the descriptor as described for Pipe::read.
+  using allocate_fn = std::function<Allocation(const Descriptor&)>;
+
+  // Invoked exactly once for each call, with the descriptor of the response
+  // (whose payloads and tensors have been received into the allocation) or
+  // with an error. It's only invoked once the buffers of the request are no
+  // longer in use, hence they can be released at that point. As it can be
+  // called from internal threads it must not block.
+  using call_callback_fn = std::function<void(const Error&, Descriptor)>;
+
+  // Issue a call. If a timeout is given, the call fails with a
+  // CallTimedOutError once it expires, and the request and response are
+  // given a deadline (see Message::deadline) so that they get dropped if
+  // they're still in flight at that point.
+  CallId call(
+      Message request,
+      allocate_fn allocateResponse,
+      call_callback_fn fn,
+      optional<std::chrono::milliseconds> timeout = nullopt);
+
+  // Make the call fail with a CallCancelledError, unless its response already
+  // started being received, in which case this is a no-op. The server isn't
+  // notified, hence the response may still be sent, but it will be discarded.
+  void cancel(CallId callId);
+
+  // Fail all outstanding calls and close the pipe.
+  void close();
+
+  ~Client();
+
+ private:
+  const std::shared_ptr<ClientImpl> impl_;
+};
+
+} // namespace rpc
+} // namespace tensorpipe
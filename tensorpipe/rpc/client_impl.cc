@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <tensorpipe/rpc/client_impl.h>
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include <tensorpipe/common/defs.h>
+#include <tensorpipe/common/error_macros.h>
+#include <tensorpipe/common/system.h>
+#include <tensorpipe/core/error.h>
+#include <tensorpipe/rpc/error.h>
+#include <tensorpipe/rpc/framing.h>
+
+namespace tensorpipe {
+namespace rpc {
+
+ClientImpl::ClientImpl(std::shared_ptr<Pipe> pipe) : pipe_(std::move(pipe)) {}
+
+void ClientImpl::init() {
+  readNextResponse();
+  // The thread keeps the client alive until it's closed, so that it's never
+  // the one destroying it (which would require it to join itself).
+  timeoutThread_ = std::thread(
+      [impl{this->shared_from_this()}]() { impl->handleTimeouts(); });
+}
+
+ClientImpl::CallId ClientImpl::call(
+    Message request,
+    allocate_fn allocateResponse,
+    call_callback_fn fn,
+    optional<std::chrono::milliseconds> timeout) {
+  CallId callId;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    callId = nextCallId_++;
+    if (error_) {
+      Error error = error_;
+      lock.unlock();
+      fn(error, Descriptor());
+      return callId;
+    }
+
+    Call& call = calls_[callId];
+    call.allocateResponse = std::move(allocateResponse);
+    call.callback = std::move(fn);
+    if (timeout.has_value()) {
+      call.timeoutIter =
+          timeouts_.emplace(TClock::now() + timeout.value(), callId);
+      if (call.timeoutIter.value() == timeouts_.begin()) {
+        timeoutsCv_.notify_all();
+      }
+    }
+  }
+
+  if (timeout.has_value()) {
+    std::chrono::system_clock::time_point deadline =
+        std::chrono::system_clock::now() + timeout.value();
+    if (!request.deadline.has_value() || deadline < request.deadline.value()) {
+      request.deadline = deadline;
+    }
+  }
+
+  TP_VLOG(6) << "RPC client is issuing call #" << callId;
+  appendTrailer(request.metadata, Trailer{callId, MessageType::kRequest});
+  pipe_->write(
+      std::move(request),
+      [impl{this->shared_from_this()}, callId](const Error& error) {
+        impl->onRequestWritten(callId, error);
+      });
+
+  return callId;
+}
+
+void ClientImpl::cancel(CallId callId) {
+  std::vector<std::function<void()>> callbacks;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto iter = calls_.find(callId);
+    if (iter == calls_.end() || iter->second.receivingResponse) {
+      return;
+    }
+    TP_VLOG(6) << "RPC client is cancelling call #" << callId;
+    setOutcomeLocked(
+        iter->second, TP_CREATE_ERROR(CallCancelledError), Descriptor());
+    maybeCompleteLocked(callId, callbacks);
+  }
+  for (auto& callback : callbacks) {
+    callback();
+  }
+}
+
+void ClientImpl::close() {
+  std::vector<std::function<void()>> callbacks;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    callbacks = setErrorLocked(TP_CREATE_ERROR(ClientClosedError));
+  }
+  pipe_->close();
+  for (auto& callback : callbacks) {
+    callback();
+  }
+
+  // The close may come from a callback invoked by the timeout thread.
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (timeoutThread_.joinable()) {
+    if (timeoutThread_.get_id() == std::this_thread::get_id()) {
+      timeoutThread_.detach();
+    } else {
+      std::thread thread = std::move(timeoutThread_);
+      lock.unlock();
+      thread.join();
+    }
+  }
+}
+
+void ClientImpl::readNextResponse() {
+  pipe_->readDescriptor([impl{this->shared_from_this()}](
+                            const Error& error, Descriptor descriptor) {
+    impl->onResponseDescriptor(error, std::move(descriptor));
+  });
+}
+
+void ClientImpl::onResponseDescriptor(
+    const Error& error,
+    Descriptor descriptor) {
+  std::vector<std::function<void()>> callbacks;
+
+  // Expired responses were discarded by the pipe, but their descriptor can
+  // still tell which call they were for.
+  if (error && !error.isOfType<MessageExpiredError>()) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      callbacks = setErrorLocked(error);
+    }
+    for (auto& callback : callbacks) {
+      callback();
+    }
+    return;
+  }
+
+  Trailer trailer;
+  if (!stripTrailer(descriptor.metadata, trailer) ||
+      trailer.type == MessageType::kRequest) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      callbacks = setErrorLocked(
+          TP_CREATE_ERROR(LogicError, "received a malformed response"));
+    }
+    pipe_->close();
+    for (auto& callback : callbacks) {
+      callback();
+    }
+    return;
+  }
+  const CallId callId = trailer.callId;
+
+  if (error) {
+    readNextResponse();
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      auto iter = calls_.find(callId);
+      if (iter != calls_.end() && !iter->second.receivingResponse) {
+        setOutcomeLocked(
+            iter->second, TP_CREATE_ERROR(CallTimedOutError), Descriptor());
+        maybeCompleteLocked(callId, callbacks);
+      }
+    }
+    for (auto& callback : callbacks) {
+      callback();
+    }
+    return;
+  }
+
+  allocate_fn allocateResponse;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto iter = calls_.find(callId);
+    if (iter != calls_.end() && !iter->second.hasOutcome) {
+      Call& call = iter->second;
+      call.receivingResponse = true;
+      if (call.timeoutIter.has_value()) {
+        timeouts_.erase(call.timeoutIter.value());
+        call.timeoutIter.reset();
+      }
+      allocateResponse = call.allocateResponse;
+    }
+  }
+
+  TP_VLOG(6) << "RPC client is receiving the response of call #" << callId;
+
+  Allocation allocation;
+  if (trailer.type == MessageType::kErrorResponse) {
+    // Error responses have no payloads and tensors.
+  } else if (allocateResponse) {
+    allocation = allocateResponse(descriptor);
+  } else if (!allocateForDiscarding(
+                 descriptor,
+                 allocation,
+                 discardBuffer_,
+                 discardBufferLength_)) {
+    // Nobody is waiting for this response anymore, but we can't drain it.
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      callbacks = setErrorLocked(TP_CREATE_ERROR(
+          LogicError,
+          "can't discard a response whose tensors target a non-CPU device"));
+    }
+    pipe_->close();
+    for (auto& callback : callbacks) {
+      callback();
+    }
+    return;
+  }
+
+  pipe_->read(
+      std::move(allocation),
+      [impl{this->shared_from_this()},
+       callId,
+       type{trailer.type},
+       descriptor{std::move(descriptor)},
+       discardBuffer{discardBuffer_}](const Error& error) mutable {
+        impl->onResponse(callId, type, error, std::move(descriptor));
+      });
+  readNextResponse();
+}
+
+void ClientImpl::onResponse(
+    CallId callId,
+    MessageType type,
+    const Error& error,
+    Descriptor descriptor) {
+  std::vector<std::function<void()>> callbacks;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto iter = calls_.find(callId);
+    if (iter != calls_.end() && iter->second.receivingResponse) {
+      Error outcome = error;
+      if (!outcome && type == MessageType::kErrorResponse) {
+        outcome = TP_CREATE_ERROR(RemoteError, descriptor.metadata);
+      }
+      setOutcomeLocked(iter->second, std::move(outcome), std::move(descriptor));
+      maybeCompleteLocked(callId, callbacks);
+    }
+    if (error) {
+      std::vector<std::function<void()>> moreCallbacks = setErrorLocked(error);
+      std::move(
+          moreCallbacks.begin(),
+          moreCallbacks.end(),
+          std::back_inserter(callbacks));
+    }
+  }
+  for (auto& callback : callbacks) {
+    callback();
+  }
+}
+
+void ClientImpl::onRequestWritten(CallId callId, const Error& error) {
+  std::vector<std::function<void()>> callbacks;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto iter = calls_.find(callId);
+    TP_DCHECK(iter != calls_.end());
+    Call& call = iter->second;
+    call.doneWritingRequest = true;
+    if (error) {
+      // The pipe sheds requests that are still queued past their deadline.
+      setOutcomeLocked(
+          call,
+          error.isOfType<MessageExpiredError>()
+              ? TP_CREATE_ERROR(CallTimedOutError)
+              : error,
+          Descriptor());
+    }
+    maybeCompleteLocked(callId, callbacks);
+  }
+  for (auto& callback : callbacks) {
+    callback();
+  }
+}
+
+void ClientImpl::handleTimeouts() {
+  setThreadName("TP_RPC_timeouts");
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Once an error is set all calls have an outcome and no new ones can start.
+  while (!error_) {
+    if (timeouts_.empty()) {
+      timeoutsCv_.wait(lock);
+      continue;
+    }
+    const TClock::time_point expiry = timeouts_.begin()->first;
+    if (TClock::now() < expiry) {
+      timeoutsCv_.wait_until(lock, expiry);
+      continue;
+    }
+
+    const CallId callId = timeouts_.begin()->second;
+    auto iter = calls_.find(callId);
+    TP_DCHECK(iter != calls_.end());
+    TP_VLOG(6) << "RPC client's call #" << callId << " timed out";
+    // This also removes the call from the timeouts.
+    setOutcomeLocked(
+        iter->second, TP_CREATE_ERROR(CallTimedOutError), Descriptor());
+    std::vector<std::function<void()>> callbacks;
+    maybeCompleteLocked(callId, callbacks);
+
+    lock.unlock();
+    for (auto& callback : callbacks) {
+      callback();
+    }
+    lock.lock();
+  }
+}
+
+void ClientImpl::setOutcomeLocked(Call& call, Error error, Descriptor response) {
+  if (call.hasOutcome) {
+    return;
+  }
+  call.hasOutcome = true;
+  call.error = std::move(error);
+  call.response = std::move(response);
+  if (call.timeoutIter.has_value()) {
+    timeouts_.erase(call.timeoutIter.value());
+    call.timeoutIter.reset();
+  }
+}
+
+void ClientImpl::maybeCompleteLocked(
+    CallId callId,
+    std::vector<std::function<void()>>& callbacks) {
+  auto iter = calls_.find(callId);
+  if (iter == calls_.end()) {
+    return;
+  }
+  Call& call = iter->second;
+  if (!call.hasOutcome || !call.doneWritingRequest) {
+    return;
+  }
+  TP_VLOG(6) << "RPC client is completing call #" << callId;
+  callbacks.push_back([fn{std::move(call.callback)},
+                       error{std::move(call.error)},
+                       response{std::move(call.response)}]() mutable {
+    fn(error, std::move(response));
+  });
+  calls_.erase(iter);
+}
+
+std::vector<std::function<void()>> ClientImpl::setErrorLocked(Error error) {
+  std::vector<std::function<void()>> callbacks;
+  if (error_) {
+    return callbacks;
+  }
+  error_ = std::move(error);
+  timeoutsCv_.notify_all();
+
+  // Calls that are receiving their response will be failed by the pipe.
+  std::vector<CallId> callIds;
+  for (auto& iter : calls_) {
+    if (!iter.second.receivingResponse) {
+      setOutcomeLocked(iter.second, error_, Descriptor());
+      callIds.push_back(iter.first);
+    }
+  }
+  for (CallId callId : callIds) {
+    maybeCompleteLocked(callId, callbacks);
+  }
+  return callbacks;
+}
+
+} // namespace rpc
+} // namespace tensorpipe
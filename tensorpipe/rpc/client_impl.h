@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <tensorpipe/common/error.h>
+#include <tensorpipe/common/optional.h>
+#include <tensorpipe/core/message.h>
+#include <tensorpipe/core/pipe.h>
+#include <tensorpipe/rpc/client.h>
+#include <tensorpipe/rpc/framing.h>
+
+namespace tensorpipe {
+namespace rpc {
+
+class ClientImpl final : public std::enable_shared_from_this<ClientImpl> {
+ public:
+  explicit ClientImpl(std::shared_ptr<Pipe> pipe);
+
+  // Called by the client's constructor.
+  void init();
+
+  using CallId = Client::CallId;
+  using allocate_fn = Client::allocate_fn;
+  using call_callback_fn = Client::call_callback_fn;
+
+  CallId call(
+      Message request,
+      allocate_fn allocateResponse,
+      call_callback_fn fn,
+      optional<std::chrono::milliseconds> timeout);
+
+  void cancel(CallId callId);
+
+  void close();
+
+ private:
+  using TClock = std::chrono::steady_clock;
+  using TTimeouts = std::multimap<TClock::time_point, CallId>;
+
+  struct Call {
+    allocate_fn allocateResponse;
+    call_callback_fn callback;
+
+    // The request's buffers can't be released before the pipe is done with
+    // them, hence the callback is held back until this is set.
+    bool doneWritingRequest{false};
+    // Once the response started being received the call can't be cancelled
+    // or time out anymore, as the user's allocation is in use.
+    bool receivingResponse{false};
+
+    bool hasOutcome{false};
+    Error error{Error::kSuccess};
+    Descriptor response;
+
+    optional<TTimeouts::iterator> timeoutIter;
+  };
+
+  const std::shared_ptr<Pipe> pipe_;
+
+  std::mutex mutex_;
+  std::unordered_map<CallId, Call> calls_;
+  CallId nextCallId_{0};
+  // Once set, all new calls fail immediately with this error.
+  Error error_{Error::kSuccess};
+
+  // The calls that have a timeout, sorted by when it expires. They're handled
+  // by a dedicated thread, which sleeps until the earliest one.
+  TTimeouts timeouts_;
+  std::condition_variable timeoutsCv_;
+  std::thread timeoutThread_;
+
+  // Receives the tensors of the responses that nobody is waiting for anymore.
+  // It's only accessed from the descriptor callbacks, which are sequential.
+  std::shared_ptr<uint8_t> discardBuffer_;
+  size_t discardBufferLength_{0};
+
+  void readNextResponse();
+  void onResponseDescriptor(const Error& error, Descriptor descriptor);
+  void onResponse(
+      CallId callId,
+      MessageType type,
+      const Error& error,
+      Descriptor descriptor);
+  void onRequestWritten(CallId callId, const Error& error);
+
+  void handleTimeouts();
+
+  // Record the outcome of a call, unless it already has one.
+  void setOutcomeLocked(Call& call, Error error, Descriptor response);
+  // If the call can be completed, remove it and append its callback to the
+  // given list, so that it can be invoked once the lock is released.
+  void maybeCompleteLocked(
+      CallId callId,
+      std::vector<std::function<void()>>& callbacks);
+
+  // Fail all calls and prevent new ones. Returns the callbacks to invoke.
+  std::vector<std::function<void()>> setErrorLocked(Error error);
+};
+
+} // namespace rpc
+} // namespace tensorpipe
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <tensorpipe/rpc/error.h>
+
+#include <sstream>
+
+namespace tensorpipe {
+namespace rpc {
+
+std::string RemoteError::what() const {
+  std::ostringstream ss;
+  ss << "remote error: " << reason_;
+  return ss.str();
+}
+
+std::string CallCancelledError::what() const {
+  return "call cancelled";
+}
+
+std::string CallTimedOutError::what() const {
+  return "call timed out";
+}
+
+std::string ClientClosedError::what() const {
+  return "client closed";
+}
+
+std::string ServerClosedError::what() const {
+  return "server closed";
+}
+
+} // namespace rpc
+} // namespace tensorpipe
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <string>
+
+#include <tensorpipe/common/error.h>
+
+namespace tensorpipe {
+namespace rpc {
+
+// The handler on the server reported a failure for the call.
+class RemoteError final : public BaseError {
+ public:
+  explicit RemoteError(std::string reason) : reason_(std::move(reason)) {}
+
+  std::string what() const override;
+
+ private:
+  const std::string reason_;
+};
+
+class CallCancelledError final : public BaseError {
+ public:
+  explicit CallCancelledError() {}
+
+  std::string what() const override;
+};
+
+class CallTimedOutError final : public BaseError {
+ public:
+  explicit CallTimedOutError() {}
+
+  std::string what() const override;
+};
+
+class ClientClosedError final : public BaseError {
+ public:
+  explicit ClientClosedError() {}
+
+  std::string what() const override;
+};
+
+class ServerClosedError final : public BaseError {
+ public:
+  explicit ServerClosedError() {}
+
+  std::string what() const override;
+};
+
+} // namespace rpc
+} // namespace tensorpipe
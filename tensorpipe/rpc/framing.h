@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include <tensorpipe/common/cpu_buffer.h>
+#include <tensorpipe/core/message.h>
+
+namespace tensorpipe {
+namespace rpc {
+
+// Requests and responses are regular messages, whose metadata is suffixed with
+// a fixed-size trailer that identifies the call they belong to. Using a suffix
+// rather than a prefix allows to add and remove it without moving the user's
+// metadata around.
+
+enum class MessageType : uint8_t {
+  kRequest = 0,
+  kResponse = 1,
+  // The payloads and tensors are empty and the metadata holds the reason.
+  kErrorResponse = 2,
+};
+
+struct Trailer {
+  uint64_t callId;
+  MessageType type;
+};
+
+constexpr size_t kTrailerLength = sizeof(uint64_t) + sizeof(uint8_t);
+
+inline void appendTrailer(std::string& metadata, const Trailer& trailer) {
+  char buffer[kTrailerLength];
+  std::memcpy(buffer, &trailer.callId, sizeof(uint64_t));
+  buffer[sizeof(uint64_t)] = static_cast<char>(trailer.type);
+  metadata.append(buffer, kTrailerLength);
+}
+
+// Return false if the metadata doesn't end with a well-formed trailer.
+inline bool stripTrailer(std::string& metadata, Trailer& trailer) {
+  if (metadata.size() < kTrailerLength) {
+    return false;
+  }
+  const char* buffer = &metadata[metadata.size() - kTrailerLength];
+  std::memcpy(&trailer.callId, buffer, sizeof(uint64_t));
+  uint8_t type = static_cast<uint8_t>(buffer[sizeof(uint64_t)]);
+  if (type > static_cast<uint8_t>(MessageType::kErrorResponse)) {
+    return false;
+  }
+  trailer.type = static_cast<MessageType>(type);
+  metadata.resize(metadata.size() - kTrailerLength);
+  return true;
+}
+
+// Produce an allocation that receives a message that will be thrown away, for
+// messages that nobody is waiting for anymore. The payloads are drained by the
+// pipe without a buffer, whereas all tensors are received into the given one,
+// which is reused across messages and only replaced (hence the old one must be
+// kept alive by whoever still uses it) if it's smaller than the largest of
+// them. Return false if the message requires some tensors to be received on
+// another device.
+inline bool allocateForDiscarding(
+    const Descriptor& descriptor,
+    Allocation& allocation,
+    std::shared_ptr<uint8_t>& buffer,
+    size_t& bufferLength) {
+  size_t maxLength = 0;
+  for (const auto& tensor : descriptor.tensors) {
+    if (tensor.targetDevice.has_value() &&
+        tensor.targetDevice.value().type != kCpuDeviceType) {
+      return false;
+    }
+    maxLength = std::max(maxLength, tensor.length);
+  }
+  if (maxLength > bufferLength) {
+    buffer = std::shared_ptr<uint8_t>(
+        new uint8_t[maxLength], std::default_delete<uint8_t[]>());
+    bufferLength = maxLength;
+  }
+
+  allocation.payloads.resize(descriptor.payloads.size());
+  for (auto& payload : allocation.payloads) {
+    payload.data = nullptr;
+  }
+  allocation.tensors.resize(descriptor.tensors.size());
+  for (auto& tensor : allocation.tensors) {
+    tensor.buffer = CpuBuffer{.ptr = buffer.get()};
+  }
+  return true;
+}
+
+} // namespace rpc
+} // namespace tensorpipe
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <tensorpipe/rpc/server.h>
+
+#include <utility>
+
+#include <tensorpipe/core/pipe.h>
+#include <tensorpipe/rpc/framing.h>
+#include <tensorpipe/rpc/server_impl.h>
+
+namespace tensorpipe {
+namespace rpc {
+
+Responder::Responder(
+    std::shared_ptr<Pipe> pipe,
+    uint64_t callId,
+    optional<std::chrono::system_clock::time_point> deadline)
+    : pipe_(std::move(pipe)), callId_(callId), deadline_(std::move(deadline)) {}
+
+void Responder::respond(Message response, respond_callback_fn fn) {
+  if (!response.deadline.has_value()) {
+    response.deadline = deadline_;
+  }
+  appendTrailer(response.metadata, Trailer{callId_, MessageType::kResponse});
+  pipe_->write(std::move(response), std::move(fn));
+}
+
+void Responder::respondWithError(std::string reason) {
+  Message response;
+  response.metadata = std::move(reason);
+  response.deadline = deadline_;
+  appendTrailer(
+      response.metadata, Trailer{callId_, MessageType::kErrorResponse});
+  pipe_->write(std::move(response), [](const Error& /* unused */) {});
+}
+
+Server::Server(allocate_fn allocateRequest, handler_fn handler, size_t numThreads)
+    : impl_(std::make_shared<ServerImpl>(
+          std::move(allocateRequest),
+          std::move(handler),
+          numThreads)) {
+  impl_->init();
+}
+
+void Server::serve(std::shared_ptr<Pipe> pipe) {
+  impl_->serve(std::move(pipe));
+}
+
+void Server::close() {
+  impl_->close();
+}
+
+Server::~Server() {
+  close();
+}
+
+} // namespace rpc
+} // namespace tensorpipe
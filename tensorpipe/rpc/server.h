@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include <tensorpipe/common/error.h>
+#include <tensorpipe/common/optional.h>
+#include <tensorpipe/core/message.h>
+
+namespace tensorpipe {
+
+class Pipe;
+
+namespace rpc {
+
+class ServerImpl;
+
+// The handle through which a handler sends back the outcome of a call. It can
+// be moved to another thread and used after the handler returned.
+class Responder final {
+ public:
+  Responder(
+      std::shared_ptr<Pipe> pipe,
+      uint64_t callId,
+      optional<std::chrono::system_clock::time_point> deadline);
+
+  // Invoked once the payloads and tensors of the response have been sent, or
+  // have failed to be, and can thus be released.
+  using respond_callback_fn = std::function<void(const Error&)>;
+
+  // Send the response to the client. If the call had a deadline, the response
+  // will be dropped when it's past it.
+  void respond(Message response, respond_callback_fn fn);
+
+  // Make the call fail on the client with a RemoteError with the given reason.
+  void respondWithError(std::string reason);
+
+ private:
+  std::shared_ptr<Pipe> pipe_;
+  uint64_t callId_;
+  optional<std::chrono::system_clock::time_point> deadline_;
+};
+
+// The server side of a request/response protocol running on top of pipes,
+// whose other ends are used by rpc::Client instances.
+//
+// For each incoming request, the server obtains memory from the user in which
+// to receive its payloads and tensors, and once they are received it invokes
+// the handler on a pool of threads. The handler must eventually respond using
+// the responder it's given, although it doesn't need to do so before it
+// returns. Requests from the same pipe may be handled concurrently and in any
+// order. If a request couldn't be received (because its pipe failed) the
+// handler is invoked with an error, so that it can release the allocation, and
+// the responder must not be used.
+class Server final {
+ public:
+  // Invoked, on the pipe's event loop, when the descriptor of a request
+  // arrives, to obtain the memory into which to receive its payloads and
+  // tensors. It must match the descriptor as described for Pipe::read.
+  using allocate_fn = std::function<Allocation(const Descriptor&)>;
+
+  using handler_fn = std::function<void(
+      const Error& error,
+      Descriptor request,
+      Allocation allocation,
+      Responder responder)>;
+
+  // With zero threads the handler is run inline on the pipe's event loop,
+  // which saves a thread hop but requires it to be fast and non-blocking.
+  Server(allocate_fn allocateRequest, handler_fn handler, size_t numThreads);
+
+  // Start receiving requests from the given pipe. The pipe must be used
+  // exclusively by the server.
+  void serve(std::shared_ptr<Pipe> pipe);
+
+  // Close all the pipes being served and stop the threads. Requests that are
+  // being handled can still be responded to, but the responses will fail.
+  void close();
+
+  ~Server();
+
+ private:
+  const std::shared_ptr<ServerImpl> impl_;
+};
+
+} // namespace rpc
+} // namespace tensorpipe
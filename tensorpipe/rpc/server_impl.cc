@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <tensorpipe/rpc/server_impl.h>
+
+#include <limits>
+#include <utility>
+
+#include <tensorpipe/common/defs.h>
+#include <tensorpipe/common/error_macros.h>
+#include <tensorpipe/common/system.h>
+#include <tensorpipe/core/error.h>
+#include <tensorpipe/rpc/error.h>
+#include <tensorpipe/rpc/framing.h>
+
+namespace tensorpipe {
+namespace rpc {
+
+ServerImpl::ServerImpl(
+    allocate_fn allocateRequest,
+    handler_fn handler,
+    size_t numThreads)
+    : allocateRequest_(std::move(allocateRequest)),
+      handler_(std::move(handler)),
+      numThreads_(numThreads),
+      // Pushing happens on the pipes' event loops, which mustn't block.
+      tasks_(std::numeric_limits<int>::max()) {}
+
+void ServerImpl::init() {
+  for (size_t threadIdx = 0; threadIdx < numThreads_; threadIdx++) {
+    // The threads keep the server alive until it's closed, so that none of
+    // them is the one destroying it (which would require it to join itself).
+    threads_.emplace_back([impl{this->shared_from_this()}, threadIdx]() {
+      setThreadName("TP_RPC_worker_" + std::to_string(threadIdx));
+      while (true) {
+        std::function<void()> task = impl->tasks_.pop();
+        if (!task) {
+          return;
+        }
+        task();
+      }
+    });
+  }
+}
+
+void ServerImpl::serve(std::shared_ptr<Pipe> pipe) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (closed_) {
+      lock.unlock();
+      pipe->close();
+      return;
+    }
+    pipes_.insert(pipe);
+  }
+  readNextRequest(std::move(pipe));
+}
+
+void ServerImpl::close() {
+  std::unordered_set<std::shared_ptr<Pipe>> pipes;
+  std::vector<std::thread> threads;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (closed_) {
+      return;
+    }
+    closed_ = true;
+    pipes = std::move(pipes_);
+    threads = std::move(threads_);
+    for (size_t threadIdx = 0; threadIdx < threads.size(); threadIdx++) {
+      tasks_.push(nullptr);
+    }
+  }
+
+  for (const auto& pipe : pipes) {
+    pipe->close();
+  }
+
+  // The close may come from a handler running on one of the threads.
+  for (auto& thread : threads) {
+    if (thread.get_id() == std::this_thread::get_id()) {
+      thread.detach();
+    } else {
+      thread.join();
+    }
+  }
+}
+
+void ServerImpl::readNextRequest(std::shared_ptr<Pipe> pipe) {
+  Pipe& pipeRef = *pipe;
+  pipeRef.readDescriptor(
+      [impl{this->shared_from_this()}, pipe{std::move(pipe)}](
+          const Error& error, Descriptor descriptor) mutable {
+        impl->onRequestDescriptor(
+            std::move(pipe), error, std::move(descriptor));
+      });
+}
+
+void ServerImpl::onRequestDescriptor(
+    std::shared_ptr<Pipe> pipe,
+    const Error& error,
+    Descriptor descriptor) {
+  if (error) {
+    // The pipe discards the requests that arrive past their deadline, but it
+    // remains usable.
+    if (error.isOfType<MessageExpiredError>()) {
+      readNextRequest(std::move(pipe));
+      return;
+    }
+    TP_VLOG(6) << "RPC server is done with a pipe: " << error.what();
+    removePipe(pipe);
+    return;
+  }
+
+  Trailer trailer;
+  if (!stripTrailer(descriptor.metadata, trailer) ||
+      trailer.type != MessageType::kRequest) {
+    TP_LOG_WARNING() << "RPC server received a malformed request";
+    pipe->close();
+    removePipe(pipe);
+    return;
+  }
+
+  TP_VLOG(6) << "RPC server is receiving the request of call #"
+             << trailer.callId;
+
+  Allocation allocation = allocateRequest_(descriptor);
+  pipe->read(
+      allocation,
+      [impl{this->shared_from_this()},
+       pipe,
+       callId{trailer.callId},
+       descriptor{std::move(descriptor)},
+       allocation](const Error& error) mutable {
+        impl->onRequest(
+            std::move(pipe),
+            callId,
+            error,
+            std::move(descriptor),
+            std::move(allocation));
+      });
+  readNextRequest(std::move(pipe));
+}
+
+void ServerImpl::onRequest(
+    std::shared_ptr<Pipe> pipe,
+    uint64_t callId,
+    const Error& error,
+    Descriptor descriptor,
+    Allocation allocation) {
+  Responder responder(std::move(pipe), callId, descriptor.deadline);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (numThreads_ > 0 && !closed_) {
+    tasks_.push([impl{this->shared_from_this()},
+                 error,
+                 descriptor{std::move(descriptor)},
+                 allocation{std::move(allocation)},
+                 responder{std::move(responder)}]() mutable {
+      impl->handler_(
+          error,
+          std::move(descriptor),
+          std::move(allocation),
+          std::move(responder));
+    });
+    return;
+  }
+  lock.unlock();
+
+  handler_(
+      error,
+      std::move(descriptor),
+      std::move(allocation),
+      std::move(responder));
+}
+
+void ServerImpl::removePipe(const std::shared_ptr<Pipe>& pipe) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  pipes_.erase(pipe);
+}
+
+} // namespace rpc
+} // namespace tensorpipe
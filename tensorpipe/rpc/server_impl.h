@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <tensorpipe/common/error.h>
+#include <tensorpipe/common/queue.h>
+#include <tensorpipe/core/message.h>
+#include <tensorpipe/core/pipe.h>
+#include <tensorpipe/rpc/server.h>
+
+namespace tensorpipe {
+namespace rpc {
+
+class ServerImpl final : public std::enable_shared_from_this<ServerImpl> {
+ public:
+  using allocate_fn = Server::allocate_fn;
+  using handler_fn = Server::handler_fn;
+
+  ServerImpl(allocate_fn allocateRequest, handler_fn handler, size_t numThreads);
+
+  // Called by the server's constructor.
+  void init();
+
+  void serve(std::shared_ptr<Pipe> pipe);
+
+  void close();
+
+ private:
+  const allocate_fn allocateRequest_;
+  const handler_fn handler_;
+  const size_t numThreads_;
+
+  std::mutex mutex_;
+  bool closed_{false};
+  std::unordered_set<std::shared_ptr<Pipe>> pipes_;
+
+  // The requests that are ready to be handled, which the threads take from.
+  // An empty function tells a thread to terminate.
+  Queue<std::function<void()>> tasks_;
+  std::vector<std::thread> threads_;
+
+  void readNextRequest(std::shared_ptr<Pipe> pipe);
+  void onRequestDescriptor(
+      std::shared_ptr<Pipe> pipe,
+      const Error& error,
+      Descriptor descriptor);
+  void onRequest(
+      std::shared_ptr<Pipe> pipe,
+      uint64_t callId,
+      const Error& error,
+      Descriptor descriptor,
+      Allocation allocation);
+  void removePipe(const std::shared_ptr<Pipe>& pipe);
+};
+
+} // namespace rpc
+} // namespace tensorpipe
@@ -17,10 +17,18 @@
 #include <tensorpipe/core/listener.h>
 #include <tensorpipe/core/message.h>
 #include <tensorpipe/core/pipe.h>
+#include <tensorpipe/core/stream.h>
 
 #include <tensorpipe/common/buffer.h>
 
 #include <tensorpipe/common/cpu_buffer.h>
+#include <tensorpipe/common/loop_pool.h>
+
+// RPC
+
+#include <tensorpipe/rpc/client.h>
+#include <tensorpipe/rpc/error.h>
+#include <tensorpipe/rpc/server.h>
 
 // Transports
 
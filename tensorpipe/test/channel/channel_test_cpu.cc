@@ -107,3 +107,78 @@ class CallbacksAreDeferredTest : public ClientServerChannelTestCase {
 };
 
 CHANNEL_TEST(CpuChannelTestSuite, CallbacksAreDeferred);
+
+// Queue several sends at once, so that all but the first are written behind
+// the descriptor of the first one (which, for channels that batch them, puts
+// them in the same frame), with an empty one among them. The receiver only
+// posts the recvs of the later ones once the sends of the earlier ones have
+// completed, hence these must not wait for the recvs that come after them.
+class SendsQueuedBehindDescriptorTest : public ClientServerChannelTestCase {
+  static constexpr size_t kNumTensors = 8;
+  static constexpr size_t kNumEarlyTensors = 4;
+  static constexpr size_t kEmptyTensorIdx = 2;
+  static constexpr size_t kDataSize = 256;
+
+ public:
+  void server(std::shared_ptr<Channel> channel) override {
+    std::vector<std::vector<uint8_t>> datas(kNumTensors);
+    std::vector<std::future<Error>> sendFutures;
+    for (size_t tensorIdx = 0; tensorIdx < kNumTensors; tensorIdx++) {
+      const size_t length = tensorIdx == kEmptyTensorIdx ? 0 : kDataSize;
+      datas[tensorIdx].resize(length);
+      std::fill(datas[tensorIdx].begin(), datas[tensorIdx].end(), tensorIdx);
+      sendFutures.push_back(sendWithFuture(
+          channel,
+          CpuBuffer{.ptr = length > 0 ? datas[tensorIdx].data() : nullptr},
+          length));
+    }
+
+    for (size_t tensorIdx = 0; tensorIdx < kNumTensors; tensorIdx++) {
+      if (tensorIdx == kNumEarlyTensors) {
+        this->peers_->send(PeerGroup::kClient, "early sends completed");
+      }
+      Error sendError = sendFutures[tensorIdx].get();
+      EXPECT_FALSE(sendError) << sendError.what();
+    }
+
+    this->peers_->done(PeerGroup::kServer);
+    this->peers_->join(PeerGroup::kServer);
+  }
+
+  void client(std::shared_ptr<Channel> channel) override {
+    std::vector<std::vector<uint8_t>> datas(kNumTensors);
+    std::vector<std::future<Error>> recvFutures;
+    for (size_t tensorIdx = 0; tensorIdx < kNumTensors; tensorIdx++) {
+      if (tensorIdx == kNumEarlyTensors) {
+        for (auto& recvFuture : recvFutures) {
+          Error recvError = recvFuture.get();
+          EXPECT_FALSE(recvError) << recvError.what();
+        }
+        EXPECT_EQ(
+            this->peers_->recv(PeerGroup::kClient), "early sends completed");
+      }
+      const size_t length = tensorIdx == kEmptyTensorIdx ? 0 : kDataSize;
+      datas[tensorIdx].resize(length);
+      recvFutures.push_back(recvWithFuture(
+          channel,
+          CpuBuffer{.ptr = length > 0 ? datas[tensorIdx].data() : nullptr},
+          length));
+    }
+    for (size_t tensorIdx = kNumEarlyTensors; tensorIdx < kNumTensors;
+         tensorIdx++) {
+      Error recvError = recvFutures[tensorIdx].get();
+      EXPECT_FALSE(recvError) << recvError.what();
+    }
+
+    for (size_t tensorIdx = 0; tensorIdx < kNumTensors; tensorIdx++) {
+      for (uint8_t value : datas[tensorIdx]) {
+        EXPECT_EQ(value, tensorIdx);
+      }
+    }
+
+    this->peers_->done(PeerGroup::kClient);
+    this->peers_->join(PeerGroup::kClient);
+  }
+};
+
+CHANNEL_TEST(CpuChannelTestSuite, SendsQueuedBehindDescriptor);
@@ -6,6 +6,10 @@
  * LICENSE file in the root directory of this source tree.
  */
 
+#include <map>
+#include <mutex>
+#include <numeric>
+
 #include <tensorpipe/channel/context.h>
 #include <tensorpipe/channel/mpt/factory.h>
 #include <tensorpipe/common/cpu_buffer.h>
@@ -33,10 +37,52 @@ class MptChannelTestHelper : public CpuChannelTestHelper {
   }
 };
 
+class MptElasticChannelTestHelper : public CpuChannelTestHelper {
+ public:
+  // Retrieve the context that was created with the given identifier, for the
+  // tests to inspect its stats.
+  std::shared_ptr<tensorpipe::channel::Context> getContext(
+      const std::string& id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return contexts_[id].lock();
+  }
+
+ protected:
+  std::shared_ptr<tensorpipe::channel::Context> makeContextInternal(
+      std::string id) override {
+    std::vector<std::shared_ptr<tensorpipe::transport::Context>> contexts = {
+        tensorpipe::transport::uv::create(),
+        tensorpipe::transport::uv::create(),
+        tensorpipe::transport::uv::create()};
+    std::vector<std::shared_ptr<tensorpipe::transport::Listener>> listeners = {
+        contexts[0]->listen("127.0.0.1"),
+        contexts[1]->listen("127.0.0.1"),
+        contexts[2]->listen("127.0.0.1")};
+    tensorpipe::channel::mpt::ElasticLanesOptions options;
+    // Small enough for the tests to need all lanes.
+    options.bytesPerLane = 1024;
+    options.idleTimeout = std::chrono::milliseconds(0);
+    auto context = tensorpipe::channel::mpt::createElastic(
+        std::move(contexts), std::move(listeners), options);
+    context->setId(id);
+    std::unique_lock<std::mutex> lock(mutex_);
+    contexts_[id] = context;
+    return context;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::map<std::string, std::weak_ptr<tensorpipe::channel::Context>>
+      contexts_;
+};
+
 MptChannelTestHelper helper;
+MptElasticChannelTestHelper elasticHelper;
 
 class MptChannelTestSuite : public ChannelTestSuite {};
 
+class MptElasticChannelTestSuite : public ChannelTestSuite {};
+
 } // namespace
 
 class ContextIsNotJoinedTest : public ChannelTestCase {
@@ -108,8 +154,71 @@ const std::string ContextIsNotJoinedTest::kReady = "ready";
 
 CHANNEL_TEST(MptChannelTestSuite, ContextIsNotJoined);
 
+class ElasticLanesGrowTest : public ClientServerChannelTestCase {
+  static constexpr size_t kDataSize = 64 * 1024;
+
+ public:
+  void server(std::shared_ptr<tensorpipe::channel::Channel> channel) override {
+    std::vector<uint8_t> data(kDataSize);
+    std::iota(data.begin(), data.end(), 0);
+    std::unique_ptr<DataWrapper> wrappedData = helper_->makeDataWrapper(data);
+
+    tensorpipe::Error sendError = sendWithFuture(channel, *wrappedData).get();
+    EXPECT_FALSE(sendError) << sendError.what();
+
+    // The transfer could only complete once the server accepted all lanes.
+    tensorpipe::channel::mpt::LaneStats stats =
+        tensorpipe::channel::mpt::getLaneStats(
+            elasticHelper.getContext("server"));
+    EXPECT_EQ(stats.numLanesOpened, 3);
+    EXPECT_GE(stats.numLaneChanges, 1);
+
+    this->peers_->done(PeerGroup::kServer);
+    this->peers_->join(PeerGroup::kServer);
+  }
+
+  void client(std::shared_ptr<tensorpipe::channel::Channel> channel) override {
+    std::unique_ptr<DataWrapper> wrappedData =
+        helper_->makeDataWrapper(kDataSize);
+
+    tensorpipe::Error recvError = recvWithFuture(channel, *wrappedData).get();
+    EXPECT_FALSE(recvError) << recvError.what();
+
+    std::vector<uint8_t> unwrappedData = wrappedData->unwrap();
+    for (size_t i = 0; i < kDataSize; i++) {
+      EXPECT_EQ(unwrappedData[i], static_cast<uint8_t>(i));
+    }
+
+    tensorpipe::channel::mpt::LaneStats stats =
+        tensorpipe::channel::mpt::getLaneStats(
+            elasticHelper.getContext("client"));
+    EXPECT_EQ(stats.numLanesOpened, 3);
+    EXPECT_GE(stats.numLaneChanges, 1);
+
+    this->peers_->done(PeerGroup::kClient);
+    this->peers_->join(PeerGroup::kClient);
+  }
+};
+
+CHANNEL_TEST(MptElasticChannelTestSuite, ElasticLanesGrow);
+
 INSTANTIATE_TEST_CASE_P(Mpt, ChannelTestSuite, ::testing::Values(&helper));
 
 INSTANTIATE_TEST_CASE_P(Mpt, CpuChannelTestSuite, ::testing::Values(&helper));
 
 INSTANTIATE_TEST_CASE_P(Mpt, MptChannelTestSuite, ::testing::Values(&helper));
+
+INSTANTIATE_TEST_CASE_P(
+    MptElastic,
+    ChannelTestSuite,
+    ::testing::Values(&elasticHelper));
+
+INSTANTIATE_TEST_CASE_P(
+    MptElastic,
+    CpuChannelTestSuite,
+    ::testing::Values(&elasticHelper));
+
+INSTANTIATE_TEST_CASE_P(
+    MptElastic,
+    MptElasticChannelTestSuite,
+    ::testing::Values(&elasticHelper));
@@ -7,6 +7,7 @@
  */
 
 #include <tensorpipe/channel/xth/factory.h>
+#include <tensorpipe/common/loop_pool.h>
 #include <tensorpipe/test/channel/channel_test_cpu.h>
 
 namespace {
@@ -21,10 +22,34 @@ class XthChannelTestHelper : public CpuChannelTestHelper {
   }
 };
 
+class XthPooledChannelTestHelper : public CpuChannelTestHelper {
+ protected:
+  std::shared_ptr<tensorpipe::channel::Context> makeContextInternal(
+      std::string id) override {
+    auto context = tensorpipe::channel::xth::create(loopPool_);
+    context->setId(std::move(id));
+    return context;
+  }
+
+ private:
+  tensorpipe::LoopPool loopPool_{1};
+};
+
 XthChannelTestHelper helper;
+XthPooledChannelTestHelper pooledHelper;
 
 } // namespace
 
 INSTANTIATE_TEST_CASE_P(Xth, ChannelTestSuite, ::testing::Values(&helper));
 
 INSTANTIATE_TEST_CASE_P(Xth, CpuChannelTestSuite, ::testing::Values(&helper));
+
+INSTANTIATE_TEST_CASE_P(
+    XthPooled,
+    ChannelTestSuite,
+    ::testing::Values(&pooledHelper));
+
+INSTANTIATE_TEST_CASE_P(
+    XthPooled,
+    CpuChannelTestSuite,
+    ::testing::Values(&pooledHelper));
@@ -171,6 +171,32 @@ TEST(ShmLoop, RegisterUnregister) {
   loop.join();
 }
 
+TEST(ShmLoop, PollFromLoop) {
+  OnDemandDeferredExecutor deferredExecutor;
+  EpollLoop loop{deferredExecutor, /*runOwnThread=*/false};
+  auto handler = std::make_shared<Handler>();
+  auto efd = Fd(eventfd(0, EFD_NONBLOCK));
+
+  deferredExecutor.runInLoop([&]() {
+    loop.registerDescriptor(efd.fd(), EPOLLIN | EPOLLONESHOT, handler);
+
+    // Nothing happens until the fd becomes readable and the loop is polled.
+    EXPECT_FALSE(loop.pollFromLoop());
+    efd.writeOrThrow<uint64_t>(1337);
+    EXPECT_TRUE(loop.pollFromLoop());
+  });
+  ASSERT_EQ(handler->nextEvents(), EPOLLIN);
+  ASSERT_EQ(efd.readOrThrow<uint64_t>(), 1337);
+
+  deferredExecutor.runInLoop([&]() {
+    EXPECT_TRUE(loop.hasRegisteredHandlers());
+    loop.unregisterDescriptor(efd.fd());
+    EXPECT_FALSE(loop.hasRegisteredHandlers());
+  });
+
+  loop.join();
+}
+
 TEST(ShmLoop, Monitor) {
   OnDemandDeferredExecutor deferredExecutor;
   EpollLoop loop{deferredExecutor};
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include <tensorpipe/common/lock_stats.h>
+#include <tensorpipe/common/mutex.h>
+#include <tensorpipe/common/queue.h>
+
+#include <gtest/gtest.h>
+
+using namespace tensorpipe;
+
+namespace {
+
+const LockStats::Snapshot& findSnapshot(
+    const std::vector<LockStats::Snapshot>& snapshots,
+    const std::string& name) {
+  for (const LockStats::Snapshot& snapshot : snapshots) {
+    if (snapshot.name == name) {
+      return snapshot;
+    }
+  }
+  ADD_FAILURE() << "No stats for " << name;
+  static LockStats::Snapshot kEmptySnapshot;
+  return kEmptySnapshot;
+}
+
+} // namespace
+
+TEST(LockStats, Uncontended) {
+  InstrumentedMutex mutex("test_uncontended");
+  LockStats::forName("test_uncontended").reset();
+  for (int i = 0; i < 10; i++) {
+    std::unique_lock<InstrumentedMutex> lock(mutex);
+  }
+  EXPECT_TRUE(mutex.try_lock());
+  mutex.unlock();
+
+  LockStats::Snapshot snapshot =
+      LockStats::forName("test_uncontended").getSnapshot();
+  EXPECT_EQ(snapshot.name, "test_uncontended");
+  EXPECT_EQ(snapshot.numAcquisitions, 11);
+  EXPECT_EQ(snapshot.numContendedAcquisitions, 0);
+  EXPECT_EQ(snapshot.waitTime.count, 0);
+  EXPECT_EQ(snapshot.holdTime.count, 11);
+}
+
+TEST(LockStats, Contended) {
+  constexpr auto kHoldTime = std::chrono::milliseconds(20);
+  InstrumentedMutex mutex("test_contended");
+  LockStats::forName("test_contended").reset();
+
+  std::unique_lock<InstrumentedMutex> lock(mutex);
+  std::promise<void> startedProm;
+  std::thread thread([&]() {
+    startedProm.set_value();
+    EXPECT_FALSE(mutex.try_lock());
+    std::unique_lock<InstrumentedMutex> otherLock(mutex);
+  });
+  startedProm.get_future().get();
+  std::this_thread::sleep_for(kHoldTime);
+  lock.unlock();
+  thread.join();
+
+  // Mutexes with the same name share their stats.
+  InstrumentedMutex otherMutex("test_contended");
+  { std::unique_lock<InstrumentedMutex> otherLock(otherMutex); }
+
+  LockStats::Snapshot snapshot = findSnapshot(
+      LockStats::getAllSnapshots(), "test_contended");
+  EXPECT_EQ(snapshot.numAcquisitions, 3);
+  EXPECT_EQ(snapshot.numContendedAcquisitions, 1);
+  EXPECT_EQ(snapshot.waitTime.count, 1);
+  EXPECT_EQ(snapshot.holdTime.count, 3);
+  EXPECT_GE(snapshot.holdTime.maxTime, kHoldTime);
+  // The wait may have started a bit after the lock was taken.
+  EXPECT_GE(snapshot.waitTime.maxTime, kHoldTime / 2);
+
+  // Each duration lands in the power-of-two bucket containing it.
+  uint64_t numBucketed = 0;
+  for (size_t bucket = 0; bucket < LockStats::kNumBuckets; bucket++) {
+    numBucketed += snapshot.holdTime.buckets[bucket];
+  }
+  EXPECT_EQ(numBucketed, 3);
+  EXPECT_EQ(snapshot.waitTime.buckets[0], 0);
+
+  EXPECT_NE(
+      LockStats::format(snapshot).find("contended=1"), std::string::npos);
+}
+
+TEST(LockStats, ConditionVariable) {
+  // Whether or not the stats are enabled, a queue must work across threads.
+  Queue<int> queue;
+  std::thread thread([&]() {
+    for (int i = 0; i < 100; i++) {
+      queue.push(i);
+    }
+  });
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(queue.pop(), i);
+  }
+  thread.join();
+
+#if TENSORPIPE_HAS_LOCK_STATS
+  LockStats::Snapshot snapshot =
+      findSnapshot(LockStats::getAllSnapshots(), "queue");
+  EXPECT_GE(snapshot.numAcquisitions, 200);
+#endif // TENSORPIPE_HAS_LOCK_STATS
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <tensorpipe/common/loop_pool.h>
+
+#include <dirent.h>
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <tensorpipe/common/error.h>
+#include <tensorpipe/transport/connection.h>
+#include <tensorpipe/transport/listener.h>
+#include <tensorpipe/transport/uv/factory.h>
+
+using namespace tensorpipe;
+
+namespace {
+
+size_t countThreads() {
+  DIR* dir = ::opendir("/proc/self/task");
+  EXPECT_NE(dir, nullptr);
+  size_t numThreads = 0;
+  while (struct dirent* entry = ::readdir(dir)) {
+    if (entry->d_name[0] != '.') {
+      numThreads++;
+    }
+  }
+  ::closedir(dir);
+  return numThreads;
+}
+
+// Have each context connect to itself and exchange some messages over that
+// connection, all contexts at the same time, and then join them (before the
+// state used by the callbacks goes away).
+void pingPong(std::vector<std::shared_ptr<transport::Context>>& contexts) {
+  constexpr int kNumRoundTrips = 100;
+  std::vector<std::shared_ptr<transport::Listener>> listeners;
+  std::vector<std::shared_ptr<transport::Connection>> clients;
+  std::vector<std::promise<std::shared_ptr<transport::Connection>>> serverProms(
+      contexts.size());
+  for (size_t idx = 0; idx < contexts.size(); idx++) {
+    listeners.push_back(contexts[idx]->listen("127.0.0.1"));
+    listeners[idx]->accept(
+        [&serverProms, idx](
+            const Error& error, std::shared_ptr<transport::Connection> conn) {
+          ASSERT_FALSE(error) << error.what();
+          serverProms[idx].set_value(std::move(conn));
+        });
+    clients.push_back(contexts[idx]->connect(listeners[idx]->addr()));
+  }
+
+  std::vector<std::promise<void>> doneProms(contexts.size());
+  std::vector<std::shared_ptr<transport::Connection>> servers;
+  std::vector<std::shared_ptr<std::function<void(int)>>> loops;
+  uint64_t value = 42;
+  for (size_t idx = 0; idx < contexts.size(); idx++) {
+    servers.push_back(serverProms[idx].get_future().get());
+    auto loop = std::make_shared<std::function<void(int)>>();
+    *loop = [&, idx, loop{loop.get()}](int numLeft) {
+      if (numLeft == 0) {
+        doneProms[idx].set_value();
+        return;
+      }
+      clients[idx]->write(&value, sizeof(value), [](const Error& error) {
+        ASSERT_FALSE(error) << error.what();
+      });
+      servers[idx]->read([&, idx, loop, numLeft](
+                             const Error& error, const void* ptr, size_t len) {
+        ASSERT_FALSE(error) << error.what();
+        ASSERT_EQ(len, sizeof(value));
+        servers[idx]->write(ptr, len, [](const Error& error) {
+          ASSERT_FALSE(error) << error.what();
+        });
+        clients[idx]->read(
+            [loop, numLeft](const Error& error, const void*, size_t) {
+              ASSERT_FALSE(error) << error.what();
+              (*loop)(numLeft - 1);
+            });
+      });
+    };
+    loops.push_back(loop);
+  }
+  for (size_t idx = 0; idx < contexts.size(); idx++) {
+    (*loops[idx])(kNumRoundTrips);
+  }
+  for (size_t idx = 0; idx < contexts.size(); idx++) {
+    doneProms[idx].get_future().get();
+  }
+  for (auto& context : contexts) {
+    context->join();
+  }
+}
+
+} // namespace
+
+TEST(LoopPool, RoundRobin) {
+  struct FakeLoop {
+    int idx;
+    bool joined{false};
+
+    void join() {
+      joined = true;
+    }
+  };
+
+  std::shared_ptr<FakeLoop> first;
+  std::shared_ptr<FakeLoop> second;
+  {
+    LoopPool pool(2);
+    int numCreated = 0;
+    std::function<std::shared_ptr<FakeLoop>()> createLoop = [&]() {
+      return std::make_shared<FakeLoop>(FakeLoop{numCreated++});
+    };
+
+    first = pool.getLoop("foo", createLoop);
+    second = pool.getLoop("foo", createLoop);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(pool.getLoop("foo", createLoop), first);
+    EXPECT_EQ(pool.getLoop("foo", createLoop), second);
+    EXPECT_EQ(numCreated, 2);
+
+    // Each kind has loops of its own.
+    EXPECT_EQ(pool.getLoop("bar", createLoop)->idx, 2);
+    EXPECT_EQ(numCreated, 3);
+    EXPECT_FALSE(first->joined);
+  }
+
+  // The pool joins its loops when it goes away.
+  EXPECT_TRUE(first->joined);
+  EXPECT_TRUE(second->joined);
+}
+
+TEST(LoopPool, ThreadsDontGrowWithContexts) {
+  for (size_t numContexts : {1, 2, 4, 8, 16}) {
+    LoopPool pool(2);
+    const size_t numThreadsBefore = countThreads();
+
+    std::vector<std::shared_ptr<transport::Context>> contexts;
+    for (size_t idx = 0; idx < numContexts; idx++) {
+      contexts.push_back(transport::uv::create(pool));
+      contexts.back()->setId("ctx" + std::to_string(idx));
+    }
+    pingPong(contexts);
+
+    EXPECT_LE(countThreads() - numThreadsBefore, pool.numLoops())
+        << "with " << numContexts << " contexts";
+  }
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <thread>
+
+#include <tensorpipe/common/deferred_executor.h>
+#include <tensorpipe/common/loop_stats.h>
+
+#include <gtest/gtest.h>
+
+using namespace tensorpipe;
+
+TEST(LoopStats, Disabled) {
+  LoopStats stats;
+  // Stats may have been enabled through the environment.
+  stats.disable();
+  ASSERT_FALSE(stats.isEnabled());
+
+  {
+    LoopStats::Activation activation(stats);
+    EXPECT_EQ(LoopStats::current(), nullptr);
+    std::string label = "foo";
+    LoopStats::HandlerScope scope(label, "test");
+    EXPECT_EQ(LoopStats::currentLabel(), "");
+  }
+
+  LoopStats::Snapshot snapshot = stats.getSnapshot();
+  EXPECT_TRUE(snapshot.handlersByLabel.empty());
+  EXPECT_TRUE(snapshot.handlersByType.empty());
+  EXPECT_TRUE(snapshot.lagByType.empty());
+}
+
+TEST(LoopStats, NestedScopesAreAccountedSeparately) {
+  LoopStats stats;
+  stats.enable();
+
+  std::string outerLabel = "outer";
+  std::string innerLabel = "inner";
+  {
+    LoopStats::Activation activation(stats);
+    ASSERT_EQ(LoopStats::current(), &stats);
+    LoopStats::HandlerScope outerScope(outerLabel, "type_a");
+    EXPECT_EQ(LoopStats::currentLabel(), "outer");
+    {
+      LoopStats::HandlerScope innerScope(innerLabel, "type_b");
+      EXPECT_EQ(LoopStats::currentLabel(), "inner");
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    EXPECT_EQ(LoopStats::currentLabel(), "outer");
+  }
+  EXPECT_EQ(LoopStats::current(), nullptr);
+
+  LoopStats::Snapshot snapshot = stats.getSnapshot();
+  ASSERT_EQ(snapshot.handlersByLabel.size(), 2);
+  EXPECT_EQ(snapshot.handlersByLabel["outer"].count, 1);
+  EXPECT_EQ(snapshot.handlersByLabel["inner"].count, 1);
+  EXPECT_GE(
+      snapshot.handlersByLabel["inner"].totalTime,
+      std::chrono::milliseconds(20));
+  // The time of the inner scope isn't counted again in the outer one.
+  EXPECT_LT(
+      snapshot.handlersByLabel["outer"].totalTime,
+      std::chrono::milliseconds(20));
+  EXPECT_EQ(snapshot.handlersByType["type_a"].count, 1);
+  EXPECT_EQ(snapshot.handlersByType["type_b"].count, 1);
+
+  stats.reset();
+  EXPECT_TRUE(stats.getSnapshot().handlersByLabel.empty());
+}
+
+TEST(LoopStats, DeferredFunctionsInheritLabel) {
+  OnDemandDeferredExecutor loop;
+  LoopStats& stats = loop.getLoopStats();
+  stats.enable();
+
+  std::string label = "p0";
+  int numRun = 0;
+  loop.deferToLoop([&]() {
+    LoopStats::HandlerScope scope(label, "callback");
+    loop.deferToLoop([&]() { numRun++; });
+    numRun++;
+  });
+  EXPECT_EQ(numRun, 2);
+
+  LoopStats::Snapshot snapshot = stats.getSnapshot();
+  EXPECT_EQ(snapshot.lagByType["deferToLoop"].count, 2);
+  EXPECT_EQ(snapshot.handlersByType["deferred"].count, 2);
+  EXPECT_EQ(snapshot.handlersByType["callback"].count, 1);
+  // The first function was deferred from outside of any handler.
+  EXPECT_EQ(snapshot.handlersByLabel[""].count, 1);
+  // The second one was deferred from within the callback and inherits its
+  // label, on top of the callback itself.
+  EXPECT_EQ(snapshot.handlersByLabel["p0"].count, 2);
+}
+
+TEST(LoopStats, GetAllSnapshots) {
+  LoopStats stats("my_loop");
+  stats.enable();
+  {
+    LoopStats::Activation activation(stats);
+    std::string label = "c0";
+    LoopStats::HandlerScope scope(label, "test");
+  }
+
+  bool found = false;
+  for (const auto& snapshot : LoopStats::getAllSnapshots()) {
+    if (snapshot.name == "my_loop") {
+      EXPECT_FALSE(found);
+      found = true;
+      EXPECT_EQ(snapshot.handlersByLabel.count("c0"), 1);
+      std::string report = LoopStats::formatTopN(snapshot, 5);
+      EXPECT_NE(report.find("my_loop"), std::string::npos);
+      EXPECT_NE(report.find("c0"), std::string::npos);
+    }
+  }
+  EXPECT_TRUE(found);
+}
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <tensorpipe/common/sparse_encoding.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace tensorpipe;
+
+namespace {
+
+// Fill a buffer with non-zero bytes, and then zero out each 4-byte word with
+// the given probability.
+std::vector<uint8_t> makeBuffer(size_t length, double sparsity, int seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int> byteDist(1, 255);
+  std::bernoulli_distribution zeroDist(sparsity);
+  std::vector<uint8_t> buffer(length);
+  for (uint8_t& byte : buffer) {
+    byte = byteDist(gen);
+  }
+  for (size_t offset = 0; offset + 4 <= length; offset += 4) {
+    if (zeroDist(gen)) {
+      std::memset(&buffer[offset], 0, 4);
+    }
+  }
+  return buffer;
+}
+
+} // namespace
+
+TEST(SparseEncoding, RoundTrip) {
+  for (size_t length : {0, 1, 3, 4, 7, 64, 255, 256, 257, 1000, 4099}) {
+    for (double sparsity : {0.0, 0.5, 0.9, 0.99, 1.0}) {
+      std::vector<uint8_t> src = makeBuffer(length, sparsity, length);
+      size_t numNonZeroWords = countNonZeroWords(src.data(), length);
+      std::vector<uint8_t> encoded(
+          sparseEncodedLength(length, numNonZeroWords));
+      encodeSparse(src.data(), length, encoded.data());
+
+      // Start from garbage, to check that the zeros are written too.
+      std::vector<uint8_t> dst(length, 0xff);
+      EXPECT_TRUE(
+          decodeSparse(encoded.data(), encoded.size(), dst.data(), length));
+      EXPECT_EQ(src, dst) << "length " << length << ", sparsity " << sparsity;
+    }
+  }
+}
+
+TEST(SparseEncoding, CountAndLength) {
+  std::vector<uint8_t> buffer(4 * 130 + 2, 0);
+  EXPECT_EQ(countNonZeroWords(buffer.data(), buffer.size()), 0);
+  // 130 words need three bitmap blocks, and the two trailing bytes are kept.
+  EXPECT_EQ(sparseEncodedLength(buffer.size(), 0), 3 * 8 + 2);
+
+  // A single non-zero byte makes its whole word non-zero.
+  buffer[4 * 65 + 3] = 1;
+  // The trailing bytes aren't part of any word.
+  buffer[4 * 130 + 1] = 1;
+  EXPECT_EQ(countNonZeroWords(buffer.data(), buffer.size()), 1);
+  EXPECT_EQ(sparseEncodedLength(buffer.size(), 1), 3 * 8 + 4 + 2);
+}
+
+TEST(SparseEncoding, Unaligned) {
+  std::vector<uint8_t> src = makeBuffer(1001, 0.7, 42);
+  std::vector<uint8_t> srcStorage(src.size() + 1);
+  std::memcpy(srcStorage.data() + 1, src.data(), src.size());
+  size_t numNonZeroWords = countNonZeroWords(srcStorage.data() + 1, src.size());
+  size_t encodedLength = sparseEncodedLength(src.size(), numNonZeroWords);
+  std::vector<uint8_t> encodedStorage(encodedLength + 3);
+  encodeSparse(srcStorage.data() + 1, src.size(), encodedStorage.data() + 3);
+
+  std::vector<uint8_t> dstStorage(src.size() + 2);
+  EXPECT_TRUE(decodeSparse(
+      encodedStorage.data() + 3,
+      encodedLength,
+      dstStorage.data() + 2,
+      src.size()));
+  EXPECT_EQ(
+      std::vector<uint8_t>(dstStorage.begin() + 2, dstStorage.end()), src);
+}
+
+TEST(SparseEncoding, BadLength) {
+  std::vector<uint8_t> src = makeBuffer(100, 0.5, 0);
+  size_t numNonZeroWords = countNonZeroWords(src.data(), src.size());
+  std::vector<uint8_t> encoded(
+      sparseEncodedLength(src.size(), numNonZeroWords));
+  encodeSparse(src.data(), src.size(), encoded.data());
+
+  // Nothing must be written when the encoding is rejected.
+  std::vector<uint8_t> dst(src.size() + 1, 0xff);
+  EXPECT_FALSE(
+      decodeSparse(encoded.data(), encoded.size() - 1, dst.data(), src.size()));
+  EXPECT_FALSE(
+      decodeSparse(encoded.data(), encoded.size(), dst.data(), dst.size()));
+  EXPECT_EQ(dst, std::vector<uint8_t>(dst.size(), 0xff));
+}
+
+TEST(SparseEncoding, BitsPastTheEnd) {
+  // 10 words fit in one bitmap block, which has room for 64.
+  std::vector<uint8_t> src(4 * 10, 0);
+  src[0] = 1;
+  std::vector<uint8_t> encoded(sparseEncodedLength(src.size(), 1));
+  encodeSparse(src.data(), src.size(), encoded.data());
+
+  // Move the bit of the first word to a word past the end, which keeps the
+  // length of the encoding consistent.
+  encoded[0] = 0;
+  encoded[7] = 0x80;
+  std::vector<uint8_t> dst(src.size(), 0xff);
+  EXPECT_FALSE(
+      decodeSparse(encoded.data(), encoded.size(), dst.data(), dst.size()));
+  EXPECT_EQ(dst, std::vector<uint8_t>(dst.size(), 0xff));
+}
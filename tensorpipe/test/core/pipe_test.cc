@@ -8,6 +8,12 @@
 
 #include <tensorpipe/test/core/pipe_test.h>
 
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
 using namespace tensorpipe;
 
 class SimpleWriteReadTest : public ClientServerPipeTestCase {
@@ -526,3 +532,763 @@ TEST(Pipe, WriteFromBothThenRead) {
   WriteFromBothThenReadTest test;
   test.run();
 }
+
+class ShedExpiredWriteTest : public ClientServerPipeTestCase {
+  InlineMessage imessage1_ = {
+      .payloads =
+          {
+              {.data = "payload #1.1", .metadata = "payload metadata #1.1"},
+          },
+      .tensors =
+          {
+              {
+                  .data = "tensor #1.1",
+                  .metadata = "tensor metadata #1.1",
+                  .device = Device{kCpuDeviceType, 0},
+              },
+          },
+      .metadata = "expired message metadata",
+  };
+
+  InlineMessage imessage2_ = {
+      .payloads =
+          {
+              {.data = "payload #2.1", .metadata = "payload metadata #2.1"},
+          },
+      .tensors =
+          {
+              {
+                  .data = "tensor #2.1",
+                  .metadata = "tensor metadata #2.1",
+                  .device = Device{kCpuDeviceType, 0},
+              },
+          },
+      .metadata = "message metadata",
+  };
+
+ public:
+  void server(Pipe& pipe) override {
+    Message message1;
+    Storage storage1;
+    std::tie(message1, storage1) = makeMessage(imessage1_);
+    message1.deadline =
+        std::chrono::system_clock::now() - std::chrono::seconds(1);
+    std::promise<Error> promise1;
+    pipe.write(std::move(message1), [&](const Error& error) {
+      promise1.set_value(error);
+    });
+
+    Message message2;
+    Storage storage2;
+    std::tie(message2, storage2) = makeMessage(imessage2_);
+    auto future2 = pipeWriteWithFuture(pipe, message2);
+
+    Error error = promise1.get_future().get();
+    EXPECT_TRUE(error.isOfType<MessageExpiredError>()) << error.what();
+    future2.get();
+
+    Pipe::ExpiryStats stats = pipe.getExpiryStats();
+    EXPECT_EQ(stats.numWritesShed, 1);
+    EXPECT_EQ(
+        stats.numBytesOfWritesShed,
+        imessage1_.payloads[0].data.length() +
+            imessage1_.tensors[0].data.length());
+  }
+
+  void client(Pipe& pipe) override {
+    // The first message never makes it to the wire.
+    auto future = pipeReadWithFuture(
+        pipe,
+        /*targetDevices=*/
+        {
+            Device{kCpuDeviceType, 0},
+        });
+    Descriptor descriptor;
+    Storage storage;
+    std::tie(descriptor, storage) = future.get();
+    expectDescriptorAndStorageMatchMessage(descriptor, storage, imessage2_);
+  }
+};
+
+TEST(Pipe, ShedExpiredWrite) {
+  ShedExpiredWriteTest test;
+  test.run();
+}
+
+class DiscardExpiredReadTest : public ClientServerPipeTestCase {
+  InlineMessage imessage1_ = {
+      .payloads =
+          {
+              {.data = "payload #1.1", .metadata = "payload metadata #1.1"},
+          },
+      .tensors =
+          {
+              {
+                  .data = "tensor #1.1",
+                  .metadata = "tensor metadata #1.1",
+                  .device = Device{kCpuDeviceType, 0},
+              },
+          },
+      .metadata = "expired message metadata",
+  };
+
+  InlineMessage imessage2_ = {
+      .payloads =
+          {
+              {.data = "payload #2.1", .metadata = "payload metadata #2.1"},
+          },
+      .tensors =
+          {
+              {
+                  .data = "tensor #2.1",
+                  .metadata = "tensor metadata #2.1",
+                  .device = Device{kCpuDeviceType, 0},
+              },
+          },
+      .metadata = "message metadata",
+  };
+
+  InlineMessage readyMessage_ = {
+      .payloads =
+          {
+              {.data = "ready", .metadata = "ready metadata"},
+          },
+      .metadata = "ready message metadata",
+  };
+
+  // The peers are threads of the same process, hence the server can tell the
+  // client when the first message expires, so that it starts reading right
+  // after that rather than after a guessed amount of time.
+  std::promise<std::chrono::system_clock::time_point> deadlinePromise_;
+
+ public:
+  void server(Pipe& pipe) override {
+    // Make sure the pipe is fully established, so that the first message is
+    // written out right away, well before its deadline, rather than being shed
+    // by the sender.
+    auto readyFuture = pipeReadWithFuture(pipe, /*targetDevices=*/{});
+    Descriptor readyDescriptor;
+    Storage readyStorage;
+    std::tie(readyDescriptor, readyStorage) = readyFuture.get();
+    expectDescriptorAndStorageMatchMessage(
+        readyDescriptor, readyStorage, readyMessage_);
+
+    Message message1;
+    Storage storage1;
+    std::tie(message1, storage1) = makeMessage(imessage1_);
+    const std::chrono::system_clock::time_point deadline =
+        std::chrono::system_clock::now() + std::chrono::milliseconds(500);
+    message1.deadline = deadline;
+    auto future1 = pipeWriteWithFuture(pipe, message1);
+    deadlinePromise_.set_value(deadline);
+
+    Message message2;
+    Storage storage2;
+    std::tie(message2, storage2) = makeMessage(imessage2_);
+    auto future2 = pipeWriteWithFuture(pipe, message2);
+
+    // The sender isn't notified of the message being discarded.
+    future1.get();
+    future2.get();
+  }
+
+  void client(Pipe& pipe) override {
+    Message readyMessage;
+    Storage readyStorage;
+    std::tie(readyMessage, readyStorage) = makeMessage(readyMessage_);
+    pipeWriteWithFuture(pipe, readyMessage).get();
+
+    // Only start reading once the first message has expired. The receiver
+    // checks the deadline when it reads the descriptor, which can't happen
+    // before a read is issued.
+    std::this_thread::sleep_until(deadlinePromise_.get_future().get());
+
+    std::promise<Error> promise1;
+    pipe.readDescriptor([&](const Error& error, Descriptor descriptor) {
+      EXPECT_EQ(descriptor.metadata, imessage1_.metadata);
+      EXPECT_TRUE(descriptor.deadline.has_value());
+      promise1.set_value(error);
+    });
+    Error error = promise1.get_future().get();
+    EXPECT_TRUE(error.isOfType<MessageExpiredError>()) << error.what();
+
+    auto future2 = pipeReadWithFuture(
+        pipe,
+        /*targetDevices=*/
+        {
+            Device{kCpuDeviceType, 0},
+        });
+    Descriptor descriptor2;
+    Storage storage2;
+    std::tie(descriptor2, storage2) = future2.get();
+    expectDescriptorAndStorageMatchMessage(descriptor2, storage2, imessage2_);
+
+    Pipe::ExpiryStats stats = pipe.getExpiryStats();
+    EXPECT_EQ(stats.numReadsShed, 1);
+    EXPECT_EQ(
+        stats.numBytesOfReadsShed,
+        imessage1_.payloads[0].data.length() +
+            imessage1_.tensors[0].data.length());
+  }
+};
+
+TEST(Pipe, DiscardExpiredRead) {
+  DiscardExpiredReadTest test;
+  test.run();
+}
+
+class TaggedReadTest : public ClientServerPipeTestCase {
+  static constexpr uint64_t kFirstTag = 1;
+  static constexpr uint64_t kSecondTag = 2;
+  static constexpr int kNumMessagesPerTag = 3;
+
+  static InlineMessage makeInlineMessage(uint64_t tag, int idx) {
+    const std::string suffix = std::to_string(tag) + "." + std::to_string(idx);
+    return {
+        .payloads =
+            {
+                {.data = "payload #" + suffix,
+                 .metadata = "payload metadata #" + suffix},
+            },
+        .tensors =
+            {
+                {
+                    .data = "tensor #" + suffix,
+                    .metadata = "tensor metadata #" + suffix,
+                    .device = Device{kCpuDeviceType, 0},
+                    // Messages received ahead of time ask for this anyways.
+                    .targetDevice = Device{kCpuDeviceType, 0},
+                },
+            },
+        .metadata = "message metadata #" + suffix,
+    };
+  }
+
+ public:
+  void server(Pipe& pipe) override {
+    // Interleave the messages of the two tags.
+    std::vector<Storage> storages;
+    std::vector<std::future<void>> futures;
+    for (int idx = 0; idx < kNumMessagesPerTag; idx++) {
+      for (uint64_t tag : {kFirstTag, kSecondTag}) {
+        Message message;
+        Storage storage;
+        std::tie(message, storage) = makeMessage(makeInlineMessage(tag, idx));
+        message.tag = tag;
+        futures.push_back(pipeWriteWithFuture(pipe, std::move(message)));
+        storages.push_back(std::move(storage));
+      }
+    }
+    for (auto& future : futures) {
+      future.get();
+    }
+  }
+
+  void client(Pipe& pipe) override {
+    auto consume = [&](uint64_t tag) {
+      for (int idx = 0; idx < kNumMessagesPerTag; idx++) {
+        Descriptor descriptor;
+        Storage storage;
+        std::tie(descriptor, storage) =
+            pipeReadTaggedWithFuture(
+                pipe, tag, /*targetDevices=*/{Device{kCpuDeviceType, 0}})
+                .get();
+        EXPECT_EQ(descriptor.tag, tag);
+        expectDescriptorAndStorageMatchMessage(
+            descriptor, storage, makeInlineMessage(tag, idx));
+      }
+    };
+
+    // Each tag is consumed by its own thread. The one of the first tag starts
+    // late, hence the pipe must receive its messages ahead of time in order for
+    // the ones of the second tag to get through.
+    std::thread secondConsumer(consume, kSecondTag);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    consume(kFirstTag);
+    secondConsumer.join();
+  }
+};
+
+TEST(Pipe, TaggedRead) {
+  TaggedReadTest test;
+  test.run();
+}
+
+class StreamWriteReadTest : public ClientServerPipeTestCase {
+  InlineMessage imessage_ = {
+      .payloads =
+          {
+              {.data = "payload #1", .metadata = "payload metadata #1"},
+          },
+      .metadata = "message metadata",
+  };
+
+  const std::string data_ = "the quick brown fox jumps over the lazy dog";
+
+ protected:
+  ContextOptions contextOptions() override {
+    return ContextOptions().enableStreams();
+  }
+
+ public:
+  void server(Pipe& pipe) override {
+    Stream stream = pipe.openStream(/*id=*/42);
+    // This write is larger than any of the reader's buffers.
+    std::promise<Error> promise1;
+    stream.write(data_.data(), 20, [&](const Error& error) {
+      promise1.set_value(error);
+    });
+    std::promise<Error> promise2;
+    stream.write(
+        data_.data() + 20, data_.size() - 20, [&](const Error& error) {
+          promise2.set_value(error);
+        });
+    stream.end();
+
+    // Messages aren't held back by the stream, which is waiting for credit.
+    Message message;
+    Storage storage;
+    std::tie(message, storage) = makeMessage(imessage_);
+    auto future = pipeWriteWithFuture(pipe, message);
+    future.get();
+
+    EXPECT_FALSE(promise1.get_future().get());
+    EXPECT_FALSE(promise2.get_future().get());
+  }
+
+  void client(Pipe& pipe) override {
+    Descriptor descriptor;
+    Storage storage;
+    auto future = pipeReadWithFuture(pipe, /*targetDevices=*/{});
+    std::tie(descriptor, storage) = future.get();
+    expectDescriptorAndStorageMatchMessage(descriptor, storage, imessage_);
+
+    Stream stream = pipe.openStream(/*id=*/42);
+    std::string received;
+    while (true) {
+      char buffer[8];
+      std::promise<std::tuple<Error, size_t>> promise;
+      stream.read(buffer, sizeof(buffer), [&](const Error& error, size_t len) {
+        promise.set_value(std::make_tuple(error, len));
+      });
+      // An empty read doesn't consume any data, and completes in order.
+      std::promise<void> emptyPromise;
+      std::future<std::tuple<Error, size_t>> future = promise.get_future();
+      stream.read(nullptr, 0, [&](const Error& error, size_t len) {
+        EXPECT_EQ(
+            future.wait_for(std::chrono::seconds(0)),
+            std::future_status::ready);
+        if (!error) {
+          EXPECT_EQ(len, 0);
+        }
+        emptyPromise.set_value();
+      });
+      emptyPromise.get_future().get();
+      Error error;
+      size_t len;
+      std::tie(error, len) = future.get();
+      if (error) {
+        EXPECT_TRUE(error.isOfType<StreamEndedError>()) << error.what();
+        break;
+      }
+      EXPECT_GT(len, 0);
+      EXPECT_LE(len, sizeof(buffer));
+      received.append(buffer, len);
+    }
+    EXPECT_EQ(received, data_);
+  }
+};
+
+TEST(Pipe, StreamWriteRead) {
+  StreamWriteReadTest test;
+  test.run();
+}
+
+class StreamsNotEnabledTest : public ClientServerPipeTestCase {
+ public:
+  void server(Pipe& pipe) override {
+    std::promise<Error> promise;
+    pipe.openStream(/*id=*/42).write(
+        "foo", 3, [&](const Error& error) { promise.set_value(error); });
+    Error error = promise.get_future().get();
+    EXPECT_TRUE(error.isOfType<StreamsNotEnabledError>()) << error.what();
+  }
+
+  void client(Pipe& pipe) override {
+    std::promise<Error> promise;
+    char buffer[8];
+    pipe.openStream(/*id=*/42).read(
+        buffer, sizeof(buffer), [&](const Error& error, size_t /* unused */) {
+          promise.set_value(error);
+        });
+    Error error = promise.get_future().get();
+    EXPECT_TRUE(error.isOfType<StreamsNotEnabledError>()) << error.what();
+  }
+};
+
+TEST(Pipe, StreamsNotEnabled) {
+  StreamsNotEnabledTest test;
+  test.run();
+}
+
+class WriteBatchingTest : public ClientServerPipeTestCase {
+  static constexpr size_t kNumMessages = 50;
+  // This one has a tensor, hence it can't be batched with the others.
+  static constexpr size_t kUnbatchedMessageIdx = 25;
+
+  std::vector<InlineMessage> imessages_;
+
+ public:
+  WriteBatchingTest() {
+    for (size_t idx = 0; idx < kNumMessages; idx++) {
+      InlineMessage imessage;
+      imessage.payloads.push_back(
+          {.data = "payload #" + std::to_string(idx),
+           .metadata = "payload metadata #" + std::to_string(idx)});
+      if (idx == kUnbatchedMessageIdx) {
+        imessage.tensors.push_back({
+            .data = "tensor #" + std::to_string(idx),
+            .metadata = "tensor metadata #" + std::to_string(idx),
+            .device = Device{kCpuDeviceType, 0},
+        });
+      }
+      imessage.metadata = "message metadata #" + std::to_string(idx);
+      imessages_.push_back(std::move(imessage));
+    }
+  }
+
+  ContextOptions contextOptions() override {
+    return ContextOptions().writeBatching(
+        std::chrono::microseconds(100), /*maxBatchSize=*/4096);
+  }
+
+  void server(Pipe& pipe) override {
+    std::vector<Message> messages(kNumMessages);
+    std::vector<Storage> storages(kNumMessages);
+    for (size_t idx = 0; idx < kNumMessages; idx++) {
+      std::tie(messages[idx], storages[idx]) = makeMessage(imessages_[idx]);
+    }
+
+    // The other messages are written from the callback of the first one, which
+    // runs on the loop, hence they all reach the pipe before any batch can be
+    // done being written, and all but the first one must wait in a batch.
+    std::vector<std::future<void>> futures;
+    std::promise<void> writesIssuedPromise;
+    pipe.write(messages[0], [&](const Error& error) {
+      EXPECT_FALSE(error) << error.what();
+      for (size_t idx = 1; idx < kNumMessages; idx++) {
+        futures.push_back(pipeWriteWithFuture(pipe, messages[idx]));
+      }
+      writesIssuedPromise.set_value();
+    });
+    writesIssuedPromise.get_future().get();
+    for (auto& future : futures) {
+      future.get();
+    }
+
+    Pipe::BatchingStats stats = pipe.getBatchingStats();
+    EXPECT_EQ(stats.numMessagesBatched, kNumMessages - 1);
+    EXPECT_GE(stats.numBatches, 1);
+    EXPECT_LT(stats.numBatches, stats.numMessagesBatched);
+    EXPECT_GE(stats.totalBatchingDelayNs, stats.maxBatchingDelayNs);
+  }
+
+  void client(Pipe& pipe) override {
+    for (size_t idx = 0; idx < kNumMessages; idx++) {
+      std::vector<Device> targetDevices;
+      if (idx == kUnbatchedMessageIdx) {
+        targetDevices.push_back(Device{kCpuDeviceType, 0});
+      }
+      auto future = pipeReadWithFuture(pipe, targetDevices);
+      Descriptor descriptor;
+      Storage storage;
+      std::tie(descriptor, storage) = future.get();
+      expectDescriptorAndStorageMatchMessage(
+          descriptor, storage, imessages_[idx]);
+    }
+  }
+};
+
+TEST(Pipe, WriteBatching) {
+  WriteBatchingTest test;
+  test.run();
+}
+
+// Only the writer batches, hence the reader learns from the handshake how the
+// descriptors are framed.
+class WriteBatchingOnOneEndTest : public WriteBatchingTest {
+ public:
+  ContextOptions clientContextOptions() override {
+    return ContextOptions();
+  }
+};
+
+TEST(Pipe, WriteBatchingOnOneEnd) {
+  WriteBatchingOnOneEndTest test;
+  test.run();
+}
+
+namespace {
+
+// The reader waits this long before reading anything, which is thus how long
+// the writer's connection is stuck.
+constexpr auto kWriteBatchingReaderDelay = std::chrono::milliseconds(500);
+
+} // namespace
+
+// The first batch can't be done being written until the reader starts reading,
+// as it's stuck behind a message that fills the connection. The second batch
+// must nonetheless be flushed once its window has passed.
+class WriteBatchingWindowTest : public ClientServerPipeTestCase {
+  std::vector<InlineMessage> imessages_ = {
+      {
+          .payloads = {{.data = std::string(64 * 1024 * 1024, 'x')}},
+          .metadata = "unbatched message",
+      },
+      {
+          .payloads = {{.data = "payload #1"}},
+          .metadata = "first batched message",
+      },
+      {
+          .payloads = {{.data = "payload #2"}},
+          .metadata = "second batched message",
+      },
+  };
+
+ public:
+  ContextOptions contextOptions() override {
+    return ContextOptions().writeBatching(
+        std::chrono::milliseconds(1), /*maxBatchSize=*/4096);
+  }
+
+  void server(Pipe& pipe) override {
+    std::vector<Message> messages(imessages_.size());
+    std::vector<Storage> storages(imessages_.size());
+    std::vector<std::future<void>> futures;
+    for (size_t idx = 0; idx < imessages_.size(); idx++) {
+      std::tie(messages[idx], storages[idx]) = makeMessage(imessages_[idx]);
+      futures.push_back(pipeWriteWithFuture(pipe, messages[idx]));
+    }
+    for (auto& future : futures) {
+      future.get();
+    }
+
+    Pipe::BatchingStats stats = pipe.getBatchingStats();
+    EXPECT_EQ(stats.numMessagesBatched, 2u);
+    EXPECT_EQ(stats.numBatches, 2u);
+    // Without the window, the second batch would wait for the first one to be
+    // written, and thus for at least as long as the reader's delay.
+    const uint64_t maxExpectedDelayNs =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            kWriteBatchingReaderDelay / 2)
+            .count();
+    EXPECT_LT(stats.maxBatchingDelayNs, maxExpectedDelayNs);
+  }
+
+  void client(Pipe& pipe) override {
+    std::this_thread::sleep_for(kWriteBatchingReaderDelay);
+    for (const InlineMessage& imessage : imessages_) {
+      Descriptor descriptor;
+      Storage storage;
+      std::tie(descriptor, storage) = pipeReadWithFuture(pipe, {}).get();
+      expectDescriptorAndStorageMatchMessage(descriptor, storage, imessage);
+    }
+  }
+};
+
+TEST(Pipe, WriteBatchingWindow) {
+  WriteBatchingWindowTest test;
+  test.run();
+}
+
+class WarmupTest : public ClientServerPipeTestCase {
+  InlineMessage imessage_ = {
+      .payloads =
+          {
+              {.data = "payload #1", .metadata = "payload metadata #1"},
+          },
+      .tensors =
+          {
+              {
+                  .data = "tensor #1",
+                  .metadata = "tensor metadata #1",
+                  .device = Device{kCpuDeviceType, 0},
+              },
+          },
+      .metadata = "pipe metadata",
+  };
+
+ public:
+  // It's enough for one end to allow warm-ups.
+  ContextOptions serverContextOptions() override {
+    return ContextOptions().enableWarmup();
+  }
+
+  void server(Pipe& pipe) override {
+    // An empty profile has nothing to wait for.
+    pipeWarmupWithFuture(pipe, Pipe::WarmupProfile{.sizes = {}}).get();
+
+    auto warmupFuture = pipeWarmupWithFuture(
+        pipe,
+        Pipe::WarmupProfile{.sizes = {1, 4096, 1024 * 1024}, .numRounds = 2});
+    warmupFuture.get();
+
+    Message message;
+    Storage storage;
+    std::tie(message, storage) = makeMessage(imessage_);
+    auto future = pipeWriteWithFuture(pipe, message);
+    future.get();
+  }
+
+  void client(Pipe& pipe) override {
+    // The warm-up messages are dropped, hence the first message that's read
+    // is the one written after them.
+    Descriptor descriptor;
+    Storage storage;
+    auto future = pipeReadWithFuture(
+        pipe, /*targetDevices=*/{Device{kCpuDeviceType, 0}});
+    std::tie(descriptor, storage) = future.get();
+    expectDescriptorAndStorageMatchMessage(descriptor, storage, imessage_);
+  }
+};
+
+TEST(Pipe, Warmup) {
+  WarmupTest test;
+  test.run();
+}
+
+// Each side drains and echoes the other's warm-up on its own, hence both can
+// wait for their warm-ups before reading anything.
+class WarmupBothEndsTest : public ClientServerPipeTestCase {
+  InlineMessage imessage_ = {
+      .payloads =
+          {
+              {.data = "payload #1", .metadata = "payload metadata #1"},
+          },
+      .metadata = "pipe metadata",
+  };
+
+  const Pipe::WarmupProfile profile_ = {
+      .sizes = {1, 4096, 1024 * 1024},
+      .numRounds = 2,
+  };
+
+ public:
+  ContextOptions contextOptions() override {
+    return ContextOptions().enableWarmup();
+  }
+
+  void server(Pipe& pipe) override {
+    pipeWarmupWithFuture(pipe, profile_).get();
+
+    Message message;
+    Storage storage;
+    std::tie(message, storage) = makeMessage(imessage_);
+    pipeWriteWithFuture(pipe, message).get();
+  }
+
+  void client(Pipe& pipe) override {
+    pipeWarmupWithFuture(pipe, profile_).get();
+
+    Descriptor descriptor;
+    Storage storage;
+    std::tie(descriptor, storage) =
+        pipeReadWithFuture(pipe, /*targetDevices=*/{}).get();
+    expectDescriptorAndStorageMatchMessage(descriptor, storage, imessage_);
+  }
+};
+
+TEST(Pipe, WarmupBothEnds) {
+  WarmupBothEndsTest test;
+  test.run();
+}
+
+namespace {
+
+constexpr size_t kSparseTensorLength = 64 * 1024 + 3;
+
+} // namespace
+
+// The first tensor is sparse enough to be sent in the sparse encoding, whereas
+// the second one isn't, hence it's sent as is even though it asks for it.
+class SparseEncodingTest : public ClientServerPipeTestCase {
+  static InlineMessage makeInlineMessage() {
+    std::string sparseData(kSparseTensorLength, '\0');
+    for (size_t offset = 0; offset < kSparseTensorLength; offset += 1000) {
+      sparseData[offset] = static_cast<char>(offset / 1000 + 1);
+    }
+    // The trailing bytes that don't make up a whole word.
+    sparseData[kSparseTensorLength - 1] = 42;
+    std::string denseData(kSparseTensorLength, '\0');
+    for (size_t offset = 0; offset < kSparseTensorLength; offset++) {
+      denseData[offset] = static_cast<char>(offset % 255 + 1);
+    }
+    return InlineMessage{
+        .payloads = {},
+        .tensors =
+            {
+                {
+                    .data = std::move(sparseData),
+                    .metadata = "sparse tensor",
+                    .device = Device{kCpuDeviceType, 0},
+                    // Sparse tensors are always received in host memory.
+                    .targetDevice = Device{kCpuDeviceType, 0},
+                },
+                {
+                    .data = std::move(denseData),
+                    .metadata = "dense tensor",
+                    .device = Device{kCpuDeviceType, 0},
+                },
+            },
+        .metadata = "pipe metadata",
+    };
+  }
+
+  InlineMessage imessage_ = makeInlineMessage();
+
+ public:
+  void server(Pipe& pipe) override {
+    Message message;
+    Storage storage;
+    std::tie(message, storage) = makeMessage(imessage_);
+    for (Message::Tensor& tensor : message.tensors) {
+      tensor.sparseEncodingThreshold = 0.9;
+    }
+    pipeWriteWithFuture(pipe, message).get();
+  }
+
+  void client(Pipe& pipe) override {
+    std::promise<Descriptor> descriptorPromise;
+    pipe.readDescriptor([&](const Error& error, Descriptor descriptor) {
+      ASSERT_FALSE(error) << error.what();
+      descriptorPromise.set_value(std::move(descriptor));
+    });
+    Descriptor descriptor = descriptorPromise.get_future().get();
+    ASSERT_EQ(descriptor.tensors.size(), 2);
+    EXPECT_GT(descriptor.tensors[0].sparseLength, 0);
+    EXPECT_LT(descriptor.tensors[0].sparseLength, kSparseTensorLength);
+    EXPECT_EQ(descriptor.tensors[1].sparseLength, 0);
+
+    Allocation allocation;
+    Storage storage;
+    std::tie(allocation, storage) = makeAllocation(
+        descriptor, {Device{kCpuDeviceType, 0}, Device{kCpuDeviceType, 0}});
+    // Start from garbage, to check that the zeros are written too.
+    for (const auto& tensor : storage.tensors) {
+      std::memset(tensor.first.get(), 0xff, kSparseTensorLength);
+    }
+    std::promise<Error> readPromise;
+    pipe.read(std::move(allocation), [&](const Error& error) {
+      readPromise.set_value(error);
+    });
+    Error error = readPromise.get_future().get();
+    ASSERT_FALSE(error) << error.what();
+    expectDescriptorAndStorageMatchMessage(
+        std::move(descriptor), std::move(storage), imessage_);
+  }
+};
+
+TEST(Pipe, SparseEncoding) {
+  SparseEncodingTest test;
+  test.run();
+}
@@ -182,6 +182,27 @@ inline std::future<void> pipeWriteWithFuture(
   return future;
 }
 
+inline std::future<void> pipeWarmupWithFuture(
+    tensorpipe::Pipe& pipe,
+    tensorpipe::Pipe::WarmupProfile profile) {
+  auto promise = std::make_shared<std::promise<void>>();
+  auto future = promise->get_future();
+
+  pipe.warmup(
+      std::move(profile),
+      [promise{std::move(promise)}](const tensorpipe::Error& error) {
+        if (error) {
+          promise->set_exception(
+              std::make_exception_ptr(std::runtime_error(error.what())));
+          return;
+        }
+
+        promise->set_value();
+      });
+
+  return future;
+}
+
 inline std::future<std::tuple<tensorpipe::Descriptor, Storage>>
 pipeReadWithFuture(
     tensorpipe::Pipe& pipe,
@@ -222,6 +243,54 @@ pipeReadWithFuture(
   return future;
 }
 
+inline std::future<std::tuple<tensorpipe::Descriptor, Storage>>
+pipeReadTaggedWithFuture(
+    tensorpipe::Pipe& pipe,
+    uint64_t tag,
+    std::vector<tensorpipe::Device> targetDevices) {
+  auto promise = std::make_shared<
+      std::promise<std::tuple<tensorpipe::Descriptor, Storage>>>();
+  auto future = promise->get_future();
+  pipe.readDescriptor(
+      tag,
+      [&pipe,
+       tag,
+       promise{std::move(promise)},
+       targetDevices{std::move(targetDevices)}](
+          const tensorpipe::Error& error,
+          tensorpipe::Descriptor descriptor) mutable {
+        if (error) {
+          promise->set_exception(
+              std::make_exception_ptr(std::runtime_error(error.what())));
+          return;
+        }
+
+        tensorpipe::Allocation allocation;
+        Storage storage;
+        std::tie(allocation, storage) =
+            makeAllocation(descriptor, targetDevices);
+        pipe.read(
+            tag,
+            std::move(allocation),
+            [promise{std::move(promise)},
+             descriptor{std::move(descriptor)},
+             storage{std::move(storage)}](
+                const tensorpipe::Error& error) mutable {
+              if (error) {
+                promise->set_exception(
+                    std::make_exception_ptr(std::runtime_error(error.what())));
+                return;
+              }
+
+              promise->set_value(
+                  std::make_tuple<tensorpipe::Descriptor, Storage>(
+                      std::move(descriptor), std::move(storage)));
+            });
+      });
+
+  return future;
+}
+
 inline void expectDescriptorAndStorageMatchMessage(
     tensorpipe::Descriptor descriptor,
     Storage storage,
@@ -290,8 +359,9 @@ inline std::vector<std::string> genUrls() {
   return res;
 }
 
-inline std::shared_ptr<tensorpipe::Context> makeContext() {
-  auto context = std::make_shared<tensorpipe::Context>();
+inline std::shared_ptr<tensorpipe::Context> makeContext(
+    tensorpipe::ContextOptions opts = tensorpipe::ContextOptions()) {
+  auto context = std::make_shared<tensorpipe::Context>(std::move(opts));
 
   context->registerTransport(0, "uv", tensorpipe::transport::uv::create());
 #if TENSORPIPE_HAS_SHM_TRANSPORT
@@ -326,7 +396,7 @@ class ClientServerPipeTestCase {
   void run() {
     pg_.spawn(
         [&]() {
-          auto context = makeContext();
+          auto context = makeContext(serverContextOptions());
 
           auto listener = context->listen(genUrls());
           pg_.send(PeerGroup::kClient, listener->url("uv"));
@@ -351,7 +421,7 @@ class ClientServerPipeTestCase {
           context->join();
         },
         [&]() {
-          auto context = makeContext();
+          auto context = makeContext(clientContextOptions());
 
           auto url = pg_.recv(PeerGroup::kClient);
           auto pipe = context->connect(url);
@@ -368,5 +438,19 @@ class ClientServerPipeTestCase {
   virtual void client(tensorpipe::Pipe& pipe) = 0;
   virtual void server(tensorpipe::Pipe& pipe) = 0;
 
+  // The options of the contexts of both ends of the pipe.
+  virtual tensorpipe::ContextOptions contextOptions() {
+    return tensorpipe::ContextOptions();
+  }
+
+  // For tests whose two ends need different options.
+  virtual tensorpipe::ContextOptions serverContextOptions() {
+    return contextOptions();
+  }
+
+  virtual tensorpipe::ContextOptions clientContextOptions() {
+    return contextOptions();
+  }
+
   virtual ~ClientServerPipeTestCase() = default;
 };
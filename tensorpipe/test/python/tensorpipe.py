@@ -5,23 +5,83 @@
 # This source code is licensed under the BSD-style license found in the
 # LICENSE file in the root directory of this source tree.
 
+import ctypes
 import threading
 import unittest
 
 import pytensorpipe as tp
 
+try:
+    import numpy as np
+except ImportError:
+    np = None
+
+
+def create_context() -> tp.Context:
+    context = tp.Context()
+    context.register_transport(0, "tcp", tp.create_uv_transport())
+    create_shm_transport = getattr(tp, "create_shm_transport", None)
+    if create_shm_transport is not None:
+        context.register_transport(-1, "shm", create_shm_transport())
+    context.register_channel(0, "basic", tp.create_basic_channel())
+    create_cma_channel = getattr(tp, "create_cma_channel", None)
+    if create_cma_channel is not None:
+        context.register_channel(-1, "cma", create_cma_channel())
+    return context
+
+
+class ArrayInterface:
+    """A minimal array, exposing a bytearray through the array interface."""
+
+    def __init__(self, data: bytearray, shape, typestr: str) -> None:
+        self._data = data
+        address = ctypes.addressof(ctypes.c_char.from_buffer(data))
+        self.__array_interface__ = {
+            "data": (address, False),
+            "shape": shape,
+            "typestr": typestr,
+            "version": 3,
+        }
+
+
+def exchange_tensor(test: unittest.TestCase, tensor: tp.OutgoingTensor):
+    """Send a message with the given tensor and return it on the other end,
+    after having received it into memory allocated by the bindings."""
+    context = create_context()
+    listener: tp.Listener = context.listen(["tcp://127.0.0.1"])
+    server_pipe = None
+    write_completed = threading.Event()
+
+    def on_connection(pipe: tp.Pipe) -> None:
+        nonlocal server_pipe
+        server_pipe = pipe
+        message = tp.OutgoingMessage(b"", [], [tensor])
+        pipe.write(message, write_completed.set)
+
+    listener.listen(on_connection)
+    client_pipe: tp.Pipe = context.connect(listener.get_url("tcp"))
+
+    received_tensor = None
+    read_completed = threading.Event()
+
+    def on_read_descriptor(message: tp.IncomingMessage) -> None:
+        nonlocal received_tensor
+        test.assertEqual(len(message.tensors), 1)
+        received_tensor = message.tensors[0]
+        received_tensor.allocate()
+        client_pipe.read(message, read_completed.set)
+
+    client_pipe.read_descriptor(on_read_descriptor)
+
+    write_completed.wait()
+    read_completed.wait()
+    context.join()
+    return received_tensor
+
 
 class TestTensorpipe(unittest.TestCase):
     def test_read_write(self):
-        context = tp.Context()
-        context.register_transport(0, "tcp", tp.create_uv_transport())
-        create_shm_transport = getattr(tp, "create_shm_transport", None)
-        if create_shm_transport is not None:
-            context.register_transport(-1, "shm", create_shm_transport())
-        context.register_channel(0, "basic", tp.create_basic_channel())
-        create_cma_channel = getattr(tp, "create_cma_channel", None)
-        if create_cma_channel is not None:
-            context.register_channel(-1, "cma", create_cma_channel())
+        context = create_context()
 
         # We must keep a reference to it, or it will be destroyed early.
         server_pipe = None
@@ -82,6 +142,52 @@ class TestTensorpipe(unittest.TestCase):
         # See https://github.com/pybind/pybind11/issues/1446.
         context.join()
 
+    def test_array_interface(self):
+        data = bytearray(range(24))
+        tensor = tp.OutgoingTensor(
+            ArrayInterface(data, (2, 3), "<f4"), b"meta", send_layout=True
+        )
+        received = exchange_tensor(self, tensor)
+        self.assertEqual(received.metadata, b"meta")
+        self.assertEqual(received.dtype, "<f4")
+        self.assertEqual(received.shape, (2, 3))
+        interface = received.__array_interface__
+        self.assertEqual(interface["shape"], (2, 3))
+        self.assertEqual(interface["typestr"], "<f4")
+        self.assertEqual(ctypes.string_at(interface["data"][0], 24), data)
+
+    def test_raw_bytes_have_no_layout(self):
+        received = exchange_tensor(self, tp.OutgoingTensor(b"World!", b"meta"))
+        self.assertEqual(received.metadata, b"meta")
+        self.assertIsNone(received.dtype)
+        self.assertIsNone(received.shape)
+        self.assertEqual(received.__array_interface__["shape"], (6,))
+
+    @unittest.skipIf(np is None, "NumPy is not available")
+    def test_numpy(self):
+        array = np.arange(12, dtype=np.int64).reshape(3, 4)
+        received = exchange_tensor(
+            self, tp.OutgoingTensor(array, b"", send_layout=True)
+        )
+        self.assertEqual(received.dtype, "<i8")
+        self.assertEqual(received.shape, (3, 4))
+        np.testing.assert_array_equal(np.asarray(received), array)
+        if hasattr(np, "from_dlpack"):
+            np.testing.assert_array_equal(np.from_dlpack(received), array)
+
+    @unittest.skipIf(np is None, "NumPy is not available")
+    def test_numpy_without_layout(self):
+        # By default the metadata reaches the receiver untouched.
+        array = np.arange(12, dtype=np.int64).reshape(3, 4)
+        received = exchange_tensor(self, tp.OutgoingTensor(array, b"meta"))
+        self.assertEqual(received.metadata, b"meta")
+        self.assertIsNone(received.dtype)
+        self.assertEqual(received.length, array.nbytes)
+        np.testing.assert_array_equal(
+            np.frombuffer(np.asarray(received), dtype=np.int64).reshape(3, 4),
+            array,
+        )
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <tensorpipe/rpc/client.h>
+#include <tensorpipe/rpc/error.h>
+#include <tensorpipe/rpc/server.h>
+#include <tensorpipe/test/core/pipe_test.h>
+
+using namespace tensorpipe;
+
+namespace {
+
+// Keeps the memory of all the allocations alive until the end of the test.
+class Arena {
+ public:
+  Allocation allocate(const Descriptor& descriptor) {
+    Allocation allocation;
+    Storage storage;
+    std::tie(allocation, storage) = makeAllocation(
+        descriptor,
+        std::vector<Device>(
+            descriptor.tensors.size(), Device{kCpuDeviceType, 0}));
+    std::unique_lock<std::mutex> lock(mutex_);
+    storages_.push_back(std::move(storage));
+    return allocation;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<Storage> storages_;
+};
+
+// The test harness hands out references, whereas the RPC classes want to
+// share ownership of the pipe. The pipe outlives them in all tests.
+std::shared_ptr<Pipe> unownedPipe(Pipe& pipe) {
+  return std::shared_ptr<Pipe>(&pipe, [](Pipe* /* unused */) {});
+}
+
+// The payload must be kept alive until the call's callback is invoked.
+Message makeTextMessage(
+    std::string metadata,
+    const std::string* payload = nullptr) {
+  Message message;
+  message.metadata = std::move(metadata);
+  if (payload != nullptr) {
+    message.payloads.push_back({
+        .data = const_cast<char*>(payload->data()),
+        .length = payload->size(),
+    });
+  }
+  return message;
+}
+
+std::string payloadOf(const Descriptor& descriptor, const Allocation& alloc) {
+  if (descriptor.payloads.empty()) {
+    return "";
+  }
+  return std::string(
+      static_cast<char*>(alloc.payloads[0].data), descriptor.payloads[0].length);
+}
+
+// The client tells the server it can stop by sending this.
+constexpr char kBye[] = "bye";
+
+} // namespace
+
+class RpcEchoTest : public ClientServerPipeTestCase {
+  static constexpr int kNumCalls = 100;
+
+ public:
+  void server(Pipe& pipe) override {
+    Arena arena;
+    std::promise<void> byePromise;
+    rpc::Server server(
+        [&](const Descriptor& descriptor) {
+          return arena.allocate(descriptor);
+        },
+        [&](const Error& error,
+            Descriptor request,
+            Allocation allocation,
+            rpc::Responder responder) {
+          ASSERT_FALSE(error) << error.what();
+          // Send the request's payload back, without copying it.
+          Message response;
+          response.metadata = "reply to " + request.metadata;
+          response.payloads = {{
+              .data = allocation.payloads[0].data,
+              .length = request.payloads[0].length,
+          }};
+          bool isBye = request.metadata == kBye;
+          responder.respond(std::move(response), [&, isBye](const Error& error) {
+            EXPECT_FALSE(error) << error.what();
+            if (isBye) {
+              byePromise.set_value();
+            }
+          });
+        },
+        /*numThreads=*/4);
+    server.serve(unownedPipe(pipe));
+    byePromise.get_future().get();
+  }
+
+  void client(Pipe& pipe) override {
+    Arena arena;
+    rpc::Client client(unownedPipe(pipe));
+
+    // Issue all calls at once, and wait for them afterwards.
+    std::vector<std::future<void>> futures;
+    for (int callIdx = 0; callIdx <= kNumCalls; callIdx++) {
+      std::string metadata =
+          callIdx < kNumCalls ? "call #" + std::to_string(callIdx) : kBye;
+      auto payload = std::make_shared<std::string>(
+          "payload #" + std::to_string(callIdx));
+      auto promise = std::make_shared<std::promise<void>>();
+      futures.push_back(promise->get_future());
+      std::shared_ptr<Allocation> allocation = std::make_shared<Allocation>();
+      client.call(
+          makeTextMessage(metadata, payload.get()),
+          [&, allocation](const Descriptor& descriptor) {
+            *allocation = arena.allocate(descriptor);
+            return *allocation;
+          },
+          [promise, allocation, metadata, payload](
+              const Error& error, Descriptor response) {
+            EXPECT_FALSE(error) << error.what();
+            EXPECT_EQ(response.metadata, "reply to " + metadata);
+            EXPECT_EQ(payloadOf(response, *allocation), *payload);
+            promise->set_value();
+          });
+    }
+    for (auto& future : futures) {
+      future.get();
+    }
+  }
+};
+
+TEST(Rpc, Echo) {
+  RpcEchoTest test;
+  test.run();
+}
+
+class RpcFailuresTest : public ClientServerPipeTestCase {
+ public:
+  void server(Pipe& pipe) override {
+    Arena arena;
+    std::promise<void> byePromise;
+    // Requests that are never responded to.
+    std::mutex mutex;
+    std::vector<rpc::Responder> pendingResponders;
+    rpc::Server server(
+        [&](const Descriptor& descriptor) {
+          return arena.allocate(descriptor);
+        },
+        [&](const Error& error,
+            Descriptor request,
+            Allocation /* unused */,
+            rpc::Responder responder) {
+          ASSERT_FALSE(error) << error.what();
+          if (request.metadata == "fail") {
+            responder.respondWithError("boom");
+          } else if (request.metadata == kBye) {
+            responder.respond(Message(), [&](const Error& error) {
+              EXPECT_FALSE(error) << error.what();
+              byePromise.set_value();
+            });
+          } else {
+            std::unique_lock<std::mutex> lock(mutex);
+            pendingResponders.push_back(std::move(responder));
+          }
+        },
+        /*numThreads=*/1);
+    server.serve(unownedPipe(pipe));
+    byePromise.get_future().get();
+  }
+
+  void client(Pipe& pipe) override {
+    Arena arena;
+    rpc::Client client(unownedPipe(pipe));
+    auto allocate = [&](const Descriptor& descriptor) {
+      return arena.allocate(descriptor);
+    };
+    auto callWithFuture =
+        [&](std::string metadata,
+            optional<std::chrono::milliseconds> timeout,
+            rpc::Client::CallId* callId) {
+          auto promise = std::make_shared<std::promise<Error>>();
+          rpc::Client::CallId id = client.call(
+              makeTextMessage(std::move(metadata)),
+              allocate,
+              [promise](const Error& error, Descriptor /* unused */) {
+                promise->set_value(error);
+              },
+              timeout);
+          if (callId != nullptr) {
+            *callId = id;
+          }
+          return promise->get_future();
+        };
+
+    Error error = callWithFuture("fail", nullopt, nullptr).get();
+    EXPECT_TRUE(error.isOfType<rpc::RemoteError>()) << error.what();
+    EXPECT_NE(error.what().find("boom"), std::string::npos);
+
+    error =
+        callWithFuture("slow", std::chrono::milliseconds(100), nullptr).get();
+    EXPECT_TRUE(error.isOfType<rpc::CallTimedOutError>()) << error.what();
+
+    rpc::Client::CallId callId;
+    auto future = callWithFuture("hang", nullopt, &callId);
+    client.cancel(callId);
+    error = future.get();
+    EXPECT_TRUE(error.isOfType<rpc::CallCancelledError>()) << error.what();
+
+    // The client is still usable after all that.
+    error = callWithFuture(kBye, nullopt, nullptr).get();
+    EXPECT_FALSE(error) << error.what();
+
+    client.close();
+    error = callWithFuture("late", nullopt, nullptr).get();
+    EXPECT_TRUE(error.isOfType<rpc::ClientClosedError>()) << error.what();
+  }
+};
+
+TEST(Rpc, Failures) {
+  RpcFailuresTest test;
+  test.run();
+}
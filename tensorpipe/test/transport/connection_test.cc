@@ -175,6 +175,52 @@ TEST_P(TransportTest, Connection_QueueWritesBeforeReads) {
       });
 }
 
+TEST_P(TransportTest, Connection_DiscardRead) {
+  // This is larger than both the ring buffers of the shm transport and the
+  // chunks in which the uv transport drains data, so that it takes several
+  // rounds to discard it, after which the next message must be read intact.
+  constexpr size_t kDiscardedSize = 5 * 1024 * 1024;
+  const std::string kNextMsg = "next message";
+  std::string discardedMsg(kDiscardedSize, 0x42);
+
+  testConnection(
+      [&](std::shared_ptr<Connection> conn) {
+        doRead(
+            conn,
+            nullptr,
+            kDiscardedSize,
+            [&, conn](const Error& error, const void* ptr, size_t len) {
+              ASSERT_FALSE(error) << error.what();
+              ASSERT_EQ(ptr, nullptr);
+              ASSERT_EQ(len, kDiscardedSize);
+            });
+        doRead(
+            conn,
+            [&, conn](const Error& error, const void* ptr, size_t len) {
+              ASSERT_FALSE(error) << error.what();
+              ASSERT_EQ(
+                  std::string(static_cast<const char*>(ptr), len), kNextMsg);
+              peers_->done(PeerGroup::kServer);
+            });
+        peers_->join(PeerGroup::kServer);
+      },
+      [&](std::shared_ptr<Connection> conn) {
+        doWrite(
+            conn,
+            discardedMsg.data(),
+            discardedMsg.size(),
+            [&, conn](const Error& error) {
+              ASSERT_FALSE(error) << error.what();
+            });
+        doWrite(
+            conn, kNextMsg.data(), kNextMsg.size(), [&](const Error& error) {
+              ASSERT_FALSE(error) << error.what();
+              peers_->done(PeerGroup::kClient);
+            });
+        peers_->join(PeerGroup::kClient);
+      });
+}
+
 // TODO: Enable this test when uv transport could handle
 TEST_P(TransportTest, DISABLED_Connection_EmptyBuffer) {
   constexpr size_t numBytes = 13;
@@ -57,3 +57,15 @@ TEST_P(TransportTest, Context_DomainDescriptor) {
 
   context->join();
 }
+
+TEST_P(TransportTest, Context_DomainDescriptorIsStable) {
+  // Viability checks are cached per process, hence later contexts must come to
+  // the same conclusion as earlier ones.
+  auto context = GetParam()->getContext();
+  auto otherContext = GetParam()->getContext();
+
+  EXPECT_EQ(context->domainDescriptor(), otherContext->domainDescriptor());
+
+  context->join();
+  otherContext->join();
+}
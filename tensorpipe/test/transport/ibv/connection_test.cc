@@ -20,6 +20,7 @@ namespace {
 class IbvTransportTest : public TransportTest {};
 
 IbvTransportTestHelper helper;
+IbvLoopbackTransportTestHelper loopbackHelper;
 
 // This value is defined in tensorpipe/transport/ibv/connection.h
 static constexpr auto kBufferSize = 2 * 1024 * 1024;
@@ -176,3 +177,8 @@ TEST_P(IbvTransportTest, NopWriteWrapAround) {
 }
 
 INSTANTIATE_TEST_CASE_P(Ibv, IbvTransportTest, ::testing::Values(&helper));
+
+INSTANTIATE_TEST_CASE_P(
+    IbvLoopback,
+    IbvTransportTest,
+    ::testing::Values(&loopbackHelper));
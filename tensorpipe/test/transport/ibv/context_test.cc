@@ -40,6 +40,16 @@ TEST_P(IbvTransportContextTest, LookupHostnameAddress) {
 #define LOOPBACK_INTERFACE "lo0"
 #endif
 
+TEST(IbvLoopback, HasItsOwnDomain) {
+  // The loopback provider can't reach real devices, hence contexts using it
+  // must never be deemed compatible with those using actual InfiniBand.
+  IbvLoopbackTransportTestHelper loopbackHelper;
+  auto context = loopbackHelper.getContext();
+  EXPECT_EQ(context->domainDescriptor().rfind("ibv_loopback:", 0), 0)
+      << context->domainDescriptor();
+  context->join();
+}
+
 #ifdef LOOPBACK_INTERFACE
 TEST_P(IbvTransportContextTest, LookupInterfaceAddress) {
   Error error;
@@ -11,7 +11,13 @@
 namespace {
 
 IbvTransportTestHelper helper;
+IbvLoopbackTransportTestHelper loopbackHelper;
 
 } // namespace
 
 INSTANTIATE_TEST_CASE_P(Ibv, TransportTest, ::testing::Values(&helper));
+
+INSTANTIATE_TEST_CASE_P(
+    IbvLoopback,
+    TransportTest,
+    ::testing::Values(&loopbackHelper));
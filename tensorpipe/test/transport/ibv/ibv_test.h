@@ -23,3 +23,11 @@ class IbvTransportTestHelper : public TransportTestHelper {
     return "127.0.0.1";
   }
 };
+
+class IbvLoopbackTransportTestHelper : public IbvTransportTestHelper {
+ protected:
+  std::shared_ptr<tensorpipe::transport::Context> getContextInternal()
+      override {
+    return tensorpipe::transport::ibv::createLoopback();
+  }
+};
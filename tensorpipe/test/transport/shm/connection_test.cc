@@ -19,7 +19,11 @@ namespace {
 
 class ShmTransportTest : public TransportTest {};
 
+// For the tests that need the payloads to go through the helper threads.
+class ShmCopyThreadsTransportTest : public TransportTest {};
+
 SHMTransportTestHelper helper;
+SHMCopyThreadsTransportTestHelper copyThreadsHelper;
 
 // This value is defined in tensorpipe/transport/shm/connection.h
 static constexpr auto kBufferSize = 2 * 1024 * 1024;
@@ -89,6 +93,94 @@ TEST_P(ShmTransportTest, ChunkingImplicitRead) {
       });
 }
 
+TEST_P(ShmCopyThreadsTransportTest, HelperThreadCopies) {
+  // This is large enough for the payload to be copied by the helper threads,
+  // and its length isn't a multiple of their batches, which thus wrap around
+  // the end of the ring buffer at different offsets. The content differs
+  // from byte to byte to catch any batch or piece ending up out of place.
+  const size_t kMsgSize = 7 * kBufferSize + 4321;
+  std::vector<uint8_t> srcBuf(kMsgSize);
+  for (size_t i = 0; i < kMsgSize; ++i) {
+    srcBuf[i] = (i * 31 + i / 4096) % 251;
+  }
+  std::vector<uint8_t> dstBuf(kMsgSize);
+
+  testConnection(
+      [&](std::shared_ptr<Connection> conn) {
+        doRead(
+            conn,
+            dstBuf.data(),
+            kMsgSize,
+            [&, conn](const Error& error, const void* ptr, size_t len) {
+              ASSERT_FALSE(error) << error.what();
+              ASSERT_EQ(len, kMsgSize);
+              ASSERT_EQ(ptr, dstBuf.data());
+              ASSERT_EQ(dstBuf, srcBuf);
+              peers_->done(PeerGroup::kServer);
+            });
+        peers_->join(PeerGroup::kServer);
+      },
+      [&](std::shared_ptr<Connection> conn) {
+        doWrite(
+            conn, srcBuf.data(), srcBuf.size(), [&, conn](const Error& error) {
+              ASSERT_FALSE(error) << error.what();
+              peers_->done(PeerGroup::kClient);
+            });
+        peers_->join(PeerGroup::kClient);
+      });
+}
+
+TEST_P(ShmCopyThreadsTransportTest, CloseWithHelperThreadCopiesInFlight) {
+  // A first small message makes sure that the connection is established, so
+  // that the large one is immediately handed to the helper threads. The large
+  // write can't complete before the close, as it doesn't fit in the ring
+  // buffer, hence the close comes while the writer's helper threads are busy
+  // with it, and the reader's may be too by the time it sees the hangup. Both
+  // must hold off on failing their operations until their copies are done.
+  const std::string kReady = "ready";
+  const size_t kMsgSize = 7 * kBufferSize;
+  std::vector<uint8_t> srcBuf(kMsgSize, 0x42);
+  std::vector<uint8_t> dstBuf(kMsgSize);
+
+  testConnection(
+      [&](std::shared_ptr<Connection> conn) {
+        doRead(
+            conn,
+            [&, conn](const Error& error, const void* ptr, size_t len) {
+              ASSERT_FALSE(error) << error.what();
+              ASSERT_EQ(
+                  std::string(static_cast<const char*>(ptr), len), kReady);
+            });
+        doRead(
+            conn,
+            dstBuf.data(),
+            kMsgSize,
+            [&, conn](
+                const Error& error,
+                const void* /* unused */,
+                size_t /* unused */) {
+              EXPECT_TRUE(error);
+              peers_->done(PeerGroup::kServer);
+            });
+        peers_->join(PeerGroup::kServer);
+      },
+      [&](std::shared_ptr<Connection> conn) {
+        std::promise<void> readyPromise;
+        doWrite(conn, kReady.data(), kReady.size(), [&](const Error& error) {
+          ASSERT_FALSE(error) << error.what();
+          readyPromise.set_value();
+        });
+        readyPromise.get_future().wait();
+        doWrite(
+            conn, srcBuf.data(), srcBuf.size(), [&, conn](const Error& error) {
+              EXPECT_TRUE(error);
+              peers_->done(PeerGroup::kClient);
+            });
+        conn->close();
+        peers_->join(PeerGroup::kClient);
+      });
+}
+
 TEST_P(ShmTransportTest, QueueWrites) {
   // This is large enough that two of those will not fit in the ring buffer at
   // the same time.
@@ -176,3 +268,8 @@ TEST_P(ShmTransportTest, NopWriteWrapAround) {
 }
 
 INSTANTIATE_TEST_CASE_P(Shm, ShmTransportTest, ::testing::Values(&helper));
+
+INSTANTIATE_TEST_CASE_P(
+    ShmCopyThreads,
+    ShmCopyThreadsTransportTest,
+    ::testing::Values(&copyThreadsHelper));
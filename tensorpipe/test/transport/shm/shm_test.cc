@@ -11,7 +11,19 @@
 namespace {
 
 SHMTransportTestHelper helper;
+SHMPooledTransportTestHelper pooledHelper;
+SHMSingleThreadTransportTestHelper singleThreadHelper;
 
 } // namespace
 
 INSTANTIATE_TEST_CASE_P(Shm, TransportTest, ::testing::Values(&helper));
+
+INSTANTIATE_TEST_CASE_P(
+    ShmPooled,
+    TransportTest,
+    ::testing::Values(&pooledHelper));
+
+INSTANTIATE_TEST_CASE_P(
+    ShmSingleThread,
+    TransportTest,
+    ::testing::Values(&singleThreadHelper));
@@ -10,6 +10,7 @@
 
 #include <sstream>
 
+#include <tensorpipe/common/loop_pool.h>
 #include <tensorpipe/test/transport/transport_test.h>
 #include <tensorpipe/transport/shm/factory.h>
 
@@ -25,3 +26,35 @@ class SHMTransportTestHelper : public TransportTestHelper {
     return "";
   }
 };
+
+class SHMPooledTransportTestHelper : public SHMTransportTestHelper {
+ protected:
+  std::shared_ptr<tensorpipe::transport::Context> getContextInternal()
+      override {
+    return tensorpipe::transport::shm::create(loopPool_);
+  }
+
+ private:
+  tensorpipe::LoopPool loopPool_{2};
+};
+
+class SHMSingleThreadTransportTestHelper : public SHMTransportTestHelper {
+ protected:
+  std::shared_ptr<tensorpipe::transport::Context> getContextInternal()
+      override {
+    return tensorpipe::transport::shm::createSingleThreaded();
+  }
+};
+
+// Gives each context helper threads of its own, so that large payloads are
+// copied by them regardless of how many cores the machine has.
+class SHMCopyThreadsTransportTestHelper : public SHMTransportTestHelper {
+ protected:
+  std::shared_ptr<tensorpipe::transport::Context> getContextInternal()
+      override {
+    return tensorpipe::transport::shm::createWithCopyThreads(kNumCopyThreads);
+  }
+
+ private:
+  static constexpr size_t kNumCopyThreads = 4;
+};
@@ -8,13 +8,31 @@
 
 #include <tensorpipe/test/transport/uv/uv_test.h>
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <string>
+#include <thread>
+
 #include <gtest/gtest.h>
 
+#include <tensorpipe/transport/uv/factory.h>
+
 namespace {
 
 class UVTransportConnectionTest : public TransportTest {};
 
 UVTransportTestHelper helper;
+UVZeroCopyTransportTestHelper zeroCopyHelper;
 
 } // namespace
 
@@ -50,7 +68,184 @@ TEST_P(UVTransportConnectionTest, LargeWrite) {
       });
 }
 
+// Reads into page-aligned buffers provided by the user, which zero-copy receive
+// must leave alone: they must stay writable, both for the user and for the
+// second read into the same buffer.
+TEST_P(UVTransportConnectionTest, LargeReadIntoAlignedBuffer) {
+  constexpr size_t kMsgSize = 16 * 1024 * 1024 + 123;
+  constexpr int kNumMsgs = 2;
+  std::string msg(kMsgSize, 0);
+  for (size_t i = 0; i < kMsgSize; i++) {
+    msg[i] = (i >> 8) ^ (i & 0xff);
+  }
+
+  testConnection(
+      [&](std::shared_ptr<Connection> conn) {
+        for (int msgIdx = 0; msgIdx < kNumMsgs; msgIdx++) {
+          doWrite(conn, msg.c_str(), msg.length(), [&](const Error& error) {
+            ASSERT_FALSE(error) << error.what();
+          });
+        }
+        peers_->done(PeerGroup::kServer);
+        peers_->join(PeerGroup::kServer);
+      },
+      [&](std::shared_ptr<Connection> conn) {
+        void* ptr = ::mmap(
+            nullptr,
+            kMsgSize,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS,
+            -1,
+            0);
+        ASSERT_NE(ptr, MAP_FAILED);
+        for (int msgIdx = 0; msgIdx < kNumMsgs; msgIdx++) {
+          std::promise<void> readProm;
+          doRead(
+              conn,
+              ptr,
+              kMsgSize,
+              [&](const Error& error, const void* data, size_t len) {
+                ASSERT_FALSE(error) << error.what();
+                ASSERT_EQ(data, ptr);
+                ASSERT_EQ(len, kMsgSize);
+                ASSERT_EQ(std::memcmp(data, msg.c_str(), kMsgSize), 0);
+                readProm.set_value();
+              });
+          readProm.get_future().get();
+          std::memset(ptr, 0, kMsgSize);
+        }
+        ::munmap(ptr, kMsgSize);
+        peers_->done(PeerGroup::kClient);
+        peers_->join(PeerGroup::kClient);
+      });
+}
+
+namespace {
+
+// Returns the permissions (e.g., "r--s") of the mapping containing the address.
+std::string getMappingPermissions(const void* ptr) {
+  const uintptr_t addr = reinterpret_cast<uintptr_t>(ptr);
+  std::ifstream maps("/proc/self/maps");
+  std::string line;
+  while (std::getline(maps, line)) {
+    std::istringstream iss(line);
+    uintptr_t start;
+    uintptr_t end;
+    char dash;
+    std::string perms;
+    iss >> std::hex >> start >> dash >> end >> perms;
+    if (start <= addr && addr < end) {
+      return perms;
+    }
+  }
+  return "";
+}
+
+} // namespace
+
+// Have a raw socket send the payload from whole pages, with MSG_ZEROCOPY, so
+// that it arrives in a layout that can be mapped even over loopback, and check
+// that the read gets it in pages mapped from the socket into its own buffer.
+TEST(UVZeroCopyReceive, ImplicitLengthReadMapsPages) {
+#ifndef TCP_ZEROCOPY_RECEIVE
+  GTEST_SKIP() << "TCP_ZEROCOPY_RECEIVE isn't supported";
+#else
+  constexpr size_t kPayloadSize = 1024 * 1024;
+  // The loopback MTU is too large for the segments to be made of whole pages.
+  constexpr int kMaxSegmentSize = 7 * 4096;
+
+  auto context = uv::createWithZeroCopyReceive(64 * 1024);
+  auto listener = context->listen("127.0.0.1");
+  std::promise<std::shared_ptr<Connection>> connProm;
+  listener->accept(
+      [&](const Error& error, std::shared_ptr<Connection> conn) {
+        ASSERT_FALSE(error) << error.what();
+        connProm.set_value(std::move(conn));
+      });
+
+  const std::string addr = listener->addr();
+  struct sockaddr_in sin;
+  std::memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sin.sin_port = htons(std::stoi(addr.substr(addr.rfind(':') + 1)));
+
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(fd, 0);
+  int one = 1;
+  if (::setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+    ::close(fd);
+    context->join();
+    GTEST_SKIP() << "SO_ZEROCOPY isn't supported";
+  }
+  ASSERT_EQ(
+      ::setsockopt(
+          fd,
+          IPPROTO_TCP,
+          TCP_MAXSEG,
+          &kMaxSegmentSize,
+          sizeof(kMaxSegmentSize)),
+      0);
+  ASSERT_EQ(::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)), 0);
+  ASSERT_EQ(
+      ::connect(fd, reinterpret_cast<struct sockaddr*>(&sin), sizeof(sin)), 0);
+  std::shared_ptr<Connection> conn = connProm.get_future().get();
+
+  void* payload = ::mmap(
+      nullptr,
+      kPayloadSize,
+      PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS,
+      -1,
+      0);
+  ASSERT_NE(payload, MAP_FAILED);
+  for (size_t i = 0; i < kPayloadSize; i++) {
+    reinterpret_cast<uint8_t*>(payload)[i] = (i >> 12) ^ (i & 0xff);
+  }
+
+  // The send may block until the connection starts reading, hence do it from
+  // another thread. Let the data pile up in the receive queue before reading,
+  // as only the pages that have already arrived can be mapped.
+  std::thread sender([&]() {
+    const uint64_t length = kPayloadSize;
+    ASSERT_EQ(::send(fd, &length, sizeof(length), 0), sizeof(length));
+    size_t offset = 0;
+    while (offset < kPayloadSize) {
+      ssize_t rv = ::send(
+          fd,
+          reinterpret_cast<uint8_t*>(payload) + offset,
+          kPayloadSize - offset,
+          MSG_ZEROCOPY);
+      ASSERT_GT(rv, 0) << std::strerror(errno);
+      offset += rv;
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+  std::promise<std::string> readProm;
+  conn->read([&](const Error& error, const void* data, size_t len) {
+    ASSERT_FALSE(error) << error.what();
+    ASSERT_EQ(len, kPayloadSize);
+    ASSERT_EQ(std::memcmp(data, payload, kPayloadSize), 0);
+    readProm.set_value(getMappingPermissions(data));
+  });
+  const std::string perms = readProm.get_future().get();
+  EXPECT_EQ(perms.substr(0, 2), "r-") << "Got permissions " << perms;
+
+  sender.join();
+  conn->close();
+  context->join();
+  ::close(fd);
+  ::munmap(payload, kPayloadSize);
+#endif
+}
+
 INSTANTIATE_TEST_CASE_P(
     Uv,
     UVTransportConnectionTest,
     ::testing::Values(&helper));
+
+INSTANTIATE_TEST_CASE_P(
+    UvZeroCopy,
+    UVTransportConnectionTest,
+    ::testing::Values(&zeroCopyHelper));
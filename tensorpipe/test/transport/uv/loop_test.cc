@@ -29,6 +29,24 @@ TEST(UvLoop, Defer) {
   loop.join();
 }
 
+TEST(UvLoop, DeferWithBusyPolling) {
+  Loop loop(std::chrono::microseconds(100));
+
+  for (int i = 0; i < 10; i++) {
+    // Defer function on event loop thread.
+    std::promise<std::thread::id> prom;
+    loop.deferToLoop([&] { prom.set_value(std::this_thread::get_id()); });
+    ASSERT_NE(std::this_thread::get_id(), prom.get_future().get());
+  }
+
+  loop.join();
+
+  BusyPollStats stats = loop.getBusyPollStats();
+  EXPECT_GT(stats.numSpins, 0);
+  EXPECT_GT(stats.numHits + stats.numMisses, 0);
+  EXPECT_LE(stats.numHits + stats.numMisses, stats.numSpins);
+}
+
 } // namespace uv
 } // namespace transport
 } // namespace test
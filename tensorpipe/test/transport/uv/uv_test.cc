@@ -11,7 +11,25 @@
 namespace {
 
 UVTransportTestHelper helper;
+UVBusyPollTransportTestHelper busyPollHelper;
+UVPooledTransportTestHelper pooledHelper;
+UVZeroCopyTransportTestHelper zeroCopyHelper;
 
 } // namespace
 
 INSTANTIATE_TEST_CASE_P(Uv, TransportTest, ::testing::Values(&helper));
+
+INSTANTIATE_TEST_CASE_P(
+    UvBusyPoll,
+    TransportTest,
+    ::testing::Values(&busyPollHelper));
+
+INSTANTIATE_TEST_CASE_P(
+    UvPooled,
+    TransportTest,
+    ::testing::Values(&pooledHelper));
+
+INSTANTIATE_TEST_CASE_P(
+    UvZeroCopy,
+    TransportTest,
+    ::testing::Values(&zeroCopyHelper));
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <tensorpipe/common/loop_pool.h>
 #include <tensorpipe/test/transport/transport_test.h>
 #include <tensorpipe/transport/uv/factory.h>
 
@@ -23,3 +24,31 @@ class UVTransportTestHelper : public TransportTestHelper {
     return "127.0.0.1";
   }
 };
+
+class UVBusyPollTransportTestHelper : public UVTransportTestHelper {
+ protected:
+  std::shared_ptr<tensorpipe::transport::Context> getContextInternal()
+      override {
+    return tensorpipe::transport::uv::createWithBusyPolling(
+        std::chrono::microseconds(100));
+  }
+};
+
+class UVZeroCopyTransportTestHelper : public UVTransportTestHelper {
+ protected:
+  std::shared_ptr<tensorpipe::transport::Context> getContextInternal()
+      override {
+    return tensorpipe::transport::uv::createWithZeroCopyReceive(64 * 1024);
+  }
+};
+
+class UVPooledTransportTestHelper : public UVTransportTestHelper {
+ protected:
+  std::shared_ptr<tensorpipe::transport::Context> getContextInternal()
+      override {
+    return tensorpipe::transport::uv::create(loopPool_);
+  }
+
+ private:
+  tensorpipe::LoopPool loopPool_{2};
+};
@@ -25,6 +25,9 @@ class Connection {
 
   virtual void read(read_callback_fn fn) = 0;
 
+  // If ptr is null the given number of bytes are drained from the connection
+  // and thrown away, without ever holding all of them in memory at once, and
+  // the callback is called with a null pointer.
   virtual void read(void* ptr, size_t length, read_callback_fn fn) = 0;
 
   using write_callback_fn = std::function<void(const Error& error)>;
@@ -72,6 +72,13 @@ class ContextImplBoilerplate : public virtual DeferredExecutor,
 
   void setError(Error error);
 
+  // Block until all listeners and connections have unenrolled, and thus until
+  // they have released whatever they were holding on the loop. This is how a
+  // context whose loop is shared with other contexts (and which thus cannot be
+  // joined) can wait for its own objects to terminate. It must be called from
+  // outside the loop, after the context was closed.
+  void waitUntilAllUnenrolled();
+
   Error error_{Error::kSuccess};
 
   // An identifier for the context, composed of the identifier for the context,
@@ -104,6 +111,11 @@ class ContextImplBoilerplate : public virtual DeferredExecutor,
   std::unordered_map<TList*, std::shared_ptr<TList>> listeners_;
   std::unordered_map<TConn*, std::shared_ptr<TConn>> connections_;
 
+  // Fulfilled, from the loop, once the last listener or connection unenrolls.
+  std::shared_ptr<std::promise<void>> allUnenrolledPromise_;
+
+  void maybeFulfillAllUnenrolledPromise();
+
   // For some odd reason it seems we need to use a qualified name here...
   template <typename T>
   friend class tensorpipe::CallbackWrapper;
@@ -184,6 +196,7 @@ void ContextImplBoilerplate<TCtx, TList, TConn>::unenroll(TList& listener) {
   TP_DCHECK(inLoop());
   auto numRemoved = listeners_.erase(&listener);
   TP_DCHECK_EQ(numRemoved, 1);
+  maybeFulfillAllUnenrolledPromise();
 }
 
 template <typename TCtx, typename TList, typename TConn>
@@ -191,6 +204,33 @@ void ContextImplBoilerplate<TCtx, TList, TConn>::unenroll(TConn& connection) {
   TP_DCHECK(inLoop());
   auto numRemoved = connections_.erase(&connection);
   TP_DCHECK_EQ(numRemoved, 1);
+  maybeFulfillAllUnenrolledPromise();
+}
+
+template <typename TCtx, typename TList, typename TConn>
+void ContextImplBoilerplate<TCtx, TList, TConn>::waitUntilAllUnenrolled() {
+  TP_DCHECK(!inLoop());
+  auto promise = std::make_shared<std::promise<void>>();
+  std::future<void> future = promise->get_future();
+  deferToLoop([this, promise{std::move(promise)}]() mutable {
+    TP_DCHECK(!allUnenrolledPromise_);
+    allUnenrolledPromise_ = std::move(promise);
+    maybeFulfillAllUnenrolledPromise();
+  });
+  future.wait();
+}
+
+template <typename TCtx, typename TList, typename TConn>
+void ContextImplBoilerplate<TCtx, TList, TConn>::
+    maybeFulfillAllUnenrolledPromise() {
+  TP_DCHECK(inLoop());
+  if (allUnenrolledPromise_ && listeners_.empty() && connections_.empty()) {
+    // The context may be destroyed as soon as the promise is fulfilled, hence
+    // we must not access any of its fields after that.
+    std::shared_ptr<std::promise<void>> promise =
+        std::move(allUnenrolledPromise_);
+    promise->set_value();
+  }
 }
 
 template <typename TCtx, typename TList, typename TConn>
@@ -207,7 +247,10 @@ void ContextImplBoilerplate<TCtx, TList, TConn>::setId(std::string id) {
 
 template <typename TCtx, typename TList, typename TConn>
 void ContextImplBoilerplate<TCtx, TList, TConn>::close() {
-  deferToLoop([this]() { closeFromLoop(); });
+  // Joining calls this even after the context was joined, at which point a loop
+  // shared with other contexts could still run this after the context is gone.
+  deferToLoop(
+      [impl{this->shared_from_this()}]() { impl->closeFromLoop(); });
 }
 
 template <typename TCtx, typename TList, typename TConn>
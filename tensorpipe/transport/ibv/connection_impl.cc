@@ -18,6 +18,7 @@
 #include <tensorpipe/common/epoll_loop.h>
 #include <tensorpipe/common/error_macros.h>
 #include <tensorpipe/common/ibv.h>
+#include <tensorpipe/common/loop_stats.h>
 #include <tensorpipe/common/memory.h>
 #include <tensorpipe/common/ringbuffer_read_write_ops.h>
 #include <tensorpipe/common/ringbuffer_role.h>
@@ -215,6 +216,7 @@ void ConnectionImpl::writeImplFromLoop(
 
 void ConnectionImpl::handleEventsFromLoop(int events) {
   TP_DCHECK(context_->inLoop());
+  LoopStats::HandlerScope scope(id_, "epoll");
   TP_VLOG(9) << "Connection " << id_ << " is handling an event on its socket ("
              << EpollLoop::formatEpollEvents(events) << ")";
 
@@ -420,6 +422,7 @@ void ConnectionImpl::processWriteOperationsFromLoop() {
 
 void ConnectionImpl::onRemoteProducedData(uint32_t length) {
   TP_DCHECK(context_->inLoop());
+  LoopStats::HandlerScope scope(id_, "ibv_completion");
   TP_VLOG(9) << "Connection " << id_ << " was signalled that " << length
              << " bytes were written to its inbox on QP " << qp_->qp_num;
 
@@ -440,6 +443,7 @@ void ConnectionImpl::onRemoteProducedData(uint32_t length) {
 
 void ConnectionImpl::onRemoteConsumedData(uint32_t length) {
   TP_DCHECK(context_->inLoop());
+  LoopStats::HandlerScope scope(id_, "ibv_completion");
   TP_VLOG(9) << "Connection " << id_ << " was signalled that " << length
              << " bytes were read from its outbox on QP " << qp_->qp_num;
   ssize_t ret;
@@ -459,6 +463,7 @@ void ConnectionImpl::onRemoteConsumedData(uint32_t length) {
 
 void ConnectionImpl::onWriteCompleted() {
   TP_DCHECK(context_->inLoop());
+  LoopStats::HandlerScope scope(id_, "ibv_completion");
   TP_VLOG(9) << "Connection " << id_
              << " done posting a RDMA write request on QP " << qp_->qp_num;
   numWritesInFlight_--;
@@ -467,6 +472,7 @@ void ConnectionImpl::onWriteCompleted() {
 
 void ConnectionImpl::onAckCompleted() {
   TP_DCHECK(context_->inLoop());
+  LoopStats::HandlerScope scope(id_, "ibv_completion");
   TP_VLOG(9) << "Connection " << id_ << " done posting a send request on QP "
              << qp_->qp_num;
   numAcksInFlight_--;
@@ -8,6 +8,12 @@
 
 #include <tensorpipe/transport/ibv/context_impl.h>
 
+#include <atomic>
+#include <cstdlib>
+#include <sstream>
+
+#include <tensorpipe/common/ibv_loopback.h>
+#include <tensorpipe/common/system.h>
 #include <tensorpipe/transport/ibv/connection_impl.h>
 #include <tensorpipe/transport/ibv/listener_impl.h>
 
@@ -31,9 +37,68 @@ std::string generateDomainDescriptor() {
   return kDomainDescriptorPrefix + "*";
 }
 
+// The loopback provider can't talk to real InfiniBand devices, hence it has a
+// domain of its own. It reaches its peers through abstract UNIX domain sockets
+// and copies into them using process_vm_writev(2), thus it's limited to the
+// processes of the same machine and of the same network namespace.
+const std::string kLoopbackDomainDescriptorPrefix{"ibv_loopback:"};
+
+std::string generateLoopbackDomainDescriptor() {
+  std::ostringstream oss;
+  oss << kLoopbackDomainDescriptorPrefix;
+  optional<std::string> bootID = getBootID();
+  TP_THROW_ASSERT_IF(!bootID.has_value()) << "Unable to read boot_id";
+  oss << bootID.value();
+  optional<std::string> nsID = getLinuxNamespaceId(LinuxNamespace::kNet);
+  if (nsID.has_value()) {
+    oss << '_' << nsID.value();
+  }
+  return oss.str();
+}
+
+// Trying to load libibverbs isn't free, and processes that don't have it would
+// pay that cost in vain for each context they create. As a library that can't
+// be found won't appear later on, we remember that an earlier attempt failed.
+// The devices, on the other hand, are enumerated again each time, as the kernel
+// module may be loaded, or a NIC brought up, while the process is running.
+std::atomic<bool> knownNotViable{false};
+
+std::shared_ptr<ContextImpl> markNotViable() {
+  knownNotViable = true;
+  return nullptr;
+}
+
 } // namespace
 
-std::shared_ptr<ContextImpl> ContextImpl::create() {
+std::shared_ptr<ContextImpl> ContextImpl::create(bool useLoopbackProvider) {
+  // The software emulation of the verbs can also be selected at runtime, for
+  // example to run the transport's tests and benchmarks on any machine. As this
+  // also affects contexts that were meant to use real devices, it's reported.
+  const bool loopbackFromEnv = std::getenv("TP_IBV_LOOPBACK") != nullptr;
+  TP_LOG_WARNING_IF(loopbackFromEnv && !useLoopbackProvider)
+      << "The TP_IBV_LOOPBACK environment variable is set, hence the IBV "
+      << "transport is using the loopback verbs provider instead of the "
+      << "InfiniBand devices";
+  if (useLoopbackProvider || loopbackFromEnv) {
+    TP_VLOG(7) << "IBV transport is using the loopback verbs provider";
+    IbvLib ibvLib = createLoopbackIbvLib();
+    Error error;
+    IbvDeviceList deviceList;
+    std::tie(error, deviceList) = IbvDeviceList::create(ibvLib);
+    TP_THROW_ASSERT_IF(error)
+        << "Couldn't get list of loopback devices: " << error.what();
+    return std::make_shared<ContextImpl>(
+        std::move(ibvLib),
+        std::move(deviceList),
+        generateLoopbackDomainDescriptor());
+  }
+
+  if (knownNotViable) {
+    TP_VLOG(7) << "IBV transport is not viable because libibverbs couldn't "
+               << "be loaded (as found out earlier)";
+    return nullptr;
+  }
+
   Error error;
   IbvLib ibvLib;
   std::tie(error, ibvLib) = IbvLib::create();
@@ -41,7 +106,7 @@ std::shared_ptr<ContextImpl> ContextImpl::create() {
     TP_VLOG(7)
         << "IBV transport is not viable because libibverbs couldn't be loaded: "
         << error.what();
-    return nullptr;
+    return markNotViable();
   }
 
   IbvDeviceList deviceList;
@@ -62,12 +127,15 @@ std::shared_ptr<ContextImpl> ContextImpl::create() {
   }
 
   return std::make_shared<ContextImpl>(
-      std::move(ibvLib), std::move(deviceList));
+      std::move(ibvLib), std::move(deviceList), generateDomainDescriptor());
 }
 
-ContextImpl::ContextImpl(IbvLib ibvLib, IbvDeviceList deviceList)
+ContextImpl::ContextImpl(
+    IbvLib ibvLib,
+    IbvDeviceList deviceList,
+    std::string domainDescriptor)
     : ContextImplBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl>(
-          generateDomainDescriptor()),
+          std::move(domainDescriptor)),
       reactor_(std::move(ibvLib), std::move(deviceList)) {}
 
 void ContextImpl::handleErrorImpl() {
@@ -27,9 +27,12 @@ class ListenerImpl;
 class ContextImpl final
     : public ContextImplBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl> {
  public:
-  static std::shared_ptr<ContextImpl> create();
+  static std::shared_ptr<ContextImpl> create(bool useLoopbackProvider = false);
 
-  ContextImpl(IbvLib ibvLib, IbvDeviceList deviceList);
+  ContextImpl(
+      IbvLib ibvLib,
+      IbvDeviceList deviceList,
+      std::string domainDescriptor);
 
   // Implement the DeferredExecutor interface.
   bool inLoop() const override;
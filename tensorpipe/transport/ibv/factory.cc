@@ -22,6 +22,12 @@ std::shared_ptr<Context> create() {
       ContextBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl>>();
 }
 
+std::shared_ptr<Context> createLoopback() {
+  return std::make_shared<
+      ContextBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl>>(
+      /*useLoopbackProvider=*/true);
+}
+
 } // namespace ibv
 } // namespace transport
 } // namespace tensorpipe
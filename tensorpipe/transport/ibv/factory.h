@@ -18,6 +18,12 @@ namespace ibv {
 
 std::shared_ptr<Context> create();
 
+// Create a context that, instead of libibverbs and actual InfiniBand devices,
+// uses a software emulation of the verbs which works on any Linux machine. It
+// is only meant for testing and benchmarking the transport's logic, as it will
+// perform much worse than the other transports.
+std::shared_ptr<Context> createLoopback();
+
 } // namespace ibv
 } // namespace transport
 } // namespace tensorpipe
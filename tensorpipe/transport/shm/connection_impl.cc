@@ -17,6 +17,7 @@
 #include <tensorpipe/common/defs.h>
 #include <tensorpipe/common/epoll_loop.h>
 #include <tensorpipe/common/error_macros.h>
+#include <tensorpipe/common/loop_stats.h>
 #include <tensorpipe/common/ringbuffer_read_write_ops.h>
 #include <tensorpipe/common/ringbuffer_role.h>
 #include <tensorpipe/common/shm_ringbuffer.h>
@@ -85,6 +86,7 @@ void ConnectionImpl::initImplFromLoop() {
 
   // Register method to be called when our peer writes to our inbox.
   inboxReactorToken_ = context_->addReaction([this]() {
+    LoopStats::HandlerScope scope(id_, "reactor");
     TP_VLOG(9) << "Connection " << id_
                << " is reacting to the peer writing to the inbox";
     processReadOperationsFromLoop();
@@ -92,6 +94,7 @@ void ConnectionImpl::initImplFromLoop() {
 
   // Register method to be called when our peer reads from our outbox.
   outboxReactorToken_ = context_->addReaction([this]() {
+    LoopStats::HandlerScope scope(id_, "reactor");
     TP_VLOG(9) << "Connection " << id_
                << " is reacting to the peer reading from the outbox";
     processWriteOperationsFromLoop();
@@ -159,6 +162,7 @@ void ConnectionImpl::writeImplFromLoop(
 
 void ConnectionImpl::handleEventsFromLoop(int events) {
   TP_DCHECK(context_->inLoop());
+  LoopStats::HandlerScope scope(id_, "epoll");
   TP_VLOG(9) << "Connection " << id_ << " is handling an event on its socket ("
              << EpollLoop::formatEpollEvents(events) << ")";
 
@@ -304,6 +308,38 @@ void ConnectionImpl::processReadOperationsFromLoop() {
   Consumer inboxConsumer(inboxRb_);
   while (!readOperations_.empty()) {
     RingbufferReadOperation& readOperation = readOperations_.front();
+    if (context_->hasHelperThreads() &&
+        readOperation.supportsOutOfLineCopy() &&
+        readOperation.length() >= kMinLengthForHelperThreads) {
+      // The operation stays at the front of the queue until all its batches
+      // are done, and it's then removed by onReadBatchDoneFromLoop.
+      while (!readOperation.fullyReserved()) {
+        std::vector<RingbufferCopy> copies;
+        if (readOperation.reservePayload(
+                inboxConsumer,
+                kMinHelperBatchSize,
+                kMaxHelperBatchSize,
+                copies) > 0) {
+          peerReactorTrigger_->run(peerOutboxReactorToken_.value());
+        }
+        if (copies.empty()) {
+          break;
+        }
+        size_t len = 0;
+        for (const RingbufferCopy& copy : copies) {
+          len += copy.len;
+        }
+        readBatches_.push_back(HelperCopyBatch{.len = len});
+        uint64_t batchId = nextReadBatchId_++;
+        context_->copyInHelperThreads(
+            std::move(copies),
+            kMinHelperBatchSize,
+            [impl{shared_from_this()}, batchId]() {
+              impl->onReadBatchDoneFromLoop(batchId);
+            });
+      }
+      break;
+    }
     if (readOperation.handleRead(inboxConsumer) > 0) {
       peerReactorTrigger_->run(peerOutboxReactorToken_.value());
     }
@@ -325,6 +361,38 @@ void ConnectionImpl::processWriteOperationsFromLoop() {
   Producer outboxProducer(outboxRb_);
   while (!writeOperations_.empty()) {
     RingbufferWriteOperation& writeOperation = writeOperations_.front();
+    if (context_->hasHelperThreads() &&
+        writeOperation.supportsOutOfLineCopy() &&
+        writeOperation.length() >= kMinLengthForHelperThreads) {
+      // The operation stays at the front of the queue until all its batches
+      // are done, and it's then removed by onWriteBatchDoneFromLoop.
+      while (!writeOperation.fullyReserved()) {
+        std::vector<RingbufferCopy> copies;
+        if (writeOperation.reservePayload(
+                outboxProducer,
+                kMinHelperBatchSize,
+                kMaxHelperBatchSize,
+                copies) > 0) {
+          peerReactorTrigger_->run(peerInboxReactorToken_.value());
+        }
+        if (copies.empty()) {
+          break;
+        }
+        size_t len = 0;
+        for (const RingbufferCopy& copy : copies) {
+          len += copy.len;
+        }
+        writeBatches_.push_back(HelperCopyBatch{.len = len});
+        uint64_t batchId = nextWriteBatchId_++;
+        context_->copyInHelperThreads(
+            std::move(copies),
+            kMinHelperBatchSize,
+            [impl{shared_from_this()}, batchId]() {
+              impl->onWriteBatchDoneFromLoop(batchId);
+            });
+      }
+      break;
+    }
     if (writeOperation.handleWrite(outboxProducer) > 0) {
       peerReactorTrigger_->run(peerInboxReactorToken_.value());
     }
@@ -336,7 +404,93 @@ void ConnectionImpl::processWriteOperationsFromLoop() {
   }
 }
 
+void ConnectionImpl::onReadBatchDoneFromLoop(uint64_t batchId) {
+  TP_DCHECK(context_->inLoop());
+  TP_DCHECK_LT(batchId, nextReadBatchId_);
+  TP_DCHECK_GE(batchId, nextReadBatchId_ - readBatches_.size());
+  readBatches_[batchId - (nextReadBatchId_ - readBatches_.size())].done = true;
+
+  // The error handling was put on hold until the helper threads were done.
+  if (error_) {
+    if (!hasHelperCopiesInFlight()) {
+      handleErrorImpl();
+    }
+    return;
+  }
+
+  Consumer inboxConsumer(inboxRb_);
+  while (!readBatches_.empty() && readBatches_.front().done) {
+    RingbufferReadOperation& readOperation = readOperations_.front();
+    if (readOperation.commitPayload(inboxConsumer, readBatches_.front().len) >
+        0) {
+      peerReactorTrigger_->run(peerOutboxReactorToken_.value());
+    }
+    readBatches_.pop_front();
+    if (readOperation.completed()) {
+      TP_DCHECK(readBatches_.empty());
+      readOperations_.pop_front();
+    }
+  }
+
+  processReadOperationsFromLoop();
+}
+
+void ConnectionImpl::onWriteBatchDoneFromLoop(uint64_t batchId) {
+  TP_DCHECK(context_->inLoop());
+  TP_DCHECK_LT(batchId, nextWriteBatchId_);
+  TP_DCHECK_GE(batchId, nextWriteBatchId_ - writeBatches_.size());
+  writeBatches_[batchId - (nextWriteBatchId_ - writeBatches_.size())].done =
+      true;
+
+  // The error handling was put on hold until the helper threads were done.
+  if (error_) {
+    if (!hasHelperCopiesInFlight()) {
+      handleErrorImpl();
+    }
+    return;
+  }
+
+  Producer outboxProducer(outboxRb_);
+  while (!writeBatches_.empty() && writeBatches_.front().done) {
+    RingbufferWriteOperation& writeOperation = writeOperations_.front();
+    if (writeOperation.commitPayload(
+            outboxProducer, writeBatches_.front().len) > 0) {
+      peerReactorTrigger_->run(peerInboxReactorToken_.value());
+    }
+    writeBatches_.pop_front();
+    if (writeOperation.completed()) {
+      TP_DCHECK(writeBatches_.empty());
+      writeOperations_.pop_front();
+    }
+  }
+
+  processWriteOperationsFromLoop();
+}
+
+bool ConnectionImpl::hasHelperCopiesInFlight() const {
+  for (const auto& batch : readBatches_) {
+    if (!batch.done) {
+      return true;
+    }
+  }
+  for (const auto& batch : writeBatches_) {
+    if (!batch.done) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void ConnectionImpl::handleErrorImpl() {
+  // The helper threads may still be accessing the ringbuffers and the buffers
+  // of the operations, which thus can't be failed (and possibly released by
+  // their owners) yet. This will be called again once they're done.
+  if (hasHelperCopiesInFlight()) {
+    return;
+  }
+  readBatches_.clear();
+  writeBatches_.clear();
+
   for (auto& readOperation : readOperations_) {
     readOperation.handleError(error_);
   }
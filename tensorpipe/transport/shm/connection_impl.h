@@ -11,6 +11,7 @@
 #include <deque>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <tensorpipe/common/epoll_loop.h>
 #include <tensorpipe/common/nop.h>
@@ -37,6 +38,16 @@ class ConnectionImpl final : public ConnectionImplBoilerplate<
                              public EpollLoop::EventHandler {
   constexpr static size_t kBufferSize = 2 * 1024 * 1024;
 
+  // The payloads of reads and writes of at least this size are copied by the
+  // context's helper threads rather than by the event loop. This happens in
+  // batches of up to half the ringbuffer, so that while the peer drains one of
+  // them this side can already be filling the next one. To amortize the cost
+  // of handing them off, batches are only started once there's enough data or
+  // space for them (or for all the rest of the payload).
+  constexpr static size_t kMinLengthForHelperThreads = 1024 * 1024;
+  constexpr static size_t kMinHelperBatchSize = 256 * 1024;
+  constexpr static size_t kMaxHelperBatchSize = kBufferSize / 2;
+
   constexpr static int kNumRingbufferRoles = 2;
   using Consumer = RingBufferRole<kNumRingbufferRoles, 0>;
   using Producer = RingBufferRole<kNumRingbufferRoles, 1>;
@@ -121,6 +132,21 @@ class ConnectionImpl final : public ConnectionImplBoilerplate<
   // Pending write operations.
   std::deque<RingbufferWriteOperation> writeOperations_;
 
+  // The batches of the payload of the first pending read or write operation
+  // that were handed to the helper threads, in the order in which they were
+  // reserved in the ringbuffer, which is also the order in which they must be
+  // committed, regardless of which one finishes first.
+  struct HelperCopyBatch {
+    size_t len;
+    bool done{false};
+  };
+  std::deque<HelperCopyBatch> readBatches_;
+  std::deque<HelperCopyBatch> writeBatches_;
+  uint64_t nextReadBatchId_{0};
+  uint64_t nextWriteBatchId_{0};
+
+  bool hasHelperCopiesInFlight() const;
+
   // Process pending read operations if in an operational state.
   //
   // This may be triggered by the other side of the connection (by pushing this
@@ -142,6 +168,12 @@ class ConnectionImpl final : public ConnectionImplBoilerplate<
   // writes were queued before the connection was ready to process them, or when
   // a new write operation is queued.
   void processWriteOperationsFromLoop();
+
+  // Called once the helper threads are done with a batch of the payload of the
+  // first pending read or write operation, to commit it (and any subsequent
+  // one that was already done) and then reserve more batches, if possible.
+  void onReadBatchDoneFromLoop(uint64_t batchId);
+  void onWriteBatchDoneFromLoop(uint64_t batchId);
 };
 
 } // namespace shm
@@ -8,6 +8,10 @@
 
 #include <tensorpipe/transport/shm/context_impl.h>
 
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
 #include <tensorpipe/common/epoll_loop.h>
 #include <tensorpipe/common/system.h>
 #include <tensorpipe/transport/shm/connection_impl.h>
@@ -24,9 +28,10 @@ namespace {
 // disambiguate descriptors when debugging.
 const std::string kDomainDescriptorPrefix{"shm:"};
 
-} // namespace
-
-std::shared_ptr<ContextImpl> ContextImpl::create() {
+// The outcome of these checks only depends on the process's environment, which
+// we don't expect to change during its lifetime, hence once they succeed it's
+// shared by all later contexts.
+optional<std::string> probeDomainDescriptor() {
   std::ostringstream oss;
   oss << kDomainDescriptorPrefix;
 
@@ -44,7 +49,7 @@ std::shared_ptr<ContextImpl> ContextImpl::create() {
   auto nsID = getLinuxNamespaceId(LinuxNamespace::kNet);
   if (!nsID.has_value()) {
     TP_VLOG(8) << "Unable to read net namespace ID";
-    return nullptr;
+    return nullopt;
   }
   oss << '_' << nsID.value();
 
@@ -56,7 +61,7 @@ std::shared_ptr<ContextImpl> ContextImpl::create() {
   std::tie(error, segment) = ShmSegment::alloc(1024 * 1024);
   if (error) {
     TP_VLOG(8) << "Couldn't allocate shared memory segment: " << error.what();
-    return nullptr;
+    return nullopt;
   }
 
   // A separate problem is that /dev/shm may be sized too small for all the
@@ -65,52 +70,156 @@ std::shared_ptr<ContextImpl> ContextImpl::create() {
 
   std::string domainDescriptor = oss.str();
   TP_VLOG(8) << "The domain descriptor for SHM is " << domainDescriptor;
-  return std::make_shared<ContextImpl>(std::move(domainDescriptor));
+  return domainDescriptor;
+}
+
+optional<std::string> getDomainDescriptor() {
+  // Only success is cached, as a failure may be transient (e.g., /dev/shm may
+  // be temporarily full), hence it's retried by the next context. The mutex
+  // makes contexts that are created concurrently wait for a single probe.
+  static std::mutex mutex;
+  static optional<std::string> domainDescriptor;
+  std::unique_lock<std::mutex> lock(mutex);
+  if (!domainDescriptor.has_value()) {
+    domainDescriptor = probeDomainDescriptor();
+  }
+  return domainDescriptor;
+}
+
+// Enough to saturate the memory bandwidth of most machines from a single
+// connection, while not taking too many cores away from the application.
+constexpr size_t kMaxNumCopyThreads = 4;
+
+// A single pool for the whole process, rather than one per context, so that
+// the number of helper threads doesn't grow with the number of contexts. Its
+// threads are only started once a context first needs them.
+CopyPool& getCopyPool() {
+  // Leave at least half of the cores to the event loops and the app.
+  static CopyPool copyPool(std::min<size_t>(
+      kMaxNumCopyThreads, std::thread::hardware_concurrency() / 2));
+  return copyPool;
+}
+
+} // namespace
+
+std::shared_ptr<ContextImpl> ContextImpl::create(
+    bool singleThread,
+    optional<size_t> numCopyThreads) {
+  const optional<std::string> domainDescriptor = getDomainDescriptor();
+  if (!domainDescriptor.has_value()) {
+    return nullptr;
+  }
+  std::unique_ptr<CopyPool> ownCopyPool;
+  if (numCopyThreads.has_value()) {
+    ownCopyPool = std::make_unique<CopyPool>(numCopyThreads.value());
+  }
+  return std::make_shared<ContextImpl>(
+      domainDescriptor.value(),
+      std::make_shared<Loop>(singleThread),
+      /*isLoopShared=*/false,
+      std::move(ownCopyPool));
+}
+
+std::shared_ptr<ContextImpl> ContextImpl::create(LoopPool& loopPool) {
+  const optional<std::string> domainDescriptor = getDomainDescriptor();
+  if (!domainDescriptor.has_value()) {
+    return nullptr;
+  }
+  std::shared_ptr<Loop> loop = loopPool.getLoop<Loop>(
+      "shm", []() { return std::make_shared<Loop>(); });
+  return std::make_shared<ContextImpl>(
+      domainDescriptor.value(), std::move(loop), /*isLoopShared=*/true);
 }
 
-ContextImpl::ContextImpl(std::string domainDescriptor)
+ContextImpl::ContextImpl(
+    std::string domainDescriptor,
+    std::shared_ptr<Loop> loop,
+    bool isLoopShared,
+    std::unique_ptr<CopyPool> ownCopyPool)
     : ContextImplBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl>(
-          std::move(domainDescriptor)) {}
+          std::move(domainDescriptor)),
+      loop_(std::move(loop)),
+      isLoopShared_(isLoopShared),
+      ownCopyPool_(std::move(ownCopyPool)),
+      copyPool_(ownCopyPool_ ? *ownCopyPool_ : getCopyPool()) {}
 
 void ContextImpl::handleErrorImpl() {
-  loop_.close();
-  reactor_.close();
+  if (!isLoopShared_) {
+    loop_->epollLoop.close();
+    loop_->reactor.close();
+  }
 }
 
 void ContextImpl::joinImpl() {
-  loop_.join();
-  reactor_.join();
+  // The copies must be done first, as their callbacks are deferred to the
+  // reactor, which must thus still be running.
+  {
+    std::unique_lock<std::mutex> lock(copiesMutex_);
+    copiesCv_.wait(lock, [&]() { return numCopiesInFlight_ == 0; });
+  }
+  if (ownCopyPool_) {
+    ownCopyPool_->join();
+  }
+  if (isLoopShared_) {
+    waitUntilAllUnenrolled();
+    return;
+  }
+  loop_->epollLoop.join();
+  loop_->reactor.join();
 }
 
 bool ContextImpl::inLoop() const {
-  return reactor_.inLoop();
+  return loop_->reactor.inLoop();
 };
 
 void ContextImpl::deferToLoop(std::function<void()> fn) {
-  reactor_.deferToLoop(std::move(fn));
+  loop_->reactor.deferToLoop(std::move(fn));
 };
 
 void ContextImpl::registerDescriptor(
     int fd,
     int events,
     std::shared_ptr<EpollLoop::EventHandler> h) {
-  loop_.registerDescriptor(fd, events, std::move(h));
+  loop_->epollLoop.registerDescriptor(fd, events, std::move(h));
 }
 
 void ContextImpl::unregisterDescriptor(int fd) {
-  loop_.unregisterDescriptor(fd);
+  loop_->epollLoop.unregisterDescriptor(fd);
 }
 
 ContextImpl::TToken ContextImpl::addReaction(TFunction fn) {
-  return reactor_.add(std::move(fn));
+  return loop_->reactor.add(std::move(fn));
 }
 
 void ContextImpl::removeReaction(TToken token) {
-  reactor_.remove(token);
+  loop_->reactor.remove(token);
 }
 
 std::tuple<int, int> ContextImpl::reactorFds() {
-  return reactor_.fds();
+  return loop_->reactor.fds();
+}
+
+bool ContextImpl::hasHelperThreads() const {
+  return copyPool_.numThreads() > 0;
+}
+
+void ContextImpl::copyInHelperThreads(
+    std::vector<RingbufferCopy> copies,
+    size_t minPieceSize,
+    std::function<void()> fn) {
+  {
+    std::unique_lock<std::mutex> lock(copiesMutex_);
+    numCopiesInFlight_++;
+  }
+  copyPool_.run(
+      std::move(copies), minPieceSize, [this, fn{std::move(fn)}]() mutable {
+        deferToLoop(std::move(fn));
+        // This must be the last access to the context, as joining it may then
+        // complete and destroy it.
+        std::unique_lock<std::mutex> lock(copiesMutex_);
+        numCopiesInFlight_--;
+        copiesCv_.notify_all();
+      });
 }
 
 } // namespace shm
@@ -8,12 +8,19 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <tuple>
+#include <vector>
 
 #include <tensorpipe/common/epoll_loop.h>
+#include <tensorpipe/common/loop_pool.h>
+#include <tensorpipe/common/optional.h>
+#include <tensorpipe/common/ringbuffer_read_write_ops.h>
 #include <tensorpipe/transport/context_impl_boilerplate.h>
+#include <tensorpipe/transport/shm/copy_pool.h>
 #include <tensorpipe/transport/shm/reactor.h>
 
 namespace tensorpipe {
@@ -23,12 +30,41 @@ namespace shm {
 class ConnectionImpl;
 class ListenerImpl;
 
+// The event loop of a context: the reactor and the epoll loop that defers its
+// events to the reactor. It can be shared by several contexts. The epoll loop
+// is declared last so that it's joined first, as it needs the reactor to run.
+// In single-thread mode the epoll loop has no thread and the reactor polls it.
+struct Loop {
+  explicit Loop(bool singleThread = false)
+      : epollLoop(reactor, /*runOwnThread=*/!singleThread) {
+    if (singleThread) {
+      reactor.pollEpollLoop(epollLoop);
+    }
+  }
+
+  Reactor reactor;
+  EpollLoop epollLoop;
+
+  void join() {
+    epollLoop.join();
+    reactor.join();
+  }
+};
+
 class ContextImpl final
     : public ContextImplBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl> {
  public:
-  static std::shared_ptr<ContextImpl> create();
+  static std::shared_ptr<ContextImpl> create(
+      bool singleThread = false,
+      optional<size_t> numCopyThreads = nullopt);
 
-  explicit ContextImpl(std::string domainDescriptor);
+  static std::shared_ptr<ContextImpl> create(LoopPool& loopPool);
+
+  ContextImpl(
+      std::string domainDescriptor,
+      std::shared_ptr<Loop> loop,
+      bool isLoopShared,
+      std::unique_ptr<CopyPool> ownCopyPool = nullptr);
 
   // Implement the DeferredExecutor interface.
   bool inLoop() const override;
@@ -50,14 +86,39 @@ class ContextImpl final
 
   std::tuple<int, int> reactorFds();
 
+  // Whether there are any helper threads, as there are none on machines with
+  // too few cores for them to be worth it. They're shared by all the contexts
+  // of the process, unless the context was given a pool of its own.
+  bool hasHelperThreads() const;
+
+  // Perform the given copies on the helper threads, in pieces of at least the
+  // given size, and then call the callback from the event loop.
+  void copyInHelperThreads(
+      std::vector<RingbufferCopy> copies,
+      size_t minPieceSize,
+      std::function<void()> fn);
+
  protected:
   // Implement the entry points called by ContextImplBoilerplate.
   void handleErrorImpl() override;
   void joinImpl() override;
 
  private:
-  Reactor reactor_;
-  EpollLoop loop_{this->reactor_};
+  const std::shared_ptr<Loop> loop_;
+
+  // A loop shared with other contexts can't be closed and joined with this one.
+  const bool isLoopShared_;
+
+  // Only set if the context was created with its own number of helper threads,
+  // in which case copyPool_ refers to it rather than to the process-wide one.
+  const std::unique_ptr<CopyPool> ownCopyPool_;
+  CopyPool& copyPool_;
+
+  // The copies of this context that are still running on the helper threads,
+  // which must be waited for before joining, as they defer to the loop.
+  std::mutex copiesMutex_;
+  std::condition_variable copiesCv_;
+  size_t numCopiesInFlight_{0};
 };
 
 } // namespace shm
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#include <tensorpipe/transport/shm/copy_pool.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <tensorpipe/common/defs.h>
+#include <tensorpipe/common/system.h>
+
+namespace tensorpipe {
+namespace transport {
+namespace shm {
+
+CopyPool::CopyPool(size_t numThreads) : numThreads_(numThreads) {}
+
+void CopyPool::run(
+    std::vector<RingbufferCopy> copies,
+    size_t minPieceSize,
+    std::function<void()> fn) {
+  TP_DCHECK_GT(numThreads_, 0);
+  size_t totalLen = 0;
+  for (const RingbufferCopy& copy : copies) {
+    totalLen += copy.len;
+  }
+  const size_t numPieces = std::max<size_t>(
+      1, std::min(numThreads_, totalLen / std::max<size_t>(minPieceSize, 1)));
+  const size_t pieceLen = (totalLen + numPieces - 1) / numPieces;
+
+  // Cut the copies into pieces of (about) the same length. A piece may span
+  // two copies, as the reserved region of the ringbuffer may wrap around.
+  std::vector<std::vector<RingbufferCopy>> pieces(numPieces);
+  size_t pieceIdx = 0;
+  size_t pieceLenSoFar = 0;
+  for (const RingbufferCopy& copy : copies) {
+    size_t offset = 0;
+    while (offset < copy.len) {
+      if (pieceLenSoFar == pieceLen) {
+        pieceIdx++;
+        pieceLenSoFar = 0;
+      }
+      const size_t len = std::min(copy.len - offset, pieceLen - pieceLenSoFar);
+      pieces[pieceIdx].push_back(RingbufferCopy{
+          .dst = reinterpret_cast<uint8_t*>(copy.dst) + offset,
+          .src = reinterpret_cast<const uint8_t*>(copy.src) + offset,
+          .len = len,
+      });
+      offset += len;
+      pieceLenSoFar += len;
+    }
+  }
+
+  auto numPiecesLeft = std::make_shared<std::atomic<size_t>>(numPieces);
+  auto sharedFn = std::make_shared<std::function<void()>>(std::move(fn));
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  TP_THROW_ASSERT_IF(closed_) << "Copy pool was already closed";
+  if (threads_.empty()) {
+    for (size_t threadIdx = 0; threadIdx < numThreads_; threadIdx++) {
+      threads_.emplace_back([this, threadIdx]() {
+        setThreadName("TP_SHM_copy_" + std::to_string(threadIdx));
+        loop();
+      });
+    }
+  }
+  for (std::vector<RingbufferCopy>& piece : pieces) {
+    tasks_.emplace_back(
+        [piece{std::move(piece)}, numPiecesLeft, sharedFn]() {
+          for (const RingbufferCopy& copy : piece) {
+            memcpy(copy.dst, copy.src, copy.len);
+          }
+          // The counter's decrement has release-acquire semantics, so the
+          // thread that sees it reach zero also sees all the other copies.
+          if (--(*numPiecesLeft) == 0) {
+            (*sharedFn)();
+          }
+        });
+  }
+  cv_.notify_all();
+}
+
+void CopyPool::loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [&]() { return closed_ || !tasks_.empty(); });
+    // Finish the tasks that are already queued before stopping, as whoever
+    // queued them is waiting for their callbacks.
+    if (tasks_.empty()) {
+      return;
+    }
+    std::function<void()> task = std::move(tasks_.front());
+    tasks_.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+  }
+}
+
+void CopyPool::close() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  closed_ = true;
+  cv_.notify_all();
+}
+
+void CopyPool::join() {
+  close();
+
+  std::vector<std::thread> threads;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (joined_) {
+      return;
+    }
+    joined_ = true;
+    threads = std::move(threads_);
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+CopyPool::~CopyPool() {
+  join();
+}
+
+} // namespace shm
+} // namespace transport
+} // namespace tensorpipe
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) Meta Platforms, Inc. and affiliates.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <tensorpipe/common/ringbuffer_read_write_ops.h>
+
+namespace tensorpipe {
+namespace transport {
+namespace shm {
+
+// A small pool of helper threads performing the copies of large payloads to
+// and from the ringbuffers, so that a single connection isn't capped at the
+// memcpy bandwidth of one core and so that the event loop stays free to serve
+// the other connections in the meantime.
+//
+// The threads are only started the first time they're needed, as most contexts
+// never see payloads large enough to use them. There is a single pool for the
+// whole process, shared by all the contexts.
+class CopyPool {
+ public:
+  explicit CopyPool(size_t numThreads);
+
+  size_t numThreads() const {
+    return numThreads_;
+  }
+
+  // Perform the given copies, splitting them into disjoint pieces of at least
+  // minPieceSize bytes that are spread across the threads, and then call the
+  // callback, from whichever thread finished last.
+  void run(
+      std::vector<RingbufferCopy> copies,
+      size_t minPieceSize,
+      std::function<void()> fn);
+
+  void close();
+
+  void join();
+
+  ~CopyPool();
+
+ private:
+  const size_t numThreads_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool closed_{false};
+  bool joined_{false};
+  std::deque<std::function<void()>> tasks_;
+  std::vector<std::thread> threads_;
+
+  void loop();
+};
+
+} // namespace shm
+} // namespace transport
+} // namespace tensorpipe
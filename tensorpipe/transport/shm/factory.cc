@@ -22,6 +22,23 @@ std::shared_ptr<Context> create() {
       ContextBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl>>();
 }
 
+std::shared_ptr<Context> create(LoopPool& loopPool) {
+  return std::make_shared<
+      ContextBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl>>(loopPool);
+}
+
+std::shared_ptr<Context> createSingleThreaded() {
+  return std::make_shared<
+      ContextBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl>>(
+      /*singleThread=*/true);
+}
+
+std::shared_ptr<Context> createWithCopyThreads(size_t numCopyThreads) {
+  return std::make_shared<
+      ContextBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl>>(
+      /*singleThread=*/false, numCopyThreads);
+}
+
 } // namespace shm
 } // namespace transport
 } // namespace tensorpipe
@@ -8,8 +8,10 @@
 
 #pragma once
 
+#include <cstddef>
 #include <memory>
 
+#include <tensorpipe/common/loop_pool.h>
 #include <tensorpipe/transport/context.h>
 
 namespace tensorpipe {
@@ -18,6 +20,21 @@ namespace shm {
 
 std::shared_ptr<Context> create();
 
+// Create a context that runs on one of the loops of the given pool, shared with
+// other contexts, rather than on threads of its own.
+std::shared_ptr<Context> create(LoopPool& loopPool);
+
+// Create a context whose reactor thread also polls the control sockets, rather
+// than having a second thread wait on them and hand each event over to it. This
+// saves a thread per context and a cross-thread wakeup per socket event.
+std::shared_ptr<Context> createSingleThreaded();
+
+// Create a context with a pool of helper threads of its own, of the given size,
+// rather than sharing the process-wide one, which is sized after the number of
+// cores (and has no threads at all on machines with fewer than two). Zero means
+// that all copies are done by the event loop.
+std::shared_ptr<Context> createWithCopyThreads(size_t numCopyThreads);
+
 } // namespace shm
 } // namespace transport
 } // namespace tensorpipe
@@ -16,6 +16,7 @@
 #include <tensorpipe/common/callback.h>
 #include <tensorpipe/common/defs.h>
 #include <tensorpipe/common/epoll_loop.h>
+#include <tensorpipe/common/loop_stats.h>
 #include <tensorpipe/common/optional.h>
 #include <tensorpipe/transport/error.h>
 #include <tensorpipe/transport/shm/connection_impl.h>
@@ -102,6 +103,7 @@ std::string ListenerImpl::addrImplFromLoop() const {
 
 void ListenerImpl::handleEventsFromLoop(int events) {
   TP_DCHECK(context_->inLoop());
+  LoopStats::HandlerScope scope(id_, "epoll");
   TP_VLOG(9) << "Listener " << id_ << " is handling an event on its socket ("
              << EpollLoop::formatEpollEvents(events) << ")";
 
@@ -71,7 +71,7 @@ Reactor::~Reactor() {
 }
 
 Reactor::TToken Reactor::add(TFunction fn) {
-  std::unique_lock<std::mutex> lock(mutex_);
+  std::unique_lock<Mutex> lock(mutex_);
   TToken token;
 
   // Either reuse a token or generate a new one.
@@ -98,7 +98,7 @@ Reactor::TToken Reactor::add(TFunction fn) {
 }
 
 void Reactor::remove(TToken token) {
-  std::unique_lock<std::mutex> lock(mutex_);
+  std::unique_lock<Mutex> lock(mutex_);
   functions_[token] = nullptr;
   reusableTokens_.insert(token);
   functionCount_--;
@@ -108,7 +108,20 @@ std::tuple<int, int> Reactor::fds() const {
   return std::make_tuple(headerSegment_.getFd(), dataSegment_.getFd());
 }
 
+void Reactor::pollEpollLoop(EpollLoop& epollLoop) {
+  epollLoop_ = &epollLoop;
+}
+
 bool Reactor::pollOnce() {
+  EpollLoop* epollLoop = epollLoop_;
+  if (epollLoop != nullptr &&
+      ++numIterationsSinceEpollPoll_ >= kIterationsBetweenEpollPolls) {
+    numIterationsSinceEpollPoll_ = 0;
+    if (epollLoop->pollFromLoop()) {
+      return true;
+    }
+  }
+
   Consumer reactorConsumer(rb_);
   uint32_t token;
   auto ret = reactorConsumer.read(&token, sizeof(token));
@@ -122,7 +135,7 @@ bool Reactor::pollOnce() {
   // Make copy of std::function so we don't need
   // to hold the lock while executing it.
   {
-    std::unique_lock<std::mutex> lock(mutex_);
+    std::unique_lock<Mutex> lock(mutex_);
     TP_DCHECK_LT(token, functions_.size());
     fn = functions_[token];
   }
@@ -135,7 +148,9 @@ bool Reactor::pollOnce() {
 }
 
 bool Reactor::readyToClose() {
-  return functionCount_ == 0;
+  EpollLoop* epollLoop = epollLoop_;
+  return functionCount_ == 0 &&
+      (epollLoop == nullptr || !epollLoop->hasRegisteredHandlers());
 }
 
 Reactor::Trigger::Trigger(Fd headerFd, Fd dataFd) {
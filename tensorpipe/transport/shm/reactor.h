@@ -19,7 +19,9 @@
 
 #include <tensorpipe/common/busy_polling_loop.h>
 #include <tensorpipe/common/callback.h>
+#include <tensorpipe/common/epoll_loop.h>
 #include <tensorpipe/common/fd.h>
+#include <tensorpipe/common/mutex.h>
 #include <tensorpipe/common/optional.h>
 #include <tensorpipe/common/ringbuffer_role.h>
 #include <tensorpipe/common/shm_segment.h>
@@ -40,6 +42,13 @@ class Reactor final : public BusyPollingLoop {
   // This allows for buffering 1M triggers (at 4 bytes a piece).
   static constexpr auto kSize = 4 * 1024 * 1024;
 
+  // When polling an epoll loop, do so once every this many iterations, busy or
+  // idle. The sockets only carry control events (connection setup, shutdown,
+  // errors) as the data goes through the ringbuffers, hence it's fine for them
+  // to wait a bit, whereas an epoll_wait(2) at every iteration would slow down
+  // the busy polling of the ringbuffers by a syscall each time.
+  static constexpr auto kIterationsBetweenEpollPolls = 64;
+
   static constexpr int kNumRingbufferRoles = 2;
 
  public:
@@ -60,6 +69,11 @@ class Reactor final : public BusyPollingLoop {
   // Returns the file descriptors for the underlying ring buffer.
   std::tuple<int, int> fds() const;
 
+  // Have the reactor's thread also poll the given epoll loop, which must not
+  // run a thread of its own, so that a single thread serves both. The reactor
+  // then also waits for the loop's handlers to be unregistered before closing.
+  void pollEpollLoop(EpollLoop& epollLoop);
+
   void close();
 
   void join();
@@ -76,7 +90,7 @@ class Reactor final : public BusyPollingLoop {
   ShmSegment dataSegment_;
   RingBuffer<kNumRingbufferRoles> rb_;
 
-  std::mutex mutex_;
+  Mutex mutex_{"shm_reactor"};
   std::atomic<bool> closed_{false};
   std::atomic<bool> joined_{false};
 
@@ -93,6 +107,9 @@ class Reactor final : public BusyPollingLoop {
   // Count how many functions are registered.
   std::atomic<uint64_t> functionCount_{0};
 
+  std::atomic<EpollLoop*> epollLoop_{nullptr};
+  int numIterationsSinceEpollPoll_{0};
+
  public:
   class Trigger {
    public:
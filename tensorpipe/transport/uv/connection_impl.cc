@@ -8,12 +8,21 @@
 
 #include <tensorpipe/transport/uv/connection_impl.h>
 
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
 #include <deque>
+#include <tuple>
 
 #include <tensorpipe/common/callback.h>
 #include <tensorpipe/common/defs.h>
 #include <tensorpipe/common/error_macros.h>
+#include <tensorpipe/common/loop_stats.h>
 #include <tensorpipe/common/optional.h>
 #include <tensorpipe/common/stream_read_write_ops.h>
 #include <tensorpipe/transport/uv/context_impl.h>
@@ -26,6 +35,55 @@ namespace tensorpipe {
 namespace transport {
 namespace uv {
 
+namespace {
+
+// If the data keeps arriving in a layout that can't be mapped (e.g., because
+// the NIC doesn't split headers from payloads) stop trying, as each attempt has
+// a cost (a few syscalls, and faulting in again the pages it remapped).
+constexpr size_t kMaxNumZeroCopyReceiveMisses = 4;
+
+// The kernel takes the length as a 32-bit integer.
+constexpr size_t kMaxZeroCopyReceiveLength = 1UL << 30;
+
+size_t getPageSize() {
+  static const size_t pageSize = ::sysconf(_SC_PAGESIZE);
+  return pageSize;
+}
+
+// Allocate the buffer for a read whose length is only known once its header
+// arrives. Large enough ones get pages of their own, as those are the only
+// buffers into which the received pages may be mapped: the transport owns them
+// and releases them (with whatever is mapped there) after the callback fires.
+std::shared_ptr<char> allocateReadBuffer(
+    size_t length,
+    size_t zeroCopyReceiveThreshold) {
+  if (length >= zeroCopyReceiveThreshold) {
+    const size_t pageSize = getPageSize();
+    const size_t mappedLength = (length + pageSize - 1) / pageSize * pageSize;
+    void* ptr = ::mmap(
+        /*addr=*/nullptr,
+        mappedLength,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        /*fd=*/-1,
+        /*off=*/0);
+    if (ptr != MAP_FAILED) {
+      return std::shared_ptr<char>(
+          reinterpret_cast<char*>(ptr),
+          [mappedLength](char* ptr) { ::munmap(ptr, mappedLength); });
+    }
+    // This runs on the loop, hence it mustn't throw: the data is just copied
+    // into a regular buffer instead, which isn't page-aligned.
+    TP_LOG_WARNING() << "Couldn't map " << mappedLength
+                     << " bytes for a read (" << ::strerror(errno)
+                     << "), falling back to a copy";
+  }
+  return std::shared_ptr<char>(
+      new char[length](), std::default_delete<char[]>());
+}
+
+} // namespace
+
 ConnectionImpl::ConnectionImpl(
     ConstructorToken token,
     std::shared_ptr<ContextImpl> context,
@@ -70,10 +128,28 @@ void ConnectionImpl::initImplFromLoop() {
   handle_->armReadCallbackFromLoop([this](ssize_t nread, const uv_buf_t* buf) {
     this->readCallbackFromLoop(nread, buf);
   });
+
+  if (context_->busyPollBudget().count() > 0) {
+    auto rv = handle_->setBusyPollFromLoop(context_->busyPollBudget());
+    if (rv < 0) {
+      // This is just an optimization, hence we can proceed without it.
+      TP_VLOG(9) << "Connection " << id_
+                 << " couldn't enable busy polling on its socket ("
+                 << formatUvError(rv) << ")";
+    }
+  }
 }
 
 void ConnectionImpl::readImplFromLoop(read_callback_fn fn) {
-  readOperations_.emplace_back(std::move(fn));
+  if (context_->zeroCopyReceiveThreshold() > 0) {
+    readOperations_.emplace_back(
+        std::move(fn),
+        [threshold{context_->zeroCopyReceiveThreshold()}](size_t length) {
+          return allocateReadBuffer(length, threshold);
+        });
+  } else {
+    readOperations_.emplace_back(std::move(fn));
+  }
 
   // Start reading if this is the first read operation.
   if (readOperations_.size() == 1) {
@@ -116,13 +192,64 @@ void ConnectionImpl::allocCallbackFromLoop(uv_buf_t* buf) {
   TP_THROW_ASSERT_IF(readOperations_.empty());
   TP_VLOG(9) << "Connection " << id_
              << " has incoming data for which it needs to provide a buffer";
-  readOperations_.front().allocFromLoop(&buf->base, &buf->len);
+  auto& readOperation = readOperations_.front();
+  if (context_->zeroCopyReceiveThreshold() > 0 && !zeroCopyReceiveDisabled_ &&
+      readOperation.readingPayloadIntoOwnBufferFromLoop()) {
+    receiveWithZeroCopyFromLoop(readOperation);
+  }
+  readOperation.allocFromLoop(&buf->base, &buf->len);
+}
+
+void ConnectionImpl::receiveWithZeroCopyFromLoop(
+    StreamReadOperation& readOperation) {
+  char* base;
+  size_t len;
+  readOperation.allocFromLoop(&base, &len);
+  const size_t pageSize = getPageSize();
+  if (len < context_->zeroCopyReceiveThreshold() ||
+      reinterpret_cast<uintptr_t>(base) % pageSize != 0) {
+    return;
+  }
+  // Always leave some data to be read by libuv, as it needs a non-empty buffer
+  // and as this way the operation can't complete here.
+  const size_t zeroCopyLen =
+      std::min((len - 1) / pageSize * pageSize, kMaxZeroCopyReceiveLength);
+  if (zeroCopyLen == 0) {
+    return;
+  }
+
+  int rv;
+  size_t numBytesMapped;
+  size_t numBytesToCopy;
+  std::tie(rv, numBytesMapped, numBytesToCopy) =
+      handle_->receiveWithZeroCopyFromLoop(base, zeroCopyLen);
+  if (rv < 0) {
+    // This is just an optimization, hence we can proceed without it.
+    TP_VLOG(9) << "Connection " << id_
+               << " couldn't receive data without copies ("
+               << formatUvError(rv) << ")";
+    zeroCopyReceiveDisabled_ = true;
+    return;
+  }
+  TP_VLOG(9) << "Connection " << id_ << " received " << numBytesMapped
+             << " bytes without copies";
+  if (numBytesMapped > 0) {
+    numZeroCopyReceiveMisses_ = 0;
+    readOperation.readFromLoop(numBytesMapped);
+  } else if (numBytesToCopy > 0) {
+    if (++numZeroCopyReceiveMisses_ == kMaxNumZeroCopyReceiveMisses) {
+      TP_VLOG(9) << "Connection " << id_
+                 << " is giving up on receiving data without copies";
+      zeroCopyReceiveDisabled_ = true;
+    }
+  }
 }
 
 void ConnectionImpl::readCallbackFromLoop(
     ssize_t nread,
     const uv_buf_t* /* unused */) {
   TP_DCHECK(context_->inLoop());
+  LoopStats::HandlerScope scope(id_, "uv_read");
   TP_VLOG(9) << "Connection " << id_ << " has completed reading some data ("
              << (nread >= 0 ? std::to_string(nread) + " bytes"
                             : formatUvError(nread))
@@ -150,6 +277,7 @@ void ConnectionImpl::readCallbackFromLoop(
 
 void ConnectionImpl::writeCallbackFromLoop(int status) {
   TP_DCHECK(context_->inLoop());
+  LoopStats::HandlerScope scope(id_, "uv_write");
   TP_VLOG(9) << "Connection " << id_ << " has completed a write request ("
              << formatUvError(status) << ")";
 
@@ -58,6 +58,10 @@ class ConnectionImpl final : public ConnectionImplBoilerplate<
   // Called when libuv is about to read data from connection.
   void allocCallbackFromLoop(uv_buf_t* buf);
 
+  // Called before handing libuv the buffer of a read, if enabled, to receive
+  // part of it without copies.
+  void receiveWithZeroCopyFromLoop(StreamReadOperation& readOperation);
+
   // Called when libuv has read data from connection.
   void readCallbackFromLoop(ssize_t nread, const uv_buf_t* buf);
 
@@ -72,6 +76,11 @@ class ConnectionImpl final : public ConnectionImplBoilerplate<
 
   std::deque<StreamReadOperation> readOperations_;
   std::deque<StreamWriteOperation> writeOperations_;
+
+  // Set when zero-copy receive turns out not to work on this connection.
+  bool zeroCopyReceiveDisabled_{false};
+  // How many attempts in a row failed because of how the data was laid out.
+  size_t numZeroCopyReceiveMisses_{0};
 };
 
 } // namespace uv
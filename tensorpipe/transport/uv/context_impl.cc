@@ -28,34 +28,82 @@ std::string generateDomainDescriptor() {
 
 } // namespace
 
-std::shared_ptr<ContextImpl> ContextImpl::create() {
-  return std::make_shared<ContextImpl>();
+std::shared_ptr<ContextImpl> ContextImpl::create(
+    std::chrono::microseconds busyPollBudget) {
+  return std::make_shared<ContextImpl>(
+      std::make_shared<Loop>(busyPollBudget), /*isLoopShared=*/false);
 }
 
-ContextImpl::ContextImpl()
+std::shared_ptr<ContextImpl> ContextImpl::create(LoopPool& loopPool) {
+  std::shared_ptr<Loop> loop = loopPool.getLoop<Loop>(
+      "uv", []() { return std::make_shared<Loop>(); });
+  return std::make_shared<ContextImpl>(std::move(loop), /*isLoopShared=*/true);
+}
+
+std::shared_ptr<ContextImpl> ContextImpl::create(
+    size_t zeroCopyReceiveThreshold) {
+  return std::make_shared<ContextImpl>(
+      std::make_shared<Loop>(),
+      /*isLoopShared=*/false,
+      zeroCopyReceiveThreshold);
+}
+
+ContextImpl::ContextImpl(
+    std::shared_ptr<Loop> loop,
+    bool isLoopShared,
+    size_t zeroCopyReceiveThreshold)
     : ContextImplBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl>(
-          generateDomainDescriptor()) {}
+          generateDomainDescriptor()),
+      loop_(std::move(loop)),
+      isLoopShared_(isLoopShared),
+      zeroCopyReceiveThreshold_(zeroCopyReceiveThreshold) {}
 
 void ContextImpl::handleErrorImpl() {
-  loop_.close();
+  if (isLoopShared_) {
+    return;
+  }
+  if (loop_->busyPollBudget().count() > 0) {
+    BusyPollStats stats = loop_->getBusyPollStats();
+    TP_VLOG(7) << "Transport context " << id_ << " busy polled "
+               << stats.numSpins << " times, with " << stats.numHits
+               << " hits and " << stats.numMisses << " misses, using "
+               << stats.spinCpuTime.count() / 1000 << "us of CPU time";
+  }
+  loop_->close();
 }
 
 void ContextImpl::joinImpl() {
-  loop_.join();
+  if (isLoopShared_) {
+    waitUntilAllUnenrolled();
+    return;
+  }
+  loop_->join();
 }
 
 bool ContextImpl::inLoop() const {
-  return loop_.inLoop();
+  return loop_->inLoop();
 };
 
 void ContextImpl::deferToLoop(std::function<void()> fn) {
-  loop_.deferToLoop(std::move(fn));
+  loop_->deferToLoop(std::move(fn));
 };
 
 std::unique_ptr<TCPHandle> ContextImpl::createHandle() {
-  return std::make_unique<TCPHandle>(loop_.ptr(), loop_);
+  return std::make_unique<TCPHandle>(loop_->ptr(), *loop_);
 };
 
+std::chrono::microseconds ContextImpl::busyPollBudget() const {
+  return loop_->busyPollBudget();
+}
+
+BusyPollStats ContextImpl::getBusyPollStats() const {
+  return loop_->getBusyPollStats();
+}
+
+size_t ContextImpl::zeroCopyReceiveThreshold() const {
+  return zeroCopyReceiveThreshold_;
+}
+
 } // namespace uv
 } // namespace transport
 } // namespace tensorpipe
@@ -8,12 +8,15 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstddef>
 #include <functional>
 #include <memory>
 #include <string>
 #include <tuple>
 
 #include <tensorpipe/common/error.h>
+#include <tensorpipe/common/loop_pool.h>
 #include <tensorpipe/transport/context_impl_boilerplate.h>
 #include <tensorpipe/transport/uv/loop.h>
 #include <tensorpipe/transport/uv/uv.h>
@@ -28,9 +31,17 @@ class ListenerImpl;
 class ContextImpl final
     : public ContextImplBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl> {
  public:
-  static std::shared_ptr<ContextImpl> create();
+  static std::shared_ptr<ContextImpl> create(
+      std::chrono::microseconds busyPollBudget = std::chrono::microseconds(0));
 
-  ContextImpl();
+  static std::shared_ptr<ContextImpl> create(LoopPool& loopPool);
+
+  static std::shared_ptr<ContextImpl> create(size_t zeroCopyReceiveThreshold);
+
+  ContextImpl(
+      std::shared_ptr<Loop> loop,
+      bool isLoopShared,
+      size_t zeroCopyReceiveThreshold = 0);
 
   // Implement the DeferredExecutor interface.
   bool inLoop() const override;
@@ -38,13 +49,26 @@ class ContextImpl final
 
   std::unique_ptr<TCPHandle> createHandle();
 
+  // Zero if busy polling is disabled.
+  std::chrono::microseconds busyPollBudget() const;
+
+  BusyPollStats getBusyPollStats() const;
+
+  // Zero if zero-copy receive is disabled.
+  size_t zeroCopyReceiveThreshold() const;
+
  protected:
   // Implement the entry points called by ContextImplBoilerplate.
   void handleErrorImpl() override;
   void joinImpl() override;
 
  private:
-  Loop loop_;
+  const std::shared_ptr<Loop> loop_;
+
+  // A loop shared with other contexts can't be closed and joined with this one.
+  const bool isLoopShared_;
+
+  const size_t zeroCopyReceiveThreshold_;
 };
 
 } // namespace uv
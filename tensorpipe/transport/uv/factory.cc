@@ -22,6 +22,25 @@ std::shared_ptr<Context> create() {
       ContextBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl>>();
 }
 
+std::shared_ptr<Context> create(LoopPool& loopPool) {
+  return std::make_shared<
+      ContextBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl>>(loopPool);
+}
+
+std::shared_ptr<Context> createWithBusyPolling(
+    std::chrono::microseconds busyPollBudget) {
+  return std::make_shared<
+      ContextBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl>>(
+      busyPollBudget);
+}
+
+std::shared_ptr<Context> createWithZeroCopyReceive(
+    size_t zeroCopyReceiveThreshold) {
+  return std::make_shared<
+      ContextBoilerplate<ContextImpl, ListenerImpl, ConnectionImpl>>(
+      zeroCopyReceiveThreshold);
+}
+
 } // namespace uv
 } // namespace transport
 } // namespace tensorpipe
@@ -8,8 +8,11 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstddef>
 #include <memory>
 
+#include <tensorpipe/common/loop_pool.h>
 #include <tensorpipe/transport/context.h>
 
 namespace tensorpipe {
@@ -18,6 +21,33 @@ namespace uv {
 
 std::shared_ptr<Context> create();
 
+// Create a context that runs on one of the loops of the given pool, shared with
+// other contexts, rather than on a thread of its own.
+std::shared_ptr<Context> create(LoopPool& loopPool);
+
+// Create a context meant for latency-critical deployments, whose event loop,
+// before going to sleep in the kernel, spins for up to the given budget waiting
+// for new events, and whose sockets ask the kernel to busy poll the device for
+// the same amount of time. This trades CPU usage (the loop thread will keep a
+// core busy while traffic flows) for lower wakeup latency.
+std::shared_ptr<Context> createWithBusyPolling(
+    std::chrono::microseconds busyPollBudget);
+
+// Create a context whose connections, when reading at least the given number of
+// bytes without being given a buffer (i.e., with read(fn)), allocate pages for
+// them and try to have the kernel map the received pages there (with
+// TCP_ZEROCOPY_RECEIVE) instead of copying them. This only succeeds when the
+// data arrives laid out in whole pages (typically with a NIC that splits
+// headers from payloads and a suitable MTU); otherwise, or on kernels that
+// don't support it, the data is copied as usual. The data passed to the
+// callback of such reads may thus be read-only, and it's only valid until the
+// callback returns. Buffers provided by the user are never remapped, hence this
+// doesn't apply to the payloads and tensors of pipes (nor to the basic
+// channel), which are always read into buffers given by the user: only the
+// users of raw connections that read with read(fn) can benefit from it.
+std::shared_ptr<Context> createWithZeroCopyReceive(
+    size_t zeroCopyReceiveThreshold);
+
 } // namespace uv
 } // namespace transport
 } // namespace tensorpipe
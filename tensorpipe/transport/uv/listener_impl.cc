@@ -10,6 +10,7 @@
 
 #include <tensorpipe/common/callback.h>
 #include <tensorpipe/common/error_macros.h>
+#include <tensorpipe/common/loop_stats.h>
 #include <tensorpipe/transport/uv/connection_impl.h>
 #include <tensorpipe/transport/uv/context_impl.h>
 #include <tensorpipe/transport/uv/error.h>
@@ -60,6 +61,7 @@ std::string ListenerImpl::addrImplFromLoop() const {
 
 void ListenerImpl::connectionCallbackFromLoop(int status) {
   TP_DCHECK(context_->inLoop());
+  LoopStats::HandlerScope scope(id_, "uv_accept");
   TP_VLOG(9) << "Listener " << id_
              << " has an incoming connection ready to be accepted ("
              << formatUvError(status) << ")";
@@ -8,6 +8,9 @@
 
 #include <tensorpipe/transport/uv/loop.h>
 
+#include <poll.h>
+#include <time.h>
+
 #include <tensorpipe/common/system.h>
 #include <tensorpipe/transport/uv/uv.h>
 
@@ -15,7 +18,19 @@ namespace tensorpipe {
 namespace transport {
 namespace uv {
 
-Loop::Loop() {
+namespace {
+
+std::chrono::nanoseconds getThreadCpuTime() {
+  struct timespec ts;
+  auto rv = ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  TP_THROW_SYSTEM_IF(rv < 0, errno);
+  return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+} // namespace
+
+Loop::Loop(std::chrono::microseconds busyPollBudget)
+    : busyPollBudget_(busyPollBudget) {
   int rv;
   rv = uv_loop_init(&loop_);
   TP_THROW_UV_IF(rv < 0, rv);
@@ -47,6 +62,15 @@ Loop::~Loop() noexcept {
   join();
 }
 
+BusyPollStats Loop::getBusyPollStats() const {
+  BusyPollStats stats;
+  stats.numSpins = numSpins_;
+  stats.numHits = numHits_;
+  stats.numMisses = numMisses_;
+  stats.spinCpuTime = std::chrono::nanoseconds(spinCpuTimeNs_);
+  return stats;
+}
+
 void Loop::wakeupEventLoopToDeferFunction() {
   auto rv = uv_async_send(&async_);
   TP_THROW_UV_IF(rv < 0, rv);
@@ -55,9 +79,64 @@ void Loop::wakeupEventLoopToDeferFunction() {
 void Loop::eventLoop() {
   int rv;
 
-  rv = uv_run(&loop_, UV_RUN_DEFAULT);
-  TP_THROW_ASSERT_IF(rv > 0)
-      << ": uv_run returned with active handles or requests";
+  if (busyPollBudget_.count() == 0) {
+    rv = uv_run(&loop_, UV_RUN_DEFAULT);
+    TP_THROW_ASSERT_IF(rv > 0)
+        << ": uv_run returned with active handles or requests";
+    return;
+  }
+
+  // This is equivalent to UV_RUN_DEFAULT, except that before each blocking
+  // iteration we first spin for a while with non-blocking ones, hoping that an
+  // event becomes ready in the meantime and that we can thus avoid paying for
+  // the kernel putting us to sleep and waking us up again.
+  while (uv_loop_alive(&loop_)) {
+    if (!spinUntilReady()) {
+      uv_run(&loop_, UV_RUN_ONCE);
+    }
+  }
+}
+
+bool Loop::spinUntilReady() {
+  const std::chrono::nanoseconds cpuTimeBefore = getThreadCpuTime();
+  const auto deadline = std::chrono::steady_clock::now() + busyPollBudget_;
+  bool ready;
+  do {
+    ready = readyToRun();
+    // Even when nothing is ready we must run the loop, as that's also where
+    // libuv registers with the kernel the handles that started reading since
+    // the last iteration, and until it does we couldn't see their events.
+    uv_run(&loop_, UV_RUN_NOWAIT);
+    numSpins_++;
+  } while (!ready && uv_loop_alive(&loop_) &&
+           std::chrono::steady_clock::now() < deadline);
+  const std::chrono::nanoseconds cpuTimeAfter = getThreadCpuTime();
+
+  if (ready) {
+    numHits_++;
+  } else {
+    numMisses_++;
+  }
+  spinCpuTimeNs_ += (cpuTimeAfter - cpuTimeBefore).count();
+
+  return ready;
+}
+
+bool Loop::readyToRun() {
+  // A zero timeout means that libuv has pending callbacks, closing handles or
+  // expired timers (or nothing left to wait for), hence it won't block.
+  if (uv_backend_timeout(&loop_) == 0) {
+    return true;
+  }
+  // Otherwise check whether the backend's file descriptor (i.e., the epoll set)
+  // has any readiness event queued, without actually consuming it.
+  struct pollfd pfd;
+  pfd.fd = uv_backend_fd(&loop_);
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  auto rv = ::poll(&pfd, 1, /*timeout=*/0);
+  TP_THROW_SYSTEM_IF(rv < 0 && errno != EINTR, errno);
+  return rv > 0;
 }
 
 void Loop::cleanUpLoop() {
@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <future>
 #include <memory>
@@ -24,9 +26,24 @@ namespace tensorpipe {
 namespace transport {
 namespace uv {
 
+// Counters describing the effectiveness of busy polling. A "hit" is a spin
+// phase that found an event ready before its budget ran out, thus sparing the
+// loop from going to sleep in the kernel. The CPU time is the one spent by the
+// loop's thread while spinning (i.e., not handling events).
+struct BusyPollStats {
+  uint64_t numSpins{0};
+  uint64_t numHits{0};
+  uint64_t numMisses{0};
+  std::chrono::nanoseconds spinCpuTime{0};
+};
+
 class Loop final : public EventLoopDeferredExecutor {
  public:
-  Loop();
+  // If the busy-poll budget is non-zero, before blocking in the kernel to wait
+  // for events the loop will spin for up to that amount of time checking
+  // whether any event became ready.
+  explicit Loop(
+      std::chrono::microseconds busyPollBudget = std::chrono::microseconds(0));
 
   uv_loop_t* ptr() {
     return &loop_;
@@ -36,6 +53,12 @@ class Loop final : public EventLoopDeferredExecutor {
     return closed_;
   }
 
+  std::chrono::microseconds busyPollBudget() const {
+    return busyPollBudget_;
+  }
+
+  BusyPollStats getBusyPollStats() const;
+
   void close();
 
   void join();
@@ -58,6 +81,21 @@ class Loop final : public EventLoopDeferredExecutor {
   std::atomic<bool> closed_{false};
   std::atomic<bool> joined_{false};
 
+  const std::chrono::microseconds busyPollBudget_;
+
+  // These are only written by the loop thread, but may be read by any thread.
+  std::atomic<uint64_t> numSpins_{0};
+  std::atomic<uint64_t> numHits_{0};
+  std::atomic<uint64_t> numMisses_{0};
+  std::atomic<int64_t> spinCpuTimeNs_{0};
+
+  // Spin until an event is ready or until the budget is exhausted. Returns
+  // whether an event was found.
+  bool spinUntilReady();
+
+  // Whether a call to uv_run would find something to do without blocking.
+  bool readyToRun();
+
   // This function is called by the event loop thread whenever
   // we have to run a number of deferred functions.
   static void uvAsyncCb(uv_async_t* handle);
@@ -8,8 +8,19 @@
 
 #pragma once
 
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <tuple>
 
 #include <uv.h>
 
@@ -296,6 +307,97 @@ class TCPHandle : public StreamHandle<TCPHandle, uv_tcp_t> {
     auto rv = ConnectRequest::perform(ptr(), addr.addr(), std::move(fn));
     TP_THROW_UV_IF(rv < 0, rv);
   }
+
+  // Ask the kernel to busy poll the device queue for up to the given time when
+  // a read on this socket finds no data. This can only be done once the socket
+  // has been created (i.e., after a connect or an accept). Returns a negative
+  // errno on failure (e.g., EPERM when lacking CAP_NET_ADMIN to go beyond the
+  // system-wide default), which callers will probably want to tolerate.
+  [[nodiscard]] int setBusyPollFromLoop(std::chrono::microseconds budget) {
+    TP_DCHECK(this->executor_.inLoop());
+#ifdef SO_BUSY_POLL
+    uv_os_fd_t fd;
+    auto rv = uv_fileno(reinterpret_cast<uv_handle_t*>(ptr()), &fd);
+    if (rv < 0) {
+      return rv;
+    }
+    int value = budget.count();
+    rv = ::setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value));
+    if (rv < 0) {
+      return -errno;
+    }
+    return 0;
+#else
+    return UV_ENOTSUP;
+#endif
+  }
+
+  // Receive into the given range, which must be page-aligned, consist of whole
+  // pages, and belong to a private anonymous mapping owned by the caller (never
+  // to memory provided by the user, whose pages this replaces), by mapping
+  // there the pages of the socket's receive queue rather than copying them. Only the whole pages that have already arrived
+  // are attempted, and for that their range gets remapped to the socket: the
+  // pages that were filled stay mapped to it, read-only, whereas the others are
+  // mapped back to (zeroed) private anonymous memory. Returns an error code
+  // (UV_ENOTSUP if the kernel can't do this at all), the number of bytes that
+  // were received (zero if they couldn't be mapped, e.g., because they're not
+  // laid out in whole pages, or if they haven't arrived yet), and the number of
+  // bytes that must be read normally before this can be attempted again.
+  [[nodiscard]] std::tuple<int, size_t, size_t> receiveWithZeroCopyFromLoop(
+      void* dst,
+      size_t length) {
+    TP_DCHECK(this->executor_.inLoop());
+#ifdef TCP_ZEROCOPY_RECEIVE
+    uv_os_fd_t fd;
+    auto rv = uv_fileno(reinterpret_cast<uv_handle_t*>(ptr()), &fd);
+    if (rv < 0) {
+      return std::make_tuple(rv, 0, 0);
+    }
+    // Remapping pages that won't be filled has a cost, as they'll have to be
+    // faulted in again, hence don't go beyond what's in the receive queue.
+    int numBytesAvailable;
+    rv = ::ioctl(fd, FIONREAD, &numBytesAvailable);
+    if (rv < 0) {
+      return std::make_tuple(-errno, 0, 0);
+    }
+    const size_t pageSize = ::sysconf(_SC_PAGESIZE);
+    length = std::min(length, numBytesAvailable / pageSize * pageSize);
+    if (length == 0) {
+      return std::make_tuple(0, 0, 0);
+    }
+    void* addr =
+        ::mmap(dst, length, PROT_READ, MAP_SHARED | MAP_FIXED, fd, /*off=*/0);
+    struct tcp_zerocopy_receive zc;
+    std::memset(&zc, 0, sizeof(zc));
+    if (addr == MAP_FAILED) {
+      rv = -errno;
+    } else {
+      zc.address = reinterpret_cast<uint64_t>(dst);
+      zc.length = length;
+      socklen_t zcLen = sizeof(zc);
+      rv = ::getsockopt(fd, IPPROTO_TCP, TCP_ZEROCOPY_RECEIVE, &zc, &zcLen);
+      if (rv < 0) {
+        rv = errno == ENOPROTOOPT ? UV_ENOTSUP : -errno;
+        zc.length = 0;
+      }
+    }
+    // A failed MAP_FIXED may have removed the previous mapping, hence restore
+    // it in that case too, so that the range is always fully accessible.
+    if (zc.length < length) {
+      addr = ::mmap(
+          reinterpret_cast<uint8_t*>(dst) + zc.length,
+          length - zc.length,
+          PROT_READ | PROT_WRITE,
+          MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+          /*fd=*/-1,
+          /*off=*/0);
+      TP_THROW_SYSTEM_IF(addr == MAP_FAILED, errno);
+    }
+    return std::make_tuple(rv, zc.length, zc.recv_skip_hint);
+#else
+    return std::make_tuple(UV_ENOTSUP, 0, 0);
+#endif
+  }
 };
 
 struct AddrinfoDeleter {